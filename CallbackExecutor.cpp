@@ -0,0 +1,195 @@
+// tracking - CallbackExecutor.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <string>
+#include "CallbackExecutor.h"
+
+namespace {
+std::atomic<size_t> configuredWorkers{CallbackExecutor::kDefaultWorkers};
+std::atomic<bool> instanceCreated{false};
+
+std::string workerLabel(size_t index) {
+    return "worker=\"" + std::to_string(index) + "\"";
+}
+}
+
+/**
+ * Register a worker's instruments
+ * @param index worker number, used as its label
+ */
+CallbackExecutor::Worker::Worker(size_t index)
+        : depth(Metrics::instance().gauge("tracking_callback_queue_depth",
+                                          "Callbacks waiting for a worker", workerLabel(index))),
+          peakDepth(Metrics::instance().gauge("tracking_callback_queue_depth_max",
+                                              "Most callbacks ever waiting for a worker", workerLabel(index))),
+          wait(Metrics::instance().histogram("tracking_callback_queue_wait_seconds",
+                                             "Time from posting a callback to running it", workerLabel(index))),
+          full(Metrics::instance().counter("tracking_callback_queue_full_total",
+                                           "Posts that found the queue full and spilled to the overflow list",
+                                           workerLabel(index))) {
+}
+
+/**
+ * Set the worker count of the process-wide executor
+ * @param workers number of worker threads, at least one
+ * @return true if it will be used
+ * @return false if the executor already exists
+ */
+bool CallbackExecutor::configure(size_t workers) {
+    if (instanceCreated.load()) {
+        return false;
+    }
+    configuredWorkers.store(std::max<size_t>(workers, 1));
+    return true;
+}
+
+/**
+ * The process-wide executor
+ * @return CallbackExecutor& executor with the configured number of workers
+ */
+CallbackExecutor &CallbackExecutor::instance() {
+    static CallbackExecutor executor((instanceCreated.store(true), configuredWorkers.load()));
+    return executor;
+}
+
+/**
+ * Constructor for the executor, starts the workers
+ * @param workers number of worker threads, at least one
+ */
+CallbackExecutor::CallbackExecutor(size_t workers) {
+    const size_t count = std::max<size_t>(workers, 1);
+    this->workers.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        this->workers.push_back(std::make_unique<Worker>(i));
+    }
+    for (auto &worker: this->workers) {
+        worker->thread = std::thread(&CallbackExecutor::run, this, std::ref(*worker));
+    }
+}
+
+CallbackExecutor::~CallbackExecutor() {
+    stop();
+}
+
+/**
+ * Wait for a key's callbacks
+ * Posts a marker behind them and waits for it to run.
+ * @param key key whose worker to flush
+ * @return void
+ */
+void CallbackExecutor::flush(size_t key) {
+    std::promise<void> done;
+    std::future<void> ran = done.get_future();
+    if (!post(key, [&done] {
+        done.set_value();
+    })) {
+        return;
+    }
+    ran.wait();
+}
+
+/**
+ * Stop every worker once its queue is empty
+ * @return void
+ */
+void CallbackExecutor::stop() {
+    stopped.store(true);
+    for (auto &worker: workers) {
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->stopping = true;
+        }
+        worker->wake.notify_one();
+    }
+    for (auto &worker: workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+/**
+ * Worker loop
+ * Runs tasks while there are any, the queue first and then the overflow list,
+ * whose tasks were all posted after the queued ones. When both look empty it
+ * flags itself asleep, looks once more (a post may have raced the flag) and
+ * only then waits.
+ * @param worker the worker this thread drains
+ * @return void
+ */
+void CallbackExecutor::run(Worker &worker) {
+    Item item;
+    for (;;) {
+        if (worker.queue.tryPop(item)) {
+            worker.wait.record(Clock::now() - item.posted);
+            item.task();
+            item.task = Task();
+            worker.depth.set(static_cast<int64_t>(worker.queue.size()));
+            continue;
+        }
+        if (worker.queue.size() > 0) {
+            // A poster claimed a cell but has not finished writing it.
+            std::this_thread::yield();
+            continue;
+        }
+        if (worker.overflowing.load(std::memory_order_acquire)) {
+            std::deque<Item> spilled;
+            {
+                std::lock_guard<std::mutex> lock(worker.overflowMutex);
+                spilled.swap(worker.overflow);
+                // Posts from here on may use the queue again, they run after this batch.
+                worker.overflowing.store(false, std::memory_order_release);
+            }
+            for (Item &spill: spilled) {
+                worker.wait.record(Clock::now() - spill.posted);
+                spill.task();
+            }
+            continue;
+        }
+        worker.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.wake.wait(lock, [&worker] {
+                return worker.stopping || worker.queue.size() > 0
+                       || worker.overflowing.load(std::memory_order_acquire);
+            });
+            stopping = worker.stopping;
+        }
+        worker.sleeping.store(false, std::memory_order_relaxed);
+        if (stopping && worker.queue.size() == 0 && !worker.overflowing.load(std::memory_order_acquire)) {
+            return;
+        }
+    }
+}
+
+/**
+ * Close the gate
+ * Posts and calls already inside hold the lock, so after it is taken none is
+ * running and none can start; the flush then waits for what they posted.
+ * @return void
+ */
+void CallbackGate::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    executor.flush(key);
+}
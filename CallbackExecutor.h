@@ -0,0 +1,280 @@
+// tracking - CallbackExecutor.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_CALLBACKEXECUTOR_H
+#define TRACKING_CALLBACKEXECUTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Metrics.h"
+#include "MpscQueue.h"
+
+/**
+ * Worker pool that runs subscription callbacks off the MAVSDK receive thread.
+ *
+ * Every key (a vehicle's system id) maps to one worker, and each worker drains
+ * its own lock-free MpscQueue in order, so callbacks of one vehicle run one at
+ * a time and in the order they were posted, while a slow handler only holds up
+ * the vehicles sharing its worker. Tasks are stored inline in the queue cell;
+ * posting never allocates while there is room. A full queue spills into the
+ * worker's overflow list, which takes every later post too until the worker
+ * has drained it after the queue, so posting never waits, never drops a
+ * callback and never reorders one, whichever thread posts.
+ *
+ * Idle workers sleep on a condition variable and are only notified when they
+ * actually sleep, so a busy worker costs the poster no system call.
+ */
+class CallbackExecutor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Largest callable a task can hold, captures included.
+    static constexpr size_t kTaskBytes = 128;
+    static constexpr size_t kQueueCapacity = 1024;
+    static constexpr size_t kDefaultWorkers = 2;
+
+    /// Type-erased callable with inline storage; move-only.
+    class Task {
+    public:
+        Task() = default;
+
+        template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+        explicit Task(F &&callable) {
+            using Callable = std::decay_t<F>;
+            static_assert(sizeof(Callable) <= kTaskBytes, "Callback captures too much, raise kTaskBytes");
+            static_assert(alignof(Callable) <= alignof(std::max_align_t), "Callback is over-aligned");
+            new(storage) Callable(std::forward<F>(callable));
+            ops = &kOps<Callable>;
+        }
+
+        Task(Task &&other) noexcept {
+            moveFrom(other);
+        }
+
+        Task &operator=(Task &&other) noexcept {
+            if (this != &other) {
+                reset();
+                moveFrom(other);
+            }
+            return *this;
+        }
+
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task() {
+            reset();
+        }
+
+        void operator()() {
+            ops->invoke(storage);
+        }
+
+        explicit operator bool() const {
+            return ops != nullptr;
+        }
+
+    private:
+        struct Ops {
+            void (*invoke)(void *);
+            /// Move-construct into the destination and destroy the source.
+            void (*relocate)(void *from, void *to);
+            void (*destroy)(void *);
+        };
+
+        template<typename Callable>
+        static constexpr Ops kOps{
+                [](void *self) { (*static_cast<Callable *>(self))(); },
+                [](void *from, void *to) {
+                    new(to) Callable(std::move(*static_cast<Callable *>(from)));
+                    static_cast<Callable *>(from)->~Callable();
+                },
+                [](void *self) { static_cast<Callable *>(self)->~Callable(); }};
+
+        void moveFrom(Task &other) {
+            if (other.ops != nullptr) {
+                other.ops->relocate(other.storage, storage);
+                ops = other.ops;
+                other.ops = nullptr;
+            }
+        }
+
+        void reset() {
+            if (ops != nullptr) {
+                ops->destroy(storage);
+                ops = nullptr;
+            }
+        }
+
+        alignas(std::max_align_t) unsigned char storage[kTaskBytes]{};
+        const Ops *ops{nullptr};
+    };
+
+    /**
+     * Set the worker count of the process-wide executor.
+     * @return false if instance() was already called, the count is then fixed
+     */
+    static bool configure(size_t workers);
+
+    /// The process-wide executor, started on first use.
+    static CallbackExecutor &instance();
+
+    explicit CallbackExecutor(size_t workers);
+    ~CallbackExecutor();
+
+    CallbackExecutor(const CallbackExecutor &) = delete;
+    CallbackExecutor &operator=(const CallbackExecutor &) = delete;
+
+    /**
+     * Run the callable on the key's worker, after everything posted for that key before it.
+     * @return false if the executor is stopping, the callable is dropped
+     */
+    template<typename F>
+    bool post(size_t key, F &&callable) {
+        if (stopped.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        Worker &worker = *workers[key % workers.size()];
+        const Clock::time_point now = Clock::now();
+        // Once anything overflowed, later posts go behind it so none overtakes it.
+        if (worker.overflowing.load(std::memory_order_acquire)
+            || !worker.queue.tryEmplace([&callable, now](Item &item) {
+                item.task = Task(std::forward<F>(callable));
+                item.posted = now;
+            })) {
+            std::lock_guard<std::mutex> lock(worker.overflowMutex);
+            worker.overflow.push_back(Item{Task(std::forward<F>(callable)), now});
+            worker.overflowing.store(true, std::memory_order_release);
+            worker.full.add();
+        }
+        worker.peakDepth.raise(static_cast<int64_t>(worker.queue.size()));
+        // Pairs with the fence in run(): either we see it asleep or it sees the task.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (worker.sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.wake.notify_one();
+        }
+        return true;
+    };
+
+    /**
+     * Wait until everything posted for the key so far has run.
+     * Must not be called from a worker thread. Returns at once once stopped.
+     */
+    void flush(size_t key);
+
+    /// Run everything queued, then stop the workers. Posts made later are dropped.
+    void stop();
+
+    size_t workerCount() const {
+        return workers.size();
+    };
+
+private:
+    struct Item {
+        Task task;
+        Clock::time_point posted{};
+    };
+
+    struct Worker {
+        explicit Worker(size_t index);
+
+        MpscQueue<Item, kQueueCapacity> queue;
+        /// Posts that found the queue full, in order; set while it holds any, so later posts queue behind them.
+        std::mutex overflowMutex;
+        std::deque<Item> overflow;
+        std::atomic<bool> overflowing{false};
+        alignas(64) std::atomic<bool> sleeping{false};
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping{false};
+        std::thread thread;
+
+        Gauge &depth;
+        Gauge &peakDepth;
+        Histogram &wait;
+        Counter &full;
+    };
+
+    void run(Worker &worker);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<bool> stopped{false};
+};
+
+/**
+ * Posting end of one key's worker that outlives its owner.
+ *
+ * MAVSDK keeps callbacks, and answers to async calls arrive, after the object
+ * they were made for may be gone. Such callbacks hold a shared_ptr to the gate
+ * and go through it instead of the object: close() shuts the gate under the
+ * same lock post() and call() check it under, then waits for what was posted,
+ * so once it returns nothing reaches the owner any more.
+ */
+class CallbackGate {
+public:
+    CallbackGate(CallbackExecutor &executor, size_t key) : executor(executor), key(key) {
+    };
+
+    CallbackGate(const CallbackGate &) = delete;
+    CallbackGate &operator=(const CallbackGate &) = delete;
+
+    /**
+     * Run the callable on the key's worker, see CallbackExecutor::post.
+     * @return false if the gate is closed, the callable is dropped
+     */
+    template<typename F>
+    bool post(F &&callable) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !closed && executor.post(key, std::forward<F>(callable));
+    };
+
+    /**
+     * Run the callable on the calling thread; close() waits for it. It must be short and must not use the gate.
+     * @return false if the gate is closed, the callable is not run
+     */
+    template<typename F>
+    bool call(F &&callable) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed) {
+            return false;
+        }
+        std::forward<F>(callable)();
+        return true;
+    };
+
+    /// Refuse every later post and call, then wait for the posted ones. Must not be called from a worker thread.
+    void close();
+
+private:
+    CallbackExecutor &executor;
+    const size_t key;
+    std::mutex mutex;
+    bool closed{false};
+};
+
+
+#endif //TRACKING_CALLBACKEXECUTOR_H
@@ -0,0 +1,370 @@
+// tracking - CameraPipeline.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include "CameraPipeline.h"
+#include "Geodesy.h"
+
+namespace {
+constexpr std::chrono::milliseconds kIdleBackoff{5};
+/// A camera clock further off than this from the arrival time is not trusted.
+constexpr std::chrono::seconds kMaxClockSkew{10};
+
+Counter &cameraCounter(const std::string &labels, const char *event) {
+    return Metrics::instance().counter("tracking_camera_total", "Survey triggers and captures by outcome",
+                                       labels + ",event=\"" + event + "\"");
+}
+
+/// A CSV field as RFC 4180 wants it: quoted, with quotes doubled, if it holds a separator, quote or line break.
+std::string csvField(const std::string &value) {
+    if (value.find_first_of(",\"\r\n") == std::string::npos) {
+        return value;
+    }
+    std::string quoted = "\"";
+    for (const char c: value) {
+        quoted += c;
+        if (c == '"') {
+            quoted += '"';
+        }
+    }
+    return quoted + '"';
+}
+}
+
+/**
+ * Register the counters of one vehicle
+ * @param labels labels identifying the vehicle
+ */
+CameraPipeline::Instruments::Instruments(const std::string &labels)
+        : triggered(cameraCounter(labels, "triggered")),
+          acknowledged(cameraCounter(labels, "acknowledged")),
+          failed(cameraCounter(labels, "failed")),
+          busy(cameraCounter(labels, "busy")),
+          captures(cameraCounter(labels, "captured")),
+          written(cameraCounter(labels, "written")),
+          dropped(cameraCounter(labels, "dropped")),
+          unmatched(cameraCounter(labels, "unmatched")),
+          poseOffset(Metrics::instance().histogram("tracking_camera_pose_offset_seconds",
+                                                   "Time between a capture and the pose it was tagged with",
+                                                   labels)) {
+}
+
+/**
+ * Constructor for the pipeline, nothing runs until start()
+ * @param sysid vehicle the photos belong to
+ */
+CameraPipeline::CameraPipeline(int sysid)
+        : sysid(sysid), instruments("sysid=\"" + std::to_string(sysid) + "\"") {
+}
+
+CameraPipeline::~CameraPipeline() {
+    stop();
+}
+
+/**
+ * Start triggering and geotagging
+ * @param config trigger schedule and join tolerance
+ * @param trigger starts one asynchronous photo
+ * @param geotagPath CSV file the geotags are appended to
+ * @return true if started
+ * @return false if already running or the file could not be opened
+ */
+bool CameraPipeline::start(const Config &config, Trigger trigger, const std::string &geotagPath) {
+    if (running.load()) {
+        return false;
+    }
+    geotags = std::fopen(geotagPath.c_str(), "a");
+    if (geotags == nullptr) {
+        return false;
+    }
+    std::fseek(geotags, 0, SEEK_END);
+    if (std::ftell(geotags) == 0) {
+        std::fprintf(geotags, "sysid,index,time_utc_us,success,latitude_deg,longitude_deg,absolute_altitude_m,"
+                              "relative_altitude_m,roll_deg,pitch_deg,yaw_deg,pose_offset_ms,file_url\n");
+    }
+    this->config = config;
+    this->trigger = std::move(trigger);
+    utcOffset = std::chrono::system_clock::now().time_since_epoch()
+                - std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                        Clock::now().time_since_epoch());
+    hasTriggered = false;
+    busyCounted = false;
+    inFlight.store(0);
+    {
+        std::lock_guard<std::mutex> lock(poseMutex);
+        poseCount = 0;
+        poseNext = 0;
+    }
+    running.store(true, std::memory_order_release);
+    writer = std::thread(&CameraPipeline::writerLoop, this);
+    scheduler = std::make_unique<FixedRateLoop>(config.pollHz, [this] { schedule(); });
+    scheduler->start();
+    return true;
+}
+
+/**
+ * Stop triggering, geotag everything already queued and close the file
+ * @return void
+ */
+void CameraPipeline::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    scheduler->stop();
+    scheduler.reset();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    std::fclose(geotags);
+    geotags = nullptr;
+}
+
+/**
+ * Cache a pose for the triggers and the join
+ * Called from the telemetry callback with every position fix.
+ * @param pose latest pose of the vehicle
+ * @return void
+ */
+void CameraPipeline::recordPose(const PoseSnapshot &pose) {
+    if (!running.load(std::memory_order_relaxed) || !pose.hasFix()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(poseMutex);
+    poses[poseNext] = pose;
+    poseNext = (poseNext + 1) % kPoseHistory;
+    poseCount = std::min(poseCount + 1, kPoseHistory);
+}
+
+bool CameraPipeline::latestPose(PoseSnapshot &out) const {
+    std::lock_guard<std::mutex> lock(poseMutex);
+    if (poseCount == 0) {
+        return false;
+    }
+    out = poses[(poseNext + kPoseHistory - 1) % kPoseHistory];
+    return true;
+}
+
+/**
+ * The camera's answer to a trigger
+ * Only the trigger in flight is answered: an answer to one that already timed
+ * out would otherwise clear, and be counted for, the trigger sent after it.
+ * @param trigger number the trigger was sent with
+ * @param accepted true if the camera took the photo
+ * @return void
+ */
+void CameraPipeline::onTriggerResult(uint64_t trigger, bool accepted) {
+    uint64_t expected = trigger;
+    if (trigger == 0 || !inFlight.compare_exchange_strong(expected, 0)) {
+        return;
+    }
+    (accepted ? instruments.acknowledged : instruments.failed).add();
+}
+
+/**
+ * Queue a capture for the writer
+ * @param capture what the camera reported
+ * @return true if queued
+ * @return false if stopped or the queue is full (counted as dropped)
+ */
+bool CameraPipeline::submitCapture(Capture &&capture) {
+    if (!running.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    instruments.captures.add();
+    if (!captures.tryEmplace([&capture](Capture &slot) { slot = std::move(capture); })) {
+        instruments.dropped.add();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * One scheduler tick: fire the trigger if a photo is due and the camera is free
+ * Distance is measured over ground from where the last trigger fired. The
+ * first tick with a fix always fires.
+ * @return void
+ */
+void CameraPipeline::schedule() {
+    PoseSnapshot pose;
+    if (!latestPose(pose)) {
+        return;
+    }
+    const Clock::time_point now = Clock::now();
+    bool due = !hasTriggered;
+    if (!due && config.distance_m > 0.0) {
+        due = geodesy::groundDistance({lastLatitude, lastLongitude, 0.0},
+                                      {pose.latitude_deg, pose.longitude_deg, 0.0}) >= config.distance_m;
+    }
+    if (!due && config.interval > Clock::duration::zero()) {
+        due = now - lastTrigger >= config.interval;
+    }
+    if (!due) {
+        return;
+    }
+
+    uint64_t pending = inFlight.load();
+    if (pending != 0) {
+        if (now - lastTrigger < config.ackTimeout) {
+            // Count each late photo once, not on every tick it waits.
+            if (!busyCounted) {
+                instruments.busy.add();
+                busyCounted = true;
+            }
+            return;
+        }
+        if (inFlight.compare_exchange_strong(pending, 0)) {
+            instruments.failed.add();
+        }
+    }
+
+    busyCounted = false;
+    hasTriggered = true;
+    lastTrigger = now;
+    lastLatitude = pose.latitude_deg;
+    lastLongitude = pose.longitude_deg;
+    instruments.triggered.add();
+    const uint64_t number = ++triggerCount;
+    inFlight.store(number);
+    if (!trigger(number)) {
+        inFlight.store(0);
+        instruments.failed.add();
+    }
+}
+
+CameraPipeline::Clock::time_point CameraPipeline::captureTime(const Capture &capture) const {
+    if (capture.time_utc_us == 0) {
+        return capture.received;
+    }
+    const auto utc = std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::microseconds(capture.time_utc_us));
+    const Clock::time_point time(std::chrono::duration_cast<Clock::duration>(utc - utcOffset));
+    const Clock::duration skew = time > capture.received ? time - capture.received : capture.received - time;
+    return skew < kMaxClockSkew ? time : capture.received;
+}
+
+/**
+ * Move queued captures to the waiting list and write those that can be joined
+ * A capture is written once a pose newer than it is cached, or once no such
+ * pose can be expected any more.
+ * @return size_t number of geotags written
+ */
+size_t CameraPipeline::drain() {
+    Capture capture;
+    while (captures.tryPop(capture)) {
+        waiting.push_back(std::move(capture));
+    }
+    PoseSnapshot latest;
+    const bool hasPose = latestPose(latest);
+    const Clock::time_point now = Clock::now();
+    size_t count = 0;
+    while (!waiting.empty()) {
+        const Clock::time_point time = captureTime(waiting.front());
+        const bool covered = hasPose && latest.positionTime >= time;
+        if (!covered && now - time < config.maxPoseGap && running.load(std::memory_order_relaxed)) {
+            break;
+        }
+        write(waiting.front());
+        waiting.pop_front();
+        ++count;
+    }
+    if (count > 0) {
+        std::fflush(geotags);
+    }
+    return count;
+}
+
+/**
+ * Join one capture with the nearest cached pose and append its geotag line
+ * @param capture what the camera reported
+ * @return void
+ */
+void CameraPipeline::write(const Capture &capture) {
+    const Clock::time_point time = captureTime(capture);
+    PoseSnapshot nearest;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(poseMutex);
+        // Poses arrive in time order: binary search the ring, oldest first.
+        const size_t oldest = (poseNext + kPoseHistory - poseCount) % kPoseHistory;
+        auto at = [&](size_t i) -> const PoseSnapshot & {
+            return poses[(oldest + i) % kPoseHistory];
+        };
+        size_t low = 0;
+        size_t high = poseCount;
+        while (low < high) {
+            const size_t middle = (low + high) / 2;
+            if (at(middle).positionTime < time) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        // low is the first pose at or after the capture; the one before it may be nearer.
+        if (low < poseCount) {
+            nearest = at(low);
+            found = true;
+        }
+        if (low > 0 && (!found || time - at(low - 1).positionTime < nearest.positionTime - time)) {
+            nearest = at(low - 1);
+            found = true;
+        }
+    }
+    const Clock::duration offset = found ? nearest.positionTime - time : Clock::duration::zero();
+    if (found && (offset > config.maxPoseGap || -offset > config.maxPoseGap)) {
+        found = false;
+    }
+
+    if (found) {
+        instruments.poseOffset.record(offset < Clock::duration::zero() ? -offset : offset);
+        std::fprintf(geotags, "%d,%d,%llu,%d,%.8f,%.8f,%.2f,%.2f,%.1f,%.1f,%.1f,%.1f,%s\n", sysid, capture.index,
+                     static_cast<unsigned long long>(capture.time_utc_us), capture.success ? 1 : 0,
+                     nearest.latitude_deg, nearest.longitude_deg, nearest.absolute_altitude_m,
+                     nearest.relative_altitude_m, nearest.roll_deg, nearest.pitch_deg, nearest.yaw_deg,
+                     std::chrono::duration<double, std::milli>(offset).count(), csvField(capture.fileUrl).c_str());
+    } else {
+        instruments.unmatched.add();
+        std::fprintf(geotags, "%d,%d,%llu,%d,,,,,,,,,%s\n", sysid, capture.index,
+                     static_cast<unsigned long long>(capture.time_utc_us), capture.success ? 1 : 0,
+                     csvField(capture.fileUrl).c_str());
+    }
+    instruments.written.add();
+}
+
+void CameraPipeline::writerLoop() {
+    while (running.load(std::memory_order_relaxed)) {
+        drain();
+        std::this_thread::sleep_for(kIdleBackoff);
+    }
+    // Stopped: everything still queued or waiting is written with what is cached.
+    drain();
+}
+
+/**
+ * Counters since the process started
+ * @return Stats trigger and capture counts
+ */
+CameraPipeline::Stats CameraPipeline::stats() const {
+    Stats result;
+    result.triggered = instruments.triggered.value();
+    result.acknowledged = instruments.acknowledged.value();
+    result.failed = instruments.failed.value();
+    result.busy = instruments.busy.value();
+    result.captures = instruments.captures.value();
+    result.written = instruments.written.value();
+    result.dropped = instruments.dropped.value();
+    result.unmatched = instruments.unmatched.value();
+    return result;
+}
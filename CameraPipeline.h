@@ -0,0 +1,195 @@
+// tracking - CameraPipeline.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_CAMERAPIPELINE_H
+#define TRACKING_CAMERAPIPELINE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "FixedRateLoop.h"
+#include "Metrics.h"
+#include "MpscQueue.h"
+#include "PoseSnapshot.h"
+
+/**
+ * Survey photos for one vehicle: scheduled triggers and a streaming geotag index.
+ *
+ * A scheduler thread fires the trigger every distance_m flown and/or every
+ * interval. The trigger only starts an asynchronous photo; while the camera has
+ * not answered the previous one, due triggers are counted as busy instead of
+ * piling up. Captures reported by the camera go into a bounded lock-free queue
+ * (a full queue drops and counts, never blocks the caller), and a writer thread
+ * joins each with the cached pose nearest to its capture time and appends a
+ * CSV line to the geotag file. A capture is held back until a pose newer than
+ * it has arrived (or maxPoseGap has passed), so both neighbours are seen.
+ * Nothing here ever waits on the camera, so a slow camera cannot hold up
+ * telemetry or the follow loop.
+ *
+ * Poses come from recordPose(), called with every new position fix.
+ */
+class CameraPipeline {
+public:
+    using Clock = PoseSnapshot::Clock;
+
+    /// Poses kept for the join, about 25 s of 10 Hz telemetry.
+    static constexpr size_t kPoseHistory = 256;
+    static constexpr size_t kQueueCapacity = 256;
+
+    struct Config {
+        /// Trigger every this many meters over ground, 0 for no distance trigger.
+        double distance_m = 0.0;
+        /// Trigger at least this often, zero for no time trigger.
+        Clock::duration interval{};
+        /// A trigger the camera has not answered by then is counted failed and the next one may go.
+        Clock::duration ackTimeout = std::chrono::seconds(2);
+        /// How often the scheduler looks at the triggers, clamped like any FixedRateLoop.
+        int pollHz = 50;
+        /// Captures with no pose this close in time are written without a position.
+        Clock::duration maxPoseGap = std::chrono::milliseconds(500);
+    };
+
+    /// What the camera reported about one image.
+    struct Capture {
+        int32_t index{};
+        /// Capture time on the camera's UTC clock, 0 if it has none.
+        uint64_t time_utc_us{};
+        bool success{};
+        /// When the report arrived, used when the camera has no usable clock.
+        Clock::time_point received{};
+        std::string fileUrl;
+    };
+
+    struct Stats {
+        uint64_t triggered{};
+        /// Triggers the camera accepted.
+        uint64_t acknowledged{};
+        /// Triggers rejected by the camera, refused by the trigger function, or never answered.
+        uint64_t failed{};
+        /// Triggers that came due while the previous one was still unanswered.
+        uint64_t busy{};
+        uint64_t captures{};
+        /// Geotag lines written.
+        uint64_t written{};
+        /// Captures lost to a full queue.
+        uint64_t dropped{};
+        /// Captures written without a position, no pose near enough.
+        uint64_t unmatched{};
+    };
+
+    /**
+     * Starts one photo without waiting for it; the answer goes to onTriggerResult() with the trigger's number.
+     * Runs on the scheduler thread. Returns false if the request could not be made.
+     */
+    using Trigger = std::function<bool(uint64_t trigger)>;
+
+    /// @param sysid vehicle the photos belong to, labels the metrics
+    explicit CameraPipeline(int sysid);
+    ~CameraPipeline();
+
+    CameraPipeline(const CameraPipeline &) = delete;
+    CameraPipeline &operator=(const CameraPipeline &) = delete;
+
+    /// Open the geotag file (appending) and start both threads. False if running or the file cannot be opened.
+    bool start(const Config &config, Trigger trigger, const std::string &geotagPath);
+
+    /// Stop triggering, write what is queued and close the file.
+    void stop();
+
+    bool isRunning() const {
+        return running.load(std::memory_order_acquire);
+    };
+
+    /// Cache a pose for the triggers and the join. Cheap and a no-op while stopped.
+    void recordPose(const PoseSnapshot &pose);
+
+    /// The camera's answer to the numbered trigger, ignored unless that one is still in flight. Any thread.
+    void onTriggerResult(uint64_t trigger, bool accepted);
+
+    /// Queue a capture for geotagging. Never blocks; false while stopped or when the queue is full.
+    bool submitCapture(Capture &&capture);
+
+    Stats stats() const;
+
+private:
+    /// Registered once per vehicle, counted without locks.
+    struct Instruments {
+        explicit Instruments(const std::string &labels);
+
+        Counter &triggered;
+        Counter &acknowledged;
+        Counter &failed;
+        Counter &busy;
+        Counter &captures;
+        Counter &written;
+        Counter &dropped;
+        Counter &unmatched;
+        /// Time between a capture and the pose it was tagged with.
+        Histogram &poseOffset;
+    };
+
+    void schedule();
+    void writerLoop();
+    size_t drain();
+    void write(const Capture &capture);
+    /// Capture time on the monotonic clock.
+    Clock::time_point captureTime(const Capture &capture) const;
+    bool latestPose(PoseSnapshot &out) const;
+
+    const int sysid;
+    Instruments instruments;
+
+    Config config{};
+    Trigger trigger;
+    std::unique_ptr<FixedRateLoop> scheduler;
+    std::thread writer;
+    std::atomic<bool> running{false};
+    std::FILE *geotags{nullptr};
+    /// system_clock minus steady_clock at start, to put camera UTC times on the monotonic clock.
+    std::chrono::system_clock::duration utcOffset{};
+
+    // Scheduler state, only touched on the scheduler thread.
+    bool hasTriggered{false};
+    Clock::time_point lastTrigger{};
+    double lastLatitude{};
+    double lastLongitude{};
+    bool busyCounted{false};
+    /// Numbers every trigger ever sent, never reset: a late answer from an earlier survey must not match.
+    uint64_t triggerCount{0};
+    /// Number of the unanswered trigger, sent at lastTrigger; zero when none is in flight.
+    std::atomic<uint64_t> inFlight{0};
+
+    /// Ring of recent poses, oldest overwritten first, in arrival order.
+    mutable std::mutex poseMutex;
+    std::array<PoseSnapshot, kPoseHistory> poses{};
+    size_t poseCount{0};
+    size_t poseNext{0};
+
+    MpscQueue<Capture, kQueueCapacity> captures;
+    /// Writer thread only: captures waiting for a pose newer than them.
+    std::deque<Capture> waiting;
+};
+
+
+#endif //TRACKING_CAMERAPIPELINE_H
@@ -0,0 +1,258 @@
+// tracking - CommandQueue.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include "CommandQueue.h"
+
+namespace {
+CommandQueue::Clock::duration interval(double hz) {
+    return std::chrono::duration_cast<CommandQueue::Clock::duration>(std::chrono::duration<double>(1.0 / hz));
+}
+
+Counter &queueCounter(const std::string &labels, const char *channel, const char *event) {
+    return Metrics::instance().counter("tracking_command_queue_total",
+                                       "Outbound setpoints by what happened to them",
+                                       labels + ",channel=\"" + channel + "\",event=\"" + event + "\"");
+}
+}
+
+/**
+ * Register the counters of one channel
+ * @param labels labels identifying the vehicle
+ * @param channel channel name
+ */
+CommandQueue::Instruments::Instruments(const std::string &labels, const char *channel)
+        : submitted(queueCounter(labels, channel, "submitted")),
+          sent(queueCounter(labels, channel, "sent")),
+          coalesced(queueCounter(labels, channel, "coalesced")),
+          keepAlives(queueCounter(labels, channel, "keep_alive")),
+          dropped(queueCounter(labels, channel, "dropped")),
+          failed(queueCounter(labels, channel, "failed")),
+          delay(Metrics::instance().histogram("tracking_command_queue_delay_seconds",
+                                              "Time a setpoint waited in the outbound queue",
+                                              labels + ",channel=\"" + channel + "\"")) {
+}
+
+/**
+ * Constructor for the queue, the sending thread starts with start()
+ * @param config rates
+ * @param sender called on the queue's thread for every send
+ * @param labels labels for the queue's metrics
+ */
+CommandQueue::CommandQueue(const Config &config, Sender sender, const std::string &labels)
+        : sender(std::move(sender)),
+          instruments{Instruments(labels, "offboard"), Instruments(labels, "follow_target")} {
+    setConfig(config);
+}
+
+CommandQueue::~CommandQueue() {
+    stop();
+}
+
+/**
+ * Start the sending thread
+ * @return true if started
+ * @return false if it is already running or was stopped
+ */
+bool CommandQueue::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running || stopped) {
+        return false;
+    }
+    running = true;
+    worker = std::thread(&CommandQueue::run, this);
+    return true;
+}
+
+/**
+ * Stop the sending thread, unsent setpoints are dropped
+ * @return void
+ */
+void CommandQueue::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        running = false;
+        for (size_t c = 0; c < kChannels; ++c) {
+            if (slots[c].pending) {
+                slots[c].pending = false;
+                instruments[c].dropped.add();
+            }
+        }
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+/**
+ * Queue a setpoint
+ * An unsent setpoint on the same channel is replaced and counted as coalesced.
+ * @param command setpoint
+ * @return true if queued
+ * @return false if the queue was stopped
+ */
+bool CommandQueue::submit(const OutboundCommand &command) {
+    const auto channel = static_cast<size_t>(channelOf(command.kind));
+    bool coalesced;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopped) {
+            instruments[channel].dropped.add();
+            return false;
+        }
+        Slot &slot = slots[channel];
+        instruments[channel].submitted.add();
+        coalesced = slot.pending;
+        if (coalesced) {
+            instruments[channel].coalesced.add();
+        } else {
+            slot.queued = Clock::now();
+            slot.pending = true;
+        }
+        slot.command = command;
+    }
+    // A replaced setpoint does not move the sender's deadline, only a new one needs a wake-up.
+    if (!coalesced) {
+        wake.notify_one();
+    }
+    return true;
+}
+
+/**
+ * Turn keep-alive resends on or off
+ * @param channel channel
+ * @param enabled resend the last setpoint when no new one arrives
+ * @return void
+ */
+void CommandQueue::setKeepAlive(Channel channel, bool enabled) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slots[static_cast<size_t>(channel)].keepAlive = enabled;
+    }
+    wake.notify_one();
+}
+
+/**
+ * Forget a channel's setpoints
+ * @param channel channel
+ * @return void
+ */
+void CommandQueue::clear(Channel channel) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Slot &slot = slots[static_cast<size_t>(channel)];
+    if (slot.pending) {
+        instruments[static_cast<size_t>(channel)].dropped.add();
+    }
+    slot.pending = false;
+    slot.hasLast = false;
+}
+
+/**
+ * Change the rates, takes effect from the next send
+ * @param config rates; keep-alive is clamped to [2 Hz, maxRate_hz]
+ * @return void
+ */
+void CommandQueue::setConfig(const Config &config) {
+    const double maxRate = std::max(config.maxRate_hz, kMinKeepAliveHz);
+    const double keepAlive = std::clamp(config.keepAlive_hz, kMinKeepAliveHz, maxRate);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        minInterval = interval(maxRate);
+        keepAliveInterval = interval(keepAlive);
+    }
+    wake.notify_one();
+}
+
+/**
+ * Totals over every channel
+ * @return Stats
+ */
+CommandQueue::Stats CommandQueue::stats() const {
+    Stats total;
+    for (const Instruments &channel: instruments) {
+        total.submitted += channel.submitted.value();
+        total.sent += channel.sent.value();
+        total.coalesced += channel.coalesced.value();
+        total.keepAlives += channel.keepAlives.value();
+        total.dropped += channel.dropped.value();
+        total.failed += channel.failed.value();
+    }
+    return total;
+}
+
+/**
+ * Sending thread
+ * Sends each channel's pending setpoint once its rate interval since the last
+ * send has passed, or resends the last one once a keep-alive interval has,
+ * and otherwise sleeps until the earliest of those deadlines or a submit.
+ * The sender runs without the lock held, so submit never waits on the link.
+ * @return void
+ */
+void CommandQueue::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        const Clock::time_point now = Clock::now();
+        Clock::time_point next = Clock::time_point::max();
+        size_t due = kChannels;
+        bool resend = false;
+        for (size_t c = 0; c < kChannels && due == kChannels; ++c) {
+            const Slot &slot = slots[c];
+            Clock::time_point at = Clock::time_point::max();
+            if (slot.pending) {
+                at = slot.lastSend + minInterval;
+            } else if (slot.keepAlive && slot.hasLast) {
+                at = slot.lastSend + keepAliveInterval;
+            }
+            if (at <= now) {
+                due = c;
+                resend = !slot.pending;
+            } else {
+                next = std::min(next, at);
+            }
+        }
+        if (due == kChannels) {
+            if (next == Clock::time_point::max()) {
+                wake.wait(lock);
+            } else {
+                wake.wait_until(lock, next);
+            }
+            continue;
+        }
+
+        Slot &slot = slots[due];
+        const OutboundCommand command = slot.command;
+        const Clock::time_point queued = slot.queued;
+        slot.pending = false;
+        slot.hasLast = true;
+        slot.lastSend = now;
+        lock.unlock();
+
+        Instruments &counters = instruments[due];
+        if (resend) {
+            counters.keepAlives.add();
+        } else {
+            counters.delay.record(now - queued);
+        }
+        if (sender(command)) {
+            counters.sent.add();
+        } else {
+            counters.failed.add();
+        }
+        lock.lock();
+    }
+}
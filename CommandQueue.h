@@ -0,0 +1,171 @@
+// tracking - CommandQueue.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_COMMANDQUEUE_H
+#define TRACKING_COMMANDQUEUE_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Metrics.h"
+
+/// One outbound setpoint, whatever MAVLink message ends up carrying it.
+struct OutboundCommand {
+    enum class Kind : uint8_t {
+        /// Global position, altitude above mean sea level.
+        PositionGlobal,
+        /// Global position, altitude relative to home.
+        PositionGlobalRelative,
+        VelocityNed,
+        /// Global position with a NED velocity feed-forward.
+        PositionVelocity,
+        /// Follow-me target location with its velocity.
+        FollowTarget,
+    };
+
+    Kind kind{};
+    double latitude_deg{};
+    double longitude_deg{};
+    float altitude_m{};
+    float north_m_s{};
+    float east_m_s{};
+    float down_m_s{};
+    float yaw_deg{};
+};
+
+/**
+ * Per-vehicle outbound setpoint queue: latest wins, rate capped, kept alive.
+ *
+ * Callers submit as fast as they like; a setpoint that has not gone out yet is
+ * replaced by the next one on the same channel (offboard setpoints of any kind
+ * share one channel, follow-me targets have their own), so a slow link carries
+ * only the newest. A dedicated thread sends at most maxRate_hz per channel and,
+ * on channels with keep-alive on, resends the last setpoint when nothing new
+ * came for a keep-alive period, so offboard mode does not time out.
+ *
+ * submit() takes a short mutex and never allocates or blocks on the link.
+ */
+class CommandQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Sender = std::function<bool(const OutboundCommand &)>;
+
+    enum class Channel : uint8_t {
+        Offboard,
+        FollowTarget,
+    };
+    static constexpr size_t kChannels = 2;
+
+    /// Offboard mode falls back when setpoints stop for 0.5 s, anything under 2 Hz is useless.
+    static constexpr double kMinKeepAliveHz = 2.0;
+
+    struct Config {
+        /// Most setpoints sent per second, per channel. 20 Hz is what MAVSDK's offboard resend uses too.
+        double maxRate_hz = 20.0;
+        /// Resend rate while keep-alive is on and no new setpoint arrives, clamped to [2, maxRate_hz].
+        double keepAlive_hz = 4.0;
+    };
+
+    struct Stats {
+        uint64_t submitted{};
+        uint64_t sent{};
+        /// Replaced by a newer setpoint before they were sent.
+        uint64_t coalesced{};
+        /// Resends of the last setpoint.
+        uint64_t keepAlives{};
+        /// Discarded unsent by clear() or after stop().
+        uint64_t dropped{};
+        /// Sends the sender reported as failed.
+        uint64_t failed{};
+    };
+
+    /**
+     * @param config rates
+     * @param sender does the actual send on the queue's thread, returns false on failure
+     * @param labels Prometheus labels for the queue's counters, e.g. sysid="2"
+     */
+    CommandQueue(const Config &config, Sender sender, const std::string &labels);
+    ~CommandQueue();
+
+    CommandQueue(const CommandQueue &) = delete;
+    CommandQueue &operator=(const CommandQueue &) = delete;
+
+    bool start();
+    void stop();
+
+    /// Queue a setpoint, replacing any unsent one on its channel. False once stopped.
+    bool submit(const OutboundCommand &command);
+
+    /// Turn resending of the channel's last setpoint on or off.
+    void setKeepAlive(Channel channel, bool enabled);
+
+    /// Drop the channel's unsent setpoint and forget its last one, e.g. when leaving offboard.
+    void clear(Channel channel);
+
+    void setConfig(const Config &config);
+
+    Stats stats() const;
+
+    static Channel channelOf(OutboundCommand::Kind kind) {
+        return kind == OutboundCommand::Kind::FollowTarget ? Channel::FollowTarget : Channel::Offboard;
+    };
+
+private:
+    struct Slot {
+        OutboundCommand command{};
+        bool pending{};
+        bool hasLast{};
+        bool keepAlive{};
+        Clock::time_point lastSend{};
+        /// When the pending setpoint was submitted, for the queue delay histogram.
+        Clock::time_point queued{};
+    };
+
+    /// Registered once, counted without locks.
+    struct Instruments {
+        Instruments(const std::string &labels, const char *channel);
+
+        Counter &submitted;
+        Counter &sent;
+        Counter &coalesced;
+        Counter &keepAlives;
+        Counter &dropped;
+        Counter &failed;
+        Histogram &delay;
+    };
+
+    void run();
+
+    const Sender sender;
+    std::array<Instruments, kChannels> instruments;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    Clock::duration minInterval;
+    Clock::duration keepAliveInterval;
+    std::array<Slot, kChannels> slots{};
+    bool running{false};
+    bool stopped{false};
+    std::thread worker;
+};
+
+
+#endif //TRACKING_COMMANDQUEUE_H
@@ -0,0 +1,111 @@
+// tracking - ConnectionManager.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <fstream>
+#include "ConnectionManager.h"
+#include "Logger.h"
+
+using namespace std;
+
+ConnectionManager::ConnectionManager()
+        : m_mavsdk(std::make_unique<Mavsdk>(Mavsdk::Configuration{Mavsdk::ComponentType::GroundStation})) {
+}
+
+ConnectionManager::~ConnectionManager() {
+    m_fleet.reset();
+    m_mavsdk.reset();
+}
+
+/**
+ * Add a link to the shared MAVSDK instance
+ * @param url MAVSDK connection URL
+ * @return true if success
+ * @return false if failed
+ */
+bool ConnectionManager::addEndpoint(const string &url) {
+    const ConnectionResult result = m_mavsdk->add_any_connection(url);
+    if (result != ConnectionResult::Success) {
+        LOG_ERROR("Connection to {} failed: {}", url, result);
+        return false;
+    }
+    m_endpoints.push_back(url);
+    LOG_INFO("Listening on {}", url);
+    return true;
+}
+
+/**
+ * Add several links to the shared MAVSDK instance
+ * @param urls MAVSDK connection URLs
+ * @return size_t number of links that were added
+ */
+size_t ConnectionManager::addEndpoints(const vector<string> &urls) {
+    size_t added = 0;
+    for (const string &url: urls) {
+        if (addEndpoint(url)) {
+            ++added;
+        }
+    }
+    return added;
+}
+
+/**
+ * Load endpoint URLs from a file
+ * @param path path of the endpoint list
+ * @return vector<string> endpoint URLs, empty if the file could not be read
+ */
+vector<string> ConnectionManager::loadEndpoints(const string &path) {
+    vector<string> urls;
+    ifstream in(path);
+    if (!in) {
+        LOG_ERROR("Could not read endpoint list {}", path);
+        return urls;
+    }
+    string line;
+    while (getline(in, line)) {
+        const size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == string::npos || line[begin] == '#') {
+            continue;
+        }
+        const size_t end = line.find_last_not_of(" \t\r");
+        urls.push_back(line.substr(begin, end - begin + 1));
+    }
+    return urls;
+}
+
+/**
+ * Wait for the first autopilot to show up on any link
+ * @param timeout_s timeout in seconds
+ * @return the system, empty on timeout
+ */
+optional<shared_ptr<System>> ConnectionManager::waitForAutopilot(double timeout_s) {
+    return m_mavsdk->first_autopilot(timeout_s);
+}
+
+/**
+ * Create the fleet shared by all links
+ * Calling it again returns the existing fleet.
+ * @param mainSystemId system id of our own plane
+ * @param rates telemetry stream rates requested from every plane
+ * @param commandRates setpoint send and keep-alive rates for every plane
+ * @return Fleet& the fleet
+ */
+Fleet &ConnectionManager::createFleet(uint8_t mainSystemId, const TelemetryRates &rates,
+                                      const CommandQueue::Config &commandRates) {
+    if (!m_fleet) {
+        m_fleet = std::make_unique<Fleet>(*m_mavsdk, mainSystemId, rates, commandRates);
+    }
+    return *m_fleet;
+}
@@ -0,0 +1,85 @@
+// tracking - ConnectionManager.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_CONNECTIONMANAGER_H
+#define TRACKING_CONNECTIONMANAGER_H
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "Fleet.h"
+
+/**
+ * Owns the one MAVSDK instance of the process and every link attached to it.
+ *
+ * Any number of UDP/TCP/serial endpoints can be added; MAVSDK routes the
+ * systems from all of them into the same instance, and a single Fleet is
+ * built on top of it. One process can therefore serve several SITL
+ * instances or radios with one set of MAVSDK receive threads.
+ */
+class ConnectionManager {
+public:
+    ConnectionManager();
+    ~ConnectionManager();
+
+    ConnectionManager(const ConnectionManager &) = delete;
+    ConnectionManager &operator=(const ConnectionManager &) = delete;
+
+    /**
+     * Add a link by MAVSDK connection URL, e.g.
+     * udp://:14540, tcp://127.0.0.1:5760 or serial:///dev/ttyUSB0:57600.
+     * @return false if MAVSDK rejected it
+     */
+    bool addEndpoint(const std::string &url);
+
+    /// Add every endpoint in the list, returns how many were accepted.
+    size_t addEndpoints(const std::vector<std::string> &urls);
+
+    /**
+     * Read endpoint URLs from a text file, one per line.
+     * Blank lines and lines starting with '#' are ignored.
+     */
+    static std::vector<std::string> loadEndpoints(const std::string &path);
+
+    /// Wait for the first autopilot on any link.
+    std::optional<std::shared_ptr<System>> waitForAutopilot(double timeout_s);
+
+    /// Create the fleet for all links; the given system id is our own (main) plane.
+    Fleet &createFleet(uint8_t mainSystemId, const TelemetryRates &rates = TelemetryRates{},
+                       const CommandQueue::Config &commandRates = CommandQueue::Config{});
+
+    Fleet *fleet() const {
+        return m_fleet.get();
+    }
+
+    Mavsdk &mavsdk() {
+        return *m_mavsdk;
+    }
+
+    const std::vector<std::string> &endpoints() const {
+        return m_endpoints;
+    }
+
+private:
+    // Declaration order matters: the fleet must be destroyed before MAVSDK.
+    std::unique_ptr<Mavsdk> m_mavsdk;
+    std::unique_ptr<Fleet> m_fleet;
+    std::vector<std::string> m_endpoints;
+};
+
+
+#endif //TRACKING_CONNECTIONMANAGER_H
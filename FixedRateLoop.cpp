@@ -0,0 +1,119 @@
+// tracking - FixedRateLoop.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include "FixedRateLoop.h"
+
+namespace {
+int clampRate(int rateHz) {
+    return std::clamp(rateHz, FixedRateLoop::minRateHz, FixedRateLoop::maxRateHz);
+}
+}
+
+/**
+ * Constructor for the loop
+ * @param rateHz tick rate, clamped to [10, 100] Hz
+ * @param body function called on every tick from the loop thread
+ */
+FixedRateLoop::FixedRateLoop(int rateHz, std::function<void()> body)
+        : rateHz(clampRate(rateHz)),
+          tickPeriod(std::chrono::duration_cast<Clock::duration>(
+                  std::chrono::duration<double>(1.0 / clampRate(rateHz)))),
+          body(std::move(body)) {
+}
+
+FixedRateLoop::~FixedRateLoop() {
+    stop();
+}
+
+/**
+ * Start the loop thread
+ * @return true if started
+ * @return false if it was already running
+ */
+bool FixedRateLoop::start() {
+    bool expected = false;
+    if (!running.compare_exchange_strong(expected, true)) {
+        return false;
+    }
+    worker = std::thread(&FixedRateLoop::run, this);
+    return true;
+}
+
+/**
+ * Stop the loop thread and wait for it to exit
+ * @return void
+ */
+void FixedRateLoop::stop() {
+    running.store(false, std::memory_order_release);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+/**
+ * Loop body
+ * Deadlines are absolute, so time spent in the body does not push later ticks back.
+ * If a tick overruns past one or more deadlines they are skipped, not replayed.
+ * @return void
+ */
+void FixedRateLoop::run() {
+    Clock::time_point deadline = Clock::now() + tickPeriod;
+    while (running.load(std::memory_order_acquire)) {
+        std::this_thread::sleep_until(deadline);
+        recordJitter(Clock::now() - deadline);
+
+        body();
+        ticks.fetch_add(1, std::memory_order_relaxed);
+
+        deadline += tickPeriod;
+        const Clock::time_point finished = Clock::now();
+        if (finished > deadline) {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+            const auto behind = (finished - deadline) / tickPeriod;
+            missedTicks.fetch_add(static_cast<uint64_t>(behind), std::memory_order_relaxed);
+            deadline += tickPeriod * (behind + 1);
+        }
+    }
+}
+
+/**
+ * Get a copy of the tick statistics
+ * @return Stats
+ */
+FixedRateLoop::Stats FixedRateLoop::stats() const {
+    Stats result;
+    result.ticks = ticks.load(std::memory_order_relaxed);
+    result.overruns = overruns.load(std::memory_order_relaxed);
+    result.missedTicks = missedTicks.load(std::memory_order_relaxed);
+    result.lastJitter = std::chrono::nanoseconds(lastJitterNs.load(std::memory_order_relaxed));
+    result.maxJitter = std::chrono::nanoseconds(maxJitterNs.load(std::memory_order_relaxed));
+    if (result.ticks > 0) {
+        result.meanJitter = std::chrono::nanoseconds(
+                totalJitterNs.load(std::memory_order_relaxed) / static_cast<int64_t>(result.ticks));
+    }
+    return result;
+}
+
+void FixedRateLoop::recordJitter(Clock::duration jitter) {
+    const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(jitter).count();
+    lastJitterNs.store(ns, std::memory_order_relaxed);
+    totalJitterNs.fetch_add(ns, std::memory_order_relaxed);
+    // Only the loop thread writes, so a plain compare is enough.
+    if (ns > maxJitterNs.load(std::memory_order_relaxed)) {
+        maxJitterNs.store(ns, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,96 @@
+// tracking - FixedRateLoop.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_FIXEDRATELOOP_H
+#define TRACKING_FIXEDRATELOOP_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+/**
+ * Dedicated thread that calls a body at a fixed rate.
+ *
+ * Ticks are scheduled against absolute deadlines (start + n * period), so the
+ * loop does not drift the way a plain sleep_for loop does. Wake-up jitter and
+ * overruns are counted on every tick.
+ */
+class FixedRateLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        uint64_t ticks{};
+        /// Ticks that finished after the next deadline had already passed.
+        uint64_t overruns{};
+        /// Deadlines skipped entirely because of overruns.
+        uint64_t missedTicks{};
+        /// Wake-up lateness relative to the deadline.
+        Clock::duration lastJitter{};
+        Clock::duration maxJitter{};
+        Clock::duration meanJitter{};
+    };
+
+    static constexpr int minRateHz = 10;
+    static constexpr int maxRateHz = 100;
+
+    /// The rate is clamped to [minRateHz, maxRateHz].
+    FixedRateLoop(int rateHz, std::function<void()> body);
+    ~FixedRateLoop();
+
+    FixedRateLoop(const FixedRateLoop &) = delete;
+    FixedRateLoop &operator=(const FixedRateLoop &) = delete;
+
+    bool start();
+    void stop();
+
+    bool isRunning() const {
+        return running.load(std::memory_order_acquire);
+    };
+
+    Stats stats() const;
+
+    int rate() const {
+        return rateHz;
+    };
+
+    Clock::duration period() const {
+        return tickPeriod;
+    };
+
+private:
+    void run();
+    void recordJitter(Clock::duration jitter);
+
+    const int rateHz;
+    const Clock::duration tickPeriod;
+    const std::function<void()> body;
+
+    std::atomic<bool> running{false};
+    std::thread worker;
+
+    std::atomic<uint64_t> ticks{0};
+    std::atomic<uint64_t> overruns{0};
+    std::atomic<uint64_t> missedTicks{0};
+    std::atomic<int64_t> lastJitterNs{0};
+    std::atomic<int64_t> maxJitterNs{0};
+    std::atomic<int64_t> totalJitterNs{0};
+};
+
+
+#endif //TRACKING_FIXEDRATELOOP_H
@@ -0,0 +1,377 @@
+// tracking - Fleet.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
+#include "Fleet.h"
+#include "Logger.h"
+
+using namespace std;
+
+namespace {
+/// Time left until the deadline, zero once it has passed.
+chrono::milliseconds remaining(chrono::steady_clock::time_point deadline) {
+    const auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now());
+    return max(left, chrono::milliseconds::zero());
+}
+}
+
+/**
+ * Constructor for the fleet
+ * Registers the systems that are already known and starts listening for new ones.
+ * @param mavsdk MAVSDK instance, must outlive the fleet
+ * @param mainSystemId system id of our own (main) plane
+ * @param rates telemetry stream rates requested from every plane
+ * @param commandRates setpoint send and keep-alive rates for every plane
+ */
+Fleet::Fleet(Mavsdk &mavsdk, uint8_t mainSystemId, const TelemetryRates &rates,
+             const CommandQueue::Config &commandRates)
+        : mavsdk(mavsdk), mainSystemId(mainSystemId), rates(rates), commandRates(commandRates),
+          connectedView(std::make_shared<const std::vector<plane *>>()) {
+    for (size_t i = 0; i < index.size(); ++i) {
+        index[i].store(nullptr, std::memory_order_relaxed);
+        connected[i].store(false, std::memory_order_relaxed);
+    }
+    // Installed before the first scan, so no message from a registered plane goes uncounted.
+    mavsdk.intercept_incoming_messages_async([this](mavlink_message_t &message) {
+        onIncoming(message);
+        return true;
+    });
+    mavsdk.intercept_outgoing_messages_async([this](mavlink_message_t &message) {
+        onOutgoing(message);
+        return true;
+    });
+    scan();
+    discoverer = std::thread(&Fleet::discoveryLoop, this);
+    newSystemHandle = mavsdk.subscribe_on_new_system([this]() {
+        // Only flag it here, plane construction must not run on the callback thread.
+        {
+            std::lock_guard<std::mutex> lock(discoveryMutex);
+            scanRequested = true;
+        }
+        discoveryWake.notify_one();
+    });
+}
+
+Fleet::~Fleet() {
+    mavsdk.unsubscribe_on_new_system(newSystemHandle);
+    mavsdk.intercept_incoming_messages_async(nullptr);
+    mavsdk.intercept_outgoing_messages_async(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(discoveryMutex);
+        stopping = true;
+    }
+    discoveryWake.notify_one();
+    if (discoverer.joinable()) {
+        discoverer.join();
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (Entry &entry: entries) {
+        if (entry.system) {
+            entry.system->unsubscribe_is_connected(entry.connectionHandle);
+        }
+    }
+}
+
+/**
+ * Register every autopilot MAVSDK knows about that is not in the fleet yet
+ * New planes are constructed side by side, each on its own thread, and each is
+ * registered as soon as it is ready; a burst of systems at startup costs about
+ * one plane construction rather than one per plane.
+ * @return void
+ */
+void Fleet::scan() {
+    std::lock_guard<std::mutex> scanLock(scanMutex);
+    vector<shared_ptr<System>> found;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const std::shared_ptr<System> &system: mavsdk.systems()) {
+            if (system->has_autopilot() && !entries[system->get_system_id()].vehicle) {
+                found.push_back(system);
+            }
+        }
+    }
+    if (found.empty()) {
+        return;
+    }
+
+    // Construct outside the lock, plane construction subscribes to the vehicle.
+    vector<future<unique_ptr<plane>>> constructed;
+    constructed.reserve(found.size());
+    for (const std::shared_ptr<System> &system: found) {
+        const bool isMain = system->get_system_id() == mainSystemId;
+        constructed.push_back(std::async(std::launch::async, [this, system, isMain] {
+            return std::make_unique<plane>(system.get(), isMain, rates, commandRates);
+        }));
+    }
+
+    for (size_t i = 0; i < found.size(); ++i) {
+        const std::shared_ptr<System> &system = found[i];
+        const uint8_t sysid = system->get_system_id();
+        unique_ptr<plane> vehicle = constructed[i].get();
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            vehicle->setRecorder(recorder.load());
+            Entry &entry = entries[sysid];
+            entry.system = system;
+            entry.vehicle = std::move(vehicle);
+            index[sysid].store(entry.vehicle.get(), std::memory_order_release);
+            connected[sysid].store(system->is_connected(), std::memory_order_release);
+            entry.connectionHandle = system->subscribe_is_connected([this, sysid](bool isConnected) {
+                setConnected(sysid, isConnected);
+            });
+        }
+        LOG_INFO("Fleet: registered plane {}", sysid);
+        rebuildView();
+    }
+}
+
+/**
+ * Wait until the given number of planes is connected
+ * @param count planes needed, the main plane included
+ * @param timeout how long to wait
+ * @return true if that many are connected
+ * @return false if timed out
+ */
+bool Fleet::waitForPlanes(size_t count, chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(registryMutex);
+    return viewChanged.wait_for(lock, timeout, [this, count] { return view()->size() >= count; });
+}
+
+/**
+ * Attach a flight recorder to every registered plane and to planes registered later
+ * @param flightRecorder recorder, must outlive the fleet; nullptr detaches
+ * @return void
+ */
+void Fleet::setRecorder(FlightRecorder *flightRecorder) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    recorder.store(flightRecorder);
+    for (Entry &entry: entries) {
+        if (entry.vehicle) {
+            entry.vehicle->setRecorder(flightRecorder);
+        }
+    }
+}
+
+void Fleet::discoveryLoop() {
+    std::unique_lock<std::mutex> lock(discoveryMutex);
+    while (true) {
+        discoveryWake.wait(lock, [this] { return scanRequested || stopping; });
+        if (stopping) {
+            return;
+        }
+        scanRequested = false;
+        lock.unlock();
+        scan();
+        lock.lock();
+    }
+}
+
+void Fleet::setConnected(uint8_t sysid, bool isConnected) {
+    if (connected[sysid].exchange(isConnected, std::memory_order_acq_rel) == isConnected) {
+        return;
+    }
+    LOG_INFO("Fleet: plane {} {}", sysid, isConnected ? "reconnected" : "disconnected");
+    rebuildView();
+}
+
+/**
+ * Count a message from the link against the plane that sent it
+ * Runs on the MAVSDK receive thread for every message, so it only reads the
+ * header, plus the command id of acknowledgements. Sequence numbers are per
+ * component; only the autopilot's are tracked.
+ * @param message message as received
+ * @return void
+ */
+void Fleet::onIncoming(const mavlink_message_t &message) {
+    plane *sender = find(message.sysid);
+    if (sender == nullptr || message.compid != MAV_COMP_ID_AUTOPILOT1) {
+        return;
+    }
+    const auto now = LinkMonitor::Clock::now();
+    sender->linkMonitor().onMessage(message.seq, now);
+    if (message.msgid == MAVLINK_MSG_ID_COMMAND_ACK) {
+        sender->linkMonitor().onCommandAck(mavlink_msg_command_ack_get_command(&message), now);
+    }
+}
+
+/**
+ * Start the round trip clock of a command sent to one of the planes
+ * @param message message about to be sent
+ * @return void
+ */
+void Fleet::onOutgoing(const mavlink_message_t &message) {
+    uint8_t target = 0;
+    uint16_t command = 0;
+    if (message.msgid == MAVLINK_MSG_ID_COMMAND_LONG) {
+        target = mavlink_msg_command_long_get_target_system(&message);
+        command = mavlink_msg_command_long_get_command(&message);
+    } else if (message.msgid == MAVLINK_MSG_ID_COMMAND_INT) {
+        target = mavlink_msg_command_int_get_target_system(&message);
+        command = mavlink_msg_command_int_get_command(&message);
+    } else {
+        return;
+    }
+    plane *receiver = find(target);
+    if (receiver != nullptr) {
+        receiver->linkMonitor().onCommandSent(command, LinkMonitor::Clock::now());
+    }
+}
+
+/**
+ * Arm every connected plane at once
+ * @param timeout how long to wait for all of them
+ * @return vector<Outcome> one per plane
+ */
+vector<Fleet::Outcome> Fleet::armAll(chrono::milliseconds timeout) {
+    return commandAll("arm", timeout, &plane::armAsync, nullopt);
+}
+
+/**
+ * Take off with every connected plane at once
+ * @param timeout how long to wait for all of them to be in the air
+ * @return vector<Outcome> one per plane
+ */
+vector<Fleet::Outcome> Fleet::takeoffAll(chrono::milliseconds timeout) {
+    return commandAll("takeoff", timeout, &plane::takeoffAsync, Telemetry::LandedState::InAir);
+}
+
+/**
+ * Land every connected plane at once
+ * @param timeout how long to wait for all of them to be on the ground
+ * @return vector<Outcome> one per plane
+ */
+vector<Fleet::Outcome> Fleet::landAll(chrono::milliseconds timeout) {
+    return commandAll("land", timeout, &plane::landAsync, Telemetry::LandedState::OnGround);
+}
+
+/**
+ * Wait for every connected plane to be healthy
+ * The planes get healthy on their own, so waiting on them one after the other
+ * against the same deadline costs no more than waiting on the slowest.
+ * @param timeout how long to wait for all of them
+ * @return vector<Outcome> one per plane
+ */
+vector<Fleet::Outcome> Fleet::waitHealthyAll(chrono::milliseconds timeout) {
+    const auto start = chrono::steady_clock::now();
+    const auto deadline = start + timeout;
+    const View planes = view();
+    vector<Outcome> outcomes;
+    outcomes.reserve(planes->size());
+    for (plane *vehicle: *planes) {
+        Outcome outcome;
+        outcome.sysid = static_cast<uint8_t>(vehicle->getSystemId());
+        outcome.result = Action::Result::Success;
+        outcome.completed = vehicle->waitForHealthy(remaining(deadline));
+        outcome.elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+        if (!outcome.completed) {
+            LOG_WARN("Fleet: plane {} not healthy after {} ms", outcome.sysid, outcome.elapsed.count());
+        }
+        outcomes.push_back(outcome);
+    }
+    return outcomes;
+}
+
+/**
+ * Wait for every connected plane to have a position fix; result is always Success
+ * @param timeout how long to wait for all of them
+ * @return vector<Outcome> one per plane
+ */
+vector<Fleet::Outcome> Fleet::waitPositionAll(chrono::milliseconds timeout) {
+    const auto start = chrono::steady_clock::now();
+    const auto deadline = start + timeout;
+    const View planes = view();
+    vector<Outcome> outcomes;
+    outcomes.reserve(planes->size());
+    for (plane *vehicle: *planes) {
+        Outcome outcome;
+        outcome.sysid = static_cast<uint8_t>(vehicle->getSystemId());
+        outcome.result = Action::Result::Success;
+        outcome.completed = vehicle->waitForPosition(remaining(deadline));
+        outcome.elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+        if (!outcome.completed) {
+            LOG_WARN("Fleet: plane {} has no position after {} ms", outcome.sysid, outcome.elapsed.count());
+        }
+        outcomes.push_back(outcome);
+    }
+    return outcomes;
+}
+
+/**
+ * Send a command to every connected plane, then collect the answers
+ * All commands are in flight before the first answer is waited on. Planes that
+ * accepted it are then waited on for the landed state, against the same deadline.
+ * @param operation name for the log
+ * @param timeout how long to wait for all of them
+ * @param send plane's async command
+ * @param until landed state that means done, nullopt if the answer is enough
+ * @return vector<Outcome> one per plane, in system id order
+ */
+vector<Fleet::Outcome> Fleet::commandAll(const char *operation, chrono::milliseconds timeout,
+                                         future<Action::Result> (plane::*send)(),
+                                         optional<Telemetry::LandedState> until) {
+    const auto start = chrono::steady_clock::now();
+    const auto deadline = start + timeout;
+    const View planes = view();
+    vector<future<Action::Result>> answers;
+    answers.reserve(planes->size());
+    for (plane *vehicle: *planes) {
+        answers.push_back((vehicle->*send)());
+    }
+
+    vector<Outcome> outcomes;
+    outcomes.reserve(planes->size());
+    for (size_t i = 0; i < planes->size(); ++i) {
+        plane *vehicle = (*planes)[i];
+        Outcome outcome;
+        outcome.sysid = static_cast<uint8_t>(vehicle->getSystemId());
+        if (answers[i].wait_until(deadline) == future_status::ready) {
+            outcome.result = answers[i].get();
+        } else {
+            outcome.result = Action::Result::Timeout;
+        }
+        outcome.completed = outcome.result == Action::Result::Success;
+        if (outcome.completed && until) {
+            outcome.completed = vehicle->waitFor(*until, remaining(deadline));
+        }
+        outcome.elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+        if (!outcome.completed) {
+            LOG_WARN("Fleet: {} on plane {} failed: {} after {} ms", string(operation), outcome.sysid,
+                     outcome.result, outcome.elapsed.count());
+        }
+        outcomes.push_back(outcome);
+    }
+    LOG_INFO("Fleet: {} on {} planes took {} ms", string(operation), outcomes.size(),
+             chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count());
+    return outcomes;
+}
+
+/**
+ * Publish a new connected-planes snapshot
+ * Readers holding the old snapshot keep a valid list; planes are never destroyed
+ * before the fleet itself.
+ * @return void
+ */
+void Fleet::rebuildView() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto planes = std::make_shared<std::vector<plane *>>();
+    for (size_t sysid = 0; sysid < entries.size(); ++sysid) {
+        if (entries[sysid].vehicle && connected[sysid].load(std::memory_order_acquire)) {
+            planes->push_back(entries[sysid].vehicle.get());
+        }
+    }
+    std::atomic_store_explicit(&connectedView, View(std::move(planes)), std::memory_order_release);
+    viewChanged.notify_all();
+}
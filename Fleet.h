@@ -0,0 +1,163 @@
+// tracking - Fleet.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_FLEET_H
+#define TRACKING_FLEET_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "plane.h"
+
+/**
+ * Registry of every plane seen on the link.
+ *
+ * Planes are owned here and indexed directly by MAVLink system id, so lookups
+ * are a single array load. New systems are picked up through
+ * subscribe_on_new_system while running; systems that drop off the link are
+ * kept (MAVSDK reuses the same System when they come back) but leave the
+ * connected view until they reconnect.
+ *
+ * Planes are created on a discovery thread, never on the MAVSDK callback thread,
+ * because plane construction talks to the vehicle. Systems found in the same
+ * scan are constructed concurrently.
+ *
+ * Fleet-wide operations (armAll, takeoffAll, landAll, waitHealthyAll) send the
+ * command to every connected plane at once and then collect the answers against
+ * one shared deadline, so they take about as long as the slowest plane.
+ *
+ * Every MAVLink message in and out passes the fleet's interceptors, which feed
+ * each plane's LinkMonitor: sequence gaps of its autopilot's messages and
+ * command round trips. They only look at the header and never drop anything.
+ */
+class Fleet {
+public:
+    /// How one plane fared in a fleet-wide operation.
+    struct Outcome {
+        uint8_t sysid{};
+        /// Autopilot's answer to the command; Timeout if none came before the deadline.
+        Action::Result result{Action::Result::Unknown};
+        /// Accepted and, where there is one, the target state reached before the deadline.
+        bool completed{};
+        /// From the start of the operation until this plane was seen done or given up on.
+        std::chrono::milliseconds elapsed{};
+    };
+
+    /// Immutable snapshot of the connected planes; cheap to copy, safe to iterate.
+    using View = std::shared_ptr<const std::vector<plane *>>;
+
+    Fleet(Mavsdk &mavsdk, uint8_t mainSystemId, const TelemetryRates &rates = TelemetryRates{},
+          const CommandQueue::Config &commandRates = CommandQueue::Config{});
+    ~Fleet();
+
+    Fleet(const Fleet &) = delete;
+    Fleet &operator=(const Fleet &) = delete;
+
+    /// Register any systems MAVSDK already knows about. Also run on every new-system event.
+    void scan();
+
+    plane *find(uint8_t sysid) const {
+        return index[sysid].load(std::memory_order_acquire);
+    };
+
+    plane *mainPlane() const {
+        return find(mainSystemId);
+    };
+
+    bool isConnected(uint8_t sysid) const {
+        return connected[sysid].load(std::memory_order_acquire);
+    };
+
+    View view() const {
+        return std::atomic_load_explicit(&connectedView, std::memory_order_acquire);
+    };
+
+    size_t size() const {
+        return view()->size();
+    };
+
+    /// Attach a flight recorder to every plane, including ones discovered later. nullptr detaches.
+    void setRecorder(FlightRecorder *flightRecorder);
+
+    /// Arm every connected plane. One Outcome per plane, in system id order.
+    std::vector<Outcome> armAll(std::chrono::milliseconds timeout);
+
+    /// Take off with every connected plane and wait until each is in the air.
+    std::vector<Outcome> takeoffAll(std::chrono::milliseconds timeout);
+
+    /// Land every connected plane and wait until each is on the ground.
+    std::vector<Outcome> landAll(std::chrono::milliseconds timeout);
+
+    /// Wait until every connected plane passes its health checks; result is always Success.
+    std::vector<Outcome> waitHealthyAll(std::chrono::milliseconds timeout);
+
+    /// Wait until at least count planes are connected, woken by registration rather than polling.
+    bool waitForPlanes(size_t count, std::chrono::milliseconds timeout);
+
+    /// Wait until every connected plane has its first position fix; result is always Success.
+    std::vector<Outcome> waitPositionAll(std::chrono::milliseconds timeout);
+
+private:
+    struct Entry {
+        std::shared_ptr<System> system;
+        std::unique_ptr<plane> vehicle;
+        System::IsConnectedHandle connectionHandle{};
+    };
+
+    std::vector<Outcome> commandAll(const char *operation, std::chrono::milliseconds timeout,
+                                    std::future<Action::Result> (plane::*send)(),
+                                    std::optional<Telemetry::LandedState> until);
+    void discoveryLoop();
+    void setConnected(uint8_t sysid, bool isConnected);
+    void rebuildView();
+    void onIncoming(const mavlink_message_t &message);
+    void onOutgoing(const mavlink_message_t &message);
+
+    Mavsdk &mavsdk;
+    const uint8_t mainSystemId;
+    const TelemetryRates rates;
+    const CommandQueue::Config commandRates;
+    std::atomic<FlightRecorder *> recorder{nullptr};
+
+    std::array<std::atomic<plane *>, 256> index{};
+    std::array<std::atomic<bool>, 256> connected{};
+    View connectedView;
+
+    /// Only one scan at a time, so a system is never constructed twice.
+    std::mutex scanMutex;
+    /// Serializes registration and view rebuilds. Never taken by lookups.
+    std::mutex registryMutex;
+    /// Notified under registryMutex whenever the connected view is rebuilt.
+    std::condition_variable viewChanged;
+    std::array<Entry, 256> entries;
+
+    Mavsdk::NewSystemHandle newSystemHandle{};
+    std::mutex discoveryMutex;
+    std::condition_variable discoveryWake;
+    bool scanRequested{false};
+    bool stopping{false};
+    std::thread discoverer;
+};
+
+
+#endif //TRACKING_FLEET_H
@@ -0,0 +1,195 @@
+// tracking - FlightRecorder.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "FlightRecorder.h"
+#include "Logger.h"
+
+using namespace std;
+
+namespace {
+/// Records start on their own page so the header page is the only one rewritten on flush.
+constexpr uint64_t kRecordOffset = 4096;
+}
+
+FlightRecorder::~FlightRecorder() {
+    close();
+}
+
+/**
+ * Create the log file, reserve its full size on disk and map it
+ * The space is allocated up front, so a full disk fails here instead of in flight.
+ * @param path log file path, truncated if it exists
+ * @param capacity number of 64-byte record slots
+ * @return true if the recorder is ready
+ * @return false if failed
+ */
+bool FlightRecorder::open(const string &path, uint64_t capacity) {
+    close();
+    if (capacity == 0) {
+        LOG_ERROR("Flight recorder: capacity must not be zero");
+        return false;
+    }
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Flight recorder: cannot create {}: errno {}", path, errno);
+        return false;
+    }
+    const size_t size = kRecordOffset + capacity * sizeof(FlightRecord);
+    const int allocated = posix_fallocate(fd, 0, static_cast<off_t>(size));
+    if (allocated != 0) {
+        LOG_ERROR("Flight recorder: cannot allocate {} bytes for {}: errno {}", size, path, allocated);
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        LOG_ERROR("Flight recorder: cannot map {}: errno {}", path, errno);
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    // Written front to back, let the kernel read ahead and write behind accordingly.
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    mapping = mapped;
+    mappingSize = size;
+    header = static_cast<FlightLogHeader *>(mapped);
+    slots = capacity;
+    next.store(0, memory_order_relaxed);
+    start = Clock::now();
+    const auto startWall = chrono::system_clock::now() - (Clock::now() - start);
+    header->startWall_ns = chrono::duration_cast<chrono::nanoseconds>(startWall.time_since_epoch()).count();
+    writeHeader();
+    records = reinterpret_cast<FlightRecord *>(static_cast<char *>(mapped) + kRecordOffset);
+    LOG_INFO("Flight recorder: writing {} ({} records)", path, capacity);
+    return true;
+}
+
+/**
+ * Write the header and unmap the log
+ * The kernel writes the remaining dirty pages back after unmapping.
+ * @return void
+ */
+void FlightRecorder::close() {
+    if (mapping == nullptr) {
+        return;
+    }
+    writeHeader();
+    records = nullptr;
+    munmap(mapping, mappingSize);
+    ::close(fd);
+    mapping = nullptr;
+    header = nullptr;
+    fd = -1;
+}
+
+/**
+ * Update the header and schedule writeback of the whole mapping
+ * @return void
+ */
+void FlightRecorder::flush() {
+    if (mapping == nullptr) {
+        return;
+    }
+    writeHeader();
+    msync(mapping, mappingSize, MS_ASYNC);
+}
+
+FlightLogReader::~FlightLogReader() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+/**
+ * Open a flight log for reading and validate its header
+ * @param path log file
+ * @return true if the log can be read
+ * @return false if it can't be opened or isn't a flight log of this version
+ */
+bool FlightLogReader::open(const string &path) {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    if (pread(fd, &fileHeader, sizeof(fileHeader), 0) != sizeof(fileHeader)
+        || memcmp(fileHeader.magic, FlightLogHeader::kMagic, sizeof(fileHeader.magic)) != 0
+        || fileHeader.version != FlightLogHeader::kVersion || fileHeader.recordSize != sizeof(FlightRecord)) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return true;
+}
+
+uint64_t FlightLogReader::sequenceAt(uint64_t slot) const {
+    uint64_t sequence = 0;
+    const off_t offset = static_cast<off_t>(fileHeader.recordOffset + slot * sizeof(FlightRecord));
+    if (pread(fd, &sequence, sizeof(sequence), offset) != sizeof(sequence)) {
+        return 0;
+    }
+    return sequence;
+}
+
+/**
+ * Find the oldest record
+ * Slots before the write position hold the current lap, slots after it the
+ * previous one (or nothing yet), so the first slot older than slot 0 is the start.
+ * @return uint64_t slot of the oldest record
+ */
+uint64_t FlightLogReader::oldestSlot() const {
+    const uint64_t first = sequenceAt(0);
+    if (first == 0) {
+        return 0;
+    }
+    uint64_t low = 1;
+    uint64_t high = fileHeader.capacity;
+    while (low < high) {
+        const uint64_t middle = low + (high - low) / 2;
+        const uint64_t sequence = sequenceAt(middle);
+        if (sequence != 0 && sequence > first) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low == fileHeader.capacity ? 0 : low;
+}
+
+size_t FlightLogReader::read(uint64_t slot, size_t count, FlightRecord *out) const {
+    const off_t offset = static_cast<off_t>(fileHeader.recordOffset + slot * sizeof(FlightRecord));
+    const ssize_t bytes = pread(fd, out, count * sizeof(FlightRecord), offset);
+    return bytes > 0 ? static_cast<size_t>(bytes) / sizeof(FlightRecord) : 0;
+}
+
+void FlightRecorder::writeHeader() {
+    memcpy(header->magic, FlightLogHeader::kMagic, sizeof(header->magic));
+    header->version = FlightLogHeader::kVersion;
+    header->recordSize = sizeof(FlightRecord);
+    header->recordOffset = kRecordOffset;
+    header->capacity = slots;
+    header->written = next.load(memory_order_relaxed);
+}
@@ -0,0 +1,268 @@
+// tracking - FlightRecorder.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_FLIGHTRECORDER_H
+#define TRACKING_FLIGHTRECORDER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/// What a flight record holds. Telemetry kinds are received samples, command kinds are setpoints we sent.
+enum class RecordKind : uint8_t {
+    Position = 1,
+    Velocity = 2,
+    Attitude = 3,
+    FixedwingMetrics = 4,
+    CommandPositionGlobal = 16,
+    CommandVelocityNed = 17,
+    CommandFollowTarget = 18,
+    CommandPositionVelocity = 19,
+};
+
+/**
+ * One fixed-layout record, 64 bytes, stored as is in the log file.
+ * Fields a kind does not use are zero:
+ *  Position: latitude_e7, longitude_e7, altitude_m (AMSL)
+ *  Velocity: north/east/down_m_s
+ *  Attitude: roll/pitch/yaw_deg
+ *  FixedwingMetrics: value = airspeed, down_m_s = -climb rate
+ *  CommandPositionGlobal: latitude_e7, longitude_e7, altitude_m, yaw_deg
+ *  CommandVelocityNed: north/east/down_m_s, yaw_deg
+ *  CommandFollowTarget: latitude_e7, longitude_e7, altitude_m, north/east/down_m_s
+ *  CommandPositionVelocity: latitude_e7, longitude_e7, altitude_m, north/east/down_m_s, yaw_deg
+ */
+struct FlightRecord {
+    /// Global record number + 1, written last; 0 means the slot is empty or being written.
+    uint64_t sequence;
+    /// Nanoseconds since the recording started, see FlightLogHeader::startWall_ns.
+    int64_t timestamp_ns;
+    int32_t latitude_e7;
+    int32_t longitude_e7;
+    float altitude_m;
+    float north_m_s;
+    float east_m_s;
+    float down_m_s;
+    float roll_deg;
+    float pitch_deg;
+    float yaw_deg;
+    float value;
+    uint8_t sysid;
+    RecordKind kind;
+    /// kFlagFailed for commands MAVSDK rejected.
+    uint16_t flags;
+    uint32_t reserved;
+
+    static constexpr uint16_t kFlagFailed = 1;
+
+    static int32_t toE7(double degrees) {
+        return static_cast<int32_t>(degrees * 1e7 + (degrees >= 0 ? 0.5 : -0.5));
+    }
+
+    static double fromE7(int32_t e7) {
+        return e7 * 1e-7;
+    }
+};
+
+static_assert(sizeof(FlightRecord) == 64, "FlightRecord must stay 64 bytes");
+
+/// File header, records follow at recordOffset. All fields little-endian native.
+struct FlightLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t recordOffset;
+    /// Number of record slots; the log wraps and overwrites the oldest once full.
+    uint64_t capacity;
+    /// Wall clock (system_clock, ns since the Unix epoch) at timestamp_ns == 0.
+    int64_t startWall_ns;
+    /// Records written, updated on flush and close. Live readers should rely on record sequences.
+    uint64_t written;
+
+    static constexpr char kMagic[8] = {'T', 'R', 'K', 'F', 'D', 'R', '1', '\0'};
+    static constexpr uint32_t kVersion = 1;
+};
+
+/**
+ * Append-only binary flight-data recorder.
+ *
+ * The log file is pre-allocated to a fixed number of 64-byte slots and mapped
+ * into memory. Appending claims a slot with one atomic increment and writes
+ * the record straight into the mapping, so recording costs no syscall and no
+ * allocation; the kernel writes dirty pages back on its own. Once full the log
+ * wraps and keeps the most recent capacity() records.
+ *
+ * Any number of threads may append concurrently. A record is complete once its
+ * sequence is non-zero, so a crash leaves at most the in-flight records torn.
+ */
+class FlightRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// 4 Mi records, 256 MiB: about 25 minutes of 30 aircraft at 50 Hz commands plus telemetry.
+    static constexpr uint64_t kDefaultCapacity = uint64_t{1} << 22;
+
+    FlightRecorder() = default;
+    ~FlightRecorder();
+
+    FlightRecorder(const FlightRecorder &) = delete;
+    FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+    /**
+     * Create (or truncate) and map the log file.
+     * @return false if the file could not be created, allocated or mapped
+     */
+    bool open(const std::string &path, uint64_t capacity = kDefaultCapacity);
+
+    /// Write the header and unmap. Only call once nothing appends any more.
+    void close();
+
+    bool isOpen() const {
+        return records != nullptr;
+    };
+
+    /**
+     * Claim a slot and let the caller fill it in place.
+     * sequence, timestamp_ns, sysid and kind are set here; other fields start zeroed.
+     */
+    template<typename F>
+    void append(uint8_t sysid, RecordKind kind, F &&fill) {
+        if (records == nullptr) {
+            return;
+        }
+        const uint64_t number = next.fetch_add(1, std::memory_order_relaxed);
+        FlightRecord &record = records[number % slots];
+        auto &sequence = reinterpret_cast<std::atomic<uint64_t> &>(record.sequence);
+        sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        FlightRecord filled{};
+        filled.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        filled.sysid = sysid;
+        filled.kind = kind;
+        fill(filled);
+        // Everything but the sequence, which only ever changes atomically.
+        std::memcpy(reinterpret_cast<char *>(&record) + sizeof(uint64_t),
+                    reinterpret_cast<const char *>(&filled) + sizeof(uint64_t),
+                    sizeof(FlightRecord) - sizeof(uint64_t));
+        sequence.store(number + 1, std::memory_order_release);
+    }
+
+    /// Ask the kernel to write the mapping back now, without waiting for it.
+    void flush();
+
+    uint64_t written() const {
+        return next.load(std::memory_order_relaxed);
+    };
+
+    uint64_t capacity() const {
+        return slots;
+    };
+
+private:
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Record sequences need lock-free 64-bit atomics");
+
+    void writeHeader();
+
+    int fd{-1};
+    void *mapping{nullptr};
+    size_t mappingSize{};
+    FlightLogHeader *header{nullptr};
+    FlightRecord *records{nullptr};
+    uint64_t slots{};
+    Clock::time_point start{};
+    std::atomic<uint64_t> next{0};
+};
+
+/**
+ * Sequential reader for a flight log, also while it is still being written.
+ *
+ * Records are read with pread in fixed-size chunks, so the file is never loaded
+ * whole. The oldest record of a wrapped log is found by binary search on the
+ * record sequences.
+ */
+class FlightLogReader {
+public:
+    FlightLogReader() = default;
+    ~FlightLogReader();
+
+    FlightLogReader(const FlightLogReader &) = delete;
+    FlightLogReader &operator=(const FlightLogReader &) = delete;
+
+    /**
+     * Open a log and check its header.
+     * @return false if it can't be read or isn't a flight log of this version
+     */
+    bool open(const std::string &path);
+
+    const FlightLogHeader &header() const {
+        return fileHeader;
+    };
+
+    /**
+     * Call visit(const FlightRecord &) for every complete record, oldest first.
+     * Each chunk is read twice and a record is kept only if its sequence is
+     * non-zero and the same both times; a writer reusing the slot in between
+     * zeroes it first, so a record torn by a live recorder is dropped.
+     * @return number of records visited
+     */
+    template<typename F>
+    uint64_t forEach(F &&visit) const {
+        if (fd < 0) {
+            return 0;
+        }
+        const uint64_t capacity = fileHeader.capacity;
+        const uint64_t oldest = oldestSlot();
+        std::vector<FlightRecord> chunk(kChunkRecords);
+        std::vector<FlightRecord> check(kChunkRecords);
+        uint64_t visited = 0;
+        for (uint64_t done = 0; done < capacity;) {
+            const uint64_t slot = (oldest + done) % capacity;
+            // Never read across the end of the ring in one go.
+            const uint64_t wanted = std::min({uint64_t{kChunkRecords}, capacity - done, capacity - slot});
+            const size_t got = read(slot, static_cast<size_t>(wanted), chunk.data());
+            if (got == 0) {
+                break;
+            }
+            const size_t checked = read(slot, got, check.data());
+            for (size_t i = 0; i < checked; ++i) {
+                if (chunk[i].sequence != 0 && chunk[i].sequence == check[i].sequence) {
+                    visit(chunk[i]);
+                    ++visited;
+                }
+            }
+            done += got;
+        }
+        return visited;
+    }
+
+private:
+    static constexpr size_t kChunkRecords = 4096;
+
+    uint64_t sequenceAt(uint64_t slot) const;
+    uint64_t oldestSlot() const;
+    size_t read(uint64_t slot, size_t count, FlightRecord *out) const;
+
+    int fd{-1};
+    FlightLogHeader fileHeader{};
+};
+
+
+#endif //TRACKING_FLIGHTRECORDER_H
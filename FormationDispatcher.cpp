@@ -0,0 +1,320 @@
+// tracking - FormationDispatcher.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include "FormationDispatcher.h"
+
+using geodesy::kRadToDeg;
+
+namespace {
+/// Grid spacing when separation is off and the index is unused.
+constexpr double kDefaultCell_m = 50.0;
+}
+
+/**
+ * Constructor for the dispatcher
+ * @param leader vehicle the formation is built around
+ * @param config dispatcher configuration, rate is clamped to [10, 100] Hz
+ */
+FormationDispatcher::FormationDispatcher(Vehicle &leader, Config config)
+        : leader(leader), config(config),
+          neighbours(config.minSeparation_m > 0.0 ? config.minSeparation_m : kDefaultCell_m),
+          poseAge(Metrics::instance().histogram(
+                  "tracking_command_pose_age_seconds", "Age of the leader fix a command was computed from",
+                  "sysid=\"" + std::to_string(leader.getSystemId()) + "\",engine=\"formation\"")),
+          loop(config.rateHz, [this] { tick(); }) {
+}
+
+FormationDispatcher::FormationDispatcher(Vehicle &leader)
+        : FormationDispatcher(leader, Config{}) {
+}
+
+FormationDispatcher::~FormationDispatcher() {
+    stop();
+}
+
+/**
+ * Add a follower to the formation
+ * @param follower vehicle that will receive the setpoints
+ * @param forward_m slot distance ahead of the leader along its track (negative is behind)
+ * @param right_m slot distance to the right of the leader's track
+ * @param up_m slot height above the leader
+ * @return void
+ */
+void FormationDispatcher::addFollower(Vehicle &follower, double forward_m, double right_m, double up_m) {
+    std::lock_guard<std::mutex> lock(formationMutex);
+    followers.push_back(&follower);
+    slotForward.push_back(forward_m);
+    slotRight.push_back(right_m);
+    slotUp.push_back(up_m);
+    const size_t n = followers.size();
+    slotNorth.resize(n);
+    slotEast.resize(n);
+    slotDown.resize(n);
+    followerLat.resize(n);
+    followerLon.resize(n);
+    followerAlt.resize(n);
+    followerNorth.resize(n);
+    followerEast.resize(n);
+    followerDown.resize(n);
+    followerFix.resize(n);
+    targetLat.resize(n);
+    targetLon.resize(n);
+    targetAlt.resize(n);
+    pushNorth.resize(n);
+    pushEast.resize(n);
+    pushDown.resize(n);
+    commandNorth.resize(n);
+    commandEast.resize(n);
+    commandDown.resize(n);
+}
+
+size_t FormationDispatcher::size() const {
+    std::lock_guard<std::mutex> lock(formationMutex);
+    return followers.size();
+}
+
+/**
+ * Compute and send one batch of setpoints
+ * The leader is read once, followers once each (velocity mode or separation
+ * on), then all setpoints are computed in one pass and sent back to back.
+ * @return void
+ */
+void FormationDispatcher::tick() {
+    tick(Vehicle::Clock::now());
+}
+
+/**
+ * Compute and send one batch with the leader predicted to the given time
+ * @param now send time of the batch
+ * @return void
+ */
+void FormationDispatcher::tick(Vehicle::Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(formationMutex);
+    const size_t n = followers.size();
+    if (n == 0) {
+        return;
+    }
+
+    const PoseSnapshot target = config.usePrediction
+                                ? leader.predictPose(now)
+                                : leader.getPose();
+    if (!target.hasFix()) {
+        staleTicks.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    poseAge.record(now - target.positionTime);
+    const double track_rad = target.trackAngle_rad();
+    commandYaw = static_cast<float>(track_rad * kRadToDeg);
+
+    const geodesy::LocalFrame frame({target.latitude_deg, target.longitude_deg, target.absolute_altitude_m});
+    const bool separating = config.minSeparation_m > 0.0;
+    if (config.mode == Mode::Velocity || separating) {
+        for (size_t i = 0; i < n; ++i) {
+            const PoseSnapshot follower = followers[i]->getPose();
+            const bool fix = follower.hasFix();
+            followerFix[i] = fix ? 1 : 0;
+            // Park a follower without a fix on the leader so the batch conversion stays finite; it is skipped below.
+            followerLat[i] = fix ? follower.latitude_deg : target.latitude_deg;
+            followerLon[i] = fix ? follower.longitude_deg : target.longitude_deg;
+            followerAlt[i] = fix ? follower.absolute_altitude_m : target.absolute_altitude_m;
+        }
+        frame.toNedBatch(followerLat.data(), followerLon.data(), followerAlt.data(),
+                         followerNorth.data(), followerEast.data(), followerDown.data(), n);
+    } else {
+        std::fill(followerFix.begin(), followerFix.end(), 1);
+    }
+    if (separating) {
+        computeSeparation();
+    }
+    computePositions(frame, track_rad);
+    if (config.mode == Mode::Velocity) {
+        computeVelocities(target.north_m_s, target.east_m_s, target.down_m_s);
+    }
+
+    uint64_t sent = 0;
+    uint64_t skipped = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (!followerFix[i]) {
+            ++skipped;
+            continue;
+        }
+        const bool ok = config.mode == Mode::Position
+                        ? followers[i]->sendPositionGlobal(targetLat[i], targetLon[i],
+                                                           static_cast<float>(targetAlt[i]), commandYaw)
+                        : followers[i]->sendVelocityNed(commandNorth[i], commandEast[i], commandDown[i],
+                                                        commandYaw);
+        sent += ok ? 1 : 0;
+    }
+    batches.fetch_add(1, std::memory_order_relaxed);
+    commandsSent.fetch_add(sent, std::memory_order_relaxed);
+    commandsFailed.fetch_add(n - skipped - sent, std::memory_order_relaxed);
+    if (skipped > 0) {
+        staleTicks.fetch_add(skipped, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Rotate every slot into the leader's track frame and place it around the leader
+ * Straight-line arithmetic over plain arrays, then one batch geodesy conversion.
+ * @param frame local frame anchored at the leader
+ * @param track_rad leader track angle
+ * @return void
+ */
+void FormationDispatcher::computePositions(const geodesy::LocalFrame &frame, double track_rad) {
+    const size_t n = followers.size();
+    const double c = std::cos(track_rad);
+    const double s = std::sin(track_rad);
+
+    const double *forward = slotForward.data();
+    const double *right = slotRight.data();
+    const double *up = slotUp.data();
+    double *north = slotNorth.data();
+    double *east = slotEast.data();
+    double *down = slotDown.data();
+    for (size_t i = 0; i < n; ++i) {
+        north[i] = forward[i] * c - right[i] * s;
+        east[i] = forward[i] * s + right[i] * c;
+        down[i] = -up[i];
+    }
+    if (config.mode == Mode::Position && config.minSeparation_m > 0.0) {
+        // Position mode sends the slots themselves, so the push moves the setpoint.
+        for (size_t i = 0; i < n; ++i) {
+            north[i] += pushNorth[i];
+            east[i] += pushEast[i];
+            down[i] += pushDown[i];
+        }
+    }
+    frame.fromNedBatch(north, east, down, targetLat.data(), targetLon.data(), targetAlt.data(), n);
+}
+
+/**
+ * Velocity commands: leader velocity plus a capped proportional pull towards each slot
+ * Follower positions must already be in the leader frame. With separation on,
+ * a capped velocity along each follower's push is added on top.
+ * @return void
+ */
+void FormationDispatcher::computeVelocities(float leaderNorth, float leaderEast, float leaderDown) {
+    const size_t n = followers.size();
+    const double gain = config.positionGain;
+    const double maxCorrection = config.maxCorrection_m_s;
+    const double separationGain = config.minSeparation_m > 0.0 ? config.separationGain : 0.0;
+
+    const double *slotN = slotNorth.data();
+    const double *slotE = slotEast.data();
+    const double *slotD = slotDown.data();
+    const double *ownN = followerNorth.data();
+    const double *ownE = followerEast.data();
+    const double *ownD = followerDown.data();
+    float *north = commandNorth.data();
+    float *east = commandEast.data();
+    float *down = commandDown.data();
+    for (size_t i = 0; i < n; ++i) {
+        const double correctionNorth = gain * (slotN[i] - ownN[i]);
+        const double correctionEast = gain * (slotE[i] - ownE[i]);
+        const double correctionDown = gain * (slotD[i] - ownD[i]);
+        const double magnitude = std::sqrt(correctionNorth * correctionNorth + correctionEast * correctionEast
+                                           + correctionDown * correctionDown);
+        const double scale = magnitude > maxCorrection ? maxCorrection / magnitude : 1.0;
+        const double awayNorth = separationGain * pushNorth[i];
+        const double awayEast = separationGain * pushEast[i];
+        const double awayDown = separationGain * pushDown[i];
+        const double away = std::sqrt(awayNorth * awayNorth + awayEast * awayEast + awayDown * awayDown);
+        const double awayScale = away > maxCorrection ? maxCorrection / away : 1.0;
+        north[i] = static_cast<float>(leaderNorth + correctionNorth * scale + awayNorth * awayScale);
+        east[i] = static_cast<float>(leaderEast + correctionEast * scale + awayEast * awayScale);
+        down[i] = static_cast<float>(leaderDown + correctionDown * scale + awayDown * awayScale);
+    }
+}
+
+/**
+ * Push every follower that is too close to another aircraft away from it
+ * The index is moved to this tick's positions (only aircraft that changed cell
+ * are relinked, followers without a fix are left out), then each follower asks
+ * for the aircraft within the minimum separation. Its push is the sum over them
+ * of the shortfall along the line from the intruder to it; two aircraft at the
+ * same point split sideways.
+ * @return void
+ */
+void FormationDispatcher::computeSeparation() {
+    const size_t n = followers.size();
+    const double minimum = config.minSeparation_m;
+    neighbours.update(0, {0.0, 0.0, 0.0});
+    for (size_t i = 0; i < n; ++i) {
+        const auto id = static_cast<uint32_t>(i + 1);
+        if (followerFix[i]) {
+            neighbours.update(id, {followerNorth[i], followerEast[i], followerDown[i]});
+        } else {
+            neighbours.remove(id);
+        }
+    }
+
+    uint64_t adjusted = 0;
+    double closest = minimum;
+    for (size_t i = 0; i < n; ++i) {
+        if (!followerFix[i]) {
+            pushNorth[i] = 0.0;
+            pushEast[i] = 0.0;
+            pushDown[i] = 0.0;
+            continue;
+        }
+        const auto self = static_cast<uint32_t>(i + 1);
+        const SpatialIndex::Point own{followerNorth[i], followerEast[i], followerDown[i]};
+        neighbours.withinRadius(own, minimum, intruders, self);
+        double north = 0.0;
+        double east = 0.0;
+        double down = 0.0;
+        for (const SpatialIndex::Neighbour &intruder: intruders) {
+            const double shortfall = minimum - intruder.distance_m;
+            closest = std::min(closest, intruder.distance_m);
+            if (intruder.distance_m < 1e-3) {
+                // No direction to push along, lower ids go left and higher ids right.
+                east += intruder.id < self ? shortfall : -shortfall;
+                continue;
+            }
+            const double otherNorth = intruder.id == 0 ? 0.0 : followerNorth[intruder.id - 1];
+            const double otherEast = intruder.id == 0 ? 0.0 : followerEast[intruder.id - 1];
+            const double otherDown = intruder.id == 0 ? 0.0 : followerDown[intruder.id - 1];
+            north += (own.north - otherNorth) / intruder.distance_m * shortfall;
+            east += (own.east - otherEast) / intruder.distance_m * shortfall;
+            down += (own.down - otherDown) / intruder.distance_m * shortfall;
+        }
+        pushNorth[i] = north;
+        pushEast[i] = east;
+        pushDown[i] = down;
+        adjusted += intruders.empty() ? 0 : 1;
+    }
+    separationAdjustments.fetch_add(adjusted, std::memory_order_relaxed);
+    closestApproach_m.store(closest, std::memory_order_relaxed);
+}
+
+/**
+ * Get a copy of the dispatcher statistics
+ * @return Stats
+ */
+FormationDispatcher::Stats FormationDispatcher::stats() const {
+    Stats result;
+    result.timing = loop.stats();
+    result.batches = batches.load(std::memory_order_relaxed);
+    result.commandsSent = commandsSent.load(std::memory_order_relaxed);
+    result.commandsFailed = commandsFailed.load(std::memory_order_relaxed);
+    result.staleTicks = staleTicks.load(std::memory_order_relaxed);
+    result.separationAdjustments = separationAdjustments.load(std::memory_order_relaxed);
+    result.closestApproach_m = closestApproach_m.load(std::memory_order_relaxed);
+    return result;
+}
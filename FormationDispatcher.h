@@ -0,0 +1,170 @@
+// tracking - FormationDispatcher.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_FORMATIONDISPATCHER_H
+#define TRACKING_FORMATIONDISPATCHER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "FixedRateLoop.h"
+#include "Geodesy.h"
+#include "Metrics.h"
+#include "SpatialIndex.h"
+#include "Vehicle.h"
+
+/**
+ * Batched setpoint dispatch for a formation of followers around one leader.
+ *
+ * Every tick reads the leader and all follower snapshots once, computes every
+ * follower's setpoint in a single pass over structure-of-arrays data, and then
+ * sends all commands back to back. Per-tick cost stays flat per follower no
+ * matter how the swarm grows: no per-follower lookups, allocation or logging.
+ *
+ * Slots are given in the leader's track frame: forward, right and up in meters.
+ * Whenever follower poses are read (velocity mode or separation on), a follower
+ * without a fix gets no setpoint that tick and stays out of the separation check.
+ *
+ * With minSeparation_m set, every tick also indexes the followers and the leader
+ * in a SpatialIndex and pushes any follower that is closer than that to another
+ * aircraft away from it: the position setpoint is moved out by the shortfall,
+ * or a velocity away from the intruder is added to the velocity setpoint.
+ */
+class FormationDispatcher {
+public:
+    enum class Mode {
+        /// set_position_global at the slot position.
+        Position,
+        /// set_velocity_ned: leader velocity plus a proportional pull towards the slot.
+        Velocity,
+    };
+
+    struct Config {
+        int rateHz = 20;
+        Mode mode = Mode::Position;
+        /// Extrapolate the leader to the send time instead of using its last fix.
+        bool usePrediction = true;
+        /// Velocity mode: correction per meter of slot error, 1/s.
+        float positionGain = 0.4f;
+        /// Velocity mode: cap on the correction added to the leader velocity, m/s.
+        float maxCorrection_m_s = 10.0f;
+        /// Keep followers this far from each other and from the leader, meters. 0 turns the check off.
+        double minSeparation_m = 0.0;
+        /// Velocity mode: speed away from an intruder per meter of shortfall, 1/s. Capped like the correction.
+        float separationGain = 0.5f;
+    };
+
+    struct Stats {
+        FixedRateLoop::Stats timing;
+        uint64_t batches{};
+        uint64_t commandsSent{};
+        uint64_t commandsFailed{};
+        /// Ticks skipped because the leader had no fix, plus follower setpoints skipped
+        /// because that follower had none.
+        uint64_t staleTicks{};
+        /// Setpoints moved to keep separation.
+        uint64_t separationAdjustments{};
+        /// Closest distance between two aircraft in the last tick with separation on, meters.
+        double closestApproach_m{};
+    };
+
+    FormationDispatcher(Vehicle &leader, Config config);
+    explicit FormationDispatcher(Vehicle &leader);
+    ~FormationDispatcher();
+
+    FormationDispatcher(const FormationDispatcher &) = delete;
+    FormationDispatcher &operator=(const FormationDispatcher &) = delete;
+
+    /// Add a follower at the given slot. Can be called while running.
+    void addFollower(Vehicle &follower, double forward_m, double right_m, double up_m);
+
+    size_t size() const;
+
+    bool start() {
+        return loop.start();
+    };
+
+    void stop() {
+        loop.stop();
+    };
+
+    /// Compute and send one batch. Called by the loop thread on every tick.
+    void tick();
+
+    /// Compute and send one batch as of the given time, for simulations on a virtual clock.
+    void tick(Vehicle::Clock::time_point now);
+
+    Stats stats() const;
+
+private:
+    void computePositions(const geodesy::LocalFrame &frame, double track_rad);
+    void computeVelocities(float leaderNorth, float leaderEast, float leaderDown);
+    void computeSeparation();
+
+    Vehicle &leader;
+    const Config config;
+
+    /// Guards the arrays below against addFollower while a batch runs.
+    mutable std::mutex formationMutex;
+
+    // Structure of arrays, one entry per follower.
+    std::vector<Vehicle *> followers;
+    std::vector<double> slotForward;
+    std::vector<double> slotRight;
+    std::vector<double> slotUp;
+    // Slots rotated into the leader's NED frame.
+    std::vector<double> slotNorth;
+    std::vector<double> slotEast;
+    std::vector<double> slotDown;
+    std::vector<double> followerLat;
+    std::vector<double> followerLon;
+    std::vector<double> followerAlt;
+    std::vector<double> followerNorth;
+    std::vector<double> followerEast;
+    std::vector<double> followerDown;
+    /// 1 if the follower had a fix this tick; all 1 when follower poses are not read.
+    std::vector<uint8_t> followerFix;
+    std::vector<double> targetLat;
+    std::vector<double> targetLon;
+    std::vector<double> targetAlt;
+    // Push away from intruders, meters.
+    std::vector<double> pushNorth;
+    std::vector<double> pushEast;
+    std::vector<double> pushDown;
+    std::vector<float> commandNorth;
+    std::vector<float> commandEast;
+    std::vector<float> commandDown;
+    float commandYaw{};
+    /// Leader at id 0, follower i at id i + 1, positions in the leader frame.
+    SpatialIndex neighbours;
+    std::vector<SpatialIndex::Neighbour> intruders;
+
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> commandsSent{0};
+    std::atomic<uint64_t> commandsFailed{0};
+    std::atomic<uint64_t> staleTicks{0};
+    std::atomic<uint64_t> separationAdjustments{0};
+    std::atomic<double> closestApproach_m{0.0};
+    /// Age of the leader fix each batch was computed from, labelled with the leader's id.
+    Histogram &poseAge;
+
+    // Last member: the loop thread must stop before anything it touches is destroyed.
+    FixedRateLoop loop;
+};
+
+
+#endif //TRACKING_FORMATIONDISPATCHER_H
@@ -0,0 +1,368 @@
+// tracking - Geodesy.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <atomic>
+#include <cmath>
+#include "Geodesy.h"
+
+// The AVX2 kernels are compiled for AVX2 whatever the build flags and only run
+// when the CPU has it, so one binary uses it where it can.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TRACKING_GEODESY_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace geodesy {
+
+namespace {
+BatchKernel detectKernel() {
+#if defined(TRACKING_GEODESY_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return BatchKernel::Avx2;
+    }
+#endif
+#if defined(__SSE2__)
+    return BatchKernel::Sse2;
+#else
+    return BatchKernel::Scalar;
+#endif
+}
+
+std::atomic<BatchKernel> &activeKernel() {
+    static std::atomic<BatchKernel> kernel{detectKernel()};
+    return kernel;
+}
+
+#if defined(TRACKING_GEODESY_AVX2)
+/// Four points at a time; returns how many were converted, the caller finishes the rest.
+__attribute__((target("avx2")))
+size_t toNedAvx2(const Geodetic &origin, double metersPerDegLat, double metersPerDegLon,
+                 const double *latitude_deg, const double *longitude_deg, const double *altitude_m,
+                 double *north, double *east, double *down, size_t count) {
+    const __m256d lat0 = _mm256_set1_pd(origin.latitude_deg);
+    const __m256d lon0 = _mm256_set1_pd(origin.longitude_deg);
+    const __m256d alt0 = _mm256_set1_pd(origin.altitude_m);
+    const __m256d scaleLat = _mm256_set1_pd(metersPerDegLat);
+    const __m256d scaleLon = _mm256_set1_pd(metersPerDegLon);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(north + i, _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(latitude_deg + i), lat0), scaleLat));
+        _mm256_storeu_pd(east + i, _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(longitude_deg + i), lon0), scaleLon));
+        _mm256_storeu_pd(down + i, _mm256_sub_pd(alt0, _mm256_loadu_pd(altitude_m + i)));
+    }
+    // Unoptimized builds don't clear the upper halves on return; SSE code after this would stall on them.
+    _mm256_zeroupper();
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t fromNedAvx2(const Geodetic &origin, double degPerMeterLat, double degPerMeterLon,
+                   const double *north, const double *east, const double *down,
+                   double *latitude_deg, double *longitude_deg, double *altitude_m, size_t count) {
+    const __m256d lat0 = _mm256_set1_pd(origin.latitude_deg);
+    const __m256d lon0 = _mm256_set1_pd(origin.longitude_deg);
+    const __m256d alt0 = _mm256_set1_pd(origin.altitude_m);
+    const __m256d scaleLat = _mm256_set1_pd(degPerMeterLat);
+    const __m256d scaleLon = _mm256_set1_pd(degPerMeterLon);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(latitude_deg + i, _mm256_add_pd(lat0, _mm256_mul_pd(_mm256_loadu_pd(north + i), scaleLat)));
+        _mm256_storeu_pd(longitude_deg + i, _mm256_add_pd(lon0, _mm256_mul_pd(_mm256_loadu_pd(east + i), scaleLon)));
+        _mm256_storeu_pd(altitude_m + i, _mm256_sub_pd(alt0, _mm256_loadu_pd(down + i)));
+    }
+    _mm256_zeroupper();
+    return i;
+}
+#endif
+}
+
+/**
+ * Vector kernel the batch conversions use
+ * @return BatchKernel the widest one the CPU supports, unless overridden
+ */
+BatchKernel batchKernel() {
+    return activeKernel().load(std::memory_order_relaxed);
+}
+
+/**
+ * Override the batch kernel, for benchmarks
+ * A kernel wider than what the CPU supports is not taken.
+ * @param kernel kernel to use
+ * @return BatchKernel the kernel now in use
+ */
+BatchKernel setBatchKernel(BatchKernel kernel) {
+    if (kernel <= detectKernel()) {
+        activeKernel().store(kernel, std::memory_order_relaxed);
+    }
+    return batchKernel();
+}
+
+const char *toString(BatchKernel kernel) {
+    switch (kernel) {
+        case BatchKernel::Avx2:
+            return "AVX2";
+        case BatchKernel::Sse2:
+            return "SSE2";
+        default:
+            return "scalar";
+    }
+}
+
+/**
+ * Geodetic to earth-centred earth-fixed coordinates
+ * @param point geodetic position
+ * @return Ecef position in meters
+ */
+Ecef toEcef(const Geodetic &point) {
+    const double lat = point.latitude_deg * kDegToRad;
+    const double lon = point.longitude_deg * kDegToRad;
+    const double sinLat = std::sin(lat);
+    const double cosLat = std::cos(lat);
+    const double primeVertical = kSemiMajorAxis_m / std::sqrt(1.0 - kEccentricitySq * sinLat * sinLat);
+    return {(primeVertical + point.altitude_m) * cosLat * std::cos(lon),
+            (primeVertical + point.altitude_m) * cosLat * std::sin(lon),
+            (primeVertical * (1.0 - kEccentricitySq) + point.altitude_m) * sinLat};
+}
+
+/**
+ * Earth-centred earth-fixed to geodetic coordinates (Heikkinen's closed form)
+ * @param point ECEF position in meters
+ * @return Geodetic position
+ */
+Geodetic fromEcef(const Ecef &point) {
+    constexpr double a = kSemiMajorAxis_m;
+    constexpr double b = kSemiMinorAxis_m;
+    constexpr double e2 = kEccentricitySq;
+    constexpr double ep2 = (a * a - b * b) / (b * b);
+
+    const double p = std::sqrt(point.x * point.x + point.y * point.y);
+    const double z = point.z;
+    const double f = 54.0 * b * b * z * z;
+    const double g = p * p + (1.0 - e2) * z * z - e2 * (a * a - b * b);
+    const double c = e2 * e2 * f * p * p / (g * g * g);
+    const double s = std::cbrt(1.0 + c + std::sqrt(c * c + 2.0 * c));
+    const double k = s + 1.0 + 1.0 / s;
+    const double pp = f / (3.0 * k * k * g * g);
+    const double q = std::sqrt(1.0 + 2.0 * e2 * e2 * pp);
+    const double r0 = -(pp * e2 * p) / (1.0 + q)
+                      + std::sqrt(0.5 * a * a * (1.0 + 1.0 / q)
+                                  - pp * (1.0 - e2) * z * z / (q * (1.0 + q))
+                                  - 0.5 * pp * p * p);
+    const double pr = p - e2 * r0;
+    const double u = std::sqrt(pr * pr + z * z);
+    const double v = std::sqrt(pr * pr + (1.0 - e2) * z * z);
+    const double z0 = b * b * z / (a * v);
+
+    Geodetic result;
+    result.altitude_m = u * (1.0 - b * b / (a * v));
+    result.latitude_deg = std::atan2(z + ep2 * z0, p) * kRadToDeg;
+    result.longitude_deg = std::atan2(point.y, point.x) * kRadToDeg;
+    return result;
+}
+
+/**
+ * Straight-line distance between two points
+ * @return double meters
+ */
+double distance(const Geodetic &from, const Geodetic &to) {
+    const Ecef a = toEcef(from);
+    const Ecef b = toEcef(to);
+    return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+}
+
+/**
+ * Great-circle ground distance on the mean sphere
+ * @return double meters
+ */
+double groundDistance(const Geodetic &from, const Geodetic &to) {
+    const double lat1 = from.latitude_deg * kDegToRad;
+    const double lat2 = to.latitude_deg * kDegToRad;
+    const double sinDLat = std::sin((lat2 - lat1) / 2.0);
+    const double sinDLon = std::sin((to.longitude_deg - from.longitude_deg) * kDegToRad / 2.0);
+    const double h = sinDLat * sinDLat + std::cos(lat1) * std::cos(lat2) * sinDLon * sinDLon;
+    return 2.0 * kMeanRadius_m * std::asin(std::sqrt(std::fmin(1.0, h)));
+}
+
+/**
+ * Initial great-circle bearing
+ * @return double degrees clockwise from north in [0, 360)
+ */
+double bearing(const Geodetic &from, const Geodetic &to) {
+    const double lat1 = from.latitude_deg * kDegToRad;
+    const double lat2 = to.latitude_deg * kDegToRad;
+    const double dLon = (to.longitude_deg - from.longitude_deg) * kDegToRad;
+    const double y = std::sin(dLon) * std::cos(lat2);
+    const double x = std::cos(lat1) * std::sin(lat2) - std::sin(lat1) * std::cos(lat2) * std::cos(dLon);
+    const double degrees = std::atan2(y, x) * kRadToDeg;
+    return degrees < 0.0 ? degrees + 360.0 : degrees;
+}
+
+/**
+ * Displace a point by a metric offset
+ * @param from start point
+ * @param north_m meters north
+ * @param east_m meters east
+ * @param up_m meters up
+ * @return Geodetic displaced point
+ */
+Geodetic offset(const Geodetic &from, double north_m, double east_m, double up_m) {
+    return LocalFrame(from).fromNed({north_m, east_m, -up_m});
+}
+
+/**
+ * Interpolate along the great circle on the mean sphere
+ * @param from start point, fraction 0
+ * @param to end point, fraction 1
+ * @param fraction position along the arc
+ * @return Geodetic interpolated point
+ */
+Geodetic intermediate(const Geodetic &from, const Geodetic &to, double fraction) {
+    const double altitude = from.altitude_m + (to.altitude_m - from.altitude_m) * fraction;
+    const double angle = groundDistance(from, to) / kMeanRadius_m;
+    if (angle < 1e-12) {
+        return {from.latitude_deg, from.longitude_deg, altitude};
+    }
+    const double lat1 = from.latitude_deg * kDegToRad;
+    const double lon1 = from.longitude_deg * kDegToRad;
+    const double lat2 = to.latitude_deg * kDegToRad;
+    const double lon2 = to.longitude_deg * kDegToRad;
+    const double a = std::sin((1.0 - fraction) * angle) / std::sin(angle);
+    const double b = std::sin(fraction * angle) / std::sin(angle);
+    const double x = a * std::cos(lat1) * std::cos(lon1) + b * std::cos(lat2) * std::cos(lon2);
+    const double y = a * std::cos(lat1) * std::sin(lon1) + b * std::cos(lat2) * std::sin(lon2);
+    const double z = a * std::sin(lat1) + b * std::sin(lat2);
+    return {std::atan2(z, std::sqrt(x * x + y * y)) * kRadToDeg, std::atan2(y, x) * kRadToDeg, altitude};
+}
+
+/**
+ * Constructor for the local frame
+ * Precomputes everything that depends only on the origin.
+ * @param origin frame origin
+ */
+LocalFrame::LocalFrame(const Geodetic &origin)
+        : originPoint(origin), originEcef(toEcef(origin)) {
+    const double lat = origin.latitude_deg * kDegToRad;
+    const double lon = origin.longitude_deg * kDegToRad;
+    sinLat = std::sin(lat);
+    cosLat = std::cos(lat);
+    sinLon = std::sin(lon);
+    cosLon = std::cos(lon);
+    const double w = 1.0 - kEccentricitySq * sinLat * sinLat;
+    const double meridional = kSemiMajorAxis_m * (1.0 - kEccentricitySq) / (w * std::sqrt(w));
+    const double primeVertical = kSemiMajorAxis_m / std::sqrt(w);
+    metersPerDegLat = (meridional + origin.altitude_m) * kDegToRad;
+    metersPerDegLon = (primeVertical + origin.altitude_m) * cosLat * kDegToRad;
+}
+
+/**
+ * Exact geodetic to NED
+ * @param point geodetic position
+ * @return Ned position relative to the origin, meters
+ */
+Ned LocalFrame::toNed(const Geodetic &point) const {
+    const Ecef ecef = toEcef(point);
+    const double dx = ecef.x - originEcef.x;
+    const double dy = ecef.y - originEcef.y;
+    const double dz = ecef.z - originEcef.z;
+    return {-sinLat * cosLon * dx - sinLat * sinLon * dy + cosLat * dz,
+            -sinLon * dx + cosLon * dy,
+            -cosLat * cosLon * dx - cosLat * sinLon * dy - sinLat * dz};
+}
+
+/**
+ * Exact NED to geodetic
+ * @param point NED position relative to the origin, meters
+ * @return Geodetic position
+ */
+Geodetic LocalFrame::fromNed(const Ned &point) const {
+    const double dx = -sinLat * cosLon * point.north - sinLon * point.east - cosLat * cosLon * point.down;
+    const double dy = -sinLat * sinLon * point.north + cosLon * point.east - cosLat * sinLon * point.down;
+    const double dz = cosLat * point.north - sinLat * point.down;
+    return fromEcef({originEcef.x + dx, originEcef.y + dy, originEcef.z + dz});
+}
+
+/**
+ * Batch geodetic to NED with the tangent-plane model
+ * @return void
+ */
+void LocalFrame::toNedBatch(const double *latitude_deg, const double *longitude_deg, const double *altitude_m,
+                            double *north, double *east, double *down, size_t count) const {
+    [[maybe_unused]] const BatchKernel kernel = batchKernel();
+    size_t i = 0;
+#if defined(TRACKING_GEODESY_AVX2)
+    if (kernel == BatchKernel::Avx2) {
+        i = toNedAvx2(originPoint, metersPerDegLat, metersPerDegLon, latitude_deg, longitude_deg, altitude_m,
+                      north, east, down, count);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128d lat0 = _mm_set1_pd(originPoint.latitude_deg);
+    const __m128d lon0 = _mm_set1_pd(originPoint.longitude_deg);
+    const __m128d alt0 = _mm_set1_pd(originPoint.altitude_m);
+    const __m128d scaleLat = _mm_set1_pd(metersPerDegLat);
+    const __m128d scaleLon = _mm_set1_pd(metersPerDegLon);
+    for (; kernel != BatchKernel::Scalar && i + 2 <= count; i += 2) {
+        _mm_storeu_pd(north + i, _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(latitude_deg + i), lat0), scaleLat));
+        _mm_storeu_pd(east + i, _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(longitude_deg + i), lon0), scaleLon));
+        _mm_storeu_pd(down + i, _mm_sub_pd(alt0, _mm_loadu_pd(altitude_m + i)));
+    }
+#endif
+    for (; i < count; ++i) {
+        north[i] = (latitude_deg[i] - originPoint.latitude_deg) * metersPerDegLat;
+        east[i] = (longitude_deg[i] - originPoint.longitude_deg) * metersPerDegLon;
+        down[i] = originPoint.altitude_m - altitude_m[i];
+    }
+}
+
+/**
+ * Batch NED to geodetic with the tangent-plane model
+ * @return void
+ */
+void LocalFrame::fromNedBatch(const double *north, const double *east, const double *down,
+                              double *latitude_deg, double *longitude_deg, double *altitude_m, size_t count) const {
+    const double degPerMeterLat = 1.0 / metersPerDegLat;
+    const double degPerMeterLon = 1.0 / metersPerDegLon;
+    [[maybe_unused]] const BatchKernel kernel = batchKernel();
+    size_t i = 0;
+#if defined(TRACKING_GEODESY_AVX2)
+    if (kernel == BatchKernel::Avx2) {
+        i = fromNedAvx2(originPoint, degPerMeterLat, degPerMeterLon, north, east, down,
+                        latitude_deg, longitude_deg, altitude_m, count);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128d lat0 = _mm_set1_pd(originPoint.latitude_deg);
+    const __m128d lon0 = _mm_set1_pd(originPoint.longitude_deg);
+    const __m128d alt0 = _mm_set1_pd(originPoint.altitude_m);
+    const __m128d scaleLat = _mm_set1_pd(degPerMeterLat);
+    const __m128d scaleLon = _mm_set1_pd(degPerMeterLon);
+    for (; kernel != BatchKernel::Scalar && i + 2 <= count; i += 2) {
+        _mm_storeu_pd(latitude_deg + i, _mm_add_pd(lat0, _mm_mul_pd(_mm_loadu_pd(north + i), scaleLat)));
+        _mm_storeu_pd(longitude_deg + i, _mm_add_pd(lon0, _mm_mul_pd(_mm_loadu_pd(east + i), scaleLon)));
+        _mm_storeu_pd(altitude_m + i, _mm_sub_pd(alt0, _mm_loadu_pd(down + i)));
+    }
+#endif
+    for (; i < count; ++i) {
+        latitude_deg[i] = originPoint.latitude_deg + north[i] * degPerMeterLat;
+        longitude_deg[i] = originPoint.longitude_deg + east[i] * degPerMeterLon;
+        altitude_m[i] = originPoint.altitude_m - down[i];
+    }
+}
+
+}
@@ -0,0 +1,177 @@
+// tracking - Geodesy.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_GEODESY_H
+#define TRACKING_GEODESY_H
+
+#include <cstddef>
+
+/**
+ * WGS84 geodesy: geodetic <-> ECEF <-> local NED/ENU, distances, bearings
+ * and metre-based offsets.
+ *
+ * Everything that needs metric distances between planes goes through here
+ * instead of adding offsets directly to degrees.
+ */
+namespace geodesy {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kDegToRad = kPi / 180.0;
+constexpr double kRadToDeg = 180.0 / kPi;
+
+// WGS84 ellipsoid
+constexpr double kSemiMajorAxis_m = 6378137.0;
+constexpr double kFlattening = 1.0 / 298.257223563;
+constexpr double kSemiMinorAxis_m = kSemiMajorAxis_m * (1.0 - kFlattening);
+constexpr double kEccentricitySq = kFlattening * (2.0 - kFlattening);
+constexpr double kMeanRadius_m = 6371008.8;
+
+struct Geodetic {
+    double latitude_deg{};
+    double longitude_deg{};
+    /// Height above the ellipsoid (MAVSDK absolute altitudes are close enough for local work).
+    double altitude_m{};
+};
+
+struct Ecef {
+    double x{};
+    double y{};
+    double z{};
+};
+
+struct Ned {
+    double north{};
+    double east{};
+    double down{};
+};
+
+struct Enu {
+    double east{};
+    double north{};
+    double up{};
+};
+
+Ecef toEcef(const Geodetic &point);
+
+/// Closed-form (Heikkinen) inverse, exact to well below a millimetre.
+Geodetic fromEcef(const Ecef &point);
+
+/// Straight-line distance between two points, meters.
+double distance(const Geodetic &from, const Geodetic &to);
+
+/// Great-circle distance on the mean sphere, ignoring altitude (haversine), meters.
+double groundDistance(const Geodetic &from, const Geodetic &to);
+
+/// Initial great-circle bearing from one point to another, degrees in [0, 360).
+double bearing(const Geodetic &from, const Geodetic &to);
+
+/// Point displaced by the given meters north/east/up from a start point.
+Geodetic offset(const Geodetic &from, double north_m, double east_m, double up_m);
+
+/// Point the given fraction of the way along the great circle from one point to another, altitude linear.
+Geodetic intermediate(const Geodetic &from, const Geodetic &to, double fraction);
+
+/// Vector kernel behind LocalFrame's batch conversions, the widest the CPU supports by default.
+enum class BatchKernel {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+BatchKernel batchKernel();
+
+/// Use another kernel, for benchmarks; one the CPU lacks is not taken. Returns the kernel in use.
+BatchKernel setBatchKernel(BatchKernel kernel);
+
+const char *toString(BatchKernel kernel);
+
+/**
+ * Local tangent plane anchored at an origin.
+ *
+ * All per-origin trigonometry and curvature radii are computed once in the
+ * constructor. toNed/fromNed are exact (through ECEF); the *Fast variants and
+ * the batch API use the first-order tangent-plane model, which is pure
+ * multiply-add and stays within a few centimetres over the few hundred metres
+ * that matter for formation spacing.
+ */
+class LocalFrame {
+public:
+    LocalFrame() = default;
+    explicit LocalFrame(const Geodetic &origin);
+
+    const Geodetic &origin() const {
+        return originPoint;
+    };
+
+    Ned toNed(const Geodetic &point) const;
+    Geodetic fromNed(const Ned &point) const;
+
+    Enu toEnu(const Geodetic &point) const {
+        const Ned ned = toNed(point);
+        return {ned.east, ned.north, -ned.down};
+    };
+
+    Geodetic fromEnu(const Enu &point) const {
+        return fromNed({point.north, point.east, -point.up});
+    };
+
+    Ned toNedFast(const Geodetic &point) const {
+        return {(point.latitude_deg - originPoint.latitude_deg) * metersPerDegLat,
+                (point.longitude_deg - originPoint.longitude_deg) * metersPerDegLon,
+                originPoint.altitude_m - point.altitude_m};
+    };
+
+    Geodetic fromNedFast(const Ned &point) const {
+        return {originPoint.latitude_deg + point.north / metersPerDegLat,
+                originPoint.longitude_deg + point.east / metersPerDegLon,
+                originPoint.altitude_m - point.down};
+    };
+
+    /**
+     * Convert whole arrays of positions to NED with the tangent-plane model.
+     * Uses AVX2 when the CPU has it (chosen at run time), else SSE2; arrays may be unaligned.
+     */
+    void toNedBatch(const double *latitude_deg, const double *longitude_deg, const double *altitude_m,
+                    double *north, double *east, double *down, size_t count) const;
+
+    /// Inverse of toNedBatch.
+    void fromNedBatch(const double *north, const double *east, const double *down,
+                      double *latitude_deg, double *longitude_deg, double *altitude_m, size_t count) const;
+
+    /// Meters per degree of latitude and longitude at the origin.
+    double metersPerDegreeLatitude() const {
+        return metersPerDegLat;
+    };
+
+    double metersPerDegreeLongitude() const {
+        return metersPerDegLon;
+    };
+
+private:
+    Geodetic originPoint{};
+    Ecef originEcef{};
+    double sinLat{};
+    double cosLat{1.0};
+    double sinLon{};
+    double cosLon{1.0};
+    double metersPerDegLat{1.0};
+    double metersPerDegLon{1.0};
+};
+
+}
+
+
+#endif //TRACKING_GEODESY_H
@@ -0,0 +1,82 @@
+// tracking - Guidance.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include "Guidance.h"
+
+namespace guidance {
+/**
+ * Velocity command towards the slot
+ * Works in the slot's local frame. The follower offset r from the slot splits
+ * into along-track and cross-track parts; the law picks an aim point on or
+ * ahead of the track, the course is the bearing to it, and the speed is
+ * chosen so that its part along the track is the leader's ground speed
+ * corrected by the along-track error.
+ * @param follower follower pose
+ * @param slot target position
+ * @param leader leader pose
+ * @param track_rad leader track in radians
+ * @param config law and gains
+ * @return Command velocity setpoint and errors
+ */
+Command compute(const PoseSnapshot &follower, const geodesy::Geodetic &slot, const PoseSnapshot &leader,
+                double track_rad, const Config &config) {
+    const geodesy::LocalFrame frame(slot);
+    const geodesy::Ned offset = frame.toNed({follower.latitude_deg, follower.longitude_deg,
+                                             follower.absolute_altitude_m});
+    const double trackNorth = std::cos(track_rad);
+    const double trackEast = std::sin(track_rad);
+
+    Command command;
+    command.alongTrack_m = -(offset.north * trackNorth + offset.east * trackEast);
+    command.crossTrack_m = offset.east * trackNorth - offset.north * trackEast;
+
+    const double followerSpeed = std::max(follower.groundSpeed_m_s(), config.minSpeed_m_s);
+    const double l1 = std::max(config.minL1_m, config.l1Damping * config.l1Period_s * followerSpeed / geodesy::kPi);
+    const double distance = std::hypot(offset.north, offset.east);
+    double aimNorth;
+    double aimEast;
+    if (command.alongTrack_m < -config.maxAhead_m) {
+        aimNorth = -offset.north;
+        aimEast = -offset.east;
+    } else if (config.law == Law::PurePursuit || distance > 2.0 * l1) {
+        // L1 tracks a line; far from the slot that line keeps turning with the leader, so rendezvous first.
+        aimNorth = config.lookahead_m * trackNorth - offset.north;
+        aimEast = config.lookahead_m * trackEast - offset.east;
+    } else {
+        const double cross = command.crossTrack_m;
+        // From the follower's foot point on the track, go ahead until the aim point is l1 away.
+        double ahead = std::fabs(cross) < l1 ? std::sqrt(l1 * l1 - cross * cross) : 0.0;
+        ahead = std::max(ahead, std::fabs(cross) / std::tan(config.maxIntercept_deg * geodesy::kDegToRad));
+        aimNorth = ahead * trackNorth + cross * trackEast;
+        aimEast = ahead * trackEast - cross * trackNorth;
+    }
+    const double course = std::atan2(aimEast, aimNorth);
+
+    // Flying at an angle to the track only part of the speed counts along it; past 60 degrees stop compensating.
+    const double alongShare = std::max(0.5, std::cos(course - track_rad));
+    const double alongSpeed = leader.groundSpeed_m_s() + config.alongTrackGain * command.alongTrack_m;
+    const double speed = std::clamp(alongSpeed / alongShare, config.minSpeed_m_s, config.maxSpeed_m_s);
+    command.north_m_s = static_cast<float>(speed * std::cos(course));
+    command.east_m_s = static_cast<float>(speed * std::sin(course));
+    // offset.down is positive when the follower is below the slot.
+    command.down_m_s = static_cast<float>(std::clamp(leader.down_m_s - config.altitudeGain * offset.down,
+                                                     -config.maxVertical_m_s, config.maxVertical_m_s));
+    command.yaw_deg = static_cast<float>(course * geodesy::kRadToDeg);
+    return command;
+}
+}
@@ -0,0 +1,90 @@
+// tracking - Guidance.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_GUIDANCE_H
+#define TRACKING_GUIDANCE_H
+
+#include "Geodesy.h"
+#include "PoseSnapshot.h"
+
+/**
+ * Lateral guidance towards a moving slot, as velocity setpoints.
+ *
+ * The slot moves with the leader along the leader's track. The follower is
+ * steered onto that track by a pursuit law and its speed is the leader's speed
+ * plus a correction for the along-track error, so it never has to catch up
+ * with a position setpoint that jumps ahead on every tick. Far from the slot
+ * (beyond 2 * L1) the L1 law falls back to pursuit until it has closed in, and
+ * a follower far ahead of the slot turns back towards it, slowing down alone
+ * would take minutes.
+ */
+namespace guidance {
+enum class Law {
+    /// Aim at a fixed distance ahead of the slot along the leader's track.
+    PurePursuit,
+    /// Aim at the point of the leader's track L1 meters away (nonlinear L1 guidance).
+    L1,
+};
+
+struct Config {
+    Law law = Law::L1;
+    /// Pure pursuit: aim this far ahead of the slot, meters.
+    double lookahead_m = 60.0;
+    /// L1: period and damping of the cross-track response; L1 = damping * period * speed / pi.
+    double l1Period_s = 7.0;
+    double l1Damping = 0.75;
+    double minL1_m = 30.0;
+    /// L1: steepest angle at which the follower closes on the track, degrees. A perpendicular run-in
+    /// makes no progress along the track and overshoots it.
+    double maxIntercept_deg = 25.0;
+    /// Along-track error to speed change, 1/s. Applies to the speed along the track, the speed
+    /// across it while intercepting comes on top.
+    double alongTrackGain = 0.3;
+    /// Further ahead of the slot than this, turn back towards it instead of slowing down.
+    double maxAhead_m = 80.0;
+    /// Altitude error to vertical speed, 1/s.
+    double altitudeGain = 0.5;
+    double minSpeed_m_s = 14.0;
+    double maxSpeed_m_s = 30.0;
+    double maxVertical_m_s = 5.0;
+};
+
+/// Velocity setpoint with the errors it was computed from.
+struct Command {
+    float north_m_s{};
+    float east_m_s{};
+    float down_m_s{};
+    /// Commanded course, degrees.
+    float yaw_deg{};
+    /// Distance from the follower to the leader's track, positive right of it.
+    double crossTrack_m{};
+    /// Distance the slot is ahead of the follower along the track.
+    double alongTrack_m{};
+};
+
+/**
+ * Velocity command that brings the follower onto the slot.
+ * @param follower follower pose, position and velocity are used
+ * @param slot where the follower should be
+ * @param leader leader pose, its velocity is the feed-forward
+ * @param track_rad leader track (course over ground) in radians
+ */
+Command compute(const PoseSnapshot &follower, const geodesy::Geodetic &slot, const PoseSnapshot &leader,
+                double track_rad, const Config &config);
+}
+
+
+#endif //TRACKING_GUIDANCE_H
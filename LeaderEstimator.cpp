@@ -0,0 +1,228 @@
+// tracking - LeaderEstimator.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include "LeaderEstimator.h"
+
+namespace {
+/// Velocity variance before the first velocity sample, (m/s)^2.
+constexpr double kUnknownVelocityVariance = 30.0 * 30.0;
+
+enum AxisIndex { North = 0, East = 1, Down = 2 };
+
+double toSeconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
+}
+
+LeaderEstimator::LeaderEstimator()
+        : LeaderEstimator(Config{}) {
+}
+
+/**
+ * Constructor for the estimator
+ * @param config noise and latency configuration
+ */
+LeaderEstimator::LeaderEstimator(Config config)
+        : config(config) {
+    reset();
+}
+
+/**
+ * Forget everything, the next position fix re-anchors the local frame
+ * @return void
+ */
+void LeaderEstimator::reset() {
+    for (Axis &axis: axes) {
+        axis = Axis{};
+        axis.vv = kUnknownVelocityVariance;
+    }
+    state = State{};
+    hasVelocity = false;
+    publish();
+}
+
+/**
+ * Feed a position fix
+ * @param latitude_deg latitude in degrees
+ * @param longitude_deg longitude in degrees
+ * @param altitude_m absolute altitude in meters
+ * @param received monotonic receive time of the fix
+ * @return void
+ */
+void LeaderEstimator::updatePosition(double latitude_deg, double longitude_deg, double altitude_m,
+                                     Clock::time_point received) {
+    if (!state.initialized) {
+        state.initialized = true;
+        state.frame = geodesy::LocalFrame({latitude_deg, longitude_deg, altitude_m});
+        state.time = received;
+        const double variance = config.positionNoise_m * config.positionNoise_m;
+        for (Axis &axis: axes) {
+            axis.position = 0.0;
+            axis.pp = variance;
+            axis.pv = 0.0;
+        }
+        publish();
+        return;
+    }
+
+    propagate(received);
+    const geodesy::Ned measured = state.frame.toNed({latitude_deg, longitude_deg, altitude_m});
+    measurePosition(axes[North], measured.north);
+    measurePosition(axes[East], measured.east);
+    measurePosition(axes[Down], measured.down);
+    publish();
+}
+
+/**
+ * Feed a velocity sample in the NED frame
+ * @param north_m_s north velocity
+ * @param east_m_s east velocity
+ * @param down_m_s down velocity
+ * @param received monotonic receive time of the sample
+ * @return void
+ */
+void LeaderEstimator::updateVelocity(double north_m_s, double east_m_s, double down_m_s,
+                                     Clock::time_point received) {
+    if (state.initialized) {
+        propagate(received);
+    }
+    if (!hasVelocity) {
+        // The first sample replaces the uninformed prior outright.
+        hasVelocity = true;
+        const double variance = config.velocityNoise_m_s * config.velocityNoise_m_s;
+        const double measured[3] = {north_m_s, east_m_s, down_m_s};
+        for (int i = 0; i < 3; ++i) {
+            axes[i].velocity = measured[i];
+            axes[i].vv = variance;
+            axes[i].pv = 0.0;
+        }
+    } else {
+        measureVelocity(axes[North], north_m_s);
+        measureVelocity(axes[East], east_m_s);
+        measureVelocity(axes[Down], down_m_s);
+    }
+    publish();
+}
+
+/**
+ * Extrapolate the latest estimate
+ * The horizon is (when - last update) plus the configured telemetry latency,
+ * clamped to maxHorizon.
+ * @param when time the estimate is needed for, usually the command send time
+ * @return PoseSnapshot predicted position and filtered velocity
+ */
+PoseSnapshot LeaderEstimator::predict(Clock::time_point when) const {
+    const State current = published.load();
+    PoseSnapshot snapshot;
+    if (!current.initialized) {
+        return snapshot;
+    }
+    const double horizon = std::clamp(toSeconds(when - current.time + config.telemetryLatency),
+                                      0.0, toSeconds(config.maxHorizon));
+    const geodesy::Geodetic position = current.frame.fromNed({current.north_m + current.north_m_s * horizon,
+                                                              current.east_m + current.east_m_s * horizon,
+                                                              current.down_m + current.down_m_s * horizon});
+
+    snapshot.latitude_deg = position.latitude_deg;
+    snapshot.longitude_deg = position.longitude_deg;
+    snapshot.absolute_altitude_m = position.altitude_m;
+    snapshot.north_m_s = static_cast<float>(current.north_m_s);
+    snapshot.east_m_s = static_cast<float>(current.east_m_s);
+    snapshot.down_m_s = static_cast<float>(current.down_m_s);
+    snapshot.positionTime = current.time;
+    snapshot.received = current.time;
+    return snapshot;
+}
+
+/**
+ * Merge the prediction into the latest snapshot
+ * Attitude, airspeed and the other fields the filter does not track come from the snapshot.
+ * @param latest latest snapshot of the vehicle
+ * @param when time the estimate is needed for
+ * @return PoseSnapshot latest with predicted position and velocity
+ */
+PoseSnapshot LeaderEstimator::predict(const PoseSnapshot &latest, Clock::time_point when) const {
+    const PoseSnapshot predicted = predict(when);
+    if (!predicted.hasFix()) {
+        return latest;
+    }
+    PoseSnapshot snapshot = latest;
+    snapshot.latitude_deg = predicted.latitude_deg;
+    snapshot.longitude_deg = predicted.longitude_deg;
+    snapshot.absolute_altitude_m = predicted.absolute_altitude_m;
+    snapshot.north_m_s = predicted.north_m_s;
+    snapshot.east_m_s = predicted.east_m_s;
+    snapshot.down_m_s = predicted.down_m_s;
+    return snapshot;
+}
+
+/**
+ * Constant-velocity time update up to the given time
+ * Out-of-order samples are measured against the current state without propagating.
+ * @param to time to propagate to
+ * @return void
+ */
+void LeaderEstimator::propagate(Clock::time_point to) {
+    const double dt = toSeconds(to - state.time);
+    if (dt <= 0.0) {
+        return;
+    }
+    const double q = config.accelerationNoise * config.accelerationNoise;
+    const double dt2 = dt * dt;
+    for (Axis &axis: axes) {
+        axis.position += axis.velocity * dt;
+        axis.pp += 2.0 * dt * axis.pv + dt2 * axis.vv + q * dt2 * dt2 / 4.0;
+        axis.pv += dt * axis.vv + q * dt2 * dt / 2.0;
+        axis.vv += q * dt2;
+    }
+    state.time = to;
+}
+
+void LeaderEstimator::measurePosition(Axis &axis, double measured) const {
+    const double innovation = measured - axis.position;
+    const double s = axis.pp + config.positionNoise_m * config.positionNoise_m;
+    const double kp = axis.pp / s;
+    const double kv = axis.pv / s;
+    axis.position += kp * innovation;
+    axis.velocity += kv * innovation;
+    axis.vv -= kv * axis.pv;
+    axis.pv *= (1.0 - kp);
+    axis.pp *= (1.0 - kp);
+}
+
+void LeaderEstimator::measureVelocity(Axis &axis, double measured) const {
+    const double innovation = measured - axis.velocity;
+    const double s = axis.vv + config.velocityNoise_m_s * config.velocityNoise_m_s;
+    const double kp = axis.pv / s;
+    const double kv = axis.vv / s;
+    axis.position += kp * innovation;
+    axis.velocity += kv * innovation;
+    axis.pp -= kp * axis.pv;
+    axis.pv *= (1.0 - kv);
+    axis.vv *= (1.0 - kv);
+}
+
+void LeaderEstimator::publish() {
+    state.north_m = axes[North].position;
+    state.east_m = axes[East].position;
+    state.down_m = axes[Down].position;
+    state.north_m_s = axes[North].velocity;
+    state.east_m_s = axes[East].velocity;
+    state.down_m_s = axes[Down].velocity;
+    published.store(state);
+}
@@ -0,0 +1,120 @@
+// tracking - LeaderEstimator.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_LEADERESTIMATOR_H
+#define TRACKING_LEADERESTIMATOR_H
+
+#include <chrono>
+#include "Geodesy.h"
+#include "PoseSnapshot.h"
+#include "SeqLock.h"
+
+/**
+ * Constant-velocity Kalman filter on a plane's position.
+ *
+ * Fed from the telemetry callbacks (position and velocity_ned), it keeps a
+ * fixed-size state per axis in a local north/east/down frame anchored at the
+ * first fix. Readers extrapolate the latest estimate to the moment a command
+ * is sent, which hides the link and telemetry latency instead of chasing
+ * where the leader used to be.
+ *
+ * Updates must come from a single thread (the telemetry callback thread).
+ * predict() may be called from any thread and never blocks the updater.
+ */
+class LeaderEstimator {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Config {
+        /// Standard deviation of the unmodelled acceleration, m/s^2.
+        double accelerationNoise = 3.0;
+        /// Standard deviation of a GPS position fix, meters.
+        double positionNoise_m = 2.0;
+        /// Standard deviation of a velocity_ned sample, m/s.
+        double velocityNoise_m_s = 0.5;
+        /// Age a fix already has when it is received, added to every prediction horizon.
+        Clock::duration telemetryLatency = std::chrono::milliseconds(100);
+        /// Never extrapolate further than this; a stalled stream should not fly off.
+        Clock::duration maxHorizon = std::chrono::seconds(2);
+    };
+
+    LeaderEstimator();
+    explicit LeaderEstimator(Config config);
+
+    LeaderEstimator(const LeaderEstimator &) = delete;
+    LeaderEstimator &operator=(const LeaderEstimator &) = delete;
+
+    void updatePosition(double latitude_deg, double longitude_deg, double altitude_m, Clock::time_point received);
+    void updateVelocity(double north_m_s, double east_m_s, double down_m_s, Clock::time_point received);
+
+    /**
+     * Estimated pose at the given time.
+     * Position and velocity fields are filled from the filter, attitude fields are left zero.
+     * Returns a snapshot without a fix until the first position update.
+     */
+    PoseSnapshot predict(Clock::time_point when) const;
+
+    /**
+     * The latest snapshot with position and velocity replaced by predict(when).
+     * What every vehicle backend returns from predictPose; unchanged until the first position update.
+     */
+    PoseSnapshot predict(const PoseSnapshot &latest, Clock::time_point when) const;
+
+    bool isInitialized() const {
+        return published.load().initialized;
+    };
+
+    void reset();
+
+private:
+    struct Axis {
+        double position{};
+        double velocity{};
+        // Covariance [pp pv; pv vv]
+        double pp{};
+        double pv{};
+        double vv{};
+    };
+
+    struct State {
+        bool initialized{};
+        geodesy::LocalFrame frame;
+        double north_m{};
+        double east_m{};
+        double down_m{};
+        double north_m_s{};
+        double east_m_s{};
+        double down_m_s{};
+        Clock::time_point time{};
+    };
+
+    void propagate(Clock::time_point to);
+    void measurePosition(Axis &axis, double measured) const;
+    void measureVelocity(Axis &axis, double measured) const;
+    void publish();
+
+    Config config;
+
+    // Filter state, owned by the updating thread.
+    Axis axes[3]{};
+    State state{};
+    bool hasVelocity{};
+
+    SeqLock<State> published;
+};
+
+
+#endif //TRACKING_LEADERESTIMATOR_H
@@ -0,0 +1,149 @@
+// tracking - LinkMonitor.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <string>
+#include "LinkMonitor.h"
+
+namespace {
+std::string sysidLabel(int sysid) {
+    return "sysid=\"" + std::to_string(sysid) + "\"";
+}
+}
+
+/**
+ * Constructor for the monitor of one vehicle
+ * @param sysid system id, labels the metrics
+ * @param window length of the windows recentLoss and the rate are computed over
+ */
+LinkMonitor::LinkMonitor(int sysid, Clock::duration window)
+        : window(window),
+          messages(Metrics::instance().counter("tracking_link_messages_total",
+                                               "MAVLink messages received from the autopilot", sysidLabel(sysid))),
+          losses(Metrics::instance().counter("tracking_link_lost_total",
+                                             "MAVLink messages missing from the autopilot's sequence",
+                                             sysidLabel(sysid))),
+          gaps(Metrics::instance().histogram("tracking_link_gap_seconds",
+                                             "Time between successive messages from the autopilot",
+                                             sysidLabel(sysid))),
+          roundTrips(Metrics::instance().histogram("tracking_link_rtt_seconds",
+                                                   "Time from a command to its acknowledgement", sysidLabel(sysid))) {
+}
+
+/**
+ * Count one message and the ones its sequence number says went missing
+ * @param sequence MAVLink sequence number of the message
+ * @param now receive time
+ * @return void
+ */
+void LinkMonitor::onMessage(uint8_t sequence, Clock::time_point now) {
+    uint64_t missing = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!started) {
+            started = true;
+            windowStart = now;
+        } else {
+            const auto step = static_cast<uint8_t>(sequence - lastSequence);
+            if (step == 0) {
+                // Same message over a second link.
+                return;
+            }
+            if (step < 128) {
+                missing = step - 1u;
+            }
+            const Clock::duration gap = now - lastMessage;
+            if (gap > maxGap) {
+                maxGap = gap;
+            }
+            gaps.record(gap);
+        }
+        lastSequence = sequence;
+        lastMessage = now;
+        ++received;
+        lost += missing;
+        ++windowReceived;
+        windowLost += missing;
+        if (now - windowStart >= window) {
+            const double expected = static_cast<double>(windowReceived + windowLost);
+            lastWindowLoss.store(static_cast<double>(windowLost) / expected, std::memory_order_relaxed);
+            const double seconds = std::chrono::duration<double>(now - windowStart).count();
+            windowRate_hz = static_cast<double>(windowReceived) / seconds;
+            windowStart = now;
+            windowReceived = 0;
+            windowLost = 0;
+        }
+    }
+    messages.add();
+    if (missing > 0) {
+        losses.add(missing);
+    }
+}
+
+/**
+ * Remember when a command went out
+ * @param command MAV_CMD id
+ * @param now send time
+ * @return void
+ */
+void LinkMonitor::onCommandSent(uint16_t command, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending[command % pending.size()] = {command, now};
+}
+
+/**
+ * Take a round trip from the acknowledged command
+ * Acks for commands not seen going out, or already answered, are ignored.
+ * @param command MAV_CMD id
+ * @param now receive time
+ * @return void
+ */
+void LinkMonitor::onCommandAck(uint16_t command, Clock::time_point now) {
+    Clock::duration rtt;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Pending &slot = pending[command % pending.size()];
+        if (slot.command != command || slot.sentAt == Clock::time_point{}) {
+            return;
+        }
+        rtt = now - slot.sentAt;
+        slot.sentAt = Clock::time_point{};
+        lastRtt = rtt;
+    }
+    roundTrips.record(rtt);
+}
+
+/**
+ * Consistent copy of the statistics
+ * @param now time the silence is measured to
+ * @return Stats totals, last window and round trips
+ */
+LinkMonitor::Stats LinkMonitor::stats(Clock::time_point now) const {
+    Stats result;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        result.received = received;
+        result.lost = lost;
+        result.rate_hz = windowRate_hz;
+        result.silence = started ? now - lastMessage : Clock::duration::zero();
+        result.maxGap = maxGap;
+        result.lastRtt = lastRtt;
+    }
+    result.recentLoss = recentLoss();
+    const Histogram::Snapshot rtt = roundTrips.snapshot();
+    result.rttSamples = rtt.count;
+    result.meanRtt = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(rtt.mean()));
+    return result;
+}
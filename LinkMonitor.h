@@ -0,0 +1,113 @@
+// tracking - LinkMonitor.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_LINKMONITOR_H
+#define TRACKING_LINKMONITOR_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include "Metrics.h"
+
+/**
+ * Link statistics of one vehicle, from the MAVLink messages its autopilot sends.
+ *
+ * Fed from the receive path with the sequence number of every message. Loss is
+ * estimated from gaps in the sequence, so it counts messages of any type lost
+ * anywhere between the autopilot and us; a jump back or of more than half the
+ * sequence space is taken as reordering or a restart and not counted. Counts
+ * are also closed off per window (1 s by default), so recentLoss and the rate
+ * follow the link instead of averaging over the whole flight. Round-trip time
+ * is measured from each COMMAND_LONG to the COMMAND_ACK for the same command.
+ *
+ * Recording is an uncontended lock and a few additions, so several receive
+ * threads may feed one monitor. recentLoss() is a single atomic load.
+ */
+class LinkMonitor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        uint64_t received{};
+        uint64_t lost{};
+        /// Share of messages lost over the last full window, [0, 1].
+        double recentLoss{};
+        /// Messages per second over the last full window.
+        double rate_hz{};
+        /// Time since the last message, as of the stats() call.
+        Clock::duration silence{};
+        Clock::duration maxGap{};
+        Clock::duration lastRtt{};
+        Clock::duration meanRtt{};
+        uint64_t rttSamples{};
+    };
+
+    explicit LinkMonitor(int sysid, Clock::duration window = std::chrono::seconds(1));
+
+    LinkMonitor(const LinkMonitor &) = delete;
+    LinkMonitor &operator=(const LinkMonitor &) = delete;
+
+    /// One message from the vehicle's autopilot, with its MAVLink sequence number.
+    void onMessage(uint8_t sequence, Clock::time_point now);
+
+    /// A command was sent to the vehicle.
+    void onCommandSent(uint16_t command, Clock::time_point now);
+
+    /// The vehicle acknowledged a command; matched with the last one sent.
+    void onCommandAck(uint16_t command, Clock::time_point now);
+
+    /// Loss over the last full window, for hot paths.
+    double recentLoss() const {
+        return lastWindowLoss.load(std::memory_order_relaxed);
+    };
+
+    Stats stats(Clock::time_point now) const;
+
+private:
+    struct Pending {
+        uint16_t command{};
+        Clock::time_point sentAt{};
+    };
+
+    const Clock::duration window;
+
+    mutable std::mutex mutex;
+    bool started{false};
+    uint8_t lastSequence{};
+    Clock::time_point lastMessage{};
+    Clock::duration maxGap{};
+    uint64_t received{};
+    uint64_t lost{};
+    Clock::time_point windowStart{};
+    uint64_t windowReceived{};
+    uint64_t windowLost{};
+    double windowRate_hz{};
+    /// Commands waiting for their ack, by command id modulo the size.
+    std::array<Pending, 8> pending{};
+    Clock::duration lastRtt{};
+
+    std::atomic<double> lastWindowLoss{0.0};
+
+    Counter &messages;
+    Counter &losses;
+    Histogram &gaps;
+    Histogram &roundTrips;
+};
+
+
+#endif //TRACKING_LINKMONITOR_H
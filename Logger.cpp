@@ -0,0 +1,169 @@
+// tracking - Logger.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <iostream>
+#include "Logger.h"
+
+using namespace std;
+
+namespace {
+/// While records keep coming, how long the writer lets them gather before the next batch.
+constexpr chrono::milliseconds kBatchWindow{1};
+
+int64_t nowNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug:
+            return "DEBUG";
+        case LogLevel::Info:
+            return "INFO ";
+        case LogLevel::Warn:
+            return "WARN ";
+        case LogLevel::Error:
+            return "ERROR";
+    }
+    return "?    ";
+}
+}
+
+ostream &operator<<(ostream &out, const LogText &text) {
+    return out << text.text;
+}
+
+/**
+ * Copy the format up to the next "{}" and step past it
+ * @param out stream to write to
+ * @param format remaining format, advanced past the placeholder
+ * @return void
+ */
+void logdetail::writeUntilPlaceholder(ostream &out, const char *&format) {
+    const char *start = format;
+    while (*format != '\0' && !(format[0] == '{' && format[1] == '}')) {
+        ++format;
+    }
+    out.write(start, format - start);
+    if (*format != '\0') {
+        format += 2;
+    } else {
+        // More arguments than placeholders, append them.
+        out << ' ';
+    }
+}
+
+/**
+ * Process-wide logger, the writer thread starts on first use
+ * @return Logger& the logger
+ */
+Logger &Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+        : startNs(nowNs()),
+          writer(&Logger::writerLoop, this) {
+}
+
+Logger::~Logger() {
+    {
+        lock_guard<mutex> lock(wakeMutex);
+        running.store(false);
+    }
+    wake.notify_one();
+    written.notify_all();
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+/**
+ * Wait until the writer has printed every record queued before the call
+ * @return void
+ */
+void Logger::flush() {
+    const size_t target = records.size() + writtenRecords.load();
+    unique_lock<mutex> lock(wakeMutex);
+    written.wait(lock, [this, target] {
+        return writtenRecords.load() >= target || !running.load();
+    });
+}
+
+/**
+ * Write every queued record
+ * @return size_t number of records written
+ */
+size_t Logger::drain() {
+    size_t count = 0;
+    Record record;
+    while (records.tryPop(record)) {
+        ostream &out = record.level >= LogLevel::Warn ? cerr : cout;
+        const int64_t elapsedNs = record.timestampNs - startNs;
+        char stamp[32];
+        snprintf(stamp, sizeof(stamp), "[%11.6f] ", static_cast<double>(elapsedNs) / 1e9);
+        out << stamp << levelName(record.level) << ' ';
+        record.renderer(out, record.format, record.payload);
+        out << '\n';
+        ++count;
+    }
+    if (count > 0) {
+        cout.flush();
+        cerr.flush();
+        {
+            lock_guard<mutex> lock(wakeMutex);
+            writtenRecords.fetch_add(count);
+        }
+        written.notify_all();
+    }
+    return count;
+}
+
+/**
+ * Writer thread: write in batches while records come in, sleep once the ring is empty
+ * @return void
+ */
+void Logger::writerLoop() {
+    while (running.load(memory_order_relaxed)) {
+        const size_t count = drain();
+        if (count >= records.capacity() / 2) {
+            // The ring is filling up, keep going.
+            continue;
+        }
+        if (count > 0) {
+            // Write in batches instead of chasing the producers cell by cell, which
+            // would bounce cache lines with them. Callers don't wake us meanwhile.
+            this_thread::sleep_for(kBatchWindow);
+            continue;
+        }
+        sleeping.store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        {
+            unique_lock<mutex> lock(wakeMutex);
+            wake.wait(lock, [this] {
+                return records.size() > 0 || !running.load(memory_order_relaxed);
+            });
+        }
+        sleeping.store(false, memory_order_relaxed);
+    }
+    drain();
+    const uint64_t lost = dropped();
+    if (lost > 0) {
+        cerr << "Logger dropped " << lost << " records" << endl;
+    }
+}
@@ -0,0 +1,220 @@
+// tracking - Logger.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_LOGGER_H
+#define TRACKING_LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include "MpscQueue.h"
+
+// Compile-time level filter: calls below this level compile to nothing.
+#define TRACKING_LOG_LEVEL_DEBUG 0
+#define TRACKING_LOG_LEVEL_INFO 1
+#define TRACKING_LOG_LEVEL_WARN 2
+#define TRACKING_LOG_LEVEL_ERROR 3
+#define TRACKING_LOG_LEVEL_OFF 4
+
+#ifndef TRACKING_LOG_LEVEL
+#define TRACKING_LOG_LEVEL TRACKING_LOG_LEVEL_INFO
+#endif
+
+enum class LogLevel : uint8_t {
+    Debug = TRACKING_LOG_LEVEL_DEBUG,
+    Info = TRACKING_LOG_LEVEL_INFO,
+    Warn = TRACKING_LOG_LEVEL_WARN,
+    Error = TRACKING_LOG_LEVEL_ERROR,
+};
+
+/// Inline copy of a short string argument, so the caller's string can go away.
+struct LogText {
+    char text[48];
+};
+
+std::ostream &operator<<(std::ostream &out, const LogText &text);
+
+namespace logdetail {
+
+/// How an argument is stored in a record: trivially copyable values as is, strings inline.
+template<typename T, typename Enable = void>
+struct Stored {
+    using type = T;
+
+    static T convert(const T &value) {
+        return value;
+    }
+};
+
+template<>
+struct Stored<std::string> {
+    using type = LogText;
+
+    static LogText convert(const std::string &value) {
+        LogText stored{};
+        std::strncpy(stored.text, value.c_str(), sizeof(stored.text) - 1);
+        return stored;
+    }
+};
+
+template<typename T>
+using StoredType = typename Stored<std::decay_t<T>>::type;
+
+constexpr size_t kPayloadBytes = 96;
+
+template<typename... Args>
+constexpr size_t payloadSize() {
+    return (size_t{0} + ... + sizeof(StoredType<Args>));
+}
+
+void writeUntilPlaceholder(std::ostream &out, const char *&format);
+
+template<typename T>
+void renderOne(std::ostream &out, const char *&format, const unsigned char *&cursor) {
+    T value;
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    writeUntilPlaceholder(out, format);
+    if constexpr (std::is_same_v<T, uint8_t> || std::is_same_v<T, int8_t>) {
+        out << static_cast<int>(value);
+    } else {
+        out << value;
+    }
+}
+
+/// Runs on the writer thread: decode the payload and substitute it into "{}" placeholders.
+template<typename... Stored>
+void render(std::ostream &out, const char *format, [[maybe_unused]] const unsigned char *payload) {
+    (renderOne<Stored>(out, format, payload), ...);
+    out << format;
+}
+
+}
+
+/**
+ * Asynchronous logger for control paths.
+ *
+ * A log call copies the format pointer and its raw arguments into a fixed-size
+ * record in a lock-free ring and returns; formatting and I/O happen on a
+ * background writer thread. Calls never allocate and never block on the
+ * terminal or journald. When the ring is full the record is dropped and counted.
+ * An idle writer sleeps on a condition variable; only the call that finds it
+ * asleep, i.e. the first record after the ring ran empty, takes the lock to wake it.
+ *
+ * Formats use "{}" placeholders filled with operator<<, so MAVSDK result enums
+ * print as usual. Format strings must be literals. Arguments must be trivially
+ * copyable or std::string (copied inline, truncated to 47 characters).
+ *
+ * Use the LOG_* macros so calls below TRACKING_LOG_LEVEL are compiled out.
+ */
+class Logger {
+public:
+    struct Record {
+        int64_t timestampNs{};
+        const char *format{};
+        void (*renderer)(std::ostream &, const char *, const unsigned char *){};
+        LogLevel level{LogLevel::Info};
+        alignas(8) unsigned char payload[logdetail::kPayloadBytes]{};
+    };
+
+    static Logger &instance();
+
+    template<typename... Args>
+    void write(LogLevel level, const char *format, const Args &... args) {
+        static_assert(logdetail::payloadSize<Args...>() <= logdetail::kPayloadBytes, "Too many log arguments");
+        static_assert((std::is_trivially_copyable_v<logdetail::StoredType<Args>> && ...),
+                      "Log arguments must be trivially copyable or std::string");
+        const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        const bool queued = records.tryEmplace([&](Record &record) {
+            record.timestampNs = now;
+            record.format = format;
+            record.level = level;
+            record.renderer = &logdetail::render<logdetail::StoredType<Args>...>;
+            [[maybe_unused]] unsigned char *cursor = record.payload;
+            ((store(cursor, logdetail::Stored<std::decay_t<Args>>::convert(args))), ...);
+        });
+        if (!queued) {
+            droppedRecords.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // Pairs with the fence in writerLoop(): either we see it asleep or it sees the record.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false, std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wake.notify_one();
+        }
+    }
+
+    /// Block until everything queued so far has been written.
+    void flush();
+
+    uint64_t dropped() const {
+        return droppedRecords.load(std::memory_order_relaxed);
+    }
+
+    ~Logger();
+
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+private:
+    Logger();
+
+    template<typename T>
+    static void store(unsigned char *&cursor, const T &value) {
+        std::memcpy(cursor, &value, sizeof(T));
+        cursor += sizeof(T);
+    }
+
+    void writerLoop();
+    size_t drain();
+
+    MpscQueue<Record, 4096> records;
+    std::atomic<uint64_t> droppedRecords{0};
+    std::atomic<uint64_t> writtenRecords{0};
+    std::atomic<bool> running{true};
+    /// Set by the writer before it waits on wake; cleared by the one caller that wakes it.
+    alignas(64) std::atomic<bool> sleeping{false};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    /// Notified after every batch, for flush().
+    std::condition_variable written;
+    const int64_t startNs;
+    std::thread writer;
+};
+
+#define TRACKING_LOG_AT(level, ...) \
+    do { \
+        if constexpr (static_cast<int>(level) >= TRACKING_LOG_LEVEL) { \
+            Logger::instance().write(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(...) TRACKING_LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) TRACKING_LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...) TRACKING_LOG_AT(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) TRACKING_LOG_AT(LogLevel::Error, __VA_ARGS__)
+
+
+#endif //TRACKING_LOGGER_H
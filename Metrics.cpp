@@ -0,0 +1,241 @@
+// tracking - Metrics.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstdio>
+#include "Metrics.h"
+
+using namespace std;
+
+namespace {
+/// Largest exported finite bucket bound, 2^kExportBits us (about 67 s).
+constexpr int kExportBits = 26;
+
+atomic<size_t> nextThreadSlot{0};
+
+string braces(const string &labels) {
+    return labels.empty() ? string() : "{" + labels + "}";
+}
+
+string withLabel(const string &labels, const string &extra) {
+    return "{" + (labels.empty() ? extra : labels + "," + extra) + "}";
+}
+}
+
+Histogram::Histogram() : shards(new Shard[kShards]) {
+}
+
+/**
+ * Shard of the calling thread, assigned on first use
+ * @return size_t shard index
+ */
+size_t Histogram::shardIndex() {
+    thread_local const size_t slot = nextThreadSlot.fetch_add(1, memory_order_relaxed) % kShards;
+    return slot;
+}
+
+/**
+ * Bucket a value falls into
+ * @param value_us value in microseconds
+ * @return size_t bucket index, the last bucket for values beyond the range
+ */
+size_t Histogram::bucketOf(uint64_t value_us) {
+    if (value_us < static_cast<uint64_t>(kSubBuckets)) {
+        return static_cast<size_t>(value_us);
+    }
+    const int msb = 63 - __builtin_clzll(value_us);
+    if (msb >= kMaxBits) {
+        return kBuckets - 1;
+    }
+    const int shift = msb - kSubBucketBits;
+    const size_t sub = static_cast<size_t>(value_us >> shift) & (kSubBuckets - 1);
+    return kSubBuckets + static_cast<size_t>(shift) * kSubBuckets + sub;
+}
+
+/**
+ * Lower bound of a bucket
+ * @param bucket bucket index
+ * @return uint64_t smallest value in microseconds that lands in it
+ */
+uint64_t Histogram::bucketLow(size_t bucket) {
+    if (bucket < static_cast<size_t>(kSubBuckets)) {
+        return bucket;
+    }
+    const size_t shift = (bucket - kSubBuckets) / kSubBuckets;
+    const uint64_t sub = (bucket - kSubBuckets) % kSubBuckets;
+    return (kSubBuckets + sub) << shift;
+}
+
+/**
+ * Merge all shards into one set of counts
+ * @return Snapshot merged counts, total, sum and maximum
+ */
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot merged;
+    merged.counts.assign(kBuckets, 0);
+    for (size_t s = 0; s < kShards; ++s) {
+        const Shard &shard = shards[s];
+        for (size_t b = 0; b < kBuckets; ++b) {
+            merged.counts[b] += shard.counts[b].load(memory_order_relaxed);
+        }
+        merged.sum += shard.sum.load(memory_order_relaxed);
+        merged.max = max(merged.max, shard.max.load(memory_order_relaxed));
+    }
+    for (uint64_t count: merged.counts) {
+        merged.count += count;
+    }
+    return merged;
+}
+
+/**
+ * Value at a quantile
+ * @param quantile 0..1
+ * @return uint64_t top of the bucket holding the quantile, capped at the maximum seen
+ */
+uint64_t Histogram::Snapshot::percentile(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(quantile * static_cast<double>(count) + 0.5));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < counts.size(); ++b) {
+        seen += counts[b];
+        if (seen >= rank) {
+            const uint64_t top = b + 1 < counts.size() ? bucketLow(b + 1) - 1 : max;
+            return std::min(top, max);
+        }
+    }
+    return max;
+}
+
+/**
+ * The process-wide registry
+ * @return Metrics& registry
+ */
+Metrics &Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+/**
+ * Find or create a histogram
+ * @param name family name
+ * @param help description of the family
+ * @param labels label list without braces
+ * @return Histogram& instrument, valid for the life of the process
+ */
+Histogram &Metrics::histogram(const string &name, const string &help, const string &labels) {
+    lock_guard<mutex> lock(registryMutex);
+    Family<Histogram> &family = histograms[name];
+    if (family.help.empty()) {
+        family.help = help;
+    }
+    unique_ptr<Histogram> &series = family.series[labels];
+    if (!series) {
+        series = make_unique<Histogram>();
+    }
+    return *series;
+}
+
+/**
+ * Find or create a counter
+ * @param name family name, by convention ending in _total
+ * @param help description of the family
+ * @param labels label list without braces
+ * @return Counter& instrument, valid for the life of the process
+ */
+Counter &Metrics::counter(const string &name, const string &help, const string &labels) {
+    lock_guard<mutex> lock(registryMutex);
+    Family<Counter> &family = counters[name];
+    if (family.help.empty()) {
+        family.help = help;
+    }
+    unique_ptr<Counter> &series = family.series[labels];
+    if (!series) {
+        series = make_unique<Counter>();
+    }
+    return *series;
+}
+
+/**
+ * Find or create a gauge
+ * @param name family name
+ * @param help description of the family
+ * @param labels label list without braces
+ * @return Gauge& instrument, valid for the life of the process
+ */
+Gauge &Metrics::gauge(const string &name, const string &help, const string &labels) {
+    lock_guard<mutex> lock(registryMutex);
+    Family<Gauge> &family = gauges[name];
+    if (family.help.empty()) {
+        family.help = help;
+    }
+    unique_ptr<Gauge> &series = family.series[labels];
+    if (!series) {
+        series = make_unique<Gauge>();
+    }
+    return *series;
+}
+
+/**
+ * Render every instrument for a Prometheus scrape
+ * @return string text exposition format
+ */
+string Metrics::prometheusText() const {
+    lock_guard<mutex> lock(registryMutex);
+    string out;
+    out.reserve(16384);
+    char number[64];
+    for (const auto &[name, family]: counters) {
+        out += "# HELP " + name + " " + family.help + "\n# TYPE " + name + " counter\n";
+        for (const auto &[labels, counter]: family.series) {
+            snprintf(number, sizeof(number), " %llu\n", static_cast<unsigned long long>(counter->value()));
+            out += name + braces(labels) + number;
+        }
+    }
+    for (const auto &[name, family]: gauges) {
+        out += "# HELP " + name + " " + family.help + "\n# TYPE " + name + " gauge\n";
+        for (const auto &[labels, gauge]: family.series) {
+            snprintf(number, sizeof(number), " %lld\n", static_cast<long long>(gauge->value()));
+            out += name + braces(labels) + number;
+        }
+    }
+    for (const auto &[name, family]: histograms) {
+        out += "# HELP " + name + " " + family.help + "\n# TYPE " + name + " histogram\n";
+        for (const auto &[labels, histogram]: family.series) {
+            const Histogram::Snapshot snapshot = histogram->snapshot();
+            uint64_t cumulative = 0;
+            size_t bucket = 0;
+            for (int bits = 0; bits <= kExportBits; ++bits) {
+                const uint64_t bound_us = uint64_t{1} << bits;
+                while (bucket < Histogram::kBuckets && Histogram::bucketLow(bucket) < bound_us) {
+                    cumulative += snapshot.counts[bucket++];
+                }
+                snprintf(number, sizeof(number), "le=\"%g\"", static_cast<double>(bound_us) * 1e-6);
+                out += name + "_bucket" + withLabel(labels, number);
+                snprintf(number, sizeof(number), " %llu\n", static_cast<unsigned long long>(cumulative));
+                out += number;
+            }
+            snprintf(number, sizeof(number), " %llu\n", static_cast<unsigned long long>(snapshot.count));
+            out += name + "_bucket" + withLabel(labels, "le=\"+Inf\"") + number;
+            snprintf(number, sizeof(number), " %.6f\n", static_cast<double>(snapshot.sum) * 1e-6);
+            out += name + "_sum" + braces(labels) + number;
+            snprintf(number, sizeof(number), " %llu\n", static_cast<unsigned long long>(snapshot.count));
+            out += name + "_count" + braces(labels) + number;
+        }
+    }
+    return out;
+}
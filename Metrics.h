@@ -0,0 +1,250 @@
+// tracking - Metrics.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_METRICS_H
+#define TRACKING_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Log-linear (HDR-style) histogram of microsecond values.
+ *
+ * Values below 16 us get exact buckets; above that every power of two is split
+ * into 16 linear sub-buckets, so any recorded value is known to within 6.25%
+ * up to about 71 minutes, where values are clamped.
+ *
+ * Recording is lock-free and allocation-free: every thread writes to its own
+ * shard of bucket counters (threads beyond the shard count share them), and
+ * shards are only merged when a snapshot is taken.
+ */
+class Histogram {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    /// Values at or above 2^kMaxBits us go to the last bucket.
+    static constexpr int kMaxBits = 32;
+    static constexpr size_t kBuckets = kSubBuckets + (kMaxBits - kSubBucketBits) * kSubBuckets;
+    static constexpr size_t kShards = 4;
+
+    struct Snapshot {
+        std::vector<uint64_t> counts;
+        uint64_t count{};
+        uint64_t sum{};
+        uint64_t max{};
+
+        /// Value at the given quantile (0..1), in microseconds, as the top of its bucket.
+        uint64_t percentile(double quantile) const;
+
+        double mean() const {
+            return count ? static_cast<double>(sum) / count : 0.0;
+        }
+    };
+
+    Histogram();
+
+    Histogram(const Histogram &) = delete;
+    Histogram &operator=(const Histogram &) = delete;
+
+    void record(uint64_t value_us) {
+        Shard &shard = shards[shardIndex()];
+        shard.counts[bucketOf(value_us)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value_us, std::memory_order_relaxed);
+        uint64_t seen = shard.max.load(std::memory_order_relaxed);
+        while (value_us > seen && !shard.max.compare_exchange_weak(seen, value_us, std::memory_order_relaxed)) {
+        }
+    };
+
+    /// Negative durations (clock skew between threads) count as zero.
+    void record(Clock::duration elapsed) {
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        record(static_cast<uint64_t>(us > 0 ? us : 0));
+    };
+
+    /// Merge every shard. Concurrent records may or may not be included.
+    Snapshot snapshot() const;
+
+    static size_t bucketOf(uint64_t value_us);
+
+    /// Smallest value that lands in the bucket.
+    static uint64_t bucketLow(size_t bucket);
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, kBuckets> counts{};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+    };
+
+    static size_t shardIndex();
+
+    std::unique_ptr<Shard[]> shards;
+};
+
+/// Monotonic event counter.
+class Counter {
+public:
+    void add(uint64_t n = 1) {
+        total.fetch_add(n, std::memory_order_relaxed);
+    };
+
+    uint64_t value() const {
+        return total.load(std::memory_order_relaxed);
+    };
+
+private:
+    std::atomic<uint64_t> total{0};
+};
+
+/// Value that goes up and down, e.g. a queue depth.
+class Gauge {
+public:
+    void set(int64_t value) {
+        current.store(value, std::memory_order_relaxed);
+    };
+
+    /// Raise to value if it is higher, for high-water marks.
+    void raise(int64_t value) {
+        int64_t seen = current.load(std::memory_order_relaxed);
+        while (value > seen && !current.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+        }
+    };
+
+    int64_t value() const {
+        return current.load(std::memory_order_relaxed);
+    };
+
+private:
+    std::atomic<int64_t> current{0};
+};
+
+/**
+ * Time between successive calls, for telemetry streams.
+ * Not thread-safe: call it from the one thread that delivers the stream.
+ */
+class IntervalRecorder {
+public:
+    explicit IntervalRecorder(Histogram &histogram) : histogram(histogram) {
+    };
+
+    void arrived(Histogram::Clock::time_point now) {
+        if (last != Histogram::Clock::time_point{}) {
+            histogram.record(now - last);
+        }
+        last = now;
+    };
+
+private:
+    Histogram &histogram;
+    Histogram::Clock::time_point last{};
+};
+
+class Metrics;
+
+/**
+ * One counter per result code of a MAVSDK call, labelled with the code's name.
+ * Codes are resolved to counters once; counting is an array index and an add.
+ */
+class ResultCounters {
+public:
+    static constexpr size_t kCodes = 32;
+
+    /// Register under tracking_mavsdk_results_total with the given labels plus result="...".
+    template<typename Result>
+    static ResultCounters forCall(Metrics &metrics, const std::string &labels);
+
+    template<typename Result>
+    void count(Result result) const {
+        const auto code = static_cast<size_t>(result);
+        counters[code < kCodes ? code : kCodes - 1]->add();
+    };
+
+private:
+    std::array<Counter *, kCodes> counters{};
+};
+
+/**
+ * Process-wide registry of named instruments, exported in Prometheus text format.
+ *
+ * Registering is slow (a mutex and a map lookup) and meant for setup: keep the
+ * returned reference and record through it. Instruments live as long as the
+ * process; registering the same name and labels twice returns the same one.
+ * Histograms are exported in seconds with power-of-two bucket bounds.
+ */
+class Metrics {
+public:
+    static Metrics &instance();
+
+    /**
+     * @param name metric family name, e.g. tracking_command_send_seconds
+     * @param help one-line description, the first registration wins
+     * @param labels Prometheus label list without braces, e.g. sysid="2",call="x"
+     */
+    Histogram &histogram(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    Counter &counter(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    Gauge &gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    /// Every instrument in Prometheus text exposition format 0.0.4.
+    std::string prometheusText() const;
+
+private:
+    Metrics() = default;
+
+    template<typename T>
+    struct Family {
+        std::string help;
+        std::map<std::string, std::unique_ptr<T>> series;
+    };
+
+    mutable std::mutex registryMutex;
+    std::map<std::string, Family<Histogram>> histograms;
+    std::map<std::string, Family<Counter>> counters;
+    std::map<std::string, Family<Gauge>> gauges;
+};
+
+/**
+ * Counters for every result code of a MAVSDK call
+ * Codes past the end of the enum print as the same name and share its counter.
+ * @param metrics registry
+ * @param labels labels identifying the call
+ * @return ResultCounters counters indexed by result code
+ */
+template<typename Result>
+ResultCounters ResultCounters::forCall(Metrics &metrics, const std::string &labels) {
+    ResultCounters resolved;
+    for (size_t code = 0; code < kCodes; ++code) {
+        std::ostringstream name;
+        name << static_cast<Result>(code);
+        resolved.counters[code] = &metrics.counter("tracking_mavsdk_results_total", "MAVSDK call results by result code",
+                                                   labels + ",result=\"" + name.str() + "\"");
+    }
+    return resolved;
+}
+
+
+#endif //TRACKING_METRICS_H
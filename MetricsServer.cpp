@@ -0,0 +1,136 @@
+// tracking - MetricsServer.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "Logger.h"
+#include "MetricsServer.h"
+
+using namespace std;
+
+namespace {
+/// How often the accept loop checks for stop().
+constexpr int kPollMs = 200;
+/// A scraper that has not sent its request by then is dropped.
+constexpr int kRequestTimeoutMs = 1000;
+}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+/**
+ * Bind to localhost and start serving
+ * @param port TCP port, 0 for any free one
+ * @return true if listening
+ * @return false if the socket could not be bound
+ */
+bool MetricsServer::start(uint16_t port) {
+    if (running.load()) {
+        return true;
+    }
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return false;
+    }
+    const int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    socklen_t length = sizeof(address);
+    if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+        || listen(listener, 8) != 0
+        || getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+        LOG_ERROR("Metrics: cannot listen on 127.0.0.1:{}: {}", port, string(strerror(errno)));
+        close(listener);
+        listener = -1;
+        return false;
+    }
+    boundPort = ntohs(address.sin_port);
+    running.store(true);
+    server = thread(&MetricsServer::serve, this);
+    LOG_INFO("Metrics: serving on http://127.0.0.1:{}/metrics", boundPort);
+    return true;
+}
+
+/**
+ * Stop serving and close the socket
+ * @return void
+ */
+void MetricsServer::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    if (server.joinable()) {
+        server.join();
+    }
+    close(listener);
+    listener = -1;
+}
+
+/**
+ * Accept loop, one connection at a time
+ * @return void
+ */
+void MetricsServer::serve() {
+    while (running.load()) {
+        pollfd pending{listener, POLLIN, 0};
+        if (poll(&pending, 1, kPollMs) <= 0) {
+            continue;
+        }
+        const int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        answer(client);
+        close(client);
+    }
+}
+
+/**
+ * Read the request line and reply with the metrics
+ * @param client connected socket
+ * @return void
+ */
+void MetricsServer::answer(int client) const {
+    char request[1024];
+    pollfd readable{client, POLLIN, 0};
+    if (poll(&readable, 1, kRequestTimeoutMs) <= 0 || recv(client, request, sizeof(request), 0) <= 0) {
+        return;
+    }
+    const bool isGet = strncmp(request, "GET ", 4) == 0;
+    const string body = isGet ? metrics.prometheusText() : string("only GET is supported\n");
+    const string response = string(isGet ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.0 405 Method Not Allowed\r\n")
+                            + "Content-Type: text/plain; version=0.0.4\r\n"
+                            + "Content-Length: " + to_string(body.size()) + "\r\n"
+                            + "Connection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        const ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
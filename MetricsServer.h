@@ -0,0 +1,62 @@
+// tracking - MetricsServer.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_METRICSSERVER_H
+#define TRACKING_METRICSSERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "Metrics.h"
+
+/**
+ * Minimal HTTP endpoint on 127.0.0.1 serving Metrics::prometheusText().
+ *
+ * Any GET gets the metrics, one request per connection, on a thread of its
+ * own so a slow scraper never touches the control or telemetry threads.
+ */
+class MetricsServer {
+public:
+    explicit MetricsServer(const Metrics &metrics) : metrics(metrics) {
+    };
+
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    /// Listen on localhost. Port 0 picks a free one, see port().
+    bool start(uint16_t port);
+
+    void stop();
+
+    uint16_t port() const {
+        return boundPort;
+    };
+
+private:
+    void serve();
+    void answer(int client) const;
+
+    const Metrics &metrics;
+    int listener{-1};
+    uint16_t boundPort{};
+    std::atomic<bool> running{false};
+    std::thread server;
+};
+
+
+#endif //TRACKING_METRICSSERVER_H
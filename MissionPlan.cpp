@@ -0,0 +1,123 @@
+// tracking - MissionPlan.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <cstring>
+#include "MissionPlan.h"
+
+namespace {
+constexpr uint64_t kFnvOffset = 14695981039346656037ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+template<typename T>
+uint64_t mix(uint64_t hash, T value) {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    for (unsigned char byte: bytes) {
+        hash = (hash ^ byte) * kFnvPrime;
+    }
+    return hash;
+}
+
+MissionPlan::Item at(const geodesy::Geodetic &point, uint16_t command) {
+    MissionPlan::Item item;
+    item.command = command;
+    item.x = static_cast<int32_t>(std::lround(point.latitude_deg * 1e7));
+    item.y = static_cast<int32_t>(std::lround(point.longitude_deg * 1e7));
+    item.z = static_cast<float>(point.altitude_m);
+    return item;
+}
+}
+
+/**
+ * Constructor for an empty plan
+ * @param config leg splitting and acceptance radius
+ */
+MissionPlan::MissionPlan(const Config &config)
+        : config(config), digest(kFnvOffset) {
+}
+
+/**
+ * Add a waypoint, splitting the leg to it if it is too long
+ * @param point where to fly, altitude relative to home
+ * @return MissionPlan& this plan
+ */
+MissionPlan &MissionPlan::waypoint(const geodesy::Geodetic &point) {
+    legTo(point);
+    Item item = at(point, kNavWaypoint);
+    item.param2 = config.acceptRadius_m;
+    item.param4 = NAN;
+    append(item);
+    return *this;
+}
+
+/**
+ * Add a loiter, splitting the leg to it if it is too long
+ * @param point circle center, altitude relative to home
+ * @param radius_m circle radius, positive clockwise
+ * @param time_s seconds to circle, 0 for unlimited
+ * @return MissionPlan& this plan
+ */
+MissionPlan &MissionPlan::loiter(const geodesy::Geodetic &point, float radius_m, float time_s) {
+    legTo(point);
+    Item item = at(point, time_s > 0.0f ? kNavLoiterTime : kNavLoiterUnlimited);
+    if (time_s > 0.0f) {
+        item.param1 = time_s;
+    }
+    item.param3 = radius_m;
+    item.param4 = NAN;
+    append(item);
+    return *this;
+}
+
+/**
+ * Add the great-circle intermediate waypoints from the last item to the point
+ * @param point end of the leg
+ * @return void
+ */
+void MissionPlan::legTo(const geodesy::Geodetic &point) {
+    if (planned.empty()) {
+        last = point;
+        return;
+    }
+    const double leg = geodesy::groundDistance(last, point);
+    length += leg;
+    if (config.maxLeg_m > 0.0 && leg > config.maxLeg_m) {
+        const auto pieces = static_cast<int>(std::ceil(leg / config.maxLeg_m));
+        for (int i = 1; i < pieces; ++i) {
+            Item item = at(geodesy::intermediate(last, point, static_cast<double>(i) / pieces), kNavWaypoint);
+            item.param2 = config.acceptRadius_m;
+            item.param4 = NAN;
+            append(item);
+        }
+    }
+    last = point;
+}
+
+void MissionPlan::append(const Item &item) {
+    planned.push_back(item);
+    uint64_t hash = digest;
+    hash = mix(hash, item.command);
+    hash = mix(hash, item.frame);
+    hash = mix(hash, item.param1);
+    hash = mix(hash, item.param2);
+    hash = mix(hash, item.param3);
+    hash = mix(hash, item.param4);
+    hash = mix(hash, item.x);
+    hash = mix(hash, item.y);
+    hash = mix(hash, item.z);
+    digest = hash;
+}
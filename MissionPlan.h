@@ -0,0 +1,109 @@
+// tracking - MissionPlan.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_MISSIONPLAN_H
+#define TRACKING_MISSIONPLAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Geodesy.h"
+
+/**
+ * A mission as the autopilot stores it, built from geodesic waypoints.
+ *
+ * Items mirror MAVLink MISSION_ITEM_INT in the global frame with altitudes
+ * relative to home, so a plan is built, compared and hashed without MAVSDK.
+ * The autopilot flies a straight line between two items, which on a long leg
+ * wanders off the shortest path; legs longer than maxLeg_m are therefore split
+ * along the great circle. The hash is kept up to date as items are added and
+ * covers every uploaded field: equal hashes mean the same mission on the vehicle.
+ */
+class MissionPlan {
+public:
+    // MAVLink MAV_CMD and MAV_FRAME values used by the items.
+    static constexpr uint16_t kNavWaypoint = 16;
+    static constexpr uint16_t kNavLoiterUnlimited = 17;
+    static constexpr uint16_t kNavLoiterTime = 19;
+    static constexpr uint8_t kFrameGlobalRelativeAltInt = 6;
+
+    struct Item {
+        uint16_t command{};
+        uint8_t frame{kFrameGlobalRelativeAltInt};
+        float param1{};
+        float param2{};
+        float param3{};
+        float param4{};
+        /// Latitude and longitude in 1e-7 degrees.
+        int32_t x{};
+        int32_t y{};
+        /// Altitude relative to home, meters.
+        float z{};
+    };
+
+    struct Config {
+        /// Longer legs get intermediate waypoints along the great circle, 0 never splits.
+        double maxLeg_m = 5000.0;
+        /// Distance at which a waypoint counts as reached.
+        float acceptRadius_m = 50.0f;
+    };
+
+    MissionPlan() : MissionPlan(Config{}) {
+    };
+
+    explicit MissionPlan(const Config &config);
+
+    /// Fly through the point; its altitude is relative to home.
+    MissionPlan &waypoint(const geodesy::Geodetic &point);
+
+    /// Circle the point for time_s seconds and go on, or until told otherwise when time_s is 0.
+    MissionPlan &loiter(const geodesy::Geodetic &point, float radius_m, float time_s = 0.0f);
+
+    const std::vector<Item> &items() const {
+        return planned;
+    };
+
+    size_t size() const {
+        return planned.size();
+    };
+
+    bool empty() const {
+        return planned.empty();
+    };
+
+    /// FNV-1a over every field of every item, in order.
+    uint64_t hash() const {
+        return digest;
+    };
+
+    /// Ground distance from the first item to the last, meters.
+    double length_m() const {
+        return length;
+    };
+
+private:
+    void legTo(const geodesy::Geodetic &point);
+    void append(const Item &item);
+
+    Config config;
+    std::vector<Item> planned;
+    uint64_t digest;
+    double length{};
+    geodesy::Geodetic last{};
+};
+
+
+#endif //TRACKING_MISSIONPLAN_H
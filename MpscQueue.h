@@ -0,0 +1,120 @@
+// tracking - MpscQueue.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_MPSCQUEUE_H
+#define TRACKING_MPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/**
+ * Bounded lock-free multi-producer single-consumer ring.
+ *
+ * Every cell carries its own sequence number (Vyukov's bounded queue), so
+ * producers only contend on one fetch of the enqueue position and never wait
+ * for each other to finish writing. Storage is allocated once up front; push
+ * and pop never allocate. A full queue rejects the push instead of blocking.
+ */
+template<typename T, size_t Capacity>
+class MpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscQueue()
+            : cells(new Cell[Capacity]) {
+        for (size_t i = 0; i < Capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    /**
+     * Claim a cell and let the caller fill it in place.
+     * @return false if the queue is full
+     */
+    template<typename F>
+    bool tryEmplace(F &&fill) {
+        size_t position = enqueuePosition.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &cells[position & kMask];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        fill(cell->value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPush(T value) {
+        return tryEmplace([&value](T &slot) { slot = std::move(value); });
+    }
+
+    /// Consumer side only.
+    bool tryPop(T &out) {
+        Cell &cell = cells[dequeuePosition & kMask];
+        const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeuePosition + 1) {
+            return false;
+        }
+        out = std::move(cell.value);
+        cell.sequence.store(dequeuePosition + Capacity, std::memory_order_release);
+        ++dequeuePosition;
+        dequeued.store(dequeuePosition, std::memory_order_relaxed);
+        return true;
+    }
+
+    /// Approximate number of queued items, safe from any thread.
+    size_t size() const {
+        const size_t in = enqueuePosition.load(std::memory_order_relaxed);
+        const size_t out = dequeued.load(std::memory_order_relaxed);
+        return in > out ? in - out : 0;
+    }
+
+    static constexpr size_t capacity() {
+        return Capacity;
+    }
+
+private:
+    static constexpr size_t kMask = Capacity - 1;
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<size_t> enqueuePosition{0};
+    alignas(64) size_t dequeuePosition{0};
+    std::atomic<size_t> dequeued{0};
+};
+
+
+#endif //TRACKING_MPSCQUEUE_H
@@ -0,0 +1,79 @@
+// tracking - PoseSnapshot.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_POSESNAPSHOT_H
+#define TRACKING_POSESNAPSHOT_H
+
+#include <chrono>
+#include <cmath>
+
+/**
+ * Everything we know about a plane's state at one instant.
+ * Published as a whole through a SeqLock so readers never see
+ * latitude from one fix and longitude from the next.
+ */
+struct PoseSnapshot {
+    using Clock = std::chrono::steady_clock;
+
+    // Position
+    double latitude_deg{};
+    double longitude_deg{};
+    double absolute_altitude_m{};
+    double relative_altitude_m{};
+
+    // Velocity (NED frame)
+    float north_m_s{};
+    float east_m_s{};
+    float down_m_s{};
+
+    // Attitude
+    float roll_deg{};
+    float pitch_deg{};
+    float yaw_deg{};
+
+    // Fixed-wing metrics and heading
+    float airspeed_m_s{};
+    float climb_rate_m_s{};
+    float throttle_percentage{};
+    double heading_deg{};
+
+    /// Monotonic receive time of the last position fix.
+    Clock::time_point positionTime{};
+    /// Monotonic receive time of the last update of any field.
+    Clock::time_point received{};
+
+    bool hasFix() const {
+        return positionTime != Clock::time_point{};
+    }
+
+    /// Horizontal speed over ground, from the NED velocity.
+    double groundSpeed_m_s() const {
+        return std::sqrt(static_cast<double>(north_m_s) * north_m_s + static_cast<double>(east_m_s) * east_m_s);
+    }
+
+    /// Below this ground speed the track is meaningless, trackAngle_rad() uses the yaw instead.
+    static constexpr double kMinTrackSpeed_m_s = 1.0;
+
+    /// Direction of travel over ground in radians from north, or the yaw when too slow to have a track.
+    double trackAngle_rad() const {
+        return groundSpeed_m_s() > kMinTrackSpeed_m_s
+               ? std::atan2(east_m_s, north_m_s)
+               : yaw_deg * (3.14159265358979323846 / 180.0);
+    }
+};
+
+
+#endif //TRACKING_POSESNAPSHOT_H
@@ -0,0 +1,150 @@
+// tracking - ReplayVehicle.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include "ReplayVehicle.h"
+
+using namespace std;
+
+/**
+ * Load the telemetry of one aircraft from a flight log
+ * Commands in the log are skipped, they were sent to the aircraft, not by it.
+ * @param path flight log
+ * @param sysid aircraft to load
+ * @param records filled with the records, sorted by time
+ * @return true if at least one position was found
+ * @return false otherwise
+ */
+bool ReplayVehicle::load(const string &path, int sysid, vector<FlightRecord> &records) {
+    FlightLogReader log;
+    if (!log.open(path)) {
+        return false;
+    }
+    records.clear();
+    bool hasPosition = false;
+    log.forEach([&](const FlightRecord &record) {
+        if (record.sysid != sysid) {
+            return;
+        }
+        switch (record.kind) {
+            case RecordKind::Position:
+                hasPosition = true;
+                records.push_back(record);
+                break;
+            case RecordKind::Velocity:
+            case RecordKind::Attitude:
+            case RecordKind::FixedwingMetrics:
+                records.push_back(record);
+                break;
+            default:
+                break;
+        }
+    });
+    // Concurrent writers may have committed slightly out of order.
+    stable_sort(records.begin(), records.end(), [](const FlightRecord &a, const FlightRecord &b) {
+        return a.timestamp_ns < b.timestamp_ns;
+    });
+    return hasPosition;
+}
+
+/**
+ * Constructor for the replayed vehicle
+ * @param sysid system id reported through the Vehicle interface
+ * @param records telemetry records sorted by time, see load
+ * @param start simulation time the first record is delivered at
+ */
+ReplayVehicle::ReplayVehicle(int sysid, vector<FlightRecord> records, Clock::time_point start)
+        : sysid(sysid), records(std::move(records)), start(start) {
+}
+
+/**
+ * Deliver every record up to the given time, the way the plane callbacks would
+ * @param now current simulation time
+ * @return void
+ */
+void ReplayVehicle::advance(Clock::time_point now) {
+    while (next < records.size() && timeOf(records[next]) <= now) {
+        const FlightRecord &record = records[next++];
+        const Clock::time_point received = timeOf(record);
+        switch (record.kind) {
+            case RecordKind::Position:
+                pose.latitude_deg = FlightRecord::fromE7(record.latitude_e7);
+                pose.longitude_deg = FlightRecord::fromE7(record.longitude_e7);
+                pose.absolute_altitude_m = record.altitude_m;
+                pose.positionTime = received;
+                estimator.updatePosition(pose.latitude_deg, pose.longitude_deg, pose.absolute_altitude_m, received);
+                break;
+            case RecordKind::Velocity:
+                pose.north_m_s = record.north_m_s;
+                pose.east_m_s = record.east_m_s;
+                pose.down_m_s = record.down_m_s;
+                estimator.updateVelocity(record.north_m_s, record.east_m_s, record.down_m_s, received);
+                break;
+            case RecordKind::Attitude:
+                pose.roll_deg = record.roll_deg;
+                pose.pitch_deg = record.pitch_deg;
+                pose.yaw_deg = record.yaw_deg;
+                break;
+            case RecordKind::FixedwingMetrics:
+                pose.airspeed_m_s = record.value;
+                pose.climb_rate_m_s = -record.down_m_s;
+                break;
+            default:
+                break;
+        }
+        pose.received = received;
+    }
+}
+
+/**
+ * Time span of the replay
+ * @return Clock::duration time between the first and the last record
+ */
+Vehicle::Clock::duration ReplayVehicle::duration() const {
+    if (records.empty()) {
+        return {};
+    }
+    return chrono::nanoseconds(records.back().timestamp_ns - records.front().timestamp_ns);
+}
+
+/**
+ * Predict the pose at the given time
+ * Position and velocity from the estimator, the rest from the latest record.
+ * @param when time to predict for
+ * @return PoseSnapshot predicted pose
+ */
+PoseSnapshot ReplayVehicle::predictPose(Clock::time_point when) const {
+    return estimator.predict(pose, when);
+}
+
+bool ReplayVehicle::sendPositionGlobal(double, double, float, float) const {
+    ++commandCount;
+    return true;
+}
+
+bool ReplayVehicle::sendVelocityNed(float, float, float, float) const {
+    ++commandCount;
+    return true;
+}
+
+bool ReplayVehicle::sendPositionVelocity(double, double, float, float, float, float, float) const {
+    ++commandCount;
+    return true;
+}
+
+Vehicle::Clock::time_point ReplayVehicle::timeOf(const FlightRecord &record) const {
+    return start + chrono::nanoseconds(record.timestamp_ns - records.front().timestamp_ns);
+}
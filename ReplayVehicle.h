@@ -0,0 +1,93 @@
+// tracking - ReplayVehicle.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_REPLAYVEHICLE_H
+#define TRACKING_REPLAYVEHICLE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FlightRecorder.h"
+#include "LeaderEstimator.h"
+#include "Vehicle.h"
+
+/**
+ * Vehicle that replays one aircraft's telemetry from a flight log.
+ *
+ * Records are played back against the simulation time passed to advance(),
+ * with their original spacing, and fed to the same estimator plane uses.
+ * Setpoints sent to it are counted and otherwise ignored; it is meant to be
+ * the leader in a replayed follow session.
+ *
+ * Not thread-safe: drive it and the engines from one thread.
+ */
+class ReplayVehicle : public Vehicle {
+public:
+    /**
+     * Telemetry records of one aircraft from a log, sorted by time.
+     * @return false if the log can't be read or has no position for that aircraft
+     */
+    static bool load(const std::string &path, int sysid, std::vector<FlightRecord> &records);
+
+    /// Replay the records so that the first one is delivered at start.
+    ReplayVehicle(int sysid, std::vector<FlightRecord> records, Clock::time_point start);
+
+    /// Deliver every record up to the given time.
+    void advance(Clock::time_point now);
+
+    bool finished() const {
+        return next >= records.size();
+    };
+
+    /// Time between the first and the last record.
+    Clock::duration duration() const;
+
+    int getSystemId() const override {
+        return sysid;
+    };
+
+    PoseSnapshot getPose() const override {
+        return pose;
+    };
+
+    PoseSnapshot predictPose(Clock::time_point when) const override;
+
+    bool sendPositionGlobal(double lat, double lon, float altAmsl, float yawDeg) const override;
+
+    bool sendVelocityNed(float north_m_s, float east_m_s, float down_m_s, float yawDeg) const override;
+
+    bool sendPositionVelocity(double lat, double lon, float altAmsl,
+                              float north_m_s, float east_m_s, float down_m_s, float yawDeg) const override;
+
+    uint64_t commandsReceived() const {
+        return commandCount;
+    };
+
+private:
+    Clock::time_point timeOf(const FlightRecord &record) const;
+
+    const int sysid;
+    const std::vector<FlightRecord> records;
+    const Clock::time_point start;
+    size_t next{};
+
+    mutable uint64_t commandCount{};
+    PoseSnapshot pose{};
+    LeaderEstimator estimator;
+};
+
+
+#endif //TRACKING_REPLAYVEHICLE_H
@@ -0,0 +1,139 @@
+// tracking - SeqLock.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_SEQLOCK_H
+#define TRACKING_SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+/**
+ * Sequence lock for small trivially copyable values.
+ *
+ * Writers serialize among themselves with a tiny spin flag and bump the
+ * sequence counter around the copy. Readers never take a lock: they copy
+ * the payload and retry if a write overlapped the copy, so a reader on the
+ * control loop can never block the MAVSDK callback thread (and vice versa).
+ *
+ * The payload is stored as relaxed atomic words so the racy copy is well
+ * defined; T must be trivially copyable.
+ */
+template<typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock payload must be trivially copyable");
+
+public:
+    SeqLock() {
+        store(T{});
+    }
+
+    explicit SeqLock(const T &initial) {
+        store(initial);
+    }
+
+    SeqLock(const SeqLock &) = delete;
+    SeqLock &operator=(const SeqLock &) = delete;
+
+    T load() const {
+        uint64_t buffer[kWords];
+        for (;;) {
+            const uint32_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1u) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (size_t i = 0; i < kWords; ++i) {
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                break;
+            }
+        }
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    void store(const T &value) {
+        lockWriter();
+        publish(value);
+        unlockWriter();
+    }
+
+    /**
+     * Read-modify-write under the writer lock.
+     * Used when several subscriptions each own a part of the payload.
+     */
+    template<typename F>
+    void update(F &&mutate) {
+        lockWriter();
+        T value = readUnsynchronized();
+        mutate(value);
+        publish(value);
+        unlockWriter();
+    }
+
+    uint32_t version() const {
+        return sequence.load(std::memory_order_acquire) >> 1u;
+    }
+
+private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    void lockWriter() {
+        while (writer.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlockWriter() {
+        writer.clear(std::memory_order_release);
+    }
+
+    // Only valid while holding the writer lock.
+    T readUnsynchronized() const {
+        uint64_t buffer[kWords];
+        for (size_t i = 0; i < kWords; ++i) {
+            buffer[i] = words[i].load(std::memory_order_relaxed);
+        }
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    void publish(const T &value) {
+        uint64_t buffer[kWords] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+        const uint32_t current = sequence.load(std::memory_order_relaxed);
+        sequence.store(current + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i) {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+        sequence.store(current + 2, std::memory_order_release);
+    }
+
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint64_t> words[kWords]{};
+    std::atomic_flag writer = ATOMIC_FLAG_INIT;
+};
+
+
+#endif //TRACKING_SEQLOCK_H
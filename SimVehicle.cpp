@@ -0,0 +1,349 @@
+// tracking - SimVehicle.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include "SimVehicle.h"
+
+using geodesy::kDegToRad;
+using geodesy::kPi;
+using geodesy::kRadToDeg;
+
+namespace {
+constexpr double kGravity_m_s2 = 9.80665;
+/// Below this commanded ground speed a velocity setpoint has no usable course.
+constexpr double kMinCourseSpeed_m_s = 1.0;
+
+double toSeconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
+
+double wrapPi(double angle_rad) {
+    return std::remainder(angle_rad, 2.0 * kPi);
+}
+
+LeaderEstimator::Config estimatorConfig(const SimVehicle::Config &config) {
+    LeaderEstimator::Config estimator;
+    estimator.telemetryLatency = config.telemetryLatency;
+    estimator.positionNoise_m = std::max(config.positionNoise_m, 0.5);
+    return estimator;
+}
+}
+
+/**
+ * Constructor for the simulated vehicle
+ * @param sysid system id reported through the Vehicle interface
+ * @param world local frame the model flies in
+ * @param initial initial position, airspeed and heading in the world frame
+ * @param config airframe limits, telemetry and link model
+ */
+SimVehicle::SimVehicle(int sysid, const geodesy::LocalFrame &world, const State &initial, Config config)
+        : sysid(sysid), world(world), config(config),
+          north_m(initial.north_m), east_m(initial.east_m), altitude_m(initial.altitude_m),
+          airspeed_m_s(initial.airspeed_m_s), heading_rad(initial.heading_deg * kDegToRad),
+          random(config.seed), estimator(estimatorConfig(config)) {
+    maneuver.airspeed_m_s = initial.airspeed_m_s;
+}
+
+SimVehicle::SimVehicle(int sysid, const geodesy::LocalFrame &world, const State &initial)
+        : SimVehicle(sysid, world, initial, Config{}) {
+}
+
+/**
+ * Advance the model to the given time
+ * Setpoints that are due take effect first, then the model is integrated over
+ * the whole step, then telemetry is sampled and the samples that are due delivered.
+ * Keep steps short (10 ms or less) for the lags to be meaningful.
+ * @param time simulation time to advance to
+ * @return void
+ */
+void SimVehicle::step(Clock::time_point time) {
+    if (!started) {
+        started = true;
+        now = time;
+        nextSample = time;
+    }
+    while (!pendingCommands.empty() && pendingCommands.front().applyAt <= time) {
+        active = pendingCommands.front();
+        mode = active.mode;
+        pendingCommands.pop_front();
+    }
+    const double dt = toSeconds(time - now);
+    if (dt > 0.0) {
+        integrate(dt);
+    }
+    now = time;
+    while (nextSample <= now) {
+        sample(nextSample);
+        nextSample += config.telemetryPeriod;
+    }
+    deliver(now);
+}
+
+/**
+ * Fly the given maneuver from now on
+ * @param next turn rate, airspeed and climb rate to hold
+ * @return void
+ */
+void SimVehicle::setManeuver(const Maneuver &next) {
+    maneuver = next;
+    mode = Mode::Maneuver;
+    pendingCommands.clear();
+}
+
+/**
+ * One integration step of the point-mass model
+ * @param dt step length in seconds
+ * @return void
+ */
+void SimVehicle::integrate(double dt) {
+    double turnRate_rad_s = 0.0;
+    double desiredAirspeed = airspeed_m_s;
+    double desiredClimb = 0.0;
+    switch (mode) {
+        case Mode::Maneuver:
+            turnRate_rad_s = maneuver.turnRate_deg_s * kDegToRad;
+            desiredAirspeed = maneuver.airspeed_m_s;
+            desiredClimb = maneuver.climb_m_s;
+            break;
+        case Mode::Position: {
+            const double yaw_rad = active.yaw_deg * kDegToRad;
+            const double aimNorth = active.north_m + config.lookahead_m * std::cos(yaw_rad);
+            const double aimEast = active.east_m + config.lookahead_m * std::sin(yaw_rad);
+            const double course = std::atan2(aimEast - east_m, aimNorth - north_m);
+            turnRate_rad_s = config.headingGain * wrapPi(course - heading_rad);
+            const double alongTrack = (active.north_m - north_m) * std::cos(yaw_rad)
+                                      + (active.east_m - east_m) * std::sin(yaw_rad);
+            desiredAirspeed = config.cruiseAirspeed_m_s + config.speedGain * alongTrack;
+            desiredClimb = config.altitudeGain * (active.altitude_m - altitude_m);
+            break;
+        }
+        case Mode::Velocity:
+        case Mode::PositionVelocity: {
+            double north_m_s = active.north_m_s;
+            double east_m_s = active.east_m_s;
+            double down_m_s = active.down_m_s;
+            if (mode == Mode::PositionVelocity) {
+                north_m_s += config.positionGain * (active.north_m - north_m);
+                east_m_s += config.positionGain * (active.east_m - east_m);
+                down_m_s -= config.altitudeGain * (active.altitude_m - altitude_m);
+            }
+            const double speed = std::hypot(north_m_s, east_m_s);
+            if (speed > kMinCourseSpeed_m_s) {
+                const double course = std::atan2(east_m_s, north_m_s);
+                turnRate_rad_s = config.headingGain * wrapPi(course - heading_rad);
+            }
+            desiredAirspeed = speed;
+            desiredClimb = -down_m_s;
+            break;
+        }
+    }
+
+    const double maxBank_rad = config.maxBank_deg * kDegToRad;
+    const double bankCommand = std::clamp(std::atan(airspeed_m_s * turnRate_rad_s / kGravity_m_s2),
+                                          -maxBank_rad, maxBank_rad);
+    bank_rad += (bankCommand - bank_rad) * std::min(1.0, dt / config.bankTimeConstant_s);
+    desiredAirspeed = std::clamp(desiredAirspeed, config.minAirspeed_m_s, config.maxAirspeed_m_s);
+    airspeed_m_s += (desiredAirspeed - airspeed_m_s) * std::min(1.0, dt / config.airspeedTimeConstant_s);
+    climb_m_s = std::clamp(desiredClimb, -config.maxSink_m_s, config.maxClimb_m_s);
+
+    heading_rad = wrapPi(heading_rad + kGravity_m_s2 * std::tan(bank_rad) / airspeed_m_s * dt);
+    north_m += (airspeed_m_s * std::cos(heading_rad) + config.windNorth_m_s) * dt;
+    east_m += (airspeed_m_s * std::sin(heading_rad) + config.windEast_m_s) * dt;
+    altitude_m += climb_m_s * dt;
+}
+
+/**
+ * Exact current state as a pose snapshot
+ * @return PoseSnapshot truth at the current simulation time
+ */
+PoseSnapshot SimVehicle::truth() const {
+    const geodesy::Geodetic position = world.fromNed({north_m, east_m, -altitude_m});
+    PoseSnapshot snapshot;
+    snapshot.latitude_deg = position.latitude_deg;
+    snapshot.longitude_deg = position.longitude_deg;
+    snapshot.absolute_altitude_m = position.altitude_m;
+    snapshot.relative_altitude_m = altitude_m;
+    snapshot.north_m_s = static_cast<float>(airspeed_m_s * std::cos(heading_rad) + config.windNorth_m_s);
+    snapshot.east_m_s = static_cast<float>(airspeed_m_s * std::sin(heading_rad) + config.windEast_m_s);
+    snapshot.down_m_s = static_cast<float>(-climb_m_s);
+    snapshot.roll_deg = static_cast<float>(bank_rad * kRadToDeg);
+    snapshot.pitch_deg = static_cast<float>(std::atan2(climb_m_s, airspeed_m_s) * kRadToDeg);
+    snapshot.yaw_deg = static_cast<float>(heading_rad * kRadToDeg);
+    snapshot.airspeed_m_s = static_cast<float>(airspeed_m_s);
+    snapshot.climb_rate_m_s = static_cast<float>(climb_m_s);
+    snapshot.heading_deg = std::fmod(heading_rad * kRadToDeg + 360.0, 360.0);
+    snapshot.positionTime = now;
+    snapshot.received = now;
+    return snapshot;
+}
+
+/**
+ * Take a telemetry sample and queue it for delivery after the telemetry latency
+ * @param time sample time
+ * @return void
+ */
+void SimVehicle::sample(Clock::time_point time) {
+    // Only draw when loss is configured, so lossless runs keep their noise sequence.
+    const bool lost = outage || (config.telemetryLoss > 0.0 && chance(random) < config.telemetryLoss);
+    lossAverage += 0.1 * ((lost ? 1.0 : 0.0) - lossAverage);
+    if (lost) {
+        return;
+    }
+    Sample taken{time + config.telemetryLatency, truth()};
+    if (config.positionNoise_m > 0.0) {
+        const double sigma = config.positionNoise_m;
+        const geodesy::Geodetic noisy = world.fromNed({north_m + sigma * noise(random),
+                                                       east_m + sigma * noise(random),
+                                                       -altitude_m + sigma * noise(random)});
+        taken.pose.latitude_deg = noisy.latitude_deg;
+        taken.pose.longitude_deg = noisy.longitude_deg;
+        taken.pose.absolute_altitude_m = noisy.altitude_m;
+    }
+    taken.pose.positionTime = taken.deliverAt;
+    taken.pose.received = taken.deliverAt;
+    inFlight.push_back(taken);
+}
+
+/**
+ * Deliver the telemetry samples that are due, the way the MAVSDK callbacks would
+ * @param time current simulation time
+ * @return void
+ */
+void SimVehicle::deliver(Clock::time_point time) {
+    while (!inFlight.empty() && inFlight.front().deliverAt <= time) {
+        const Sample &delivered = inFlight.front();
+        pose = delivered.pose;
+        estimator.updatePosition(pose.latitude_deg, pose.longitude_deg, pose.absolute_altitude_m, delivered.deliverAt);
+        estimator.updateVelocity(pose.north_m_s, pose.east_m_s, pose.down_m_s, delivered.deliverAt);
+        inFlight.pop_front();
+    }
+}
+
+/**
+ * Predict the pose at the given time
+ * Position and velocity from the estimator, the rest from the latest sample.
+ * @param when time to predict for
+ * @return PoseSnapshot predicted pose
+ */
+PoseSnapshot SimVehicle::predictPose(Clock::time_point when) const {
+    return estimator.predict(pose, when);
+}
+
+/**
+ * Queue a global position setpoint, applied after the command latency
+ * @param lat latitude in degrees
+ * @param lon longitude in degrees
+ * @param altAmsl altitude above mean sea level in meters
+ * @param yawDeg yaw in degrees
+ * @return true unless loitering, the simulated link never rejects
+ */
+bool SimVehicle::sendPositionGlobal(double lat, double lon, float altAmsl, float yawDeg) const {
+    if (loitering) {
+        return false;
+    }
+    const geodesy::Ned target = world.toNed({lat, lon, altAmsl});
+    Command command{};
+    command.applyAt = now + config.commandLatency;
+    command.mode = Mode::Position;
+    command.north_m = target.north;
+    command.east_m = target.east;
+    command.altitude_m = -target.down;
+    command.yaw_deg = yawDeg;
+    pendingCommands.push_back(command);
+    ++commandCount;
+    return true;
+}
+
+/**
+ * Queue a NED velocity setpoint, applied after the command latency
+ * @param north_m_s north velocity
+ * @param east_m_s east velocity
+ * @param down_m_s down velocity
+ * @param yawDeg yaw in degrees, ignored: a fixed-wing flies along its velocity
+ * @return true unless loitering, the simulated link never rejects
+ */
+bool SimVehicle::sendVelocityNed(float north_m_s, float east_m_s, float down_m_s, float yawDeg) const {
+    if (loitering) {
+        return false;
+    }
+    Command command{};
+    command.applyAt = now + config.commandLatency;
+    command.mode = Mode::Velocity;
+    command.north_m_s = north_m_s;
+    command.east_m_s = east_m_s;
+    command.down_m_s = down_m_s;
+    command.yaw_deg = yawDeg;
+    pendingCommands.push_back(command);
+    ++commandCount;
+    return true;
+}
+
+/**
+ * Queue a global position setpoint with a velocity feed-forward, applied after the command latency
+ * @param lat latitude in degrees
+ * @param lon longitude in degrees
+ * @param altAmsl altitude above mean sea level in meters
+ * @param north_m_s north velocity feed-forward
+ * @param east_m_s east velocity feed-forward
+ * @param down_m_s down velocity feed-forward
+ * @param yawDeg yaw in degrees, ignored like for velocity setpoints
+ * @return true unless loitering, the simulated link never rejects
+ */
+bool SimVehicle::sendPositionVelocity(double lat, double lon, float altAmsl,
+                                      float north_m_s, float east_m_s, float down_m_s, float yawDeg) const {
+    if (loitering) {
+        return false;
+    }
+    const geodesy::Ned target = world.toNed({lat, lon, altAmsl});
+    Command command{};
+    command.applyAt = now + config.commandLatency;
+    command.mode = Mode::PositionVelocity;
+    command.north_m = target.north;
+    command.east_m = target.east;
+    command.altitude_m = -target.down;
+    command.north_m_s = north_m_s;
+    command.east_m_s = east_m_s;
+    command.down_m_s = down_m_s;
+    command.yaw_deg = yawDeg;
+    pendingCommands.push_back(command);
+    ++commandCount;
+    return true;
+}
+
+/**
+ * Drop every setpoint and circle where the aircraft is, the way an autopilot's hold mode does
+ * @return true always
+ */
+bool SimVehicle::loiter() {
+    if (!loitering) {
+        loitering = true;
+        Maneuver circle;
+        circle.turnRate_deg_s = config.loiterTurnRate_deg_s;
+        circle.airspeed_m_s = config.cruiseAirspeed_m_s;
+        setManeuver(circle);
+    }
+    return true;
+}
+
+/**
+ * Take setpoints again; the circle is flown until the first one applies
+ * @return true always
+ */
+bool SimVehicle::resume() {
+    loitering = false;
+    return true;
+}
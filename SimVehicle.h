@@ -0,0 +1,218 @@
+// tracking - SimVehicle.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_SIMVEHICLE_H
+#define TRACKING_SIMVEHICLE_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include "Geodesy.h"
+#include "LeaderEstimator.h"
+#include "Vehicle.h"
+
+/**
+ * In-process kinematic fixed-wing aircraft.
+ *
+ * A point mass flying coordinated turns: bank follows the commanded turn with a
+ * first-order lag and is limited, airspeed and climb rate are limited and lagged.
+ * Telemetry is sampled at a fixed rate, optionally with GPS noise, and delivered
+ * after a latency; setpoints take effect after a latency too. Without setpoints
+ * it flies the current maneuver, which is how leaders are scripted.
+ *
+ * Position setpoints model an autopilot that aims at a point lookahead_m ahead
+ * of the setpoint along the commanded yaw and speeds up or slows down with the
+ * along-track error, so a moving setpoint is tracked instead of loitered around.
+ * Velocity setpoints are flown as course and speed. Position setpoints with a
+ * velocity feed-forward are flown as that velocity plus positionGain times the
+ * position error, the way a position controller with feed-forward does.
+ *
+ * Time only moves through step(), normally from a VirtualClock, so runs are
+ * deterministic. Not thread-safe: drive it and the engines from one thread.
+ */
+class SimVehicle : public Vehicle {
+public:
+    struct Config {
+        double cruiseAirspeed_m_s = 20.0;
+        double minAirspeed_m_s = 14.0;
+        double maxAirspeed_m_s = 30.0;
+        double maxBank_deg = 35.0;
+        double bankTimeConstant_s = 0.5;
+        double airspeedTimeConstant_s = 2.0;
+        double maxClimb_m_s = 5.0;
+        double maxSink_m_s = 5.0;
+        /// Heading error to turn rate, 1/s.
+        double headingGain = 1.0;
+        /// Altitude error to climb rate, 1/s.
+        double altitudeGain = 0.5;
+        /// Position setpoints: along-track error to airspeed change, 1/s.
+        double speedGain = 0.5;
+        /// Position setpoints: how far ahead of the setpoint the autopilot aims.
+        double lookahead_m = 40.0;
+        /// Position and velocity setpoints: position error added to the feed-forward, 1/s.
+        double positionGain = 0.2;
+        double windNorth_m_s = 0.0;
+        double windEast_m_s = 0.0;
+        Clock::duration telemetryPeriod = std::chrono::milliseconds(100);
+        Clock::duration telemetryLatency = std::chrono::milliseconds(100);
+        Clock::duration commandLatency = std::chrono::milliseconds(50);
+        /// Standard deviation of the reported horizontal and vertical position, meters.
+        double positionNoise_m = 0.0;
+        /// Probability that a telemetry sample is lost on the way.
+        double telemetryLoss = 0.0;
+        /// Turn rate flown after loiter(), deg/s.
+        double loiterTurnRate_deg_s = 6.0;
+        uint32_t seed = 1;
+    };
+
+    /// Initial state, in the world frame.
+    struct State {
+        double north_m{};
+        double east_m{};
+        /// Altitude above the world frame origin.
+        double altitude_m{};
+        double airspeed_m_s{20.0};
+        double heading_deg{};
+    };
+
+    /// Open-loop flight used when no setpoint has been received.
+    struct Maneuver {
+        double turnRate_deg_s{};
+        double airspeed_m_s{20.0};
+        double climb_m_s{};
+    };
+
+    SimVehicle(int sysid, const geodesy::LocalFrame &world, const State &initial, Config config);
+    SimVehicle(int sysid, const geodesy::LocalFrame &world, const State &initial);
+
+    /// Advance the model to the given time and deliver the telemetry and setpoints that are due.
+    void step(Clock::time_point now);
+
+    /// Fly this maneuver from now on and drop any setpoint.
+    void setManeuver(const Maneuver &maneuver);
+
+    /// Exact current state, no noise and no latency. Use it to score, never to steer.
+    PoseSnapshot truth() const;
+
+    int getSystemId() const override {
+        return sysid;
+    };
+
+    PoseSnapshot getPose() const override {
+        return pose;
+    };
+
+    PoseSnapshot predictPose(Clock::time_point when) const override;
+
+    bool sendPositionGlobal(double lat, double lon, float altAmsl, float yawDeg) const override;
+
+    bool sendVelocityNed(float north_m_s, float east_m_s, float down_m_s, float yawDeg) const override;
+
+    bool sendPositionVelocity(double lat, double lon, float altAmsl,
+                              float north_m_s, float east_m_s, float down_m_s, float yawDeg) const override;
+
+    uint64_t commandsReceived() const {
+        return commandCount;
+    };
+
+    /// Lose every telemetry sample while set, a link blackout.
+    void setTelemetryOutage(bool lost) {
+        outage = lost;
+    };
+
+    /// Share of telemetry samples lost, smoothed over about ten samples.
+    double linkLoss() const override {
+        return lossAverage;
+    };
+
+    /// Circle at loiterTurnRate_deg_s and refuse setpoints until resume().
+    bool loiter() override;
+
+    bool resume() override;
+
+    bool isLoitering() const {
+        return loitering;
+    };
+
+private:
+    enum class Mode {
+        Maneuver,
+        Position,
+        Velocity,
+        PositionVelocity,
+    };
+
+    struct Command {
+        Clock::time_point applyAt;
+        Mode mode;
+        double north_m;
+        double east_m;
+        double altitude_m;
+        double yaw_deg;
+        double north_m_s;
+        double east_m_s;
+        double down_m_s;
+    };
+
+    struct Sample {
+        Clock::time_point deliverAt;
+        PoseSnapshot pose;
+    };
+
+    void integrate(double dt);
+    void sample(Clock::time_point now);
+    void deliver(Clock::time_point now);
+
+    const int sysid;
+    const geodesy::LocalFrame world;
+    const Config config;
+
+    // Model state in the world frame.
+    double north_m;
+    double east_m;
+    double altitude_m;
+    double airspeed_m_s;
+    double heading_rad;
+    double bank_rad{};
+    double climb_m_s{};
+
+    Mode mode{Mode::Maneuver};
+    Maneuver maneuver{};
+    Command active{};
+
+    Clock::time_point now{};
+    Clock::time_point nextSample{};
+    bool started{};
+
+    // Sends are const in the Vehicle interface, the queue is what they change.
+    mutable std::deque<Command> pendingCommands;
+    mutable uint64_t commandCount{};
+    std::deque<Sample> inFlight;
+
+    std::mt19937 random;
+    std::normal_distribution<double> noise{0.0, 1.0};
+    std::uniform_real_distribution<double> chance{0.0, 1.0};
+    bool outage{false};
+    double lossAverage{};
+    bool loitering{false};
+
+    PoseSnapshot pose{};
+    LeaderEstimator estimator;
+};
+
+
+#endif //TRACKING_SIMVEHICLE_H
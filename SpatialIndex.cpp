@@ -0,0 +1,291 @@
+// tracking - SpatialIndex.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include "SpatialIndex.h"
+
+namespace {
+constexpr size_t kMinBuckets = 64;
+
+size_t bucketsFor(size_t capacity) {
+    size_t buckets = kMinBuckets;
+    while (buckets < 2 * capacity) {
+        buckets <<= 1;
+    }
+    return buckets;
+}
+
+double distance(const SpatialIndex::Point &a, const SpatialIndex::Point &b) {
+    const double north = a.north - b.north;
+    const double east = a.east - b.east;
+    const double down = a.down - b.down;
+    return std::sqrt(north * north + east * east + down * down);
+}
+}
+
+/**
+ * Constructor for the index
+ * @param cellSize_m grid spacing in meters
+ * @param capacity number of ids expected
+ */
+SpatialIndex::SpatialIndex(double cellSize_m, size_t capacity)
+        : cellSize(cellSize_m), inverseCell(1.0 / cellSize_m),
+          bucketMask(bucketsFor(capacity) - 1),
+          heads(bucketsFor(capacity), kNone) {
+    next.reserve(capacity);
+    previous.reserve(capacity);
+    bucket.reserve(capacity);
+    cellNorth.reserve(capacity);
+    cellEast.reserve(capacity);
+    positions.reserve(capacity);
+    present.reserve(capacity);
+}
+
+int64_t SpatialIndex::cellOf(double meters) const {
+    return static_cast<int64_t>(std::floor(meters * inverseCell));
+}
+
+size_t SpatialIndex::bucketOf(int64_t north, int64_t east) const {
+    const uint64_t hash = static_cast<uint64_t>(north) * 0x9E3779B97F4A7C15ull
+                          ^ static_cast<uint64_t>(east) * 0xC2B2AE3D27D4EB4Full;
+    return static_cast<size_t>(hash >> 32) & bucketMask;
+}
+
+/**
+ * Insert or move an entry
+ * Only an entry that crossed into another cell is relinked.
+ * @param id entry id
+ * @param position local NED position in meters
+ * @return void
+ */
+void SpatialIndex::update(uint32_t id, const Point &position) {
+    grow(id);
+    const int64_t north = cellOf(position.north);
+    const int64_t east = cellOf(position.east);
+    positions[id] = position;
+    if (present[id]) {
+        if (cellNorth[id] == north && cellEast[id] == east) {
+            return;
+        }
+        unlink(id);
+    } else {
+        present[id] = true;
+        ++count;
+        if (count > heads.size()) {
+            // Rehash into twice the buckets, keeping one bucket per entry on average.
+            heads.assign(heads.size() * 2, kNone);
+            bucketMask = heads.size() - 1;
+            for (uint32_t other = 0; other < present.size(); ++other) {
+                if (present[other] && other != id) {
+                    link(other, bucketOf(cellNorth[other], cellEast[other]));
+                }
+            }
+        }
+    }
+    cellNorth[id] = north;
+    cellEast[id] = east;
+    link(id, bucketOf(north, east));
+}
+
+void SpatialIndex::remove(uint32_t id) {
+    if (!contains(id)) {
+        return;
+    }
+    unlink(id);
+    present[id] = false;
+    --count;
+}
+
+void SpatialIndex::clear() {
+    std::fill(heads.begin(), heads.end(), kNone);
+    std::fill(present.begin(), present.end(), false);
+    count = 0;
+}
+
+void SpatialIndex::grow(uint32_t id) {
+    if (id < present.size()) {
+        return;
+    }
+    const size_t size = static_cast<size_t>(id) + 1;
+    next.resize(size, kNone);
+    previous.resize(size, kNone);
+    bucket.resize(size, 0);
+    cellNorth.resize(size, 0);
+    cellEast.resize(size, 0);
+    positions.resize(size);
+    present.resize(size, false);
+}
+
+void SpatialIndex::link(uint32_t id, size_t to) {
+    bucket[id] = static_cast<uint32_t>(to);
+    previous[id] = kNone;
+    next[id] = heads[to];
+    if (heads[to] != kNone) {
+        previous[heads[to]] = id;
+    }
+    heads[to] = id;
+}
+
+void SpatialIndex::unlink(uint32_t id) {
+    if (previous[id] != kNone) {
+        next[previous[id]] = next[id];
+    } else {
+        heads[bucket[id]] = next[id];
+    }
+    if (next[id] != kNone) {
+        previous[next[id]] = previous[id];
+    }
+}
+
+/**
+ * Call visit(id) for every entry in one cell
+ * Buckets are shared by cells that hash alike, so entries of other cells are skipped.
+ */
+template<typename Visit>
+void SpatialIndex::visitCell(int64_t north, int64_t east, Visit &&visit) const {
+    for (uint32_t id = heads[bucketOf(north, east)]; id != kNone; id = next[id]) {
+        if (cellNorth[id] == north && cellEast[id] == east) {
+            visit(id);
+        }
+    }
+}
+
+/**
+ * Entries within a radius
+ * @param center query point
+ * @param radius_m search radius in meters
+ * @param out entries found with their distances
+ * @param exclude id to leave out
+ * @return void
+ */
+void SpatialIndex::withinRadius(const Point &center, double radius_m, std::vector<Neighbour> &out,
+                                uint32_t exclude) const {
+    out.clear();
+    auto consider = [&](uint32_t id) {
+        if (id == exclude) {
+            return;
+        }
+        const double d = distance(center, positions[id]);
+        if (d <= radius_m) {
+            out.push_back({id, d});
+        }
+    };
+    const int64_t northLow = cellOf(center.north - radius_m);
+    const int64_t northHigh = cellOf(center.north + radius_m);
+    const int64_t eastLow = cellOf(center.east - radius_m);
+    const int64_t eastHigh = cellOf(center.east + radius_m);
+    const auto cells = static_cast<double>(northHigh - northLow + 1) * static_cast<double>(eastHigh - eastLow + 1);
+    if (cells > static_cast<double>(count)) {
+        // The radius spans more cells than there are entries, looking at each entry is cheaper.
+        for (uint32_t id = 0; id < present.size(); ++id) {
+            if (present[id]) {
+                consider(id);
+            }
+        }
+        return;
+    }
+    for (int64_t north = northLow; north <= northHigh; ++north) {
+        for (int64_t east = eastLow; east <= eastHigh; ++east) {
+            visitCell(north, east, consider);
+        }
+    }
+}
+
+/**
+ * The k nearest entries
+ * Cells are visited in square rings around the center's cell. After each ring,
+ * anything not yet seen is at least as far as the ring's edge, so once the k-th
+ * best is closer than that edge the search is done. Once the rings hold more
+ * cells than there are entries, the remaining entries are simply all scanned.
+ * @param center query point
+ * @param k number of entries wanted
+ * @param out nearest entries, nearest first
+ * @param exclude id to leave out
+ * @return void
+ */
+void SpatialIndex::nearest(const Point &center, size_t k, std::vector<Neighbour> &out, uint32_t exclude) const {
+    out.clear();
+    const size_t available = count - (contains(exclude) ? 1 : 0);
+    const size_t wanted = std::min(k, available);
+    if (wanted == 0) {
+        return;
+    }
+    auto consider = [&](uint32_t id) {
+        if (id == exclude) {
+            return;
+        }
+        const Neighbour candidate{id, distance(center, positions[id])};
+        if (out.size() == wanted && candidate.distance_m >= out.back().distance_m) {
+            return;
+        }
+        if (out.size() == wanted) {
+            out.pop_back();
+        }
+        out.insert(std::upper_bound(out.begin(), out.end(), candidate,
+                                    [](const Neighbour &a, const Neighbour &b) {
+                                        return a.distance_m < b.distance_m;
+                                    }), candidate);
+    };
+
+    const int64_t north0 = cellOf(center.north);
+    const int64_t east0 = cellOf(center.east);
+    size_t seen = 0;
+    auto visit = [&](int64_t north, int64_t east) {
+        visitCell(north, east, [&](uint32_t id) {
+            seen += id == exclude ? 0 : 1;
+            consider(id);
+        });
+    };
+    for (int64_t ring = 0;; ++ring) {
+        const auto side = static_cast<double>(2 * ring + 1);
+        if (side * side > 4.0 * static_cast<double>(count)) {
+            // Outliers far away: the rings have more cells than the index has entries, scan them all.
+            out.clear();
+            for (uint32_t id = 0; id < present.size(); ++id) {
+                if (present[id]) {
+                    consider(id);
+                }
+            }
+            return;
+        }
+        if (ring == 0) {
+            visit(north0, east0);
+        } else {
+            for (int64_t d = -ring; d <= ring; ++d) {
+                visit(north0 - ring, east0 + d);
+                visit(north0 + ring, east0 + d);
+            }
+            for (int64_t d = -ring + 1; d <= ring - 1; ++d) {
+                visit(north0 + d, east0 - ring);
+                visit(north0 + d, east0 + ring);
+            }
+        }
+        if (seen == available) {
+            return;
+        }
+        if (out.size() == wanted) {
+            // Horizontal distance from the center to the nearest cell outside the rings visited.
+            const double edge = std::min({center.north - static_cast<double>(north0 - ring) * cellSize,
+                                          static_cast<double>(north0 + ring + 1) * cellSize - center.north,
+                                          center.east - static_cast<double>(east0 - ring) * cellSize,
+                                          static_cast<double>(east0 + ring + 1) * cellSize - center.east});
+            if (out.back().distance_m <= edge) {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,115 @@
+// tracking - SpatialIndex.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_SPATIALINDEX_H
+#define TRACKING_SPATIALINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Uniform grid over local NED meters for neighbour queries between aircraft.
+ *
+ * The grid is horizontal: cells are cellSize_m columns, hashed into a fixed
+ * bucket table, and distances are full 3D. Every entry is linked into its
+ * bucket's list through index arrays, so moving an aircraft that stayed in its
+ * cell is a store, moving one that crossed into another cell is an unlink and
+ * a link, and nothing allocates once the ids in use have been seen. Queries
+ * only visit the cells the search radius overlaps, so a tick of N queries
+ * costs about O(N) instead of O(N^2) pairwise distances.
+ *
+ * Ids are small dense integers (e.g. follower indices). Not thread-safe.
+ */
+class SpatialIndex {
+public:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Point {
+        double north{};
+        double east{};
+        double down{};
+    };
+
+    struct Neighbour {
+        uint32_t id{};
+        double distance_m{};
+    };
+
+    /**
+     * @param cellSize_m grid spacing; queries are cheapest with a radius close to it
+     * @param capacity ids expected, sizes the bucket table (it grows past it, by allocating)
+     */
+    explicit SpatialIndex(double cellSize_m = 50.0, size_t capacity = 256);
+
+    /// Insert the id, or move it to the new position.
+    void update(uint32_t id, const Point &position);
+
+    void remove(uint32_t id);
+
+    void clear();
+
+    bool contains(uint32_t id) const {
+        return id < present.size() && present[id];
+    };
+
+    size_t size() const {
+        return count;
+    };
+
+    /**
+     * Every entry within radius_m of the center, in no particular order.
+     * @param exclude id to leave out, usually the one asking
+     * @param out replaced with the result; reuse it across calls to avoid allocating
+     */
+    void withinRadius(const Point &center, double radius_m, std::vector<Neighbour> &out,
+                      uint32_t exclude = kNone) const;
+
+    /**
+     * The k entries nearest to the center, nearest first.
+     * Searches outwards ring by ring and stops once no unvisited cell can hold anything closer.
+     * @param out replaced with the result, fewer than k if the index holds fewer
+     */
+    void nearest(const Point &center, size_t k, std::vector<Neighbour> &out, uint32_t exclude = kNone) const;
+
+private:
+    int64_t cellOf(double meters) const;
+    size_t bucketOf(int64_t cellNorth, int64_t cellEast) const;
+    void link(uint32_t id, size_t bucket);
+    void unlink(uint32_t id);
+    void grow(uint32_t id);
+    template<typename Visit>
+    void visitCell(int64_t cellNorth, int64_t cellEast, Visit &&visit) const;
+
+    const double cellSize;
+    const double inverseCell;
+    size_t bucketMask;
+    size_t count{0};
+
+    /// First entry of each bucket's list, kNone if empty.
+    std::vector<uint32_t> heads;
+    // Per id.
+    std::vector<uint32_t> next;
+    std::vector<uint32_t> previous;
+    std::vector<uint32_t> bucket;
+    std::vector<int64_t> cellNorth;
+    std::vector<int64_t> cellEast;
+    std::vector<Point> positions;
+    std::vector<bool> present;
+};
+
+
+#endif //TRACKING_SPATIALINDEX_H
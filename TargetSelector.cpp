@@ -0,0 +1,226 @@
+// tracking - TargetSelector.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include "Geodesy.h"
+#include "TargetSelector.h"
+
+using geodesy::kDegToRad;
+
+namespace {
+/// Closer than this the bearing and closure are noise, the contact is dead ahead.
+constexpr double kMinRange_m = 1.0;
+/// Score of a contact that is not eligible.
+constexpr double kIneligible = -1.0;
+
+std::string selectorLabels(const Vehicle &self) {
+    return "sysid=\"" + std::to_string(self.getSystemId()) + "\"";
+}
+}
+
+/**
+ * Constructor for the selector, the loop starts with start()
+ * @param self follower the contacts are scored from
+ * @param gather fills in the contacts every tick
+ * @param onChange receives every new target, on the selector's thread
+ * @param config scoring and hysteresis
+ */
+TargetSelector::TargetSelector(Vehicle &self, Gather gather, OnChange onChange, Config config)
+        : self(self), gather(std::move(gather)), onChange(std::move(onChange)), config(config),
+          switches(Metrics::instance().counter("tracking_target_changes_total", "Target lock changes by reason",
+                                               selectorLabels(self) + ",reason=\"better\"")),
+          losses(Metrics::instance().counter("tracking_target_changes_total", "Target lock changes by reason",
+                                             selectorLabels(self) + ",reason=\"lost\"")),
+          targetId(Metrics::instance().gauge("tracking_target_sysid", "System id of the locked target, -1 for none",
+                                             selectorLabels(self))),
+          lockDuration(Metrics::instance().histogram("tracking_target_lock_seconds", "Length of ended target locks",
+                                                     selectorLabels(self))),
+          loop(config.rateHz, [this] { tick(); }) {
+    targetId.set(-1);
+}
+
+TargetSelector::~TargetSelector() {
+    stop();
+}
+
+void TargetSelector::tick() {
+    tick(Clock::now());
+}
+
+/**
+ * Score every contact and keep, move or drop the lock
+ * @param now time of the selection
+ * @return void
+ */
+void TargetSelector::tick(Clock::time_point now) {
+    lastTick.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+    gather(contacts);
+    const PoseSnapshot own = self.getPose();
+    if (!own.hasFix()) {
+        return;
+    }
+    score(own, now);
+
+    const size_t n = contacts.size();
+    size_t best = n;
+    size_t locked = n;
+    Vehicle *target = current.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < n; ++i) {
+        if (scores[i] != kIneligible && (best == n || scores[i] > scores[best])) {
+            best = i;
+        }
+        if (contacts[i] == target) {
+            locked = i;
+        }
+    }
+
+    if (target == nullptr) {
+        if (best != n) {
+            lockOn(contacts[best], now);
+        }
+        return;
+    }
+    if (locked == n || scores[locked] == kIneligible) {
+        if (ineligibleSince == Clock::time_point{}) {
+            ineligibleSince = now;
+        }
+        if (now - ineligibleSince >= config.lostAfter) {
+            losses.add();
+            lockOn(best != n ? contacts[best] : nullptr, now);
+        }
+        return;
+    }
+    ineligibleSince = {};
+
+    if (best == locked || scores[best] <= scores[locked] + config.switchMargin
+        || now - lockedSince < config.minLock) {
+        challenger = nullptr;
+        return;
+    }
+    if (challenger != contacts[best]) {
+        // A new challenger starts its dwell over, even if another one was already waiting.
+        challenger = contacts[best];
+        challengedSince = now;
+    }
+    if (now - challengedSince >= config.switchDwell) {
+        switches.add();
+        lockOn(challenger, now);
+    }
+}
+
+/**
+ * Score every contact from its cached snapshot
+ * Positions are batch-converted into a frame at the follower. Each part is in
+ * [0, 1]: distance falls linearly to 0 at maxRange, closure saturates at
+ * fullClosure and bearing falls linearly to 0 at the edge of the cone.
+ * @param own follower pose
+ * @param now time of the selection, for the fix age
+ * @return void
+ */
+void TargetSelector::score(const PoseSnapshot &own, Clock::time_point now) {
+    const size_t n = contacts.size();
+    poses.resize(n);
+    latitude.resize(n);
+    longitude.resize(n);
+    altitude.resize(n);
+    north.resize(n);
+    east.resize(n);
+    down.resize(n);
+    scores.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        poses[i] = contacts[i]->getPose();
+        latitude[i] = poses[i].latitude_deg;
+        longitude[i] = poses[i].longitude_deg;
+        altitude[i] = poses[i].absolute_altitude_m;
+    }
+    const geodesy::LocalFrame frame({own.latitude_deg, own.longitude_deg, own.absolute_altitude_m});
+    frame.toNedBatch(latitude.data(), longitude.data(), altitude.data(), north.data(), east.data(), down.data(), n);
+
+    const double track = own.trackAngle_rad();
+    const double trackNorth = std::cos(track);
+    const double trackEast = std::sin(track);
+    const double cone = config.coneHalfAngle_deg * kDegToRad;
+    for (size_t i = 0; i < n; ++i) {
+        const PoseSnapshot &contact = poses[i];
+        const double horizontal = std::hypot(north[i], east[i]);
+        const double range = std::hypot(horizontal, down[i]);
+        if (!contact.hasFix() || now - contact.positionTime > config.maxPoseAge || range > config.maxRange_m) {
+            scores[i] = kIneligible;
+            continue;
+        }
+        double offNose = 0.0;
+        double closure = 0.0;
+        if (range > kMinRange_m) {
+            if (horizontal > kMinRange_m) {
+                offNose = std::acos(std::clamp((north[i] * trackNorth + east[i] * trackEast) / horizontal, -1.0, 1.0));
+            }
+            // Closing speed: the relative velocity against the line of sight.
+            closure = -((contact.north_m_s - own.north_m_s) * north[i] + (contact.east_m_s - own.east_m_s) * east[i]
+                        + (contact.down_m_s - own.down_m_s) * down[i]) / range;
+        }
+        if (offNose > cone) {
+            scores[i] = kIneligible;
+            continue;
+        }
+        scores[i] = config.distanceWeight * (1.0 - range / config.maxRange_m)
+                    + config.closureWeight * std::clamp(closure / config.fullClosure_m_s, 0.0, 1.0)
+                    + config.bearingWeight * (1.0 - offNose / cone);
+    }
+}
+
+/**
+ * Move the lock and tell the follow loop
+ * @param next new target, nullptr for none
+ * @param now time of the change
+ * @return void
+ */
+void TargetSelector::lockOn(Vehicle *next, Clock::time_point now) {
+    if (current.load(std::memory_order_relaxed) != nullptr) {
+        lockDuration.record(now - lockedSince);
+    }
+    lockedSince = now;
+    challenger = nullptr;
+    ineligibleSince = {};
+    lockStart.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+    current.store(next, std::memory_order_release);
+    targetId.set(next != nullptr ? next->getSystemId() : -1);
+    onChange(next);
+}
+
+/**
+ * Timing, lock changes and lock lengths
+ * @return Stats selector statistics
+ */
+TargetSelector::Stats TargetSelector::stats() const {
+    Stats result;
+    result.timing = loop.stats();
+    result.switches = switches.value();
+    result.losses = losses.value();
+    const Vehicle *target = current.load(std::memory_order_acquire);
+    if (target != nullptr) {
+        result.target = target->getSystemId();
+        result.currentLock = Clock::duration(lastTick.load(std::memory_order_relaxed)
+                                             - lockStart.load(std::memory_order_relaxed));
+    }
+    const Histogram::Snapshot locks = lockDuration.snapshot();
+    result.locks = locks.count;
+    result.meanLock = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double, std::micro>(locks.mean()));
+    result.longestLock = std::chrono::microseconds(locks.max);
+    return result;
+}
@@ -0,0 +1,164 @@
+// tracking - TargetSelector.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_TARGETSELECTOR_H
+#define TRACKING_TARGETSELECTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "FixedRateLoop.h"
+#include "Metrics.h"
+#include "Vehicle.h"
+
+/**
+ * Picks which of many contacts the follower should lock on to, continuously.
+ *
+ * Every tick reads each contact's snapshot once, batch-converts the positions
+ * into the follower's local frame and scores each contact in [0, 1] on
+ * distance, closure rate and how far it is off the follower's nose. Contacts
+ * out of range, outside the bearing cone or without a recent fix are not
+ * eligible. A tick is O(N) in the contacts and allocates nothing once the
+ * contact count has been seen.
+ *
+ * Hysteresis keeps the lock from thrashing: a challenger has to beat the
+ * current target by switchMargin for switchDwell, and never before the lock is
+ * minLock old. A target that stays ineligible for lostAfter loses the lock and
+ * the best eligible contact is taken at once. Every change is handed to the
+ * onChange callback on the selector's thread, nullptr when nothing is eligible.
+ */
+class TargetSelector {
+public:
+    using Clock = Vehicle::Clock;
+    /// Fills the vector with the current contacts; called once per tick, reuse its capacity.
+    using Gather = std::function<void(std::vector<Vehicle *> &)>;
+    using OnChange = std::function<void(Vehicle *)>;
+
+    struct Config {
+        int rateHz = 10;
+        double maxRange_m = 3000.0;
+        /// Contacts further off the follower's track than this are not eligible, degrees.
+        double coneHalfAngle_deg = 60.0;
+        /// Closure rate that earns the full closure score, m/s. Opening contacts score 0.
+        double fullClosure_m_s = 15.0;
+        /// Weights of the distance, closure and bearing scores.
+        double distanceWeight = 0.5;
+        double closureWeight = 0.2;
+        double bearingWeight = 0.3;
+        /// A challenger must score this much more than the current target...
+        double switchMargin = 0.1;
+        /// ...for this long before the lock moves to it.
+        Clock::duration switchDwell = std::chrono::seconds(1);
+        /// No switch to a better contact before the lock is this old.
+        Clock::duration minLock = std::chrono::seconds(3);
+        /// Contacts with an older fix are not eligible.
+        Clock::duration maxPoseAge = std::chrono::seconds(1);
+        /// The lock is lost once its target has been ineligible this long.
+        Clock::duration lostAfter = std::chrono::seconds(1);
+    };
+
+    struct Stats {
+        FixedRateLoop::Stats timing;
+        /// Lock moved to a better contact.
+        uint64_t switches{};
+        /// Lock dropped because its target stayed ineligible.
+        uint64_t losses{};
+        /// System id of the current target, -1 when none.
+        int target{-1};
+        Clock::duration currentLock{};
+        /// Ended locks.
+        uint64_t locks{};
+        Clock::duration meanLock{};
+        Clock::duration longestLock{};
+    };
+
+    /**
+     * @param self the follower, its pose anchors the scores
+     * @param gather lists the contacts, the follower itself must not be among them
+     * @param onChange told about every new target
+     */
+    TargetSelector(Vehicle &self, Gather gather, OnChange onChange, Config config);
+    ~TargetSelector();
+
+    TargetSelector(const TargetSelector &) = delete;
+    TargetSelector &operator=(const TargetSelector &) = delete;
+
+    bool start() {
+        return loop.start();
+    };
+
+    void stop() {
+        loop.stop();
+    };
+
+    /// Score the contacts and move the lock if needed. Called by the loop thread on every tick.
+    void tick();
+
+    /// One selection as of the given time, for simulations on a virtual clock.
+    void tick(Clock::time_point now);
+
+    /// Current target, nullptr when none. Any thread.
+    Vehicle *target() const {
+        return current.load(std::memory_order_acquire);
+    };
+
+    Stats stats() const;
+
+private:
+    void score(const PoseSnapshot &own, Clock::time_point now);
+    void lockOn(Vehicle *next, Clock::time_point now);
+
+    Vehicle &self;
+    const Gather gather;
+    const OnChange onChange;
+    const Config config;
+
+    // Structure of arrays, one entry per contact, reused every tick.
+    std::vector<Vehicle *> contacts;
+    std::vector<double> latitude;
+    std::vector<double> longitude;
+    std::vector<double> altitude;
+    std::vector<double> north;
+    std::vector<double> east;
+    std::vector<double> down;
+    std::vector<double> scores;
+    std::vector<PoseSnapshot> poses;
+
+    // Selection state, only touched on the ticking thread.
+    Clock::time_point lockedSince{};
+    Vehicle *challenger{nullptr};
+    Clock::time_point challengedSince{};
+    Clock::time_point ineligibleSince{};
+
+    std::atomic<Vehicle *> current{nullptr};
+    /// Lock start as a count of Clock ticks, for stats() from other threads.
+    std::atomic<Clock::rep> lockStart{0};
+    std::atomic<Clock::rep> lastTick{0};
+
+    Counter &switches;
+    Counter &losses;
+    Gauge &targetId;
+    /// Length of every ended lock.
+    Histogram &lockDuration;
+
+    // Last member: the loop thread must stop before anything it touches is destroyed.
+    FixedRateLoop loop;
+};
+
+
+#endif //TRACKING_TARGETSELECTOR_H
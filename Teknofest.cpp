@@ -0,0 +1,218 @@
+// tracking - Teknofest.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <string>
+#include "Geodesy.h"
+#include "Teknofest.h"
+
+using namespace std;
+
+using geodesy::kDegToRad;
+using geodesy::kRadToDeg;
+
+/**
+ * Constructor for the follow engine
+ * @param follower vehicle that will receive the setpoints
+ * @param leader vehicle to follow
+ * @param config engine configuration, rate is clamped to [10, 100] Hz
+ */
+Teknofest::Teknofest(Vehicle &follower, Vehicle &leader, Config config)
+        : follower(follower), leader(&leader), config(config),
+          widened(config),
+          linkStateGauge(Metrics::instance().gauge(
+                  "tracking_follow_link_state", "Follow back-off: 0 nominal, 1 degraded, 2 predicting, 3 loitering",
+                  "sysid=\"" + to_string(follower.getSystemId()) + "\"")),
+          poseAge(Metrics::instance().histogram(
+                  "tracking_command_pose_age_seconds", "Age of the leader fix a command was computed from",
+                  "sysid=\"" + to_string(follower.getSystemId()) + "\",engine=\"teknofest\"")),
+          loop(config.rateHz, [this] { tick(); }) {
+    widened.followDistance_m *= config.degradation.spacingFactor;
+}
+
+Teknofest::Teknofest(Vehicle &follower, Vehicle &leader)
+        : Teknofest(follower, leader, Config{}) {
+}
+
+Teknofest::~Teknofest() {
+    stop();
+}
+
+/**
+ * Single follow step: read the leader snapshot once, compute and send the setpoint
+ * @return void
+ */
+void Teknofest::tick() {
+    tick(Clock::now());
+}
+
+/**
+ * Single follow step with the leader predicted to the given time
+ * @param now send time of the setpoint
+ * @return void
+ */
+void Teknofest::tick(Clock::time_point now) {
+    const uint64_t tick = ticks.fetch_add(1, std::memory_order_relaxed);
+    const Vehicle &current = *leader.load(std::memory_order_acquire);
+    const LinkState previous = linkState.load(std::memory_order_relaxed);
+    const bool predicted = config.usePrediction || previous >= LinkState::Predicting;
+    PoseSnapshot target = predicted ? current.predictPose(now) : current.getPose();
+    if (!target.hasFix()) {
+        staleTicks.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const Clock::duration age = now - target.positionTime;
+    const LinkState state = assess(age, current.linkLoss(), previous, config.degradation);
+    if (state != previous) {
+        enter(state);
+    }
+    if (state == LinkState::Loitering) {
+        loiterTicks.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const bool backedOff = state != LinkState::Nominal;
+    if (backedOff && config.degradation.rateDivisor > 1
+        && tick % static_cast<uint64_t>(config.degradation.rateDivisor) != 0) {
+        throttledTicks.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (state == LinkState::Predicting && !predicted) {
+        target = current.predictPose(now);
+    }
+    poseAge.record(age);
+    const Config &active = backedOff ? widened : config;
+    const Setpoint setpoint = computeSetpoint(target, active);
+    switch (config.mode) {
+        case Mode::Position:
+            follower.sendPositionGlobal(setpoint.latitude_deg, setpoint.longitude_deg,
+                                        setpoint.absolute_altitude_m, setpoint.yaw_deg);
+            break;
+        case Mode::Velocity:
+        case Mode::PositionVelocity: {
+            const PoseSnapshot self = config.usePrediction ? follower.predictPose(now) : follower.getPose();
+            if (!self.hasFix()) {
+                staleTicks.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            const guidance::Command command = guidance::compute(
+                    self, {setpoint.latitude_deg, setpoint.longitude_deg, setpoint.absolute_altitude_m},
+                    target, setpoint.yaw_deg * kDegToRad, active.guidance);
+            if (config.mode == Mode::Velocity) {
+                follower.sendVelocityNed(command.north_m_s, command.east_m_s, command.down_m_s, command.yaw_deg);
+                break;
+            }
+            const auto share = static_cast<float>(active.feedForwardCorrection);
+            follower.sendPositionVelocity(setpoint.latitude_deg, setpoint.longitude_deg, setpoint.absolute_altitude_m,
+                                          target.north_m_s + share * (command.north_m_s - target.north_m_s),
+                                          target.east_m_s + share * (command.east_m_s - target.east_m_s),
+                                          target.down_m_s, setpoint.yaw_deg);
+            break;
+        }
+    }
+}
+
+/**
+ * Classify the leader's link
+ * Every state but Loitering follows the current fix age and loss directly. Once
+ * loitering, only a fix fresh enough for Nominal or Degraded ends it, so a
+ * single late sample does not bounce the follower in and out of hold.
+ * @param age age of the leader's last fix
+ * @param loss leader's recent link loss, [0, 1]
+ * @param current state the engine is in
+ * @param degradation thresholds
+ * @return LinkState state for this tick
+ */
+Teknofest::LinkState Teknofest::assess(Clock::duration age, double loss, LinkState current,
+                                       const Degradation &degradation) {
+    const bool loiters = degradation.loiterAge > Clock::duration::zero();
+    if (current == LinkState::Loitering && age >= degradation.degradedAge) {
+        return LinkState::Loitering;
+    }
+    if (loiters && age >= degradation.loiterAge) {
+        return LinkState::Loitering;
+    }
+    if (age >= degradation.predictAge) {
+        return LinkState::Predicting;
+    }
+    if (age >= degradation.degradedAge || loss > degradation.degradedLoss) {
+        return LinkState::Degraded;
+    }
+    return LinkState::Nominal;
+}
+
+/**
+ * Switch state, telling the follower to loiter or resume on the way in or out of Loitering
+ * Runs on the engine thread; neither call waits for the vehicle.
+ * @param next new state
+ * @return void
+ */
+void Teknofest::enter(LinkState next) {
+    const LinkState previous = linkState.exchange(next, std::memory_order_relaxed);
+    linkStateGauge.set(static_cast<int64_t>(next));
+    if (next == LinkState::Loitering) {
+        loiters.fetch_add(1, std::memory_order_relaxed);
+        follower.loiter();
+    } else if (previous == LinkState::Loitering) {
+        follower.resume();
+    }
+}
+
+/**
+ * Compute the follower setpoint from the leader pose
+ * The follower is placed followDistance_m behind the leader along its ground track
+ * (or along its heading when it is nearly stationary) and altitudeOffset_m above it.
+ * @param leader leader pose snapshot
+ * @param config engine configuration
+ * @return Setpoint global position and yaw for the follower
+ */
+Teknofest::Setpoint Teknofest::computeSetpoint(const PoseSnapshot &leader, const Config &config) {
+    const double track_rad = leader.trackAngle_rad();
+
+    const double north_m = -config.followDistance_m * std::cos(track_rad);
+    const double east_m = -config.followDistance_m * std::sin(track_rad);
+
+    const geodesy::Geodetic position = geodesy::offset(
+            {leader.latitude_deg, leader.longitude_deg, leader.absolute_altitude_m},
+            north_m, east_m, config.altitudeOffset_m);
+
+    Setpoint setpoint;
+    setpoint.latitude_deg = position.latitude_deg;
+    setpoint.longitude_deg = position.longitude_deg;
+    setpoint.absolute_altitude_m = static_cast<float>(position.altitude_m);
+    setpoint.yaw_deg = static_cast<float>(track_rad * kRadToDeg);
+    return setpoint;
+}
+
+/**
+ * Get a copy of the tick statistics
+ * @return Stats
+ */
+Teknofest::Stats Teknofest::stats() const {
+    const FixedRateLoop::Stats timing = loop.stats();
+    Stats result;
+    result.ticks = ticks.load(std::memory_order_relaxed);
+    result.staleTicks = staleTicks.load(std::memory_order_relaxed);
+    result.throttledTicks = throttledTicks.load(std::memory_order_relaxed);
+    result.loiterTicks = loiterTicks.load(std::memory_order_relaxed);
+    result.loiters = loiters.load(std::memory_order_relaxed);
+    result.linkState = linkState.load(std::memory_order_relaxed);
+    result.overruns = timing.overruns;
+    result.missedTicks = timing.missedTicks;
+    result.lastJitter = timing.lastJitter;
+    result.maxJitter = timing.maxJitter;
+    result.meanJitter = timing.meanJitter;
+    return result;
+}
@@ -0,0 +1,202 @@
+// tracking - Teknofest.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_TEKNOFEST_H
+#define TRACKING_TEKNOFEST_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "FixedRateLoop.h"
+#include "Guidance.h"
+#include "Metrics.h"
+#include "Vehicle.h"
+
+/**
+ * Fixed-rate follow engine.
+ *
+ * Runs on its own FixedRateLoop and, on every tick, turns the leader's latest
+ * pose snapshot into an offboard setpoint for the follower.
+ *
+ * The slot is followDistance_m behind the leader. Position mode sends the slot
+ * itself; velocity mode steers onto it with a guidance law; position-velocity
+ * mode sends the slot with the leader's velocity plus part of the guidance
+ * law's correction as feed-forward.
+ *
+ * The leader can be swapped while running, e.g. by a TargetSelector; the next
+ * tick follows the new one.
+ *
+ * The engine backs off as the leader's link gets worse, judged on every tick
+ * from the age of the leader's last fix and its link loss: degraded sends only
+ * every rateDivisor-th setpoint with the spacing widened, predicting also
+ * follows the estimator's extrapolation whatever usePrediction says, and past
+ * loiterAge the follower is told to loiter and nothing is sent until a fresh
+ * fix arrives, when it is told to resume.
+ */
+class Teknofest {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Mode {
+        /// set_position_global at the slot.
+        Position,
+        /// set_velocity_ned from the guidance law, see Guidance.h.
+        Velocity,
+        /// set_position_velocity_ned: the slot plus the leader's velocity and part of the guidance correction.
+        PositionVelocity,
+    };
+
+    /// How far the engine has backed off, in increasing order.
+    enum class LinkState {
+        Nominal,
+        Degraded,
+        Predicting,
+        Loitering,
+    };
+
+    struct Degradation {
+        /// Leader fix older than this, or link loss above degradedLoss: degraded.
+        Clock::duration degradedAge = std::chrono::milliseconds(500);
+        double degradedLoss = 0.2;
+        /// While degraded or predicting only every rateDivisor-th tick sends.
+        int rateDivisor = 2;
+        /// Follow distance multiplier while degraded or predicting.
+        double spacingFactor = 2.0;
+        /// Leader fix older than this: follow the extrapolated leader.
+        Clock::duration predictAge = std::chrono::seconds(1);
+        /// Leader fix older than this: loiter until a fresh one arrives. Zero never loiters.
+        Clock::duration loiterAge = std::chrono::seconds(3);
+    };
+
+    struct Config {
+        /// Tick rate, clamped to [minRateHz, maxRateHz].
+        int rateHz = 50;
+        /// Distance to keep behind the leader along its track, in meters.
+        double followDistance_m = 30.0;
+        /// Altitude to keep relative to the leader, in meters (positive is up).
+        double altitudeOffset_m = 0.0;
+        /// Extrapolate the leader to the send time instead of using its last fix.
+        bool usePrediction = true;
+        Mode mode = Mode::Position;
+        /// Velocity and position-velocity modes: pursuit law and gains.
+        guidance::Config guidance;
+        /// Position-velocity mode: share of the guidance law's correction to the leader's velocity that is fed
+        /// forward. The autopilot also closes on the position setpoint, the whole correction would overshoot.
+        double feedForwardCorrection = 0.6;
+        Degradation degradation;
+    };
+
+    struct Setpoint {
+        double latitude_deg{};
+        double longitude_deg{};
+        float absolute_altitude_m{};
+        float yaw_deg{};
+    };
+
+    struct Stats {
+        uint64_t ticks{};
+        /// Ticks that finished after the next deadline had already passed.
+        uint64_t overruns{};
+        /// Deadlines skipped entirely because of overruns.
+        uint64_t missedTicks{};
+        /// Ticks skipped because the leader had no position fix yet.
+        uint64_t staleTicks{};
+        /// Ticks not sent to lower the setpoint rate while degraded or predicting.
+        uint64_t throttledTicks{};
+        /// Ticks not sent while the follower was loitering.
+        uint64_t loiterTicks{};
+        /// Times the follower was sent to loiter.
+        uint64_t loiters{};
+        LinkState linkState{LinkState::Nominal};
+        /// Wake-up lateness relative to the deadline.
+        Clock::duration lastJitter{};
+        Clock::duration maxJitter{};
+        Clock::duration meanJitter{};
+    };
+
+    static constexpr int minRateHz = FixedRateLoop::minRateHz;
+    static constexpr int maxRateHz = FixedRateLoop::maxRateHz;
+
+    Teknofest(Vehicle &follower, Vehicle &leader, Config config);
+    Teknofest(Vehicle &follower, Vehicle &leader);
+    ~Teknofest();
+
+    Teknofest(const Teknofest &) = delete;
+    Teknofest &operator=(const Teknofest &) = delete;
+
+    bool start() {
+        return loop.start();
+    };
+
+    void stop() {
+        loop.stop();
+    };
+
+    bool isRunning() const {
+        return loop.isRunning();
+    };
+
+    /// Run a single follow step. Called by the engine thread on every tick.
+    void tick();
+
+    /// Run a single follow step as of the given time, for simulations on a virtual clock.
+    void tick(Clock::time_point now);
+
+    Stats stats() const;
+
+    /// Follow another leader from the next tick on. Any thread.
+    void setLeader(Vehicle &next) {
+        leader.store(&next, std::memory_order_release);
+    };
+
+    Vehicle &getLeader() const {
+        return *leader.load(std::memory_order_acquire);
+    };
+
+    Clock::duration period() const {
+        return loop.period();
+    };
+
+    static Setpoint computeSetpoint(const PoseSnapshot &leader, const Config &config);
+
+    /// State for a leader fix of the given age and link loss; leaving Loitering needs a fix newer than degradedAge.
+    static LinkState assess(Clock::duration age, double loss, LinkState current, const Degradation &degradation);
+
+private:
+    void enter(LinkState next);
+
+    Vehicle &follower;
+    std::atomic<Vehicle *> leader;
+    const Config config;
+
+    std::atomic<uint64_t> ticks{0};
+    std::atomic<uint64_t> staleTicks{0};
+    std::atomic<uint64_t> throttledTicks{0};
+    std::atomic<uint64_t> loiterTicks{0};
+    std::atomic<uint64_t> loiters{0};
+    std::atomic<LinkState> linkState{LinkState::Nominal};
+    /// Config with the spacing widened, used while degraded or predicting.
+    Config widened;
+    Gauge &linkStateGauge;
+    /// Age of the leader fix each setpoint was computed from.
+    Histogram &poseAge;
+
+    // Last member: the loop thread must stop before anything it touches is destroyed.
+    FixedRateLoop loop;
+};
+
+
+#endif //TRACKING_TEKNOFEST_H
@@ -18,49 +18,69 @@
 // Created by kardasland on 3/24/24.
 //
 #include "mavsdk.h"
-#include <iostream>
+#include <atomic>
 #include <plugins/action/action.h>
+#include "Logger.h"
+#include "TargetSelector.h"
 #include "TrackerMain.h"
 #include "Teknofest.h"
 
 using namespace std;
 using namespace mavsdk;
 
+namespace {
+std::atomic<bool> stopRequested{false};
+static_assert(std::atomic<bool>::is_always_lock_free, "requestStop() must be async-signal-safe");
+/// How often the follow session looks for a stop request.
+constexpr milliseconds kStopPoll{100};
+}
+
+/**
+ * End the follow session started by initialize
+ * @return void
+ */
+void TrackerMain::requestStop() {
+    stopRequested.store(true);
+}
+
 /**
  * @brief Initialize the tracker
  * @param address string IP address of the udp connection
  * @param port int Port number of the udp connection
  */
 void TrackerMain::initialize(const string &address, int port = 14550) {
-    Mavsdk mavsdk{Mavsdk::Configuration{Mavsdk::ComponentType::GroundStation}};
-    ConnectionResult connection_result = mavsdk.add_udp_connection(address, port);
-
+    initialize(vector<string>{"udp://" + address + ":" + to_string(port)});
+}
 
+/**
+ * @brief Initialize the tracker on several links at once
+ * All links share one MAVSDK instance and their planes end up in one fleet.
+ * @param endpoints MAVSDK connection URLs (udp://, tcp://, serial://)
+ */
+void TrackerMain::initialize(const vector<string> &endpoints) {
     /// If you don't need to check the health of the plane, you can override the check.
     bool overrideSafety = true;
 
-    if (connection_result != ConnectionResult::Success) {
-        std::cerr << "Connection failed: " << connection_result << '\n';
+    if (m_connections.addEndpoints(endpoints) == 0) {
+        LOG_ERROR("No connection could be opened");
         return;
     }
 
-    auto system = mavsdk.first_autopilot(3.0);
+    auto system = m_connections.waitForAutopilot(3.0);
     if (!system) {
-        std::cerr << "Timed out waiting for system\n";
+        LOG_ERROR("Timed out waiting for system");
         return;
     }
 
-    // shared pointers are kinda weird
-    std::vector<std::shared_ptr<System>> systems = mavsdk.systems();
-    for (const auto &system_ptr: systems) {
-        auto a = &system_ptr;
-        auto *adas = new plane(a->get(), system.value()->get_system_id() == system_ptr->get_system_id());
-        m_planeList.push_back(adas);
+    // The fleet keeps picking up planes that join later, on any link.
+    m_connections.createFleet(system.value()->get_system_id());
+    if (m_recorder.isOpen()) {
+        fleet()->setRecorder(&m_recorder);
     }
 
     plane *mainPlane = findMainPlane();
     if (mainPlane == nullptr) {
-        cout << "Main plane could not be found!" << endl;
+        LOG_ERROR("Main plane could not be found");
         return;
     }
 
@@ -75,45 +95,135 @@ void TrackerMain::initialize(const string &address, int port = 14550) {
     //    mainPlane->arm();
     //    mainPlane->takeoff();
     //}
-    // little bir unnecessary but it's fine
-    sleep_for(seconds(5));
+    // Go as soon as there is a plane to follow and every plane has a fix, instead of a fixed pause.
+    if (fleet()->waitForPlanes(2, seconds(5))) {
+        fleet()->waitPositionAll(seconds(5));
+    }
+    // Offboard starts from the origin, which is resolved in the background.
+    if (!mainPlane->waitForOrigin(seconds(10))) {
+        LOG_ERROR("Plane {}: GPS global origin did not resolve, not following", mainPlane->getSystemId());
+        return;
+    }
 
-    plane *targetPlane = m_planeList.at(1);
-    cout << "Following...\n";
+    plane *targetPlane = findTargetPlane();
+    if (targetPlane == nullptr) {
+        LOG_ERROR("No target plane to follow");
+        return;
+    }
 
 
-    mainPlane->startOffboard();
+    if (!mainPlane->startOffboard()) {
+        LOG_ERROR("Plane {}: offboard did not start, not following", mainPlane->getSystemId());
+        return;
+    }
 
-    cout << "Before Calling Follow\n";
-    cout << mainPlane->getAltitude() << endl;
-    cout << mainPlane->getLatitude() << endl;
-    cout << mainPlane->getLongitude() << endl;
+    LOG_INFO("Plane {}: following plane {} from {} m at {}, {}", mainPlane->getSystemId(),
+             targetPlane->getSystemId(), mainPlane->getAltitude(), mainPlane->getLatitude(),
+             mainPlane->getLongitude());
 
     //mainPlane->offGlobal(0.001,0.001,0.0,0.0);
-    //Teknofest::followPlane(mainPlane, targetPlane);
+    Teknofest follower(*mainPlane, *targetPlane);
+    // Start on the first contact, then let the selector lock on to the best one as they move.
+    TargetSelector selector(*mainPlane, [this](vector<Vehicle *> &contacts) {
+        contacts.clear();
+        const Fleet::View planes = planeList();
+        for (plane *candidate: *planes) {
+            if (!candidate->isMainPlane()) {
+                contacts.push_back(candidate);
+            }
+        }
+    }, [&follower](Vehicle *next) {
+        if (next == nullptr) {
+            LOG_WARN("Target lost, no other contact in reach, holding the last one");
+            return;
+        }
+        follower.setLeader(*next);
+        LOG_INFO("Locked on plane {}", next->getSystemId());
+    }, TargetSelector::Config{});
+    follower.start();
+    selector.start();
+    if (m_followDuration > seconds::zero()) {
+        LOG_INFO("Following for {} s", m_followDuration.count());
+    } else {
+        LOG_INFO("Following until interrupted");
+    }
+    const auto until = m_followDuration > seconds::zero() ? chrono::steady_clock::now() + m_followDuration
+                                                          : chrono::steady_clock::time_point::max();
+    while (!stopRequested.load() && chrono::steady_clock::now() < until) {
+        sleep_for(kStopPoll);
+    }
+    selector.stop();
+    follower.stop();
+
+    const TargetSelector::Stats locks = selector.stats();
+    LOG_INFO("Target switches: {} lost: {} mean/longest lock (s): {} / {}", locks.switches, locks.losses,
+             chrono::duration<double>(locks.meanLock).count(), chrono::duration<double>(locks.longestLock).count());
+
+    const Teknofest::Stats stats = follower.stats();
+    LOG_INFO("Follow ticks: {} overruns: {} missed: {} stale: {}", stats.ticks, stats.overruns,
+             stats.missedTicks, stats.staleTicks);
+    LOG_INFO("Jitter mean/max (us): {} / {}", chrono::duration_cast<chrono::microseconds>(stats.meanJitter).count(),
+             chrono::duration_cast<chrono::microseconds>(stats.maxJitter).count());
 
-    cout << "After Calling Follow\n";
-    cout << mainPlane->getAltitude() << endl;
-    cout << mainPlane->getLatitude() << endl;
-    cout << mainPlane->getLongitude() << endl;
+    LOG_INFO("Plane {}: stopped following at {} m at {}, {}", mainPlane->getSystemId(), mainPlane->getAltitude(),
+             mainPlane->getLatitude(), mainPlane->getLongitude());
 
     mainPlane->stopOffboard();
+    m_recorder.flush();
 
     sleep_for(seconds(3));
-    std::cout << "Finished...\n";
+    LOG_INFO("Finished");
 
     // You can land the plane if you want.
     // mainPlane->land();
 }
 
+/**
+ * Record telemetry and commands of every plane to a flight log
+ * @param path log file, truncated if it exists
+ * @return true if recording
+ * @return false if the log could not be created
+ */
+bool TrackerMain::record(const string &path) {
+    return m_recorder.open(path);
+}
+
+/**
+ * Serve the metrics of every plane and engine over HTTP on localhost
+ * @param port TCP port
+ * @return true if serving
+ * @return false if the port could not be bound
+ */
+bool TrackerMain::serveMetrics(uint16_t port) {
+    return m_metricsServer.start(port);
+}
+
 /**
  * Find the main plane
  * @return plane* the main plane
  */
-plane *TrackerMain::findMainPlane() {
-    for (plane *plane: m_planeList) {
-        if (plane->isMainPlane()) {
-            return plane;
+plane *TrackerMain::findMainPlane() const {
+    return fleet() ? fleet()->mainPlane() : nullptr;
+}
+
+/**
+ * Find a plane by its system id
+ * @param sysid MAVLink system id
+ * @return plane* the plane, nullptr if not registered
+ */
+plane *TrackerMain::findPlane(uint8_t sysid) const {
+    return fleet() ? fleet()->find(sysid) : nullptr;
+}
+
+/**
+ * Find the plane to follow
+ * @return plane* the first connected plane that is not the main plane
+ */
+plane *TrackerMain::findTargetPlane() const {
+    const Fleet::View planes = planeList();
+    for (plane *candidate: *planes) {
+        if (!candidate->isMainPlane()) {
+            return candidate;
         }
     }
     return nullptr;
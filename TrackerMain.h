@@ -22,20 +22,59 @@
 #define TRACKING_TRACKERMAIN_H
 
 
+#include <chrono>
+#include <string>
+#include <vector>
+#include "ConnectionManager.h"
+#include "FlightRecorder.h"
+#include "MetricsServer.h"
 #include "plane.h"
 
 class TrackerMain {
 public:
     void initialize(const string &address, int i);
 
-    std::vector<plane *> planeList() {
-        return m_planeList;
+    void initialize(const std::vector<std::string> &endpoints);
+
+    /**
+     * Record telemetry and commands of every plane to a flight log.
+     * Call before initialize.
+     * @return false if the log could not be created
+     */
+    bool record(const std::string &path);
+
+    /// Serve Prometheus metrics on http://127.0.0.1:port/metrics until the tracker is destroyed.
+    bool serveMetrics(uint16_t port);
+
+    /// Follow for this long, or until requestStop() when zero (the default). Call before initialize.
+    void setFollowDuration(std::chrono::seconds duration) {
+        m_followDuration = duration;
+    };
+
+    /// End the follow session. Only sets a lock-free flag, so a signal handler may call it.
+    static void requestStop();
+
+    /// Connected planes from every link, safe to keep and iterate while the fleet changes.
+    Fleet::View planeList() const {
+        return fleet() ? fleet()->view() : std::make_shared<const std::vector<plane *>>();
     }
 
-    plane *findMainPlane();
+    plane *findMainPlane() const;
+
+    plane *findPlane(uint8_t sysid) const;
 
 private:
-    std::vector<plane *> m_planeList;
+    plane *findTargetPlane() const;
+
+    Fleet *fleet() const {
+        return m_connections.fleet();
+    }
+
+    std::chrono::seconds m_followDuration{0};
+    /// Declared before the connections so it outlives every plane writing to it.
+    FlightRecorder m_recorder;
+    MetricsServer m_metricsServer{Metrics::instance()};
+    ConnectionManager m_connections;
 };
 
 
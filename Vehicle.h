@@ -0,0 +1,71 @@
+// tracking - Vehicle.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_VEHICLE_H
+#define TRACKING_VEHICLE_H
+
+#include "PoseSnapshot.h"
+
+/**
+ * What the follow logic needs from an aircraft: its telemetry and a way to send it setpoints.
+ *
+ * plane implements it on top of the MAVSDK plugins. SimVehicle and ReplayVehicle
+ * implement it in process, so follow logic can run without SITL and on a virtual clock.
+ * Send calls do not wait for the link: plane queues setpoints and sends them
+ * from its own thread (see CommandQueue), so true means accepted, not delivered.
+ */
+class Vehicle {
+public:
+    using Clock = PoseSnapshot::Clock;
+
+    virtual ~Vehicle() = default;
+
+    virtual int getSystemId() const = 0;
+
+    /// Latest telemetry, as received.
+    virtual PoseSnapshot getPose() const = 0;
+
+    /// Latest telemetry with position extrapolated to the given time.
+    virtual PoseSnapshot predictPose(Clock::time_point when) const = 0;
+
+    /// Absolute global position setpoint, altitude above mean sea level.
+    virtual bool sendPositionGlobal(double lat, double lon, float altAmsl, float yawDeg) const = 0;
+
+    /// Velocity setpoint in the NED frame.
+    virtual bool sendVelocityNed(float north_m_s, float east_m_s, float down_m_s, float yawDeg) const = 0;
+
+    /// Global position setpoint with a NED velocity feed-forward, altitude above mean sea level.
+    virtual bool sendPositionVelocity(double lat, double lon, float altAmsl,
+                                      float north_m_s, float east_m_s, float down_m_s, float yawDeg) const = 0;
+
+    /// Share of the vehicle's recent messages lost on the link, [0, 1]; 0 when not measured.
+    virtual double linkLoss() const {
+        return 0.0;
+    };
+
+    /// Stop taking setpoints and loiter where it is, without waiting for the link; false if not supported.
+    virtual bool loiter() {
+        return false;
+    };
+
+    /// Take setpoints again after loiter(), without waiting for the link.
+    virtual bool resume() {
+        return false;
+    };
+};
+
+
+#endif //TRACKING_VEHICLE_H
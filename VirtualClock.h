@@ -0,0 +1,54 @@
+// tracking - VirtualClock.h
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACKING_VIRTUALCLOCK_H
+#define TRACKING_VIRTUALCLOCK_H
+
+#include <chrono>
+#include "Vehicle.h"
+
+/**
+ * Simulation time, only moving when advanced.
+ *
+ * Hands out Vehicle::Clock time points so simulated telemetry, the estimator and
+ * the follow engines all run unchanged, as fast as the CPU allows and with the
+ * same result on every run. Starts one second past the epoch, because a zero
+ * time point means "no fix" in a PoseSnapshot.
+ */
+class VirtualClock {
+public:
+    using Clock = Vehicle::Clock;
+
+    Clock::time_point now() const {
+        return current;
+    };
+
+    void advance(Clock::duration step) {
+        current += step;
+    };
+
+    /// Time simulated so far.
+    Clock::duration elapsed() const {
+        return current - start;
+    };
+
+private:
+    const Clock::time_point start{std::chrono::seconds(1)};
+    Clock::time_point current{start};
+};
+
+
+#endif //TRACKING_VIRTUALCLOCK_H
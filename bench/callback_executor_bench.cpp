@@ -0,0 +1,125 @@
+// tracking - callback_executor_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Plays a receive thread delivering telemetry for a fleet, one sample per
+// vehicle every millisecond, where one vehicle's
+// handler is occasionally slow, first running the handlers inline (what a
+// MAVSDK subscription callback does) and then posting them to a
+// CallbackExecutor. Prints how long the receive thread is held per sample and
+// checks that every vehicle's samples ran in order.
+//
+// Usage: callback_executor_bench
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "../CallbackExecutor.h"
+
+using namespace std;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+constexpr size_t kVehicles = 30;
+constexpr uint64_t kSamples = 2000;
+constexpr size_t kSlowVehicle = 7;
+constexpr uint64_t kSlowEvery = 200;
+constexpr auto kSlowFor = chrono::milliseconds(2);
+constexpr auto kRound = chrono::milliseconds(1);
+
+struct Vehicle {
+    uint64_t last{};
+    uint64_t outOfOrder{};
+};
+
+/// What a telemetry handler does: check the sequence, now and then stall.
+void handle(Vehicle &vehicle, size_t id, uint64_t sequence) {
+    if (sequence != vehicle.last + 1) {
+        ++vehicle.outOfOrder;
+    }
+    vehicle.last = sequence;
+    if (id == kSlowVehicle && sequence % kSlowEvery == 0) {
+        this_thread::sleep_for(kSlowFor);
+    }
+}
+
+/// Samples that held the receive thread for a millisecond or more, a full delivery round.
+uint64_t stalls(const Histogram::Snapshot &snapshot) {
+    uint64_t count = 0;
+    for (size_t b = Histogram::bucketOf(1000); b < snapshot.counts.size(); ++b) {
+        count += snapshot.counts[b];
+    }
+    return count;
+}
+
+void report(const char *name, Histogram &held) {
+    const Histogram::Snapshot snapshot = held.snapshot();
+    printf("%-9s receive thread held per sample: p50 %llu us  p99 %llu us  max %llu us, %llu stalls >= 1 ms\n",
+           name, static_cast<unsigned long long>(snapshot.percentile(0.5)),
+           static_cast<unsigned long long>(snapshot.percentile(0.99)),
+           static_cast<unsigned long long>(snapshot.max), static_cast<unsigned long long>(stalls(snapshot)));
+}
+
+template<typename Deliver>
+void receive(Histogram &held, Deliver &&deliver) {
+    auto next = Clock::now();
+    for (uint64_t sequence = 1; sequence <= kSamples; ++sequence) {
+        for (size_t id = 0; id < kVehicles; ++id) {
+            const auto start = Clock::now();
+            deliver(id, sequence);
+            held.record(Clock::now() - start);
+        }
+        next += kRound;
+        this_thread::sleep_until(next);
+    }
+}
+}
+
+int main() {
+    Metrics &metrics = Metrics::instance();
+
+    array<Vehicle, kVehicles> inlineFleet{};
+    Histogram &inlineHeld = metrics.histogram("bench_inline_seconds", "inline handlers");
+    receive(inlineHeld, [&inlineFleet](size_t id, uint64_t sequence) {
+        handle(inlineFleet[id], id, sequence);
+    });
+    report("inline", inlineHeld);
+
+    array<Vehicle, kVehicles> postedFleet{};
+    Histogram &postedHeld = metrics.histogram("bench_posted_seconds", "posted handlers");
+    CallbackExecutor executor(4);
+    receive(postedHeld, [&executor, &postedFleet](size_t id, uint64_t sequence) {
+        executor.post(id, [&postedFleet, id, sequence] {
+            handle(postedFleet[id], id, sequence);
+        });
+    });
+    for (size_t id = 0; id < kVehicles; ++id) {
+        executor.flush(id);
+    }
+    report("executor", postedHeld);
+
+    uint64_t outOfOrder = 0;
+    uint64_t handled = 0;
+    for (const Vehicle &vehicle: postedFleet) {
+        outOfOrder += vehicle.outOfOrder;
+        handled += vehicle.last;
+    }
+    printf("executor: %llu of %llu samples handled, %llu out of order\n",
+           static_cast<unsigned long long>(handled), static_cast<unsigned long long>(kVehicles * kSamples),
+           static_cast<unsigned long long>(outOfOrder));
+    return outOfOrder == 0 && handled == kVehicles * kSamples ? 0 : 1;
+}
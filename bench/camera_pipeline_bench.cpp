@@ -0,0 +1,216 @@
+// tracking - camera_pipeline_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Runs CameraPipeline against a simulated camera on an aircraft flying east at
+// 20 m/s with 10 Hz position fixes, in real time. A responsive camera is
+// triggered by distance; a slow one (1.5 s per photo) by a 4 Hz timer it
+// cannot keep up with. Reports what the telemetry thread pays per fix, the
+// trigger counts and spacing, and how far each geotag is from where the
+// aircraft really was at the capture.
+//
+// Usage: camera_pipeline_bench [file]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../CameraPipeline.h"
+#include "../Geodesy.h"
+
+using namespace std;
+
+namespace {
+using Clock = CameraPipeline::Clock;
+
+constexpr double kSpeed_m_s = 20.0;
+const geodesy::Geodetic kOrigin{40.9, 29.3, 150.0};
+
+/// Takes one photo at a time: exposes, answers the trigger, then reports the capture.
+class FakeCamera {
+public:
+    FakeCamera(CameraPipeline &pipeline, Clock::duration busyFor)
+            : pipeline(pipeline), busyFor(busyFor), worker(&FakeCamera::run, this) {
+    }
+
+    ~FakeCamera() {
+        {
+            lock_guard<mutex> lock(mutex_);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    bool trigger(uint64_t number) {
+        {
+            lock_guard<mutex> lock(mutex_);
+            requests.push_back({number, Clock::now()});
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    /// Monotonic capture time of each image index.
+    vector<Clock::time_point> captured;
+
+private:
+    void run() {
+        unique_lock<mutex> lock(mutex_);
+        for (;;) {
+            wake.wait(lock, [this] { return stopping || !requests.empty(); });
+            if (stopping) {
+                return;
+            }
+            const auto [number, requested] = requests.front();
+            requests.pop_front();
+            lock.unlock();
+            const Clock::time_point exposure = requested + chrono::milliseconds(20);
+            this_thread::sleep_until(exposure);
+            const auto utc = chrono::system_clock::now();
+            const Clock::time_point when = Clock::now();
+            this_thread::sleep_until(requested + busyFor);
+            pipeline.onTriggerResult(number, true);
+            CameraPipeline::Capture capture;
+            capture.index = static_cast<int32_t>(captured.size());
+            capture.time_utc_us = static_cast<uint64_t>(
+                    chrono::duration_cast<chrono::microseconds>(utc.time_since_epoch()).count());
+            capture.success = true;
+            capture.received = Clock::now();
+            capture.fileUrl = "IMG_" + to_string(capture.index) + ".jpg";
+            captured.push_back(when);
+            pipeline.submitCapture(std::move(capture));
+            lock.lock();
+        }
+    }
+
+    CameraPipeline &pipeline;
+    const Clock::duration busyFor;
+    mutex mutex_;
+    condition_variable wake;
+    deque<pair<uint64_t, Clock::time_point>> requests;
+    bool stopping{false};
+    thread worker;
+};
+
+/// Each scenario gets its own system id, the counters behind the stats are per id.
+void scenario(int sysid, const char *name, const CameraPipeline::Config &config, Clock::duration busyFor,
+              const string &path) {
+    remove(path.c_str());
+    CameraPipeline pipeline(sysid);
+    FakeCamera camera(pipeline, busyFor);
+    const Clock::time_point start = Clock::now();
+    pipeline.start(config, [&camera](uint64_t trigger) { return camera.trigger(trigger); }, path);
+
+    // Telemetry: 10 Hz fixes of an aircraft flying east.
+    double worstRecord = 0.0;
+    double totalRecord = 0.0;
+    int fixes = 0;
+    auto next = start;
+    while (Clock::now() - start < chrono::seconds(10)) {
+        next += chrono::milliseconds(100);
+        this_thread::sleep_until(next);
+        const Clock::time_point now = Clock::now();
+        const double east = kSpeed_m_s * chrono::duration<double>(now - start).count();
+        const geodesy::Geodetic position = geodesy::offset(kOrigin, 0.0, east, 0.0);
+        PoseSnapshot pose;
+        pose.latitude_deg = position.latitude_deg;
+        pose.longitude_deg = position.longitude_deg;
+        pose.absolute_altitude_m = position.altitude_m;
+        pose.east_m_s = static_cast<float>(kSpeed_m_s);
+        pose.yaw_deg = 90.0f;
+        pose.positionTime = now;
+        const auto before = Clock::now();
+        pipeline.recordPose(pose);
+        const double spent = chrono::duration<double, micro>(Clock::now() - before).count();
+        worstRecord = max(worstRecord, spent);
+        totalRecord += spent;
+        ++fixes;
+    }
+    // Let the last photo finish before stopping.
+    this_thread::sleep_for(busyFor + chrono::milliseconds(100));
+    pipeline.stop();
+    const CameraPipeline::Stats stats = pipeline.stats();
+
+    const geodesy::LocalFrame frame(kOrigin);
+    ifstream in(path);
+    string line;
+    getline(in, line);
+    double worstError = 0.0;
+    double totalError = 0.0;
+    vector<double> eastings;
+    while (getline(in, line)) {
+        vector<string> fields;
+        stringstream split(line);
+        string field;
+        while (getline(split, field, ',')) {
+            fields.push_back(field);
+        }
+        if (fields.size() < 13 || fields[4].empty()) {
+            continue;
+        }
+        const auto index = static_cast<size_t>(stoi(fields[1]));
+        const double east = frame.toNed({stod(fields[4]), stod(fields[5]), stod(fields[6])}).east;
+        const double truth = kSpeed_m_s * chrono::duration<double>(camera.captured[index] - start).count();
+        worstError = max(worstError, fabs(east - truth));
+        totalError += fabs(east - truth);
+        eastings.push_back(east);
+    }
+    double minSpacing = 1e9;
+    double maxSpacing = 0.0;
+    for (size_t i = 1; i < eastings.size(); ++i) {
+        minSpacing = min(minSpacing, eastings[i] - eastings[i - 1]);
+        maxSpacing = max(maxSpacing, eastings[i] - eastings[i - 1]);
+    }
+
+    printf("%s\n", name);
+    printf("  triggered %llu, acknowledged %llu, busy %llu, failed %llu\n",
+           static_cast<unsigned long long>(stats.triggered), static_cast<unsigned long long>(stats.acknowledged),
+           static_cast<unsigned long long>(stats.busy), static_cast<unsigned long long>(stats.failed));
+    printf("  captures %llu, written %llu, unmatched %llu, dropped %llu\n",
+           static_cast<unsigned long long>(stats.captures), static_cast<unsigned long long>(stats.written),
+           static_cast<unsigned long long>(stats.unmatched), static_cast<unsigned long long>(stats.dropped));
+    printf("  recordPose: mean %.2f us, max %.2f us over %d fixes\n", totalRecord / fixes, worstRecord, fixes);
+    if (!eastings.empty()) {
+        printf("  geotag error: mean %.2f m, max %.2f m (10 Hz fixes at %.0f m/s)\n",
+               totalError / static_cast<double>(eastings.size()), worstError, kSpeed_m_s);
+    }
+    if (eastings.size() > 1) {
+        printf("  photo spacing: %.1f .. %.1f m\n", minSpacing, maxSpacing);
+    }
+}
+}
+
+int main(int argc, char **argv) {
+    const string path = argc > 1 ? argv[1] : "camera_pipeline_bench.csv";
+
+    CameraPipeline::Config byDistance;
+    byDistance.distance_m = 25.0;
+    scenario(1, "every 25 m, camera busy 300 ms per photo", byDistance, chrono::milliseconds(300), path);
+
+    CameraPipeline::Config byTime;
+    byTime.interval = chrono::milliseconds(250);
+    scenario(2, "every 250 ms, camera busy 1.5 s per photo", byTime, chrono::milliseconds(1500), path);
+    return 0;
+}
@@ -0,0 +1,96 @@
+// tracking - command_queue_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Measures what a caller pays for CommandQueue::submit, then drives a queue
+// the way a 50 Hz follow loop would against a slow link (a sender that takes
+// 5 ms, rate capped at 20 Hz) and checks the send rate, the coalescing, and
+// the keep-alive resends once the loop goes quiet.
+//
+// Usage: command_queue_bench
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "../CommandQueue.h"
+
+using namespace std;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+constexpr int kSubmits = 1000000;
+
+double rate(uint64_t count, Clock::duration elapsed) {
+    return static_cast<double>(count) / chrono::duration<double>(elapsed).count();
+}
+}
+
+int main() {
+    {
+        CommandQueue queue(CommandQueue::Config{}, [](const OutboundCommand &) {
+            return true;
+        }, "bench=\"submit\"");
+        queue.start();
+        OutboundCommand command;
+        const auto start = Clock::now();
+        for (int i = 0; i < kSubmits; ++i) {
+            command.yaw_deg = static_cast<float>(i);
+            queue.submit(command);
+        }
+        printf("submit:      %.1f ns\n",
+               chrono::duration<double, nano>(Clock::now() - start).count() / kSubmits);
+    }
+
+    atomic<uint64_t> delivered{0};
+    CommandQueue::Config config;
+    config.maxRate_hz = 20.0;
+    config.keepAlive_hz = 4.0;
+    CommandQueue queue(config, [&delivered](const OutboundCommand &) {
+        this_thread::sleep_for(chrono::milliseconds(5));
+        delivered.fetch_add(1, memory_order_relaxed);
+        return true;
+    }, "bench=\"link\"");
+    queue.setKeepAlive(CommandQueue::Channel::Offboard, true);
+    queue.start();
+
+    const auto busy = chrono::seconds(3);
+    const auto start = Clock::now();
+    auto next = start;
+    OutboundCommand command;
+    command.kind = OutboundCommand::Kind::VelocityNed;
+    while (Clock::now() - start < busy) {
+        queue.submit(command);
+        next += chrono::milliseconds(20);
+        this_thread::sleep_until(next);
+    }
+    const CommandQueue::Stats loaded = queue.stats();
+    printf("50 Hz loop:  %.1f Hz sent (cap %.0f), %llu submitted, %llu coalesced\n",
+           rate(delivered.load(), busy), config.maxRate_hz,
+           static_cast<unsigned long long>(loaded.submitted), static_cast<unsigned long long>(loaded.coalesced));
+
+    const uint64_t before = delivered.load();
+    const auto quiet = chrono::seconds(2);
+    this_thread::sleep_for(quiet);
+    const CommandQueue::Stats idle = queue.stats();
+    printf("idle:        %.1f Hz keep-alive (min %.0f), %llu resends\n",
+           rate(delivered.load() - before, quiet), config.keepAlive_hz,
+           static_cast<unsigned long long>(idle.keepAlives));
+    queue.stop();
+    const bool capped = rate(before, busy) <= config.maxRate_hz * 1.05;
+    const bool alive = rate(delivered.load() - before, quiet) >= CommandQueue::kMinKeepAliveHz;
+    return capped && alive ? 0 : 1;
+}
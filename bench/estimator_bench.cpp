@@ -0,0 +1,230 @@
+// tracking - estimator_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Replays a leader track through a delayed, noisy telemetry link and reports
+// how far the follow setpoint is from the leader's true position, with and
+// without the LeaderEstimator prediction. "predicted" uses the default config
+// as plane does (100 ms assumed latency, whatever the link really has);
+// "matched latency" is the best case, with the true link latency configured.
+//
+// Usage: estimator_bench [track.csv]
+// CSV columns: time_s,latitude_deg,longitude_deg,altitude_m,north_m_s,east_m_s,down_m_s
+// Without a file a synthetic fixed-wing track (straights and 300 m turns at 25 m/s) is used.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../Geodesy.h"
+#include "../LeaderEstimator.h"
+
+using namespace std;
+
+using geodesy::kPi;
+
+namespace {
+
+struct Sample {
+    double time_s;
+    double latitude_deg;
+    double longitude_deg;
+    double altitude_m;
+    double north_m_s;
+    double east_m_s;
+    double down_m_s;
+};
+
+vector<Sample> loadTrack(const string &path) {
+    vector<Sample> track;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#' || line[0] == 't') {
+            continue;
+        }
+        replace(line.begin(), line.end(), ',', ' ');
+        istringstream fields(line);
+        Sample s{};
+        if (fields >> s.time_s >> s.latitude_deg >> s.longitude_deg >> s.altitude_m
+                   >> s.north_m_s >> s.east_m_s >> s.down_m_s) {
+            track.push_back(s);
+        }
+    }
+    return track;
+}
+
+vector<Sample> syntheticTrack() {
+    vector<Sample> track;
+    const double speed = 25.0;
+    const double radius = 300.0;
+    const double dt = 0.01;
+    const geodesy::LocalFrame origin({40.0, 29.0, 0.0});
+    double north = 0.0, east = 0.0, heading = 0.0, alt = 100.0;
+    for (double t = 0.0; t < 600.0; t += dt) {
+        // 20 s straight, then a 180 degree turn, alternating direction.
+        const double phase = fmod(t, 2 * (20.0 + kPi * radius / speed));
+        const double turnStart = 20.0;
+        const double turnEnd = turnStart + kPi * radius / speed;
+        double turnRate = 0.0;
+        if (phase >= turnStart && phase < turnEnd) {
+            turnRate = speed / radius;
+        } else if (phase >= turnEnd + 20.0) {
+            turnRate = -speed / radius;
+        }
+        const double climb = 2.0 * sin(t / 15.0);
+        heading += turnRate * dt;
+        const double vn = speed * cos(heading);
+        const double ve = speed * sin(heading);
+        north += vn * dt;
+        east += ve * dt;
+        alt += climb * dt;
+        const geodesy::Geodetic position = origin.fromNed({north, east, -alt});
+        track.push_back({t, position.latitude_deg, position.longitude_deg, position.altitude_m, vn, ve, -climb});
+    }
+    return track;
+}
+
+Sample truthAt(const vector<Sample> &track, double t) {
+    auto it = lower_bound(track.begin(), track.end(), t,
+                          [](const Sample &s, double time) { return s.time_s < time; });
+    if (it == track.begin()) {
+        return track.front();
+    }
+    if (it == track.end()) {
+        return track.back();
+    }
+    const Sample &b = *it;
+    const Sample &a = *(it - 1);
+    const double w = (t - a.time_s) / (b.time_s - a.time_s);
+    Sample s{};
+    s.time_s = t;
+    s.latitude_deg = a.latitude_deg + w * (b.latitude_deg - a.latitude_deg);
+    s.longitude_deg = a.longitude_deg + w * (b.longitude_deg - a.longitude_deg);
+    s.altitude_m = a.altitude_m + w * (b.altitude_m - a.altitude_m);
+    return s;
+}
+
+double distance_m(double lat1, double lon1, double alt1, double lat2, double lon2, double alt2) {
+    return geodesy::distance({lat1, lon1, alt1}, {lat2, lon2, alt2});
+}
+
+struct ErrorStats {
+    vector<double> errors;
+
+    void print(const char *label) {
+        sort(errors.begin(), errors.end());
+        double sum = 0.0, sumSq = 0.0;
+        for (double e: errors) {
+            sum += e;
+            sumSq += e * e;
+        }
+        const double n = static_cast<double>(errors.size());
+        printf("  %-16s mean %7.2f m  rms %7.2f m  p95 %7.2f m  max %7.2f m\n", label,
+               sum / n, sqrt(sumSq / n), errors[static_cast<size_t>(0.95 * (n - 1))], errors.back());
+    }
+};
+
+void run(const vector<Sample> &track, double latency_s, double telemetryRateHz, double commandRateHz) {
+    using Clock = LeaderEstimator::Clock;
+    const Clock::time_point base = Clock::time_point{} + chrono::seconds(1);
+    auto at = [base](double seconds) {
+        return base + chrono::duration_cast<Clock::duration>(chrono::duration<double>(seconds));
+    };
+
+    LeaderEstimator estimator(LeaderEstimator::Config{});
+    LeaderEstimator::Config matchedConfig;
+    matchedConfig.telemetryLatency = chrono::duration_cast<Clock::duration>(chrono::duration<double>(latency_s));
+    LeaderEstimator matchedEstimator(matchedConfig);
+
+    mt19937 rng(42);
+    normal_distribution<double> positionNoise(0.0, 1.5);
+    normal_distribution<double> velocityNoise(0.0, 0.3);
+
+    const double start = track.front().time_s;
+    const double end = track.back().time_s;
+    const double telemetryPeriod = 1.0 / telemetryRateHz;
+    const double commandPeriod = 1.0 / commandRateHz;
+
+    double nextTelemetry = start;   // measurement time of the next fix
+    double nextCommand = start + 5.0; // let the filter settle
+    Sample lastFix{};
+    bool haveFix = false;
+    ErrorStats raw, predicted, matched;
+
+    while (nextCommand < end) {
+        // Deliver every fix whose arrival time (measurement + latency) is before the command.
+        while (nextTelemetry + latency_s <= nextCommand) {
+            Sample fix = truthAt(track, nextTelemetry);
+            const Sample &nearest = *lower_bound(track.begin(), track.end() - 1, nextTelemetry,
+                                                 [](const Sample &s, double time) { return s.time_s < time; });
+            const double noiseN = positionNoise(rng), noiseE = positionNoise(rng), noiseD = positionNoise(rng);
+            const geodesy::Geodetic noisy = geodesy::offset({fix.latitude_deg, fix.longitude_deg, fix.altitude_m},
+                                                            noiseN, noiseE, -noiseD);
+            fix.latitude_deg = noisy.latitude_deg;
+            fix.longitude_deg = noisy.longitude_deg;
+            fix.altitude_m = noisy.altitude_m;
+            const Clock::time_point arrival = at(nextTelemetry + latency_s);
+            const double north = nearest.north_m_s + velocityNoise(rng);
+            const double east = nearest.east_m_s + velocityNoise(rng);
+            const double down = nearest.down_m_s + velocityNoise(rng);
+            for (LeaderEstimator *filter: {&estimator, &matchedEstimator}) {
+                filter->updatePosition(fix.latitude_deg, fix.longitude_deg, fix.altitude_m, arrival);
+                filter->updateVelocity(north, east, down, arrival);
+            }
+            lastFix = fix;
+            haveFix = true;
+            nextTelemetry += telemetryPeriod;
+        }
+        if (haveFix) {
+            const Sample truth = truthAt(track, nextCommand);
+            raw.errors.push_back(distance_m(truth.latitude_deg, truth.longitude_deg, truth.altitude_m,
+                                            lastFix.latitude_deg, lastFix.longitude_deg, lastFix.altitude_m));
+            const PoseSnapshot estimate = estimator.predict(at(nextCommand));
+            predicted.errors.push_back(distance_m(truth.latitude_deg, truth.longitude_deg, truth.altitude_m,
+                                                  estimate.latitude_deg, estimate.longitude_deg,
+                                                  estimate.absolute_altitude_m));
+            const PoseSnapshot best = matchedEstimator.predict(at(nextCommand));
+            matched.errors.push_back(distance_m(truth.latitude_deg, truth.longitude_deg, truth.altitude_m,
+                                                best.latitude_deg, best.longitude_deg, best.absolute_altitude_m));
+        }
+        nextCommand += commandPeriod;
+    }
+
+    printf("latency %3.0f ms, telemetry %.0f Hz, commands %.0f Hz\n", latency_s * 1000.0, telemetryRateHz,
+           commandRateHz);
+    raw.print("last fix");
+    predicted.print("predicted");
+    matched.print("matched latency");
+}
+}
+
+int main(int argc, char **argv) {
+    vector<Sample> track = argc > 1 ? loadTrack(argv[1]) : syntheticTrack();
+    if (track.size() < 2) {
+        cerr << "Track needs at least two samples\n";
+        return 1;
+    }
+    printf("%zu track samples over %.1f s\n", track.size(), track.back().time_s - track.front().time_s);
+    for (double latency: {0.1, 0.2, 0.3}) {
+        run(track, latency, 10.0, 50.0);
+    }
+    return 0;
+}
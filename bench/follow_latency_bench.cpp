@@ -0,0 +1,143 @@
+// tracking - follow_latency_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// End-to-end telemetry-to-command latency of the follow path, on loopback.
+//
+// Starts mock_autopilot, connects to it the way TrackerMain does (one MAVSDK
+// instance, a Fleet, a Teknofest engine from system 1 to system 2) and follows
+// for the given time. The mock timestamps both ends and prints the percentiles:
+// MAVSDK receive and callbacks, plane snapshots, the tick wait, the command
+// queue hand-off and the send. The queue's rate cap is set to the tick rate so
+// that no setpoint is held back for rate limiting.
+// Prediction is off so the command altitude identifies the telemetry sample.
+//
+// Usage: follow_latency_bench [--systems N] [--rate HZ] [--tick HZ] [--duration S] [--port P]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <vector>
+#include "../ConnectionManager.h"
+#include "../Teknofest.h"
+
+using namespace std;
+
+extern char **environ;
+
+namespace {
+constexpr uint8_t kFollowerId = 1;
+constexpr uint8_t kLeaderId = 2;
+/// Discovery and plane construction, on top of the measured time.
+constexpr int kSetup_s = 10;
+}
+
+int main(int argc, char **argv) {
+    string systems = "2";
+    string rate = "50";
+    string port = "14540";
+    int tickHz = 50;
+    int duration_s = 30;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const string arg = argv[i];
+        if (arg == "--systems") {
+            systems = argv[i + 1];
+        } else if (arg == "--rate") {
+            rate = argv[i + 1];
+        } else if (arg == "--port") {
+            port = argv[i + 1];
+        } else if (arg == "--tick") {
+            tickHz = atoi(argv[i + 1]);
+        } else if (arg == "--duration") {
+            duration_s = atoi(argv[i + 1]);
+        } else {
+            fprintf(stderr, "Usage: %s [--systems N] [--rate HZ] [--tick HZ] [--duration S] [--port P]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (atoi(systems.c_str()) < 2) {
+        fprintf(stderr, "need at least a follower and a leader\n");
+        return 2;
+    }
+
+    ConnectionManager connections;
+    if (!connections.addEndpoint("udp://:" + port)) {
+        fprintf(stderr, "could not listen on udp port %s\n", port.c_str());
+        return 1;
+    }
+
+    const string mockDuration = to_string(duration_s + kSetup_s);
+    vector<string> mockArgs{MOCK_AUTOPILOT_PATH, "--systems", systems, "--rate", rate, "--port", port,
+                            "--duration", mockDuration};
+    vector<char *> mockArgv;
+    for (string &arg: mockArgs) {
+        mockArgv.push_back(arg.data());
+    }
+    mockArgv.push_back(nullptr);
+    pid_t mock{};
+    if (posix_spawn(&mock, MOCK_AUTOPILOT_PATH, nullptr, nullptr, mockArgv.data(), environ) != 0) {
+        perror("posix_spawn " MOCK_AUTOPILOT_PATH);
+        return 1;
+    }
+
+    const auto setupEnd = chrono::steady_clock::now() + chrono::seconds(kSetup_s);
+    if (!connections.waitForAutopilot(kSetup_s)) {
+        fprintf(stderr, "mock autopilot did not show up\n");
+        waitpid(mock, nullptr, 0);
+        return 1;
+    }
+    TelemetryRates rates;
+    rates.position_hz = atof(rate.c_str());
+    rates.attitude_hz = rates.position_hz;
+    CommandQueue::Config commandRates;
+    commandRates.maxRate_hz = tickHz;
+    Fleet &fleet = connections.createFleet(kFollowerId, rates, commandRates);
+    while ((fleet.find(kFollowerId) == nullptr || fleet.find(kLeaderId) == nullptr)
+           && chrono::steady_clock::now() < setupEnd) {
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    plane *follower = fleet.find(kFollowerId);
+    plane *leader = fleet.find(kLeaderId);
+    if (follower == nullptr || leader == nullptr) {
+        fprintf(stderr, "planes were not discovered in %d s\n", kSetup_s);
+        waitpid(mock, nullptr, 0);
+        return 1;
+    }
+
+    Teknofest::Config config;
+    config.rateHz = tickHz;
+    config.usePrediction = false;
+    {
+        Teknofest engine(*follower, *leader, config);
+        engine.start();
+        this_thread::sleep_for(chrono::seconds(duration_s));
+        engine.stop();
+        const Teknofest::Stats stats = engine.stats();
+        printf("follow: %d Hz, %llu ticks, %llu overruns, %llu stale, mean jitter %lld us\n", tickHz,
+               static_cast<unsigned long long>(stats.ticks), static_cast<unsigned long long>(stats.overruns),
+               static_cast<unsigned long long>(stats.staleTicks),
+               static_cast<long long>(chrono::duration_cast<chrono::microseconds>(stats.meanJitter).count()));
+        fflush(stdout);
+    }
+
+    // The mock prints its report when its own time runs out.
+    int status = 0;
+    waitpid(mock, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -0,0 +1,256 @@
+// tracking - formation_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Per-tick cost of separation checks as the formation grows. First the
+// neighbour queries alone: move every aircraft, then ask each one for the
+// others within the separation distance, with the SpatialIndex and with the
+// pairwise O(N^2) loop, checking both find the same pairs and that nearest()
+// agrees with a sort. Then whole FormationDispatcher ticks on simulated
+// aircraft that join up from scrambled positions, with separation off and on,
+// and the closest true distance between any two aircraft during the join-up.
+//
+// Usage: formation_bench
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+#include "../FormationDispatcher.h"
+#include "../SimVehicle.h"
+#include "../SpatialIndex.h"
+#include "../VirtualClock.h"
+
+using namespace std;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+constexpr double kSeparation_m = 40.0;
+/// Slot spacing, and the density of the random fleets: about one aircraft per square of this side.
+constexpr double kSpacing_m = 60.0;
+
+struct Moving {
+    vector<SpatialIndex::Point> position;
+    vector<SpatialIndex::Point> velocity;
+};
+
+Moving makeFleet(size_t size, mt19937 &rng) {
+    const double side = kSpacing_m * sqrt(static_cast<double>(size));
+    uniform_real_distribution<double> horizontal(0.0, side);
+    uniform_real_distribution<double> vertical(-20.0, 20.0);
+    uniform_real_distribution<double> speed(-3.0, 3.0);
+    Moving fleet;
+    for (size_t i = 0; i < size; ++i) {
+        fleet.position.push_back({horizontal(rng), horizontal(rng), vertical(rng)});
+        fleet.velocity.push_back({speed(rng), speed(rng), 0.0});
+    }
+    return fleet;
+}
+
+void move(Moving &fleet, double dt) {
+    for (size_t i = 0; i < fleet.position.size(); ++i) {
+        fleet.position[i].north += fleet.velocity[i].north * dt;
+        fleet.position[i].east += fleet.velocity[i].east * dt;
+    }
+}
+
+double distance(const SpatialIndex::Point &a, const SpatialIndex::Point &b) {
+    return sqrt((a.north - b.north) * (a.north - b.north) + (a.east - b.east) * (a.east - b.east)
+                + (a.down - b.down) * (a.down - b.down));
+}
+
+/// Checks the index against brute force on the fleet as it is now. Returns the mismatches.
+size_t verify(const SpatialIndex &index, const Moving &fleet) {
+    const size_t n = fleet.position.size();
+    size_t mismatches = 0;
+    vector<SpatialIndex::Neighbour> found;
+    for (uint32_t i = 0; i < n; ++i) {
+        index.withinRadius(fleet.position[i], kSeparation_m, found, i);
+        vector<uint32_t> indexed;
+        for (const auto &neighbour: found) {
+            indexed.push_back(neighbour.id);
+        }
+        sort(indexed.begin(), indexed.end());
+        vector<uint32_t> brute;
+        vector<double> all;
+        for (uint32_t j = 0; j < n; ++j) {
+            if (j == i) {
+                continue;
+            }
+            const double d = distance(fleet.position[i], fleet.position[j]);
+            all.push_back(d);
+            if (d <= kSeparation_m) {
+                brute.push_back(j);
+            }
+        }
+        mismatches += indexed == brute ? 0 : 1;
+
+        const size_t k = min<size_t>(4, all.size());
+        partial_sort(all.begin(), all.begin() + static_cast<long>(k), all.end());
+        index.nearest(fleet.position[i], k, found, i);
+        bool same = found.size() == k;
+        for (size_t j = 0; same && j < k; ++j) {
+            same = fabs(found[j].distance_m - all[j]) < 1e-9;
+        }
+        mismatches += same ? 0 : 1;
+    }
+    return mismatches;
+}
+
+void queries() {
+    mt19937 rng(11);
+    printf("neighbour queries, %.0f m separation, per tick (move all, query all)\n", kSeparation_m);
+    printf("%8s %12s %12s %10s %10s\n", "aircraft", "pairwise", "index", "pairs", "mismatch");
+    for (size_t size: {25, 50, 100, 200}) {
+        Moving fleet = makeFleet(size, rng);
+        SpatialIndex index(kSeparation_m, size);
+        vector<SpatialIndex::Neighbour> found;
+        found.reserve(size);
+        const int ticks = static_cast<int>(4000000 / (size * size)) + 100;
+
+        size_t pairs = 0;
+        auto start = Clock::now();
+        for (int t = 0; t < ticks; ++t) {
+            move(fleet, 0.05);
+            pairs = 0;
+            for (size_t i = 0; i < size; ++i) {
+                found.clear();
+                for (size_t j = 0; j < size; ++j) {
+                    const double d = distance(fleet.position[i], fleet.position[j]);
+                    if (j != i && d <= kSeparation_m) {
+                        found.push_back({static_cast<uint32_t>(j), d});
+                    }
+                }
+                pairs += found.size();
+            }
+        }
+        const double pairwise = chrono::duration<double, micro>(Clock::now() - start).count() / ticks;
+
+        start = Clock::now();
+        for (int t = 0; t < ticks; ++t) {
+            move(fleet, 0.05);
+            for (uint32_t i = 0; i < size; ++i) {
+                index.update(i, fleet.position[i]);
+            }
+            pairs = 0;
+            for (uint32_t i = 0; i < size; ++i) {
+                index.withinRadius(fleet.position[i], kSeparation_m, found, i);
+                pairs += found.size();
+            }
+        }
+        const double indexed = chrono::duration<double, micro>(Clock::now() - start).count() / ticks;
+
+        printf("%8zu %9.1f us %9.1f us %10zu %10zu\n", size, pairwise, indexed, pairs / 2, verify(index, fleet));
+    }
+}
+
+struct Run {
+    double tick_us{};
+    double closest_m{};
+    uint64_t adjustments{};
+};
+
+/**
+ * Followers start scattered over the area behind the leader and join a grid of
+ * slots kSpacing_m apart, so their paths cross on the way in.
+ */
+Run formation(size_t size, double minSeparation_m, FormationDispatcher::Mode mode) {
+    const geodesy::LocalFrame world({40.9, 29.3, 0.0});
+    VirtualClock clock;
+    SimVehicle::State leaderStart;
+    leaderStart.altitude_m = 150.0;
+    SimVehicle leader(1, world, leaderStart);
+
+    mt19937 rng(5);
+    const auto columns = static_cast<size_t>(ceil(sqrt(static_cast<double>(size))));
+    const double depth = kSpacing_m * static_cast<double>(columns);
+    uniform_real_distribution<double> along(-2.0 * depth, -kSpacing_m);
+    uniform_real_distribution<double> across(-depth, depth);
+    uniform_real_distribution<double> height(-10.0, 10.0);
+    vector<unique_ptr<SimVehicle>> followers;
+    FormationDispatcher::Config config;
+    config.minSeparation_m = minSeparation_m;
+    config.mode = mode;
+    FormationDispatcher dispatcher(leader, config);
+    for (size_t i = 0; i < size; ++i) {
+        SimVehicle::State start;
+        start.north_m = along(rng);
+        start.east_m = across(rng);
+        start.altitude_m = 150.0 + height(rng);
+        followers.push_back(make_unique<SimVehicle>(static_cast<int>(i + 2), world, start));
+        const double row = static_cast<double>(i / columns + 1);
+        const double column = static_cast<double>(i % columns) - static_cast<double>(columns - 1) / 2.0;
+        dispatcher.addFollower(*followers.back(), -kSpacing_m * row, kSpacing_m * column, 0.0);
+    }
+
+    Run run;
+    run.closest_m = 1e9;
+    Clock::duration spent{};
+    const auto period = chrono::milliseconds(50);
+    int ticks = 0;
+    // Two minutes: long enough for everyone to reach their slot.
+    while (clock.elapsed() < chrono::seconds(120)) {
+        clock.advance(period);
+        leader.step(clock.now());
+        for (auto &follower: followers) {
+            follower->step(clock.now());
+        }
+        const auto start = Clock::now();
+        dispatcher.tick(clock.now());
+        spent += Clock::now() - start;
+        ++ticks;
+
+        if (clock.elapsed() > chrono::seconds(5)) {
+            // After the first seconds, the spawn positions themselves can be close.
+            vector<geodesy::Ned> truth;
+            for (auto &follower: followers) {
+                const PoseSnapshot pose = follower->truth();
+                truth.push_back(world.toNed({pose.latitude_deg, pose.longitude_deg, pose.absolute_altitude_m}));
+            }
+            for (size_t i = 0; i < truth.size(); ++i) {
+                for (size_t j = i + 1; j < truth.size(); ++j) {
+                    run.closest_m = min(run.closest_m, distance({truth[i].north, truth[i].east, truth[i].down},
+                                                                {truth[j].north, truth[j].east, truth[j].down}));
+                }
+            }
+        }
+    }
+    run.tick_us = chrono::duration<double, micro>(spent).count() / ticks;
+    run.adjustments = dispatcher.stats().separationAdjustments;
+    return run;
+}
+}
+
+int main() {
+    queries();
+
+    for (const auto mode: {FormationDispatcher::Mode::Position, FormationDispatcher::Mode::Velocity}) {
+        printf("\nformation dispatcher tick, %s mode, join-up from scrambled positions\n",
+               mode == FormationDispatcher::Mode::Position ? "position" : "velocity");
+        printf("%8s %12s %12s %14s %14s %12s\n", "aircraft", "tick off", "tick on", "closest off", "closest on",
+               "adjusted");
+        for (size_t size: {25, 50, 100, 200}) {
+            const Run off = formation(size, 0.0, mode);
+            const Run on = formation(size, kSeparation_m, mode);
+            printf("%8zu %9.1f us %9.1f us %12.1f m %12.1f m %12llu\n", size, off.tick_us, on.tick_us,
+                   off.closest_m, on.closest_m, static_cast<unsigned long long>(on.adjustments));
+        }
+    }
+    return 0;
+}
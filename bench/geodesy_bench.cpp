@@ -0,0 +1,145 @@
+// tracking - geodesy_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Compares per-tick cost of turning fleet positions into metric offsets from a
+// leader: naive haversine + bearing per pair, exact LocalFrame::toNed per point,
+// and the tangent-plane batch kernel. Also reports the accuracy of the fast model.
+//
+// Usage: geodesy_bench
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../Geodesy.h"
+
+using namespace std;
+using namespace geodesy;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+struct Fleet {
+    vector<double> latitude;
+    vector<double> longitude;
+    vector<double> altitude;
+};
+
+Fleet makeFleet(const Geodetic &leader, size_t size, double spread_m, mt19937 &rng) {
+    uniform_real_distribution<double> horizontal(-spread_m, spread_m);
+    uniform_real_distribution<double> vertical(-50.0, 50.0);
+    Fleet fleet;
+    for (size_t i = 0; i < size; ++i) {
+        const Geodetic p = offset(leader, horizontal(rng), horizontal(rng), vertical(rng));
+        fleet.latitude.push_back(p.latitude_deg);
+        fleet.longitude.push_back(p.longitude_deg);
+        fleet.altitude.push_back(p.altitude_m);
+    }
+    return fleet;
+}
+
+template<typename F>
+double nanosecondsPerPoint(size_t points, int ticks, F &&tick) {
+    const auto start = Clock::now();
+    for (int t = 0; t < ticks; ++t) {
+        tick();
+    }
+    const double elapsed = chrono::duration<double, nano>(Clock::now() - start).count();
+    return elapsed / (static_cast<double>(points) * ticks);
+}
+
+volatile double sink;
+}
+
+int main() {
+    mt19937 rng(7);
+    const Geodetic leader{40.9, 29.3, 150.0};
+
+    const BatchKernel widest = batchKernel();
+    printf("batch kernel: %s\n", toString(widest));
+
+    // Accuracy of the tangent-plane model against the exact ECEF path.
+    for (double spread: {100.0, 500.0, 2000.0, 10000.0}) {
+        const Fleet fleet = makeFleet(leader, 1000, spread, rng);
+        const LocalFrame frame(leader);
+        double worst = 0.0;
+        for (size_t i = 0; i < fleet.latitude.size(); ++i) {
+            const Geodetic p{fleet.latitude[i], fleet.longitude[i], fleet.altitude[i]};
+            const Ned exact = frame.toNed(p);
+            const Ned fast = frame.toNedFast(p);
+            worst = fmax(worst, hypot(hypot(exact.north - fast.north, exact.east - fast.east), exact.down - fast.down));
+        }
+        printf("tangent-plane error within %6.0f m: max %.3f m\n", spread, worst);
+    }
+
+    double roundTrip = 0.0;
+    for (int i = 0; i < 1000; ++i) {
+        uniform_real_distribution<double> lat(-89.0, 89.0), lon(-180.0, 180.0), alt(-100.0, 10000.0);
+        const Geodetic p{lat(rng), lon(rng), alt(rng)};
+        const Geodetic back = fromEcef(toEcef(p));
+        roundTrip = fmax(roundTrip, distance(p, back));
+    }
+    printf("ECEF round trip: max %.2e m\n\n", roundTrip);
+
+    printf("%8s %14s %14s %14s %14s %14s\n", "planes", "haversine", "exact NED", "batch scalar", "batch SSE2",
+           "batch AVX2");
+    for (size_t size: {10, 50, 200, 1000}) {
+        const Fleet fleet = makeFleet(leader, size, 1000.0, rng);
+        vector<double> north(size), east(size), down(size);
+        const int ticks = static_cast<int>(2000000 / size);
+
+        const double naive = nanosecondsPerPoint(size, ticks, [&] {
+            double acc = 0.0;
+            for (size_t i = 0; i < size; ++i) {
+                const Geodetic p{fleet.latitude[i], fleet.longitude[i], fleet.altitude[i]};
+                const double d = groundDistance(leader, p);
+                const double b = bearing(leader, p) * kDegToRad;
+                acc += d * cos(b) + d * sin(b) + (leader.altitude_m - p.altitude_m);
+            }
+            sink = acc;
+        });
+
+        const double exact = nanosecondsPerPoint(size, ticks, [&] {
+            const LocalFrame frame(leader);
+            double acc = 0.0;
+            for (size_t i = 0; i < size; ++i) {
+                const Ned ned = frame.toNed({fleet.latitude[i], fleet.longitude[i], fleet.altitude[i]});
+                acc += ned.north + ned.east + ned.down;
+            }
+            sink = acc;
+        });
+
+        // Every kernel the CPU has, narrowest first; "-" where it lacks one.
+        printf("%8zu %11.1f ns %11.1f ns", size, naive, exact);
+        for (BatchKernel kernel: {BatchKernel::Scalar, BatchKernel::Sse2, BatchKernel::Avx2}) {
+            if (kernel > widest || setBatchKernel(kernel) != kernel) {
+                printf(" %14s", "-");
+                continue;
+            }
+            const double batch = nanosecondsPerPoint(size, ticks, [&] {
+                const LocalFrame frame(leader);
+                frame.toNedBatch(fleet.latitude.data(), fleet.longitude.data(), fleet.altitude.data(),
+                                 north.data(), east.data(), down.data(), size);
+                sink = north[size - 1] + east[size / 2] + down[0];
+            });
+            printf(" %11.1f ns", batch);
+        }
+        setBatchKernel(widest);
+        printf("   (per plane per tick)\n");
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+// tracking - link_monitor_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Cost and accuracy of LinkMonitor on a synthetic MAVLink sequence with random
+// loss, then the follow engine's back-off on simulated aircraft: a 10 s
+// blackout of the leader's telemetry and 30% telemetry loss, each with the
+// default degradation settings and with back-off turned off.
+//
+// Usage: link_monitor_bench
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include "../LinkMonitor.h"
+#include "../SimVehicle.h"
+#include "../Teknofest.h"
+#include "../VirtualClock.h"
+
+using namespace std;
+
+namespace {
+using Clock = Vehicle::Clock;
+
+const geodesy::LocalFrame kWorld({40.9, 29.3, 100.0});
+constexpr Clock::duration kPhysicsStep = chrono::milliseconds(10);
+constexpr Clock::duration kWarmup = chrono::seconds(60);
+constexpr Clock::duration kOutage = chrono::seconds(10);
+constexpr Clock::duration kAfter = chrono::seconds(60);
+
+void monitorCost() {
+    printf("%8s %12s %12s %12s\n", "loss", "estimated", "window", "per message");
+    int sysid = 1;
+    for (double loss: {0.0, 0.05, 0.2, 0.5}) {
+        LinkMonitor monitor(sysid++);
+        mt19937 rng(7);
+        uniform_real_distribution<double> chance(0.0, 1.0);
+        constexpr int kMessages = 2000000;
+        // 200 messages a second from the autopilot.
+        const auto spacing = chrono::microseconds(5000);
+        Clock::time_point now{};
+        uint8_t sequence = 0;
+        int delivered = 0;
+        const auto start = Clock::now();
+        for (int i = 0; i < kMessages; ++i) {
+            now += spacing;
+            ++sequence;
+            if (chance(rng) < loss) {
+                continue;
+            }
+            monitor.onMessage(sequence, now);
+            ++delivered;
+        }
+        const double ns = chrono::duration<double, nano>(Clock::now() - start).count() / delivered;
+        const LinkMonitor::Stats stats = monitor.stats(now);
+        const double estimated = static_cast<double>(stats.lost) / static_cast<double>(stats.lost + stats.received);
+        printf("%7.0f%% %11.2f%% %11.2f%% %9.1f ns\n", loss * 100.0, estimated * 100.0, stats.recentLoss * 100.0, ns);
+    }
+}
+
+struct Outcome {
+    uint64_t sentDuring{};
+    double closest_m{1e9};
+    double rejoin_s{-1.0};
+    uint64_t sent{};
+    double meanGap_m{};
+    Teknofest::Stats stats;
+};
+
+double slotError(const SimVehicle &leader, const SimVehicle &follower, const Teknofest::Config &config) {
+    const Teknofest::Setpoint slot = Teknofest::computeSetpoint(leader.truth(), config);
+    const PoseSnapshot self = follower.truth();
+    const geodesy::Ned offset = geodesy::LocalFrame({slot.latitude_deg, slot.longitude_deg, slot.absolute_altitude_m})
+            .toNed({self.latitude_deg, self.longitude_deg, self.absolute_altitude_m});
+    return sqrt(offset.north * offset.north + offset.east * offset.east + offset.down * offset.down);
+}
+
+/// Leader circling at 3 deg/s with the follower behind it. With blackout the leader's telemetry stops for
+/// kOutage after the warm-up; loss drops that share of its fixes throughout.
+Outcome fly(const Teknofest::Config &config, bool blackout, double loss) {
+    SimVehicle::Config airframe;
+    airframe.positionNoise_m = 1.0;
+    airframe.telemetryLoss = loss;
+    SimVehicle::State start;
+    SimVehicle leader(1, kWorld, start, airframe);
+    SimVehicle::Maneuver turn;
+    turn.turnRate_deg_s = 3.0;
+    leader.setManeuver(turn);
+    airframe.telemetryLoss = 0.0;
+    airframe.seed = 2;
+    start.north_m = -80.0;
+    SimVehicle follower(2, kWorld, start, airframe);
+    Teknofest engine(follower, leader, config);
+
+    VirtualClock clock;
+    Clock::time_point nextTick = clock.now();
+    Outcome outcome;
+    uint64_t sentBefore = 0;
+    double gaps = 0.0;
+    uint64_t samples = 0;
+    Clock::time_point lastScore = clock.now();
+    while (clock.elapsed() < kWarmup + kOutage + kAfter) {
+        const Clock::duration elapsed = clock.elapsed();
+        if (blackout && elapsed == kWarmup) {
+            leader.setTelemetryOutage(true);
+            sentBefore = follower.commandsReceived();
+        }
+        if (blackout && elapsed == kWarmup + kOutage) {
+            leader.setTelemetryOutage(false);
+            outcome.sentDuring = follower.commandsReceived() - sentBefore;
+        }
+        clock.advance(kPhysicsStep);
+        leader.step(clock.now());
+        follower.step(clock.now());
+        if (clock.now() >= nextTick) {
+            engine.tick(clock.now());
+            nextTick += engine.period();
+        }
+        if (clock.now() - lastScore >= chrono::milliseconds(100) && clock.elapsed() > kWarmup) {
+            lastScore = clock.now();
+            const PoseSnapshot a = leader.truth();
+            const PoseSnapshot b = follower.truth();
+            const geodesy::Ned gap = geodesy::LocalFrame({a.latitude_deg, a.longitude_deg, a.absolute_altitude_m})
+                    .toNed({b.latitude_deg, b.longitude_deg, b.absolute_altitude_m});
+            const double distance = sqrt(gap.north * gap.north + gap.east * gap.east);
+            outcome.closest_m = min(outcome.closest_m, distance);
+            gaps += distance;
+            ++samples;
+            if (blackout && outcome.rejoin_s < 0.0 && clock.elapsed() > kWarmup + kOutage
+                && slotError(leader, follower, config) < 10.0) {
+                outcome.rejoin_s = chrono::duration<double>(clock.elapsed() - kWarmup - kOutage).count();
+            }
+        }
+    }
+    outcome.sent = follower.commandsReceived();
+    outcome.meanGap_m = gaps / static_cast<double>(samples);
+    outcome.stats = engine.stats();
+    return outcome;
+}
+
+void report(const char *name, const Outcome &outcome, bool blackout) {
+    printf("%-12s", name);
+    if (blackout) {
+        printf(" %10llu %9.1f m", static_cast<unsigned long long>(outcome.sentDuring), outcome.closest_m);
+        if (outcome.rejoin_s >= 0.0) {
+            printf(" %9.1f s", outcome.rejoin_s);
+        } else {
+            printf(" %11s", "never");
+        }
+    } else {
+        printf(" %10llu %9.1f m %9.1f m", static_cast<unsigned long long>(outcome.sent), outcome.meanGap_m,
+               outcome.closest_m);
+    }
+    printf(" %10llu %8llu %8llu\n", static_cast<unsigned long long>(outcome.stats.throttledTicks),
+           static_cast<unsigned long long>(outcome.stats.loiterTicks),
+           static_cast<unsigned long long>(outcome.stats.loiters));
+}
+}
+
+int main() {
+    monitorCost();
+
+    Teknofest::Config adaptive;
+    Teknofest::Config fixed;
+    fixed.degradation.degradedAge = Clock::duration::max();
+    fixed.degradation.predictAge = Clock::duration::max();
+    fixed.degradation.degradedLoss = 1.0;
+    fixed.degradation.loiterAge = Clock::duration::zero();
+
+    printf("\n10 s leader blackout after %lld s, 50 Hz engine\n",
+           static_cast<long long>(chrono::duration_cast<chrono::seconds>(kWarmup).count()));
+    printf("%-12s %10s %11s %11s %10s %8s %8s\n", "", "sent", "closest", "rejoin", "throttled", "loiter", "loiters");
+    report("back-off", fly(adaptive, true, 0.0), true);
+    report("none", fly(fixed, true, 0.0), true);
+
+    printf("\n30%% leader telemetry loss\n");
+    printf("%-12s %10s %11s %11s %10s %8s %8s\n", "", "sent", "mean gap", "closest", "throttled", "loiter", "loiters");
+    report("back-off", fly(adaptive, false, 0.3), false);
+    report("none", fly(fixed, false, 0.3), false);
+    return 0;
+}
@@ -0,0 +1,83 @@
+// tracking - logger_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Measures the caller-side cost of a log call on the follow path, against a
+// synchronous ostream write with a flush. Records go to stdout, so redirect it:
+//
+// Usage: logger_bench > /dev/null
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include "../Logger.h"
+
+using namespace std;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+constexpr int kBursts = 200;
+/// Stay under the ring capacity so no record is dropped while measuring.
+constexpr int kBurstSize = 1000;
+
+double nsPerCall(Clock::duration elapsed, int calls) {
+    return chrono::duration<double, nano>(elapsed).count() / calls;
+}
+}
+
+int main() {
+    Logger &logger = Logger::instance();
+    const double lat = 41.0082;
+    const double lon = 28.9784;
+    const float alt = 120.5f;
+    const int sysid = 2;
+
+    Clock::duration logged{};
+    for (int burst = 0; burst < kBursts; ++burst) {
+        const auto start = Clock::now();
+        for (int i = 0; i < kBurstSize; ++i) {
+            LOG_INFO("Plane {}: target {} {} {} tick {}", sysid, lat, lon, alt, i);
+        }
+        logged += Clock::now() - start;
+        logger.flush();
+    }
+
+    Clock::duration filtered{};
+    {
+        const auto start = Clock::now();
+        for (int i = 0; i < kBursts * kBurstSize; ++i) {
+            LOG_DEBUG("Plane {}: target {} {} {} tick {}", sysid, lat, lon, alt, i);
+        }
+        filtered = Clock::now() - start;
+    }
+
+    Clock::duration synchronous{};
+    for (int burst = 0; burst < kBursts; ++burst) {
+        const auto start = Clock::now();
+        for (int i = 0; i < kBurstSize; ++i) {
+            cout << "Plane " << sysid << ": target " << lat << " " << lon << " " << alt << " tick " << i << endl;
+        }
+        synchronous += Clock::now() - start;
+    }
+
+    const int calls = kBursts * kBurstSize;
+    fprintf(stderr, "async log call:        %7.1f ns\n", nsPerCall(logged, calls));
+    fprintf(stderr, "filtered (debug) call: %7.1f ns\n", nsPerCall(filtered, calls));
+    fprintf(stderr, "cout << ... << endl:   %7.1f ns\n", nsPerCall(synchronous, calls));
+    fprintf(stderr, "dropped records:       %llu\n", static_cast<unsigned long long>(logger.dropped()));
+    return 0;
+}
@@ -0,0 +1,151 @@
+// tracking - metrics_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Measures the cost of recording into a Histogram from one and from several
+// threads, the percentile error against exact sorted values, and the time to
+// scrape a registry the size of a 30 aircraft fleet over HTTP.
+//
+// Usage: metrics_bench
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <netinet/in.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../MetricsServer.h"
+
+using namespace std;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+constexpr int kRecords = 10000000;
+constexpr int kThreads = 4;
+constexpr int kAircraft = 30;
+
+double nsPerRecord(Histogram &histogram, int records) {
+    const auto start = Clock::now();
+    for (int i = 0; i < records; ++i) {
+        histogram.record(static_cast<uint64_t>(i & 0xffff));
+    }
+    return chrono::duration<double, nano>(Clock::now() - start).count() / records;
+}
+
+/// One scrape over a fresh connection, returns the body size.
+size_t scrape(uint16_t port) {
+    const int sock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server.sin_port = htons(port);
+    if (connect(sock, reinterpret_cast<sockaddr *>(&server), sizeof(server)) != 0) {
+        close(sock);
+        return 0;
+    }
+    const string request = "GET /metrics HTTP/1.0\r\n\r\n";
+    send(sock, request.data(), request.size(), 0);
+    string response;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, static_cast<size_t>(n));
+    }
+    close(sock);
+    const size_t body = response.find("\r\n\r\n");
+    return body == string::npos ? 0 : response.size() - body - 4;
+}
+}
+
+int main() {
+    Metrics &metrics = Metrics::instance();
+
+    Histogram &single = metrics.histogram("bench_single_seconds", "single thread");
+    nsPerRecord(single, kRecords / 10);
+    printf("record, 1 thread:  %.1f ns\n", nsPerRecord(single, kRecords));
+
+    Histogram &shared = metrics.histogram("bench_shared_seconds", "shared by several threads");
+    vector<thread> workers;
+    const auto sharedStart = Clock::now();
+    for (int t = 0; t < kThreads; ++t) {
+        workers.emplace_back([&shared] {
+            nsPerRecord(shared, kRecords);
+        });
+    }
+    for (thread &worker: workers) {
+        worker.join();
+    }
+    printf("record, %d threads: %.1f ns per record of wall time, all threads together\n", kThreads,
+           chrono::duration<double, nano>(Clock::now() - sharedStart).count() / (kThreads * kRecords));
+
+    // Latency-like values: lognormal around 2 ms with a long tail.
+    mt19937_64 random(7);
+    lognormal_distribution<double> latency(7.6, 0.8);
+    vector<uint64_t> values(1000000);
+    Histogram &accuracy = metrics.histogram("bench_accuracy_seconds", "percentile accuracy");
+    for (uint64_t &value: values) {
+        value = static_cast<uint64_t>(latency(random));
+        accuracy.record(value);
+    }
+    sort(values.begin(), values.end());
+    const Histogram::Snapshot snapshot = accuracy.snapshot();
+    for (double quantile: {0.5, 0.99, 0.999}) {
+        const uint64_t exact = values[static_cast<size_t>(quantile * values.size()) - 1];
+        const uint64_t estimate = snapshot.percentile(quantile);
+        printf("p%-5g exact %6llu us  histogram %6llu us  error %+.2f%%\n", quantile * 100,
+               static_cast<unsigned long long>(exact), static_cast<unsigned long long>(estimate),
+               100.0 * (static_cast<double>(estimate) - static_cast<double>(exact)) / static_cast<double>(exact));
+    }
+
+    // What a fleet registers: four streams, three send calls and eight result sets per plane.
+    for (int sysid = 1; sysid <= kAircraft; ++sysid) {
+        const string id = "sysid=\"" + to_string(sysid) + "\"";
+        for (const char *stream: {"position", "velocity", "attitude", "fixedwing_metrics"}) {
+            metrics.histogram("tracking_telemetry_interval_seconds", "interval", id + ",stream=\"" + stream + "\"")
+                    .record(static_cast<uint64_t>(100000));
+        }
+        for (const char *call: {"set_position_global", "set_velocity_ned", "set_target_location"}) {
+            metrics.histogram("tracking_command_send_seconds", "send", id + ",call=\"" + call + "\"").record(
+                    static_cast<uint64_t>(20));
+        }
+        for (int call = 0; call < 8; ++call) {
+            for (int result = 0; result < 12; ++result) {
+                metrics.counter("tracking_mavsdk_results_total", "results",
+                                id + ",call=\"c" + to_string(call) + "\",result=\"r" + to_string(result) + "\"");
+            }
+        }
+    }
+
+    MetricsServer server(metrics);
+    if (!server.start(0)) {
+        return 1;
+    }
+    constexpr int kScrapes = 20;
+    size_t bytes = 0;
+    const auto start = Clock::now();
+    for (int i = 0; i < kScrapes; ++i) {
+        bytes = scrape(server.port());
+    }
+    const double ms = chrono::duration<double, milli>(Clock::now() - start).count() / kScrapes;
+    printf("scrape over http:  %.2f ms for %zu bytes (%d aircraft)\n", ms, bytes, kAircraft);
+    server.stop();
+    return bytes > 0 ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+// tracking - mission_plan_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// What moving a plane by mission costs compared to streaming offboard
+// setpoints: building and hashing plans of growing size, how far a straight
+// lat/lon leg strays from the great circle with and without splitting, and the
+// MAVLink bytes of a transit flown as an upload (or a cached plan) against a
+// setpoint stream for the whole leg. Byte counts use full payloads plus
+// MAVLink 2 framing (10 byte header, 2 byte checksum), no signing.
+//
+// Usage: mission_plan_bench
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../MissionPlan.h"
+
+using namespace std;
+using namespace geodesy;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+const Geodetic kHome{40.9, 29.3, 120.0};
+constexpr double kFraming = 12.0;
+constexpr double kSetpoint = 53.0 + kFraming;     // SET_POSITION_TARGET_GLOBAL_INT
+constexpr double kMissionCount = 9.0 + kFraming;
+constexpr double kMissionRequest = 5.0 + kFraming; // MISSION_REQUEST_INT
+constexpr double kMissionItem = 38.0 + kFraming;   // MISSION_ITEM_INT
+constexpr double kMissionAck = 8.0 + kFraming;
+constexpr double kCommand = 33.0 + kFraming;       // COMMAND_LONG, mission start or rewind
+constexpr double kCommandAck = 10.0 + kFraming;
+constexpr double kAirspeed_m_s = 20.0;
+
+void buildCost() {
+    printf("%10s %12s %12s\n", "waypoints", "build", "per item");
+    mt19937 rng(5);
+    uniform_real_distribution<double> offset(-20000.0, 20000.0);
+    for (int size: {10, 100, 500}) {
+        vector<Geodetic> points;
+        for (int i = 0; i < size; ++i) {
+            points.push_back(geodesy::offset(kHome, offset(rng), offset(rng), 0.0));
+        }
+        const int rounds = 20000 / size;
+        size_t items = 0;
+        uint64_t sink = 0;
+        const auto start = Clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            MissionPlan plan;
+            for (const Geodetic &point: points) {
+                plan.waypoint(point);
+            }
+            items = plan.size();
+            sink += plan.hash();
+        }
+        const double us = chrono::duration<double, micro>(Clock::now() - start).count() / rounds;
+        printf("%10d %9.1f us %9.0f ns   (%zu items after splitting, checksum %016llx)\n", size, us,
+               us * 1000.0 / static_cast<double>(items), items, static_cast<unsigned long long>(sink));
+    }
+}
+
+/// Largest distance from the great circle between the leg's ends, flying straight lat/lon lines between items.
+double worstDrift(const MissionPlan &plan, const Geodetic &from, const Geodetic &to) {
+    const double course = bearing(from, to) * kDegToRad;
+    double worst = 0.0;
+    const auto &items = plan.items();
+    for (size_t i = 1; i < items.size(); ++i) {
+        const Geodetic a{items[i - 1].x * 1e-7, items[i - 1].y * 1e-7, 0.0};
+        const Geodetic b{items[i].x * 1e-7, items[i].y * 1e-7, 0.0};
+        for (int step = 1; step < 50; ++step) {
+            const double f = step / 50.0;
+            const Geodetic chord{a.latitude_deg + (b.latitude_deg - a.latitude_deg) * f,
+                                 a.longitude_deg + (b.longitude_deg - a.longitude_deg) * f, 0.0};
+            const double angular = groundDistance(from, chord) / kMeanRadius_m;
+            const double crossTrack = asin(sin(angular) * sin(bearing(from, chord) * kDegToRad - course));
+            worst = max(worst, fabs(crossTrack) * kMeanRadius_m);
+        }
+    }
+    return worst;
+}
+
+void legDrift() {
+    printf("\nEast-north-east legs from %.1f N: distance off the great circle\n", kHome.latitude_deg);
+    printf("%10s %14s %10s %14s\n", "leg", "unsplit", "items", "5 km pieces");
+    for (double leg_km: {20.0, 50.0, 100.0, 200.0}) {
+        const Geodetic from{kHome.latitude_deg, kHome.longitude_deg, 300.0};
+        const Geodetic to = geodesy::offset(from, leg_km * 1000.0 * 0.38, leg_km * 1000.0 * 0.92, 0.0);
+        MissionPlan::Config whole;
+        whole.maxLeg_m = 0.0;
+        const MissionPlan straight = MissionPlan(whole).waypoint(from).waypoint(to);
+        const MissionPlan split = MissionPlan().waypoint(from).waypoint(to);
+        printf("%7.0f km %12.1f m %10zu %12.1f m\n", leg_km, worstDrift(straight, from, to), split.size(),
+               worstDrift(split, from, to));
+    }
+}
+
+void linkCost() {
+    printf("\nTransit at %.0f m/s: MAVLink bytes to move the plane\n", kAirspeed_m_s);
+    printf("%10s %8s %12s %12s %12s %12s\n", "leg", "items", "upload", "cached", "setpoints 4Hz",
+           "setpoints 20Hz");
+    for (double leg_km: {10.0, 20.0, 50.0, 100.0}) {
+        const Geodetic to = geodesy::offset(kHome, leg_km * 1000.0, 0.0, 0.0);
+        const MissionPlan plan = MissionPlan().waypoint(kHome).waypoint(to).loiter(to, 150.0f);
+        const auto items = static_cast<double>(plan.size());
+        const double start = kCommand + kCommandAck;
+        const double upload = kMissionCount + items * (kMissionRequest + kMissionItem) + kMissionAck + start;
+        // A cached plan is rewound to its first item and started.
+        const double cached = 2.0 * start;
+        const double seconds = leg_km * 1000.0 / kAirspeed_m_s;
+        printf("%7.0f km %8zu %10.0f B %10.0f B %10.1f kB %11.1f kB\n", leg_km, plan.size(), upload, cached,
+               seconds * 4.0 * kSetpoint / 1000.0, seconds * 20.0 * kSetpoint / 1000.0);
+    }
+}
+}
+
+int main() {
+    buildCost();
+    legDrift();
+    linkCost();
+    return 0;
+}
@@ -0,0 +1,94 @@
+// tracking - recorder_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Measures the cost of FlightRecorder::append and the CPU share of recording a
+// 30 aircraft fleet: 50 Hz commands plus the default telemetry rates
+// (position, velocity and attitude at 10 Hz, fixed-wing metrics at 5 Hz).
+// Writes enough records to wrap the log, so flight_log can be checked on the result.
+//
+// Usage: recorder_bench [file]
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "../FlightRecorder.h"
+
+using namespace std;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+constexpr int kAircraft = 30;
+constexpr double kRecordsPerAircraft_hz = 50.0 + 10.0 + 10.0 + 10.0 + 5.0;
+constexpr uint64_t kCapacity = uint64_t{1} << 20;
+constexpr uint64_t kRecords = kCapacity * 3;
+
+void appendPosition(FlightRecorder &recorder, uint8_t sysid, uint64_t i) {
+    recorder.append(sysid, RecordKind::Position, [i](FlightRecord &entry) {
+        entry.latitude_e7 = FlightRecord::toE7(41.0 + static_cast<double>(i) * 1e-7);
+        entry.longitude_e7 = FlightRecord::toE7(29.0);
+        entry.altitude_m = 120.0f;
+    });
+}
+}
+
+int main(int argc, char **argv) {
+    const string path = argc > 1 ? argv[1] : "recorder_bench.trk";
+    FlightRecorder recorder;
+    if (!recorder.open(path, kCapacity)) {
+        return 1;
+    }
+
+    // First lap touches fresh pages, later laps rewrite resident ones.
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < kCapacity; ++i) {
+        appendPosition(recorder, static_cast<uint8_t>(1 + i % kAircraft), i);
+    }
+    const double coldNs = chrono::duration<double, nano>(Clock::now() - start).count() / kCapacity;
+
+    start = Clock::now();
+    for (uint64_t i = kCapacity; i < kRecords - kCapacity; ++i) {
+        appendPosition(recorder, static_cast<uint8_t>(1 + i % kAircraft), i);
+    }
+    const double warmNs = chrono::duration<double, nano>(Clock::now() - start).count() / (kRecords - 2 * kCapacity);
+
+    // Last lap from several threads at once, as the MAVSDK callbacks and the control loop do.
+    const unsigned threads = 4;
+    vector<thread> writers;
+    start = Clock::now();
+    for (unsigned t = 0; t < threads; ++t) {
+        writers.emplace_back([&recorder, t]() {
+            for (uint64_t i = t; i < kCapacity; i += threads) {
+                appendPosition(recorder, static_cast<uint8_t>(1 + i % kAircraft), i);
+            }
+        });
+    }
+    for (thread &writer: writers) {
+        writer.join();
+    }
+    const double contendedNs = chrono::duration<double, nano>(Clock::now() - start).count() / kCapacity;
+    recorder.close();
+
+    const double rate = kAircraft * kRecordsPerAircraft_hz;
+    printf("append, first lap (page faults): %6.1f ns\n", coldNs);
+    printf("append, resident pages:          %6.1f ns\n", warmNs);
+    printf("append, %u threads (wall/record): %6.1f ns\n", threads, contendedNs);
+    printf("%d aircraft: %.0f records/s, %.1f MiB/min\n", kAircraft, rate, rate * 60 * sizeof(FlightRecord) / (1 << 20));
+    printf("CPU share at that rate:          %.4f %% (first lap %.4f %%)\n", warmNs * rate / 1e7, coldNs * rate / 1e7);
+    printf("wrote %llu records to %s\n", static_cast<unsigned long long>(kRecords), path.c_str());
+    return 0;
+}
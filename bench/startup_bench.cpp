@@ -0,0 +1,140 @@
+// tracking - startup_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Startup time of the tracker against mock_autopilot, on loopback.
+//
+// Starts the mock with N systems and goes through the same steps as
+// TrackerMain: wait for the first autopilot, create the fleet, wait until all N
+// planes are registered and until each has a position fix. Prints when each
+// step finished, counted from the spawn, and when the last plane had its GPS
+// global origin cached (it is resolved in the background).
+//
+// Usage: startup_bench [--systems N] [--rate HZ] [--port P]
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <vector>
+#include "../ConnectionManager.h"
+
+using namespace std;
+
+extern char **environ;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+constexpr int kTimeout_s = 20;
+
+double millisSince(Clock::time_point start) {
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+}
+
+int main(int argc, char **argv) {
+    string systems = "8";
+    string rate = "10";
+    string port = "14540";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const string arg = argv[i];
+        if (arg == "--systems") {
+            systems = argv[i + 1];
+        } else if (arg == "--rate") {
+            rate = argv[i + 1];
+        } else if (arg == "--port") {
+            port = argv[i + 1];
+        } else {
+            fprintf(stderr, "Usage: %s [--systems N] [--rate HZ] [--port P]\n", argv[0]);
+            return 2;
+        }
+    }
+    const size_t count = static_cast<size_t>(atoi(systems.c_str()));
+    if (count < 1) {
+        fprintf(stderr, "need at least one system\n");
+        return 2;
+    }
+
+    ConnectionManager connections;
+    if (!connections.addEndpoint("udp://:" + port)) {
+        fprintf(stderr, "could not listen on udp port %s\n", port.c_str());
+        return 1;
+    }
+
+    vector<string> mockArgs{MOCK_AUTOPILOT_PATH, "--systems", systems, "--rate", rate, "--port", port,
+                            "--duration", to_string(kTimeout_s)};
+    vector<char *> mockArgv;
+    for (string &arg: mockArgs) {
+        mockArgv.push_back(arg.data());
+    }
+    mockArgv.push_back(nullptr);
+    const Clock::time_point start = Clock::now();
+    pid_t mock{};
+    if (posix_spawn(&mock, MOCK_AUTOPILOT_PATH, nullptr, nullptr, mockArgv.data(), environ) != 0) {
+        perror("posix_spawn " MOCK_AUTOPILOT_PATH);
+        return 1;
+    }
+    auto finish = [mock](int status) {
+        kill(mock, SIGTERM);
+        waitpid(mock, nullptr, 0);
+        return status;
+    };
+
+    const auto system = connections.waitForAutopilot(kTimeout_s);
+    if (!system) {
+        fprintf(stderr, "mock autopilot did not show up\n");
+        return finish(1);
+    }
+    printf("%-28s %9.1f ms\n", "first autopilot", millisSince(start));
+
+    TelemetryRates rates;
+    rates.position_hz = atof(rate.c_str());
+    Fleet &fleet = connections.createFleet(system.value()->get_system_id(), rates);
+    printf("%-28s %9.1f ms  (%zu planes)\n", "fleet created", millisSince(start), fleet.size());
+
+    if (!fleet.waitForPlanes(count, chrono::seconds(kTimeout_s))) {
+        fprintf(stderr, "only %zu of %zu planes registered\n", fleet.size(), count);
+        return finish(1);
+    }
+    printf("%-28s %9.1f ms\n", "all planes registered", millisSince(start));
+
+    size_t fixed = 0;
+    for (const Fleet::Outcome &outcome: fleet.waitPositionAll(chrono::seconds(kTimeout_s))) {
+        fixed += outcome.completed ? 1 : 0;
+    }
+    printf("%-28s %9.1f ms  (%zu of %zu)\n", "all planes have a fix", millisSince(start), fixed, count);
+
+    // The origin answer is not waited on anywhere, poll for it here only to show when it lands.
+    const Clock::time_point deadline = Clock::now() + chrono::seconds(kTimeout_s);
+    size_t resolved = 0;
+    while (Clock::now() < deadline) {
+        resolved = 0;
+        const Fleet::View planes = fleet.view();
+        for (plane *vehicle: *planes) {
+            resolved += vehicle->getOrigin().valid ? 1 : 0;
+        }
+        if (resolved == count) {
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    printf("%-28s %9.1f ms  (%zu of %zu)\n", "all origins cached", millisSince(start), resolved, count);
+    return finish(fixed == count && resolved == count ? 0 : 1);
+}
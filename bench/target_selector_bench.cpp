@@ -0,0 +1,144 @@
+// tracking - target_selector_bench.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Cost of one TargetSelector tick as the number of contacts grows, then five
+// simulated minutes of a follower flying through 50 maneuvering contacts with
+// noisy fixes, with the default hysteresis and with none, comparing how often
+// the lock moves and how long locks last.
+//
+// Usage: target_selector_bench
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+#include "../SimVehicle.h"
+#include "../TargetSelector.h"
+#include "../VirtualClock.h"
+
+using namespace std;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+const geodesy::LocalFrame kWorld({40.9, 29.3, 0.0});
+
+struct Sky {
+    unique_ptr<SimVehicle> follower;
+    vector<unique_ptr<SimVehicle>> contacts;
+};
+
+/// Follower at the origin flying north, contacts scattered ahead of it, each flying its own circle.
+/// The follower's id labels the selector's counters, so every run gets its own.
+Sky makeSky(int followerId, size_t size, double noise_m, uint32_t seed) {
+    mt19937 rng(seed);
+    uniform_real_distribution<double> north(200.0, 2500.0);
+    uniform_real_distribution<double> east(-1500.0, 1500.0);
+    uniform_real_distribution<double> heading(0.0, 360.0);
+    uniform_real_distribution<double> turn(-6.0, 6.0);
+    SimVehicle::Config airframe;
+    airframe.positionNoise_m = noise_m;
+    Sky sky;
+    SimVehicle::State start;
+    start.altitude_m = 150.0;
+    sky.follower = make_unique<SimVehicle>(followerId, kWorld, start, airframe);
+    for (size_t i = 0; i < size; ++i) {
+        start.north_m = north(rng);
+        start.east_m = east(rng);
+        start.heading_deg = heading(rng);
+        airframe.seed = static_cast<uint32_t>(i + 2);
+        sky.contacts.push_back(make_unique<SimVehicle>(static_cast<int>(i + 1000), kWorld, start, airframe));
+        SimVehicle::Maneuver maneuver;
+        maneuver.turnRate_deg_s = turn(rng);
+        sky.contacts.back()->setManeuver(maneuver);
+    }
+    return sky;
+}
+
+void step(Sky &sky, Clock::time_point now) {
+    sky.follower->step(now);
+    for (auto &contact: sky.contacts) {
+        contact->step(now);
+    }
+}
+
+TargetSelector::Gather gatherFrom(Sky &sky) {
+    return [&sky](vector<Vehicle *> &contacts) {
+        contacts.clear();
+        for (auto &contact: sky.contacts) {
+            contacts.push_back(contact.get());
+        }
+    };
+}
+
+void tickCost() {
+    printf("%10s %12s %14s\n", "contacts", "tick", "per contact");
+    for (size_t size: {10, 50, 100, 200}) {
+        Sky sky = makeSky(1, size, 0.0, 3);
+        VirtualClock clock;
+        // Fly past the telemetry latency so every aircraft has a fix; without one a tick returns early.
+        while (clock.elapsed() < chrono::seconds(1)) {
+            clock.advance(chrono::milliseconds(10));
+            step(sky, clock.now());
+        }
+        TargetSelector selector(*sky.follower, gatherFrom(sky), [](Vehicle *) {}, TargetSelector::Config{});
+        selector.tick(clock.now());
+        if (selector.target() == nullptr) {
+            printf("%10zu   no eligible contact, not timed\n", size);
+            continue;
+        }
+        const int ticks = 200000 / static_cast<int>(size);
+        const auto start = Clock::now();
+        for (int i = 0; i < ticks; ++i) {
+            selector.tick(clock.now());
+        }
+        const double ns = chrono::duration<double, nano>(Clock::now() - start).count() / ticks;
+        printf("%10zu %9.2f us %11.1f ns\n", size, ns / 1000.0, ns / static_cast<double>(size));
+    }
+}
+
+void thrash(int followerId, const char *name, const TargetSelector::Config &config) {
+    Sky sky = makeSky(followerId, 50, 5.0, 9);
+    VirtualClock clock;
+    uint64_t changes = 0;
+    TargetSelector selector(*sky.follower, gatherFrom(sky), [&changes](Vehicle *) { ++changes; }, config);
+    const auto period = chrono::milliseconds(100);
+    while (clock.elapsed() < chrono::minutes(5)) {
+        clock.advance(period);
+        step(sky, clock.now());
+        selector.tick(clock.now());
+    }
+    const TargetSelector::Stats stats = selector.stats();
+    printf("%-18s %8llu %8llu %8llu %10.1f s %10.1f s\n", name, static_cast<unsigned long long>(changes),
+           static_cast<unsigned long long>(stats.switches), static_cast<unsigned long long>(stats.losses),
+           chrono::duration<double>(stats.meanLock).count(), chrono::duration<double>(stats.longestLock).count());
+}
+}
+
+int main() {
+    tickCost();
+
+    printf("\n50 contacts, 5 m GPS noise, 5 minutes at 10 Hz\n");
+    printf("%-18s %8s %8s %8s %12s %12s\n", "", "changes", "better", "lost", "mean lock", "longest");
+    thrash(2, "hysteresis", TargetSelector::Config{});
+    TargetSelector::Config none;
+    none.switchMargin = 0.0;
+    none.switchDwell = Clock::duration::zero();
+    none.minLock = Clock::duration::zero();
+    thrash(3, "no hysteresis", none);
+    return 0;
+}
@@ -14,18 +14,127 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
 #include "TrackerMain.h"
 
-int main() {
+namespace {
+/// Most callback workers --callback-threads accepts.
+constexpr unsigned long kMaxCallbackThreads = 256;
+/// Longest follow session --duration accepts, a day.
+constexpr unsigned long kMaxDuration_s = 24 * 60 * 60;
+
+void onSignal(int) {
+    TrackerMain::requestStop();
+}
+
+void usage(const char *program) {
+    std::fprintf(stderr, "Usage: %s [--record file] [--metrics port] [--callback-threads N] [--duration S] "
+                         "[endpoint...]\n", program);
+}
+
+/**
+ * Parse a whole decimal argument within [low, high]
+ * strtoul would take "-1" as ULONG_MAX and "12abc" as 12; both are refused here.
+ * @param text the argument
+ * @param low smallest accepted value
+ * @param high largest accepted value
+ * @param value set on success
+ * @return true if the argument is a number in range
+ */
+bool parseNumber(const char *text, unsigned long low, unsigned long high, unsigned long &value) {
+    if (text[0] < '0' || text[0] > '9') {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    const unsigned long parsed = std::strtoul(text, &end, 10);
+    if (errno != 0 || *end != '\0' || parsed < low || parsed > high) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+}
+
+/**
+ * Usage: tracking [--record file] [--metrics port] [--callback-threads N] [--duration S] [endpoint...]
+ * Each endpoint is a MAVSDK connection URL (udp://:14540, tcp://host:port,
+ * serial:///dev/ttyUSB0:57600) or @file with one URL per line.
+ * Without endpoints it listens on localhost:3131.
+ * --record writes a binary flight log, read it back with flight_log.
+ * --metrics serves Prometheus metrics on http://127.0.0.1:port/metrics.
+ * --callback-threads sets how many workers run telemetry callbacks (default 2).
+ * --duration follows for S seconds; by default, or with 0, until SIGINT or SIGTERM.
+ */
+int main(int argc, char **argv) {
 
     /* TODO
      *
      */
 
     TrackerMain trackerMain;
-    // Initialize the tracker
-    int port = 3131;
-    string ip = "localhost";
-    trackerMain.initialize(ip, port);
+    int first = 1;
+    while (first + 1 < argc) {
+        const string option = argv[first];
+        if (option == "--record") {
+            if (!trackerMain.record(argv[first + 1])) {
+                return 1;
+            }
+        } else if (option == "--callback-threads") {
+            unsigned long threads = 0;
+            if (!parseNumber(argv[first + 1], 1, kMaxCallbackThreads, threads)) {
+                std::fprintf(stderr, "--callback-threads takes 1 to %lu, not %s\n", kMaxCallbackThreads,
+                             argv[first + 1]);
+                usage(argv[0]);
+                return 2;
+            }
+            CallbackExecutor::configure(static_cast<size_t>(threads));
+        } else if (option == "--metrics") {
+            unsigned long port = 0;
+            if (!parseNumber(argv[first + 1], 1, 65535, port)) {
+                std::fprintf(stderr, "--metrics takes a port from 1 to 65535, not %s\n", argv[first + 1]);
+                usage(argv[0]);
+                return 2;
+            }
+            if (!trackerMain.serveMetrics(static_cast<uint16_t>(port))) {
+                return 1;
+            }
+        } else if (option == "--duration") {
+            unsigned long duration = 0;
+            if (!parseNumber(argv[first + 1], 0, kMaxDuration_s, duration)) {
+                std::fprintf(stderr, "--duration takes 0 to %lu seconds, not %s\n", kMaxDuration_s, argv[first + 1]);
+                usage(argv[0]);
+                return 2;
+            }
+            trackerMain.setFollowDuration(std::chrono::seconds(duration));
+        } else {
+            break;
+        }
+        first += 2;
+    }
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    if (argc <= first) {
+        // Initialize the tracker
+        int port = 3131;
+        string ip = "localhost";
+        trackerMain.initialize(ip, port);
+        return 0;
+    }
+
+    vector<string> endpoints;
+    for (int i = first; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg.size() > 1 && arg[0] == '@') {
+            const vector<string> fromFile = ConnectionManager::loadEndpoints(arg.substr(1));
+            endpoints.insert(endpoints.end(), fromFile.begin(), fromFile.end());
+        } else {
+            endpoints.push_back(arg);
+        }
+    }
+    trackerMain.initialize(endpoints);
     return 0;
 }
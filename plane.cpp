@@ -20,8 +20,9 @@
 #include <mavsdk/plugins/camera/camera.h>
 #include <mavsdk/plugins/info/info.h>
 #include <future>
+#include "Geodesy.h"
+#include "Logger.h"
 #include "plane.h"
-#include "iostream"
 
 using namespace std;
 
@@ -29,10 +30,89 @@ using namespace std;
  * Constructor for the plane object
  * @param sharedPtr System pointer
  * @param isMain bool to check if the plane is the main plane
+ * @param rates telemetry stream rates to request from the vehicle
+ * @param commandRates max send and keep-alive rates for setpoints
  */
-plane::plane(System *sharedPtr, bool isMain)
+plane::plane(System *sharedPtr, bool isMain, const TelemetryRates &rates, const CommandQueue::Config &commandRates)
         : isMain(isMain), system(sharedPtr) {
-    init();
+    init(rates, commandRates);
+}
+
+/**
+ * Destructor for the plane object
+ * Closes the callback gate first: callbacks MAVSDK still holds, and answers
+ * to async calls still on their way, then find it closed and never reach this
+ * plane or its survey, and the ones already queued have run when close() returns.
+ */
+plane::~plane() {
+    if (callbackGate) {
+        callbackGate->close();
+    }
+    if (survey) {
+        survey->stop();
+    }
+}
+
+namespace {
+string planeLabels(int sysid, const string &name, const string &value) {
+    return "sysid=\"" + to_string(sysid) + "\"," + name + "=\"" + value + "\"";
+}
+
+Histogram &streamInterval(int sysid, const string &stream) {
+    return Metrics::instance().histogram("tracking_telemetry_interval_seconds",
+                                         "Time between successive telemetry callbacks per stream",
+                                         planeLabels(sysid, "stream", stream));
+}
+
+Histogram &sendLatency(int sysid, const string &call) {
+    return Metrics::instance().histogram("tracking_command_send_seconds",
+                                         "Time spent in the MAVSDK command send call",
+                                         planeLabels(sysid, "call", call));
+}
+
+/// follow(target) does not chase a fix older than this, the target may be long gone.
+constexpr chrono::seconds kMaxTargetAge{2};
+
+template<typename Result>
+ResultCounters results(int sysid, const string &call) {
+    return ResultCounters::forCall<Result>(Metrics::instance(), planeLabels(sysid, "call", call));
+}
+}
+
+/**
+ * Register the plane's instruments
+ * @param sysid system id, used as a label on every series
+ */
+plane::Instruments::Instruments(int sysid)
+        : position(streamInterval(sysid, "position")),
+          velocity(streamInterval(sysid, "velocity")),
+          attitude(streamInterval(sysid, "attitude")),
+          fixedwingMetrics(streamInterval(sysid, "fixedwing_metrics")),
+          positionSend(sendLatency(sysid, "set_position_global")),
+          velocitySend(sendLatency(sysid, "set_velocity_ned")),
+          positionVelocitySend(sendLatency(sysid, "set_position_velocity_ned")),
+          followTargetSend(sendLatency(sysid, "set_target_location")),
+          followPoseAge(Metrics::instance().histogram("tracking_command_pose_age_seconds",
+                                                      "Age of the leader fix a command was computed from",
+                                                      planeLabels(sysid, "engine", "follow_me"))),
+          followStaleTargets(Metrics::instance().counter("tracking_follow_stale_targets_total",
+                                                         "Follow-me targets not sent, the target fix was too old",
+                                                         "sysid=\"" + to_string(sysid) + "\"")),
+          positionResults(results<Offboard::Result>(sysid, "set_position_global")),
+          velocityResults(results<Offboard::Result>(sysid, "set_velocity_ned")),
+          positionVelocityResults(results<Offboard::Result>(sysid, "set_position_velocity_ned")),
+          followTargetResults(results<FollowMe::Result>(sysid, "set_target_location")),
+          offboardStartResults(results<Offboard::Result>(sysid, "offboard_start")),
+          offboardStopResults(results<Offboard::Result>(sysid, "offboard_stop")),
+          armResults(results<Action::Result>(sysid, "arm")),
+          takeoffResults(results<Action::Result>(sysid, "takeoff")),
+          landResults(results<Action::Result>(sysid, "land")),
+          holdResults(results<Action::Result>(sysid, "hold")),
+          missionUploadResults(results<MissionRaw::Result>(sysid, "mission_upload")),
+          missionStartResults(results<MissionRaw::Result>(sysid, "mission_start")),
+          missionUploadsCached(Metrics::instance().counter("tracking_mission_uploads_cached_total",
+                                                           "Mission uploads skipped, the vehicle held the plan",
+                                                           "sysid=\"" + to_string(sysid) + "\"")) {
 }
 
 /**
@@ -48,33 +128,178 @@ void plane::debug(bool detailed = false) const {
         const Info::Version& system_version = info.get_version().second;
 
         // Print out the vehicle version information.
-        std::cout << system_version << std::endl;
+        LOG_INFO("Plane {}: flight software {}.{}.{} ({}), OS {}.{}.{}", sysid, system_version.flight_sw_major,
+                 system_version.flight_sw_minor, system_version.flight_sw_patch, system_version.flight_sw_git_hash,
+                 system_version.os_sw_major, system_version.os_sw_minor, system_version.os_sw_patch);
         return;
     }
-    cout << "Plane ID " << sysid << " has been loaded!" << endl;
-    cout << "Information: " << endl;
-    cout << "Latitude: " << latitude << " Longitude: " << longitude << " Altitude: " << altitude << endl;
-    cout << "Main Plane: " << (isMain ? "true" : "false") << endl;
+    const PoseSnapshot snapshot = pose.load();
+    LOG_INFO("Plane {}: loaded at latitude {} longitude {} altitude {} m, main plane: {}", sysid,
+             snapshot.latitude_deg, snapshot.longitude_deg, snapshot.absolute_altitude_m, isMain ? "yes" : "no");
 }
 
 /**
  * Initialize the plane object
  * This function is called in the constructor
  * It sets the system id, latitude, longitude and altitude
- * It also subscribes to the position of the plane
+ * It asks for the GPS global origin without waiting for the answer and caches it;
+ * the cache is refreshed asynchronously when the vehicle reports a new home position, and again on
+ * later home reports until a request succeeds.
+ * Nothing here blocks on the vehicle, so planes can be constructed side by side.
+ * It also subscribes to the position, velocity, attitude, fixed-wing metrics and
+ * heading of the plane. Every callback publishes into the same pose snapshot, so
+ * readers always get a consistent copy without locking or querying the vehicle.
+ * Callbacks only take the receive time and hand the sample to the plane's
+ * callback worker, so the MAVSDK receive thread never runs plane code.
+ * Setpoints are sent from the plane's command queue thread, never from the caller.
+ * @param rates telemetry stream rates to request
+ * @param commandRates max send and keep-alive rates for setpoints
  * @return void
  */
-void plane::init() {
+void plane::init(const TelemetryRates &rates, const CommandQueue::Config &commandRates) {
     sysid = system->get_system_id();
-    Telemetry::GpsGlobalOrigin origin = telemetry.get_gps_global_origin().second;
-    latitude = origin.latitude_deg;
-    longitude = origin.longitude_deg;
-    altitude = origin.altitude_m;
-     telemetry.subscribe_position([this](Telemetry::Position position) {
-        latitude = position.latitude_deg;
-        longitude = position.longitude_deg;
-        altitude = position.absolute_altitude_m;
-        //cout << "Position updated: " << latitude << " " << longitude << " " << altitude << endl;
+    callbackGate = std::make_shared<CallbackGate>(CallbackExecutor::instance(), static_cast<size_t>(sysid));
+    instruments = std::make_unique<Instruments>(sysid);
+    link = std::make_unique<LinkMonitor>(sysid);
+    commands = std::make_unique<CommandQueue>(commandRates, [this](const OutboundCommand &command) {
+        return transmit(command);
+    }, "sysid=\"" + to_string(sysid) + "\"");
+    commands->start();
+    survey = std::make_unique<CameraPipeline>(sysid);
+    setTelemetryRates(rates);
+    // Don't hold up construction for the round trip; offLocal() refuses until the origin is cached.
+    originRefreshPending.store(true);
+    telemetry.get_gps_global_origin_async([this, gate = callbackGate](Telemetry::Result result,
+                                                                      Telemetry::GpsGlobalOrigin gpsOrigin) {
+        gate->post([this, result, gpsOrigin] {
+            if (result == Telemetry::Result::Success) {
+                storeOrigin(gpsOrigin);
+                // Until the first fix the origin is the best position there is.
+                pose.update([&gpsOrigin](PoseSnapshot &snapshot) {
+                    if (!snapshot.hasFix()) {
+                        snapshot.latitude_deg = gpsOrigin.latitude_deg;
+                        snapshot.longitude_deg = gpsOrigin.longitude_deg;
+                        snapshot.absolute_altitude_m = gpsOrigin.altitude_m;
+                    }
+                });
+            } else {
+                LOG_WARN("Plane {}: GPS global origin unavailable: {}", sysid, result);
+            }
+            originRefreshPending.store(false);
+        });
+    });
+    telemetry.subscribe_landed_state([this, gate = callbackGate](Telemetry::LandedState state) {
+        gate->post([this, state] {
+            if (landedState.exchange(state) != state) {
+                // Lock so a waiter can't miss the notify between its check and its wait.
+                std::lock_guard<std::mutex> lock(stateMutex);
+                stateChanged.notify_all();
+            }
+        });
+    });
+    telemetry.subscribe_health_all_ok([this, gate = callbackGate](bool ok) {
+        gate->post([this, ok] {
+            if (healthy.exchange(ok) != ok) {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                stateChanged.notify_all();
+            }
+        });
+    });
+    telemetry.subscribe_home([this, gate = callbackGate](Telemetry::Position position) {
+        gate->post([this, position] {
+            if (position.latitude_deg == home.latitude_deg && position.longitude_deg == home.longitude_deg
+                && position.absolute_altitude_m == home.absolute_altitude_m) {
+                return;
+            }
+            refreshOrigin(position);
+        });
+    });
+    telemetry.subscribe_position([this, gate = callbackGate](Telemetry::Position position) {
+        const auto now = PoseSnapshot::Clock::now();
+        gate->post([this, position, now] {
+            instruments->position.arrived(now);
+            pose.update([&position, now](PoseSnapshot &snapshot) {
+                snapshot.latitude_deg = position.latitude_deg;
+                snapshot.longitude_deg = position.longitude_deg;
+                snapshot.absolute_altitude_m = position.absolute_altitude_m;
+                snapshot.relative_altitude_m = position.relative_altitude_m;
+                snapshot.positionTime = now;
+                snapshot.received = now;
+            });
+            estimator.updatePosition(position.latitude_deg, position.longitude_deg, position.absolute_altitude_m, now);
+            if (!hasPosition.load(std::memory_order_relaxed) && !hasPosition.exchange(true)) {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                stateChanged.notify_all();
+            }
+            if (survey->isRunning()) {
+                survey->recordPose(pose.load());
+            }
+            record(RecordKind::Position, [&position](FlightRecord &entry) {
+                entry.latitude_e7 = FlightRecord::toE7(position.latitude_deg);
+                entry.longitude_e7 = FlightRecord::toE7(position.longitude_deg);
+                entry.altitude_m = position.absolute_altitude_m;
+            });
+        });
+    });
+    telemetry.subscribe_velocity_ned([this, gate = callbackGate](Telemetry::VelocityNed velocity) {
+        const auto now = PoseSnapshot::Clock::now();
+        gate->post([this, velocity, now] {
+            instruments->velocity.arrived(now);
+            pose.update([&velocity, now](PoseSnapshot &snapshot) {
+                snapshot.north_m_s = velocity.north_m_s;
+                snapshot.east_m_s = velocity.east_m_s;
+                snapshot.down_m_s = velocity.down_m_s;
+                snapshot.received = now;
+            });
+            estimator.updateVelocity(velocity.north_m_s, velocity.east_m_s, velocity.down_m_s, now);
+            record(RecordKind::Velocity, [&velocity](FlightRecord &entry) {
+                entry.north_m_s = velocity.north_m_s;
+                entry.east_m_s = velocity.east_m_s;
+                entry.down_m_s = velocity.down_m_s;
+            });
+        });
+    });
+    telemetry.subscribe_attitude_euler([this, gate = callbackGate](Telemetry::EulerAngle attitude) {
+        const auto now = PoseSnapshot::Clock::now();
+        gate->post([this, attitude, now] {
+            instruments->attitude.arrived(now);
+            pose.update([&attitude, now](PoseSnapshot &snapshot) {
+                snapshot.roll_deg = attitude.roll_deg;
+                snapshot.pitch_deg = attitude.pitch_deg;
+                snapshot.yaw_deg = attitude.yaw_deg;
+                snapshot.received = now;
+            });
+            record(RecordKind::Attitude, [&attitude](FlightRecord &entry) {
+                entry.roll_deg = attitude.roll_deg;
+                entry.pitch_deg = attitude.pitch_deg;
+                entry.yaw_deg = attitude.yaw_deg;
+            });
+        });
+    });
+    telemetry.subscribe_fixedwing_metrics([this, gate = callbackGate](Telemetry::FixedwingMetrics metrics) {
+        const auto now = PoseSnapshot::Clock::now();
+        gate->post([this, metrics, now] {
+            instruments->fixedwingMetrics.arrived(now);
+            pose.update([&metrics, now](PoseSnapshot &snapshot) {
+                snapshot.airspeed_m_s = metrics.airspeed_m_s;
+                snapshot.climb_rate_m_s = metrics.climb_rate_m_s;
+                snapshot.throttle_percentage = metrics.throttle_percentage;
+                snapshot.received = now;
+            });
+            record(RecordKind::FixedwingMetrics, [&metrics](FlightRecord &entry) {
+                entry.value = metrics.airspeed_m_s;
+                entry.down_m_s = -metrics.climb_rate_m_s;
+            });
+        });
+    });
+    telemetry.subscribe_heading([this, gate = callbackGate](Telemetry::Heading heading) {
+        const auto now = PoseSnapshot::Clock::now();
+        gate->post([this, heading, now] {
+            pose.update([&heading, now](PoseSnapshot &snapshot) {
+                snapshot.heading_deg = heading.heading_deg;
+                snapshot.received = now;
+            });
+        });
     });
 
     debug();
@@ -85,11 +310,76 @@ void plane::init() {
  * @return void
  */
 void plane::checkHealth() const {
-    while (!telemetry.health_all_ok()) {
-        cout << "Waiting for system to be ready\n";
-        sleep_for(seconds(1));
+    if (!healthy.load()) {
+        LOG_INFO("Plane {}: waiting for system to be ready", sysid);
+        waitForHealthy(milliseconds::max());
+    }
+    LOG_INFO("Plane {}: system is ready", sysid);
+}
+
+/**
+ * Wait for the vehicle to reach a landed state
+ * @param state landed state to wait for
+ * @param timeout maximum time to wait
+ * @return true if the state was reached
+ * @return false if timed out
+ */
+bool plane::waitFor(Telemetry::LandedState state, milliseconds timeout) const {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    auto reached = [this, state] { return landedState.load() == state; };
+    if (timeout == milliseconds::max()) {
+        stateChanged.wait(lock, reached);
+        return true;
+    }
+    return stateChanged.wait_for(lock, timeout, reached);
+}
+
+/**
+ * Wait for all health checks to pass
+ * @param timeout maximum time to wait
+ * @return true if healthy
+ * @return false if timed out
+ */
+bool plane::waitForHealthy(milliseconds timeout) const {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    auto ok = [this] { return healthy.load(); };
+    if (timeout == milliseconds::max()) {
+        stateChanged.wait(lock, ok);
+        return true;
     }
-    cout << "System is ready\n";
+    return stateChanged.wait_for(lock, timeout, ok);
+}
+
+/**
+ * Wait for the first position fix
+ * @param timeout maximum time to wait
+ * @return true if the plane has a position
+ * @return false if timed out
+ */
+bool plane::waitForPosition(milliseconds timeout) const {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    auto fixed = [this] { return hasPosition.load(); };
+    if (timeout == milliseconds::max()) {
+        stateChanged.wait(lock, fixed);
+        return true;
+    }
+    return stateChanged.wait_for(lock, timeout, fixed);
+}
+
+/**
+ * Wait for the GPS global origin
+ * @param timeout maximum time to wait
+ * @return true if the origin is cached
+ * @return false if timed out
+ */
+bool plane::waitForOrigin(milliseconds timeout) const {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    auto resolved = [this] { return origin.load().valid; };
+    if (timeout == milliseconds::max()) {
+        stateChanged.wait(lock, resolved);
+        return true;
+    }
+    return stateChanged.wait_for(lock, timeout, resolved);
 }
 
 /**
@@ -99,25 +389,16 @@ void plane::checkHealth() const {
  */
 bool plane::takeoff() {
     const auto takeoff_result = action.takeoff();
+    instruments->takeoffResults.count(takeoff_result);
     if (takeoff_result != Action::Result::Success) {
-        cerr << "Takeoff failed: " << takeoff_result << '\n';
+        LOG_ERROR("Plane {}: takeoff failed: {}", sysid, takeoff_result);
         return false;
     }
-    auto in_air_promise = promise<void>{};
-    auto in_air_future = in_air_promise.get_future();
-    Telemetry::LandedStateHandle handle = telemetry.subscribe_landed_state(
-            [this, &in_air_promise, &handle](Telemetry::LandedState state) {
-                if (state == Telemetry::LandedState::InAir) {
-                    cout << "Taking off has finished\n.";
-                    telemetry.unsubscribe_landed_state(handle);
-                    in_air_promise.set_value();
-                }
-            });
-    in_air_future.wait_for(seconds(10));
-    if (in_air_future.wait_for(seconds(3)) == future_status::timeout) {
-        cerr << "Takeoff timed out.\n";
+    if (!waitFor(Telemetry::LandedState::InAir, seconds(13))) {
+        LOG_ERROR("Plane {}: takeoff timed out", sysid);
         return false;
     }
+    LOG_INFO("Plane {}: takeoff finished", sysid);
     return true;
 }
 
@@ -128,47 +409,383 @@ bool plane::takeoff() {
  */
 bool plane::arm() const {
     const auto arm_result = action.arm();
+    instruments->armResults.count(arm_result);
     if (arm_result != Action::Result::Success) {
-        cerr << "Arming failed: " << arm_result << '\n';
+        LOG_ERROR("Plane {}: arming failed: {}", sysid, arm_result);
         return false;
     }
-    cout << "Armed\n";
+    LOG_INFO("Plane {}: armed", sysid);
     return true;
 }
 
+namespace {
+/**
+ * Promise for an action result, and the MAVSDK callback that fulfils it
+ * The callback holds copies of the counters, which live as long as the process,
+ * so an answer arriving after the plane is gone touches nothing of it.
+ * @param results counters for the result codes
+ * @return pair of the future and the callback to pass to the *_async call
+ */
+pair<future<Action::Result>, Action::ResultCallback> actionResult(const ResultCounters &results) {
+    auto done = make_shared<promise<Action::Result>>();
+    future<Action::Result> result = done->get_future();
+    return {std::move(result), [done, results](Action::Result answer) {
+        results.count(answer);
+        done->set_value(answer);
+    }};
+}
+
+/**
+ * Promise for a mission result, and the MAVSDK callback that fulfils it
+ * @return pair of the future and the callback to pass to the *_async call
+ */
+pair<future<MissionRaw::Result>, MissionRaw::ResultCallback> missionResult() {
+    auto done = make_shared<promise<MissionRaw::Result>>();
+    future<MissionRaw::Result> result = done->get_future();
+    return {std::move(result), [done](MissionRaw::Result answer) {
+        done->set_value(answer);
+    }};
+}
+
+/**
+ * Wait for a mission result until the deadline
+ * @return MissionRaw::Result the answer, Timeout if none came in time
+ */
+MissionRaw::Result awaitMission(future<MissionRaw::Result> &result, chrono::steady_clock::time_point deadline) {
+    if (result.wait_until(deadline) != future_status::ready) {
+        return MissionRaw::Result::Timeout;
+    }
+    return result.get();
+}
+}
+
+/**
+ * Send the arm command without waiting
+ * @return future with the autopilot's answer, or Timeout from MAVSDK
+ */
+future<Action::Result> plane::armAsync() {
+    auto [result, callback] = actionResult(instruments->armResults);
+    action.arm_async(callback);
+    return std::move(result);
+}
+
+/**
+ * Send the takeoff command without waiting
+ * The future only says whether the autopilot took it; wait for InAir to know it flew.
+ * @return future with the autopilot's answer, or Timeout from MAVSDK
+ */
+future<Action::Result> plane::takeoffAsync() {
+    auto [result, callback] = actionResult(instruments->takeoffResults);
+    action.takeoff_async(callback);
+    return std::move(result);
+}
+
+/**
+ * Send the land command without waiting
+ * The future only says whether the autopilot took it; wait for OnGround to know it landed.
+ * @return future with the autopilot's answer, or Timeout from MAVSDK
+ */
+future<Action::Result> plane::landAsync() {
+    auto [result, callback] = actionResult(instruments->landResults);
+    action.land_async(callback);
+    return std::move(result);
+}
+
 /**
  * Offset the plane in global coordinates
+ * Deprecated: the offsets are added to the origin's degrees, so the same offset
+ * is a different distance at every latitude. Use offLocal, which takes meters.
  * @warning Parameters are only offset, not the actual coordinates.
- * @warning Do note that when you want to get increase altitude, you have to use negative values.
- * @param latOff latitude offset
- * @param longOff  longitude offset
- * @param altOff altitude offset
+ * @param latOff latitude offset in degrees
+ * @param longOff longitude offset in degrees
+ * @param altOff meters up from the current altitude above home
  * @param yawOff yaw offset
- * @return true if success
+ * @return true if the setpoint was queued
  * @return false if failed
  */
 bool plane::offGlobal(double latOff, double longOff, double altOff, double yawOff) const {
+    const GlobalOrigin cached = origin.load();
+    if (!cached.valid) {
+        LOG_WARN("Plane {}: GPS global origin is not known yet", sysid);
+        return false;
+    }
+
+    OutboundCommand command;
+    command.kind = OutboundCommand::Kind::PositionGlobalRelative;
+    command.latitude_deg = cached.latitude_deg + latOff;
+    command.longitude_deg = cached.longitude_deg + longOff;
+    // Relative to home, like the setpoint kind; an AMSL altitude here would add the field elevation.
+    command.altitude_m = static_cast<float>(pose.load().relative_altitude_m + altOff);
+    command.yaw_deg = static_cast<float>(yawOff);
+    return commands->submit(command);
+}
+
+/**
+ * Store a resolved GPS global origin in the cache
+ * @param gpsOrigin origin reported by the vehicle
+ * @return void
+ */
+void plane::storeOrigin(const Telemetry::GpsGlobalOrigin &gpsOrigin) {
+    GlobalOrigin resolved;
+    resolved.latitude_deg = gpsOrigin.latitude_deg;
+    resolved.longitude_deg = gpsOrigin.longitude_deg;
+    resolved.altitude_m = gpsOrigin.altitude_m;
+    resolved.valid = true;
+    origin.store(resolved);
+    std::lock_guard<std::mutex> lock(stateMutex);
+    stateChanged.notify_all();
+}
+
+/**
+ * Re-resolve the GPS global origin without blocking
+ * At most one request is in flight; the cache keeps the old value until it answers.
+ * The home position is only taken as handled once the origin resolves, so a
+ * home report that finds a request in flight, or one whose request fails, is
+ * retried on the next report instead of being forgotten.
+ * @param reportedHome home position that prompted the refresh
+ * @return void
+ */
+void plane::refreshOrigin(const Telemetry::Position &reportedHome) {
+    bool expected = false;
+    if (!originRefreshPending.compare_exchange_strong(expected, true)) {
+        return;
+    }
+    telemetry.get_gps_global_origin_async([this, gate = callbackGate, reportedHome](
+            Telemetry::Result result, Telemetry::GpsGlobalOrigin gpsOrigin) {
+        gate->post([this, result, gpsOrigin, reportedHome] {
+            if (result == Telemetry::Result::Success) {
+                storeOrigin(gpsOrigin);
+                home = reportedHome;
+            } else {
+                LOG_WARN("Plane {}: GPS global origin refresh failed: {}", sysid, result);
+            }
+            originRefreshPending.store(false);
+        });
+    });
+}
+
+/**
+ * Offset the plane from the GPS global origin in meters
+ * Unlike offGlobal the offsets are metric, so they mean the same distance at any latitude.
+ * @param north_m meters north of the origin
+ * @param east_m meters east of the origin
+ * @param altOff meters up from the current altitude above home
+ * @param yawDeg yaw in degrees
+ * @return true if the setpoint was queued
+ * @return false if failed
+ */
+bool plane::offLocal(double north_m, double east_m, double altOff, double yawDeg) const {
+    const GlobalOrigin cached = origin.load();
+    if (!cached.valid) {
+        LOG_WARN("Plane {}: GPS global origin is not known yet", sysid);
+        return false;
+    }
+    const geodesy::Geodetic target = geodesy::offset({cached.latitude_deg, cached.longitude_deg, cached.altitude_m},
+                                                     north_m, east_m, 0.0);
+    OutboundCommand command;
+    command.kind = OutboundCommand::Kind::PositionGlobalRelative;
+    command.latitude_deg = target.latitude_deg;
+    command.longitude_deg = target.longitude_deg;
+    // Relative to home, like the setpoint kind; an AMSL altitude here would add the field elevation.
+    command.altitude_m = static_cast<float>(pose.load().relative_altitude_m + altOff);
+    command.yaw_deg = static_cast<float>(yawDeg);
+    return commands->submit(command);
+}
+
+/**
+ * Queue an absolute global position setpoint
+ * Unlike offGlobal this does no lookups and no logging, it is meant for control loops.
+ * @param lat latitude in degrees
+ * @param lon longitude in degrees
+ * @param altAmsl altitude above mean sea level in meters
+ * @param yawDeg yaw in degrees
+ * @return true if the setpoint was queued
+ * @return false if the queue is stopped
+ */
+bool plane::sendPositionGlobal(double lat, double lon, float altAmsl, float yawDeg) const {
+    OutboundCommand command;
+    command.kind = OutboundCommand::Kind::PositionGlobal;
+    command.latitude_deg = lat;
+    command.longitude_deg = lon;
+    command.altitude_m = altAmsl;
+    command.yaw_deg = yawDeg;
+    return commands->submit(command);
+}
 
-    const auto res_and_gps_origin = telemetry.get_gps_global_origin();
-    if (res_and_gps_origin.first != Telemetry::Result::Success) {
-        cerr << "Telemetry failed: " << res_and_gps_origin.first << '\n';
+/**
+ * Queue a velocity setpoint in the NED frame
+ * No lookups and no logging, meant for control loops.
+ * @param north_m_s north velocity
+ * @param east_m_s east velocity
+ * @param down_m_s down velocity
+ * @param yawDeg yaw in degrees
+ * @return true if the setpoint was queued
+ * @return false if the queue is stopped
+ */
+bool plane::sendVelocityNed(float north_m_s, float east_m_s, float down_m_s, float yawDeg) const {
+    OutboundCommand command;
+    command.kind = OutboundCommand::Kind::VelocityNed;
+    command.north_m_s = north_m_s;
+    command.east_m_s = east_m_s;
+    command.down_m_s = down_m_s;
+    command.yaw_deg = yawDeg;
+    return commands->submit(command);
+}
+
+/**
+ * Queue a global position setpoint with a velocity feed-forward
+ * @param lat latitude in degrees
+ * @param lon longitude in degrees
+ * @param altAmsl altitude above mean sea level in meters
+ * @param north_m_s north velocity feed-forward
+ * @param east_m_s east velocity feed-forward
+ * @param down_m_s down velocity feed-forward
+ * @param yawDeg yaw in degrees
+ * @return true if the setpoint was queued
+ * @return false if the origin is not known yet or the queue is stopped
+ */
+bool plane::sendPositionVelocity(double lat, double lon, float altAmsl,
+                                 float north_m_s, float east_m_s, float down_m_s, float yawDeg) const {
+    if (!origin.load().valid) {
+        return false;
     }
+    OutboundCommand command;
+    command.kind = OutboundCommand::Kind::PositionVelocity;
+    command.latitude_deg = lat;
+    command.longitude_deg = lon;
+    command.altitude_m = altAmsl;
+    command.north_m_s = north_m_s;
+    command.east_m_s = east_m_s;
+    command.down_m_s = down_m_s;
+    command.yaw_deg = yawDeg;
+    return commands->submit(command);
+}
 
-    cout << "Reading home position in Global coordinates\n";
-    cout << "Origin (lat, lon, alt amsl):\n " << res_and_gps_origin.second << '\n';
+/**
+ * Send a queued setpoint through its MAVSDK plugin and record it
+ * Runs on the command queue thread only.
+ * @param command setpoint to send
+ * @return true if MAVSDK accepted it
+ */
+bool plane::transmit(const OutboundCommand &command) const {
+    switch (command.kind) {
+        case OutboundCommand::Kind::PositionGlobal:
+        case OutboundCommand::Kind::PositionGlobalRelative: {
+            const Offboard::PositionGlobalYaw positionGlobalYaw{
+                    command.latitude_deg, command.longitude_deg, command.altitude_m, command.yaw_deg,
+                    command.kind == OutboundCommand::Kind::PositionGlobal
+                    ? Offboard::PositionGlobalYaw::AltitudeType::Amsl
+                    : Offboard::PositionGlobalYaw::AltitudeType::RelHome};
+            const bool sent = setPositionGlobal(positionGlobalYaw);
+            recordPositionCommand(positionGlobalYaw, sent);
+            return sent;
+        }
+        case OutboundCommand::Kind::VelocityNed:
+            return setVelocityNed({command.north_m_s, command.east_m_s, command.down_m_s, command.yaw_deg});
+        case OutboundCommand::Kind::PositionVelocity:
+            return setPositionVelocity(command);
+        case OutboundCommand::Kind::FollowTarget: {
+            FollowMe::TargetLocation location;
+            location.latitude_deg = command.latitude_deg;
+            location.longitude_deg = command.longitude_deg;
+            location.absolute_altitude_m = command.altitude_m;
+            location.velocity_x_m_s = command.north_m_s;
+            location.velocity_y_m_s = command.east_m_s;
+            location.velocity_z_m_s = command.down_m_s;
+            const bool sent = setFollowTarget(location);
+            recordFollowTarget(location, sent);
+            return sent;
+        }
+    }
+    return false;
+}
 
-    Telemetry::GpsGlobalOrigin origin = res_and_gps_origin.second;
-    cout << "Applying offset\n";
-    const Offboard::PositionGlobalYaw positionGlobalYaw{
-            origin.latitude_deg + latOff,
-            origin.longitude_deg + longOff,
-            static_cast<float>(altitude + altOff),
-            static_cast<float>(yawOff),
-            Offboard::PositionGlobalYaw::AltitudeType::RelHome};
-    offboard.set_position_global(positionGlobalYaw);
+/**
+ * Send a velocity setpoint, timing the call, counting its result and recording it
+ * @param setpoint setpoint to send
+ * @return true if MAVSDK accepted it
+ */
+bool plane::setVelocityNed(const Offboard::VelocityNedYaw &setpoint) const {
+    const auto start = PoseSnapshot::Clock::now();
+    const Offboard::Result result = offboard.set_velocity_ned(setpoint);
+    instruments->velocitySend.record(PoseSnapshot::Clock::now() - start);
+    instruments->velocityResults.count(result);
+    const bool sent = result == Offboard::Result::Success;
+    record(RecordKind::CommandVelocityNed, [&setpoint, sent](FlightRecord &entry) {
+        entry.north_m_s = setpoint.north_m_s;
+        entry.east_m_s = setpoint.east_m_s;
+        entry.down_m_s = setpoint.down_m_s;
+        entry.yaw_deg = setpoint.yaw_deg;
+        entry.flags = sent ? 0 : FlightRecord::kFlagFailed;
+    });
+    return sent;
+}
 
-    return true;
+/**
+ * Send a position setpoint with velocity feed-forward, timing, counting and recording it
+ * MAVSDK takes this one in the local NED frame, which is anchored at the GPS
+ * global origin, so the position is converted through the cached origin.
+ * @param command PositionVelocity setpoint
+ * @return true if MAVSDK accepted it
+ * @return false if the origin is not known or MAVSDK failed
+ */
+bool plane::setPositionVelocity(const OutboundCommand &command) const {
+    const GlobalOrigin cached = origin.load();
+    if (!cached.valid) {
+        return false;
+    }
+    const geodesy::Ned local = geodesy::LocalFrame({cached.latitude_deg, cached.longitude_deg, cached.altitude_m})
+            .toNed({command.latitude_deg, command.longitude_deg, command.altitude_m});
+    const Offboard::PositionNedYaw position{static_cast<float>(local.north), static_cast<float>(local.east),
+                                            static_cast<float>(local.down), command.yaw_deg};
+    const Offboard::VelocityNedYaw velocity{command.north_m_s, command.east_m_s, command.down_m_s, command.yaw_deg};
+    const auto start = PoseSnapshot::Clock::now();
+    const Offboard::Result result = offboard.set_position_velocity_ned(position, velocity);
+    instruments->positionVelocitySend.record(PoseSnapshot::Clock::now() - start);
+    instruments->positionVelocityResults.count(result);
+    const bool sent = result == Offboard::Result::Success;
+    record(RecordKind::CommandPositionVelocity, [&command, sent](FlightRecord &entry) {
+        entry.latitude_e7 = FlightRecord::toE7(command.latitude_deg);
+        entry.longitude_e7 = FlightRecord::toE7(command.longitude_deg);
+        entry.altitude_m = command.altitude_m;
+        entry.north_m_s = command.north_m_s;
+        entry.east_m_s = command.east_m_s;
+        entry.down_m_s = command.down_m_s;
+        entry.yaw_deg = command.yaw_deg;
+        entry.flags = sent ? 0 : FlightRecord::kFlagFailed;
+    });
+    return sent;
+}
+
+/**
+ * Send a global position setpoint, timing the call and counting its result
+ * @param setpoint setpoint to send
+ * @return true if MAVSDK accepted it
+ */
+bool plane::setPositionGlobal(const Offboard::PositionGlobalYaw &setpoint) const {
+    const auto start = PoseSnapshot::Clock::now();
+    const Offboard::Result result = offboard.set_position_global(setpoint);
+    instruments->positionSend.record(PoseSnapshot::Clock::now() - start);
+    instruments->positionResults.count(result);
+    return result == Offboard::Result::Success;
+}
+
+/**
+ * Record a global position setpoint in the flight recorder, if one is attached
+ * @param setpoint setpoint as sent
+ * @param sent whether MAVSDK accepted it
+ * @return void
+ */
+void plane::recordPositionCommand(const Offboard::PositionGlobalYaw &setpoint, bool sent) const {
+    record(RecordKind::CommandPositionGlobal, [&setpoint, sent](FlightRecord &entry) {
+        entry.latitude_e7 = FlightRecord::toE7(setpoint.lat_deg);
+        entry.longitude_e7 = FlightRecord::toE7(setpoint.lon_deg);
+        entry.altitude_m = setpoint.alt_m;
+        entry.yaw_deg = setpoint.yaw_deg;
+        entry.flags = sent ? 0 : FlightRecord::kFlagFailed;
+    });
 }
+
 /**
  * Land the plane
  * @return true if success
@@ -176,16 +793,17 @@ bool plane::offGlobal(double latOff, double longOff, double altOff, double yawOf
  */
 bool plane::land() const {
     const auto land_result = action.land();
+    instruments->landResults.count(land_result);
     if (land_result != Action::Result::Success) {
-        cerr << "Landing failed: " << land_result << '\n';
+        LOG_ERROR("Plane {}: landing failed: {}", sysid, land_result);
         return false;
     }
-    // Check if vehicle is still in air
-    while (telemetry.in_air()) {
-        cout << "Vehicle is landing...\n";
-        sleep_for(seconds(1));
+    LOG_INFO("Plane {}: landing", sysid);
+    if (!waitFor(Telemetry::LandedState::OnGround, minutes(5))) {
+        LOG_ERROR("Plane {}: landing timed out", sysid);
+        return false;
     }
-    cout << "Landed!\n";
+    LOG_INFO("Plane {}: landed", sysid);
     return true;
 }
 
@@ -203,33 +821,34 @@ bool plane::isInAir() const {
  * @return false if failed
  */
 bool plane::startFollowing() {
-    cout << "Starting to follow...\n";
-    telemetry.subscribe_flight_mode([&](Telemetry::FlightMode flight_mode) {
-        const FollowMe::TargetLocation last_location = followMe.get_last_location();
-        cout << "[FlightMode: " << flight_mode
-             << "] Target is at: " << last_location.latitude_deg << ", "
-             << last_location.longitude_deg << " degrees.\n";
+    LOG_INFO("Plane {}: starting to follow", sysid);
+    telemetry.subscribe_flight_mode([this, gate = callbackGate](Telemetry::FlightMode flight_mode) {
+        gate->post([this, flight_mode] {
+            const FollowMe::TargetLocation last_location = followMe().get_last_location();
+            LOG_DEBUG("[FlightMode: {}] Target is at: {}, {} degrees", flight_mode,
+                      last_location.latitude_deg, last_location.longitude_deg);
+        });
     });
     FollowMe::Config config;
     config.follow_height_m = 12.f;  // Minimum height
     config.follow_angle_deg = 180.f;  // Follow from behind
-    FollowMe::Result config_result = followMe.set_config(config);
+    FollowMe::Result config_result = followMe().set_config(config);
     if (config_result != FollowMe::Result::Success) {
         // handle config-setting failure (in this case print error)
-        cout << "Setting configuration failed:" << config_result << '\n';
+        LOG_ERROR("Plane {}: setting follow configuration failed: {}", sysid, config_result);
         return false;
     }
 
-    cout << "Config Set\n";
+    LOG_DEBUG("Plane {}: follow configuration set", sysid);
 
-    FollowMe::Result follow_me_result = followMe.start();
+    FollowMe::Result follow_me_result = followMe().start();
     if (follow_me_result != FollowMe::Result::Success) {
         // handle start failure (in this case print error)
-        cout << "Failed to start following:" << follow_me_result << '\n';
+        LOG_ERROR("Plane {}: failed to start following: {}", sysid, follow_me_result);
         return false;
     }
 
-    cout << "Follow me started\n";
+    LOG_INFO("Plane {}: follow me started", sysid);
     return true;
 }
 
@@ -242,12 +861,81 @@ bool plane::startFollowing() {
  * @return void
  */
 void plane::follow(double lat, double lon, float alt = 0.0f) const {
-    cout << "Main plane location: " << latitude << " " << longitude << " " << altitude << "\n";
-    cout << "Target plane location: " << lat << " " << lon << " " << alt << "\n";
-    FollowMe::TargetLocation location;
-    location.latitude_deg = lat;
-    location.longitude_deg = lon;
-    followMe.set_target_location(location);
+    const PoseSnapshot snapshot = pose.load();
+    LOG_DEBUG("Main plane location: {} {} {}", snapshot.latitude_deg, snapshot.longitude_deg,
+              snapshot.absolute_altitude_m);
+    LOG_DEBUG("Target plane location: {} {} {}", lat, lon, alt);
+    // Only the position is given, the rest keeps MAVSDK's "not set" defaults.
+    const FollowMe::TargetLocation unset;
+    OutboundCommand command;
+    command.kind = OutboundCommand::Kind::FollowTarget;
+    command.latitude_deg = lat;
+    command.longitude_deg = lon;
+    command.altitude_m = unset.absolute_altitude_m;
+    command.north_m_s = unset.velocity_x_m_s;
+    command.east_m_s = unset.velocity_y_m_s;
+    command.down_m_s = unset.velocity_z_m_s;
+    commands->submit(command);
+}
+
+/**
+ * Follow another plane using its predicted position
+ * The target position is extrapolated to the send time, so link and telemetry
+ * latency does not leave the follower chasing where the target used to be.
+ * @param target plane to follow
+ * @return void
+ */
+void plane::follow(const plane &target) const {
+    const auto now = PoseSnapshot::Clock::now();
+    const PoseSnapshot predicted = target.predictPose(now);
+    if (!predicted.hasFix()) {
+        return;
+    }
+    if (now - target.getPose().positionTime > kMaxTargetAge) {
+        instruments->followStaleTargets.add();
+        return;
+    }
+    instruments->followPoseAge.record(now - predicted.positionTime);
+    OutboundCommand command;
+    command.kind = OutboundCommand::Kind::FollowTarget;
+    command.latitude_deg = predicted.latitude_deg;
+    command.longitude_deg = predicted.longitude_deg;
+    command.altitude_m = static_cast<float>(predicted.absolute_altitude_m);
+    command.north_m_s = predicted.north_m_s;
+    command.east_m_s = predicted.east_m_s;
+    command.down_m_s = predicted.down_m_s;
+    commands->submit(command);
+}
+
+/**
+ * Send a follow-me target, timing the call and counting its result
+ * @param location target to send
+ * @return true if MAVSDK accepted it
+ */
+bool plane::setFollowTarget(const FollowMe::TargetLocation &location) const {
+    const auto start = PoseSnapshot::Clock::now();
+    const FollowMe::Result result = followMe().set_target_location(location);
+    instruments->followTargetSend.record(PoseSnapshot::Clock::now() - start);
+    instruments->followTargetResults.count(result);
+    return result == FollowMe::Result::Success;
+}
+
+/**
+ * Record a follow-me target in the flight recorder, if one is attached
+ * @param location target as sent
+ * @param sent whether MAVSDK accepted it
+ * @return void
+ */
+void plane::recordFollowTarget(const FollowMe::TargetLocation &location, bool sent) const {
+    record(RecordKind::CommandFollowTarget, [&location, sent](FlightRecord &entry) {
+        entry.latitude_e7 = FlightRecord::toE7(location.latitude_deg);
+        entry.longitude_e7 = FlightRecord::toE7(location.longitude_deg);
+        entry.altitude_m = location.absolute_altitude_m;
+        entry.north_m_s = location.velocity_x_m_s;
+        entry.east_m_s = location.velocity_y_m_s;
+        entry.down_m_s = location.velocity_z_m_s;
+        entry.flags = sent ? 0 : FlightRecord::kFlagFailed;
+    });
 }
 
 /**
@@ -256,41 +944,48 @@ void plane::follow(double lat, double lon, float alt = 0.0f) const {
  * @return false if failed
  */
 bool plane::stopFollowing() const {
-    FollowMe::Result follow_me_result = followMe.stop();
+    commands->clear(CommandQueue::Channel::FollowTarget);
+    FollowMe::Result follow_me_result = followMe().stop();
     if (follow_me_result != FollowMe::Result::Success) {
         // handle stop failure (in this case print error)
-        cout << "Failed to stop following:" << follow_me_result << '\n';
+        LOG_ERROR("Plane {}: failed to stop following: {}", sysid, follow_me_result);
         return false;
     }
     return true;
 }
 
+/**
+ * Start offboard mode
+ * Uses the cached GPS global origin for the initial setpoint.
+ * @return true if success
+ * @return false if failed
+ */
 bool plane::startOffboard() {
-    cout << "Reading home position in Global coordinates\n";
-
-    const auto res_and_gps_origin = telemetry.get_gps_global_origin();
-    if (res_and_gps_origin.first != Telemetry::Result::Success) {
-        cerr << "Telemetry failed: " << res_and_gps_origin.first << '\n';
+    const GlobalOrigin cached = origin.load();
+    if (!cached.valid) {
+        LOG_WARN("Plane {}: GPS global origin is not known yet", sysid);
+        return false;
     }
 
-    Telemetry::GpsGlobalOrigin origin = res_and_gps_origin.second;
-    cerr << "Origin (lat, lon, alt amsl):\n " << origin << '\n';
-
-    cout << "Starting Offboard position control in Global coordinates\n";
+    LOG_INFO("Plane {}: starting offboard position control in global coordinates", sysid);
 
     // Send it once before starting offboard, otherwise it will be rejected.
-    // this is a step north about 10m, using the default altitude type (altitude relative to home)
-    const Offboard::PositionGlobalYaw north{
-            origin.latitude_deg + 0.0001, origin.longitude_deg, 90.0f, 0.0f};
+    // this is a step north of 10m, using the default altitude type (altitude relative to home)
+    const geodesy::Geodetic step = geodesy::offset({cached.latitude_deg, cached.longitude_deg, cached.altitude_m},
+                                                   10.0, 0.0, 0.0);
+    const Offboard::PositionGlobalYaw north{step.latitude_deg, step.longitude_deg, 90.0f, 0.0f};
     offboard.set_position_global(north);
 
     Offboard::Result offboard_result = offboard.start();
+    instruments->offboardStartResults.count(offboard_result);
     if (offboard_result != Offboard::Result::Success) {
-        cerr << "Offboard start failed: " << offboard_result << '\n';
+        LOG_ERROR("Plane {}: offboard start failed: {}", sysid, offboard_result);
         return false;
     }
 
-    cout << "Offboard started\n";
+    commands->setKeepAlive(CommandQueue::Channel::Offboard, true);
+    controlMode.store(ControlMode::Offboard);
+    LOG_INFO("Plane {}: offboard started", sysid);
     return true;
 }
 
@@ -300,23 +995,341 @@ bool plane::startOffboard() {
  * @return false if failed
  */
 bool plane::stopOffboard() {
+    commands->setKeepAlive(CommandQueue::Channel::Offboard, false);
+    commands->clear(CommandQueue::Channel::Offboard);
     Offboard::Result offboard_result = offboard.stop();
+    instruments->offboardStopResults.count(offboard_result);
     if (offboard_result != Offboard::Result::Success) {
-        cerr << "Offboard stop failed: " << offboard_result << '\n';
+        LOG_ERROR("Plane {}: offboard stop failed: {}", sysid, offboard_result);
         return false;
     }
-    cout << "Offboard stopped\n";
+    controlMode.store(ControlMode::None);
+    LOG_INFO("Plane {}: offboard stopped", sysid);
     return true;
 }
 
 /**
- * Get the airspeed of the plane
- * @return airspeed
+ * Hold at the current position without waiting for the autopilot
+ * The setpoint stream stops first, so the keep-alive cannot pull the vehicle
+ * back into offboard. The mode it interrupts, offboard or mission, is kept for
+ * resume(); a second loiter() keeps the first one's.
+ * @return true if the hold command was sent
  */
-double plane::getAirSpeed() const {
-    Telemetry::VelocityNed velocity = telemetry.velocity_ned();
-    return sqrt(velocity.east_m_s * velocity.east_m_s + velocity.north_m_s * velocity.north_m_s);
+bool plane::loiter() {
+    const ControlMode previous = controlMode.exchange(ControlMode::None);
+    if (previous != ControlMode::None) {
+        resumeMode.store(previous);
+    }
+    if (previous == ControlMode::Offboard) {
+        commands->setKeepAlive(CommandQueue::Channel::Offboard, false);
+        commands->clear(CommandQueue::Channel::Offboard);
+    }
+    LOG_WARN("Plane {}: loitering, link to the target is lost", sysid);
+    action.hold_async([this, gate = callbackGate](Action::Result result) {
+        gate->post([this, result] {
+            instruments->holdResults.count(result);
+            if (result != Action::Result::Success) {
+                LOG_ERROR("Plane {}: hold failed: {}", sysid, result);
+            }
+        });
+    });
+    return true;
 }
+
+/**
+ * Go back to what loiter() interrupted, without waiting for the autopilot
+ * Offboard is restarted with the vehicle's own position as the first setpoint,
+ * so it does not start on a stale one and the follow engine takes over from
+ * there; a mission continues from its current item.
+ * @return true if the previous mode is being restored
+ * @return false if loiter() interrupted nothing
+ */
+bool plane::resume() {
+    const ControlMode previous = resumeMode.exchange(ControlMode::None);
+    if (previous == ControlMode::Mission) {
+        LOG_INFO("Plane {}: link to the target is back, resuming the mission", sysid);
+        missionRaw().start_mission_async([this, gate = callbackGate](MissionRaw::Result result) {
+            gate->post([this, result] {
+                instruments->missionStartResults.count(result);
+                if (result != MissionRaw::Result::Success) {
+                    LOG_ERROR("Plane {}: mission resume failed: {}", sysid, result);
+                    return;
+                }
+                ControlMode expected = ControlMode::None;
+                controlMode.compare_exchange_strong(expected, ControlMode::Mission);
+            });
+        });
+        return true;
+    }
+    if (previous != ControlMode::Offboard) {
+        return false;
+    }
+    const PoseSnapshot here = pose.load();
+    Offboard::PositionGlobalYaw setpoint{here.latitude_deg, here.longitude_deg,
+                                         static_cast<float>(here.absolute_altitude_m), here.yaw_deg};
+    setpoint.altitude_type = Offboard::PositionGlobalYaw::AltitudeType::Amsl;
+    offboard.set_position_global(setpoint);
+    LOG_INFO("Plane {}: link to the target is back, resuming offboard", sysid);
+    offboard.start_async([this, gate = callbackGate](Offboard::Result result) {
+        gate->post([this, result] {
+            instruments->offboardStartResults.count(result);
+            if (result != Offboard::Result::Success) {
+                LOG_ERROR("Plane {}: offboard restart failed: {}", sysid, result);
+                return;
+            }
+            // Unless something else took control meanwhile.
+            ControlMode expected = ControlMode::None;
+            if (controlMode.compare_exchange_strong(expected, ControlMode::Offboard)) {
+                commands->setKeepAlive(CommandQueue::Channel::Offboard, true);
+            }
+        });
+    });
+    return true;
+}
+
+/**
+ * Upload a mission plan without waiting, unless the vehicle already holds it
+ * @param plan mission to upload
+ * @return future with the upload result, or Timeout from MAVSDK
+ */
+future<MissionRaw::Result> plane::uploadMission(const MissionPlan &plan) {
+    const uint64_t hash = plan.hash();
+    if (residentMission.load() == hash) {
+        instruments->missionUploadsCached.add();
+        promise<MissionRaw::Result> cached;
+        cached.set_value(MissionRaw::Result::Success);
+        return cached.get_future();
+    }
+
+    vector<MissionRaw::MissionItem> items;
+    items.reserve(plan.size());
+    for (const MissionPlan::Item &planned: plan.items()) {
+        MissionRaw::MissionItem item;
+        item.seq = static_cast<uint32_t>(items.size());
+        item.frame = planned.frame;
+        item.command = planned.command;
+        item.current = items.empty() ? 1 : 0;
+        item.autocontinue = 1;
+        item.param1 = planned.param1;
+        item.param2 = planned.param2;
+        item.param3 = planned.param3;
+        item.param4 = planned.param4;
+        item.x = planned.x;
+        item.y = planned.y;
+        item.z = planned.z;
+        items.push_back(item);
+    }
+
+    // Whatever the vehicle holds is unknown until this upload answers.
+    residentMission.store(0);
+    auto done = make_shared<promise<MissionRaw::Result>>();
+    future<MissionRaw::Result> result = done->get_future();
+    // The answer may come after startMission() gave up and the plane is gone: count through a copy, cache via the gate.
+    missionRaw().upload_mission_async(std::move(items), [this, gate = callbackGate, done, hash,
+            results = instruments->missionUploadResults](MissionRaw::Result answer) {
+        results.count(answer);
+        // The future only becomes ready once the cache is updated.
+        const bool posted = gate->post([this, done, hash, answer] {
+            if (answer == MissionRaw::Result::Success) {
+                residentMission.store(hash);
+            }
+            done->set_value(answer);
+        });
+        if (!posted) {
+            done->set_value(answer);
+        }
+    });
+    return result;
+}
+
+/**
+ * Fly a mission plan from its first item
+ * Offboard is not stopped on the way, that would put the vehicle in hold first:
+ * the mission is started while offboard is still active and the setpoint
+ * stream is only dropped once the autopilot has switched.
+ * Every step is asynchronous and waited for against one deadline, so a lost
+ * acknowledgement fails the call instead of holding up the caller.
+ * @param plan mission to fly
+ * @param timeout for the upload, rewind and start together
+ * @return true if the vehicle is flying the mission
+ * @return false if the upload or the start failed or timed out
+ */
+bool plane::startMission(const MissionPlan &plan, milliseconds timeout) {
+    if (plan.empty()) {
+        LOG_ERROR("Plane {}: mission plan is empty", sysid);
+        return false;
+    }
+    const auto deadline = chrono::steady_clock::now() + timeout;
+    const bool cached = residentMission.load() == plan.hash();
+    future<MissionRaw::Result> upload = uploadMission(plan);
+    if (upload.wait_until(deadline) != future_status::ready) {
+        // A late answer still updates the plan cache, nothing else waits on it.
+        missionRaw().cancel_mission_upload();
+        LOG_ERROR("Plane {}: mission upload timed out", sysid);
+        return false;
+    }
+    const MissionRaw::Result uploaded = upload.get();
+    if (uploaded != MissionRaw::Result::Success) {
+        LOG_ERROR("Plane {}: mission upload failed: {}", sysid, uploaded);
+        return false;
+    }
+    if (cached) {
+        // Flown before, maybe only partly: start over.
+        auto [rewind, callback] = missionResult();
+        missionRaw().set_current_mission_item_async(0, callback);
+        const MissionRaw::Result rewound = awaitMission(rewind, deadline);
+        if (rewound != MissionRaw::Result::Success) {
+            LOG_WARN("Plane {}: mission rewind failed: {}", sysid, rewound);
+        }
+    }
+
+    missionCurrent.store(0);
+    missionTotal.store(static_cast<int32_t>(plan.size()));
+    auto [start, callback] = missionResult();
+    missionRaw().start_mission_async(callback);
+    const MissionRaw::Result started = awaitMission(start, deadline);
+    instruments->missionStartResults.count(started);
+    if (started != MissionRaw::Result::Success) {
+        LOG_ERROR("Plane {}: mission start failed: {}", sysid, started);
+        return false;
+    }
+    if (controlMode.exchange(ControlMode::Mission) == ControlMode::Offboard) {
+        commands->setKeepAlive(CommandQueue::Channel::Offboard, false);
+        commands->clear(CommandQueue::Channel::Offboard);
+    }
+    LOG_INFO("Plane {}: flying a {} item mission{}", sysid, plan.size(), cached ? " (already uploaded)" : "");
+    return true;
+}
+
+/**
+ * Pause the mission, the vehicle holds where it is
+ * @return true if success
+ * @return false if failed
+ */
+bool plane::pauseMission() {
+    const MissionRaw::Result result = missionRaw().pause_mission();
+    if (result != MissionRaw::Result::Success) {
+        LOG_ERROR("Plane {}: mission pause failed: {}", sysid, result);
+        return false;
+    }
+    controlMode.store(ControlMode::None);
+    return true;
+}
+
+/**
+ * Wait for the mission to be finished
+ * @param timeout maximum time to wait
+ * @return true if the last item was reached
+ * @return false if timed out
+ */
+bool plane::waitForMission(milliseconds timeout) const {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    auto finished = [this] {
+        return missionTotal.load() > 0 && missionCurrent.load() >= missionTotal.load();
+    };
+    if (timeout == milliseconds::max()) {
+        stateChanged.wait(lock, finished);
+        return true;
+    }
+    return stateChanged.wait_for(lock, timeout, finished);
+}
+
+/**
+ * Request telemetry stream rates from the vehicle
+ * Requests are sent asynchronously, failures are only reported.
+ * Streams with a rate of 0 are left at the autopilot default.
+ * @param rates stream rates in Hz
+ * @return void
+ */
+void plane::setTelemetryRates(const TelemetryRates &rates) {
+    const int id = sysid;
+    auto report = [id](const char *stream) {
+        return [id, stream](Telemetry::Result result) {
+            if (result != Telemetry::Result::Success) {
+                LOG_WARN("Plane {}: setting {} rate failed: {}", id, stream, result);
+            }
+        };
+    };
+    if (rates.position_hz > 0) {
+        telemetry.set_rate_position_async(rates.position_hz, report("position"));
+    }
+    if (rates.velocity_hz > 0) {
+        telemetry.set_rate_velocity_ned_async(rates.velocity_hz, report("velocity"));
+    }
+    if (rates.attitude_hz > 0) {
+        telemetry.set_rate_attitude_euler_async(rates.attitude_hz, report("attitude"));
+    }
+    if (rates.fixedwingMetrics_hz > 0) {
+        telemetry.set_rate_fixedwing_metrics_async(rates.fixedwingMetrics_hz, report("fixed-wing metrics"));
+    }
+    if (rates.landedState_hz > 0) {
+        telemetry.set_rate_landed_state_async(rates.landedState_hz, report("landed state"));
+    }
+    if (rates.home_hz > 0) {
+        telemetry.set_rate_home_async(rates.home_hz, report("home"));
+    }
+}
+/**
+ * Predict the pose of the plane at the given time
+ * Position and velocity come from the estimator, attitude from the latest snapshot.
+ * @param when time to predict for, usually the command send time
+ * @return PoseSnapshot predicted pose
+ */
+PoseSnapshot plane::predictPose(PoseSnapshot::Clock::time_point when) const {
+    return estimator.predict(pose.load(), when);
+}
+
+/**
+ * The follow-me plugin, constructed by the first caller
+ * @return FollowMe& the plugin
+ */
+FollowMe &plane::followMe() const {
+    std::call_once(followMeCreated, [this] {
+        followMePlugin = std::make_unique<FollowMe>(*system);
+    });
+    return *followMePlugin;
+}
+
+/**
+ * The camera plugin, constructed by the first caller
+ * Camera discovery only starts then, so planes without a payload never pay for it.
+ * @return Camera& the plugin
+ */
+Camera &plane::camera() const {
+    std::call_once(cameraCreated, [this] {
+        cameraPlugin = std::make_unique<Camera>(*system);
+    });
+    return *cameraPlugin;
+}
+
+/**
+ * The mission plugin, constructed by the first caller along with its subscriptions
+ * @return MissionRaw& the plugin
+ */
+MissionRaw &plane::missionRaw() {
+    std::call_once(missionRawCreated, [this] {
+        missionRawPlugin = std::make_unique<MissionRaw>(*system);
+        missionRawPlugin->subscribe_mission_progress([this, gate = callbackGate](
+                MissionRaw::MissionProgress progress) {
+            gate->post([this, progress] {
+                missionCurrent.store(progress.current);
+                missionTotal.store(progress.total);
+                std::lock_guard<std::mutex> lock(stateMutex);
+                stateChanged.notify_all();
+            });
+        });
+        missionRawPlugin->subscribe_mission_changed([this, gate = callbackGate](bool changed) {
+            if (changed) {
+                // Someone else touched the mission, the next upload must not be skipped.
+                gate->post([this] {
+                    residentMission.store(0);
+                });
+            }
+        });
+    });
+    return *missionRawPlugin;
+}
+
 /**
  * Check if the plane has a camera
  * @param camera_id camera id
@@ -335,34 +1348,104 @@ bool plane::hasCamera(int camera_id = -1) const {
  * @return false if failed
  */
 bool plane::setCameraMode(Camera::Mode mode = Camera::Mode::Photo) {
-    Camera::Result result = camera.set_mode(mode);
+    Camera::Result result = camera().set_mode(mode);
     if (Camera::Result::Success != result) {
-        cerr << "Setting camera mode failed: " << result << '\n';
+        LOG_ERROR("Plane {}: setting camera mode failed: {}", sysid, result);
         return false;
     }else {
-        cout << "Camera mode set to: " << mode << '\n';
-
-        // this can be made a separate function, but for simplicity, it's here
-        camera.subscribe_capture_info([](const Camera::CaptureInfo& capture_info) {
-            std::cout << "Image captured, stored at: " << capture_info.file_url << '\n';
-        });
+        LOG_INFO("Plane {}: camera mode set to {}", sysid, mode);
+        subscribeCaptures();
         return true;
     }
 }
+
+/**
+ * Subscribe to capture info, only the first call does anything
+ * During a survey captures go straight into the pipeline's queue, which never
+ * blocks the MAVSDK thread; otherwise the file URL is logged.
+ * @return void
+ */
+void plane::subscribeCaptures() {
+    std::call_once(captureSubscription, [this] {
+        camera().subscribe_capture_info([this, gate = callbackGate](const Camera::CaptureInfo &capture_info) {
+            bool submitted = false;
+            // Under the gate, so the survey cannot be destroyed half way.
+            gate->call([this, &capture_info, &submitted] {
+                if (survey->isRunning()) {
+                    survey->submitCapture({capture_info.index, capture_info.time_utc_us, capture_info.is_success,
+                                           PoseSnapshot::Clock::now(), capture_info.file_url});
+                    submitted = true;
+                }
+            });
+            if (!submitted) {
+                gate->post([url = capture_info.file_url] {
+                    LOG_INFO("Image captured, stored at: {}", url);
+                });
+            }
+        });
+    });
+}
 /**
  * Take a photo
  * @return true if success
  * @return false if failed
  */
 bool plane::takePhoto() const {
-    const auto photo_result = camera.take_photo();
+    const auto photo_result = camera().take_photo();
     if (photo_result != Camera::Result::Success) {
-        std::cerr << "Taking Photo failed: " << photo_result;
+        LOG_ERROR("Plane {}: taking photo failed: {}", sysid, photo_result);
         return false;
     }
     return true;
 }
 
+/**
+ * Start a survey
+ * @param config trigger distance and/or interval
+ * @param geotagPath CSV file the geotags are appended to
+ * @return true if started
+ * @return false if a survey is already running or the file could not be opened
+ */
+bool plane::startSurvey(const CameraPipeline::Config &config, const std::string &geotagPath) {
+    subscribeCaptures();
+    if (!survey->start(config, [this](uint64_t trigger) { return triggerPhoto(trigger); }, geotagPath)) {
+        LOG_ERROR("Plane {}: survey could not start, geotags to {}", sysid, geotagPath);
+        return false;
+    }
+    LOG_INFO("Plane {}: survey started, geotags to {}", sysid, geotagPath);
+    return true;
+}
+
+/**
+ * Stop the survey
+ * @return void
+ */
+void plane::stopSurvey() {
+    survey->stop();
+}
+
+CameraPipeline::Stats plane::surveyStats() const {
+    return survey->stats();
+}
+
+/**
+ * Ask the camera for one photo without waiting for it
+ * Runs on the survey scheduler thread; the answer arrives on the MAVSDK thread.
+ * @param trigger survey trigger number, handed back with the answer
+ * @return true, the request itself cannot fail
+ */
+bool plane::triggerPhoto(uint64_t trigger) {
+    camera().take_photo_async([this, gate = callbackGate, trigger](Camera::Result result) {
+        gate->call([this, trigger, result] {
+            survey->onTriggerResult(trigger, result == Camera::Result::Success);
+            if (result != Camera::Result::Success) {
+                LOG_WARN("Plane {}: survey photo failed: {}", sysid, result);
+            }
+        });
+    });
+    return true;
+}
+
 /**
  * Start video recording
  * @param stream bool to if you want to stream the video
@@ -372,7 +1455,7 @@ bool plane::takePhoto() const {
  * @return false if failed
  */
 bool plane::startVideo(bool stream = false, int streamID = -1) const {
-    Camera::Result operation_result = stream ? camera.start_video_streaming(streamID) : camera.start_video();
+    Camera::Result operation_result = stream ? camera().start_video_streaming(streamID) : camera().start_video();
     return operation_result == Camera::Result::Success;
 }
 /**
@@ -385,7 +1468,7 @@ bool plane::startVideo(bool stream = false, int streamID = -1) const {
  * @return false if failed
  */
 bool plane::stopVideo(bool stream = false, int streamID = -1) const {
-    Camera::Result operation_result = stream ? camera.stop_video_streaming(streamID) : camera.stop_video();
+    Camera::Result operation_result = stream ? camera().stop_video_streaming(streamID) : camera().stop_video();
     return operation_result == Camera::Result::Success;
 }
 
@@ -23,40 +23,211 @@
 #ifndef TRACKING_PLANE_H
 #define TRACKING_PLANE_H
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <mavsdk/plugins/camera/camera.h>
 #include <mavsdk/plugins/follow_me/follow_me.h>
+#include <mavsdk/plugins/mission_raw/mission_raw.h>
 #include "mavsdk.h"
 #include "mavsdk/plugins/action/action.h"
 #include "mavsdk/plugins/offboard/offboard.h"
 #include "mavsdk/plugins/telemetry/telemetry.h"
+#include "CallbackExecutor.h"
+#include "CameraPipeline.h"
+#include "CommandQueue.h"
+#include "FlightRecorder.h"
+#include "LeaderEstimator.h"
+#include "LinkMonitor.h"
+#include "Metrics.h"
+#include "MissionPlan.h"
+#include "PoseSnapshot.h"
+#include "SeqLock.h"
+#include "Vehicle.h"
 
 using namespace mavsdk;
 using namespace std;
 using std::chrono::milliseconds;
+using std::chrono::minutes;
 using std::chrono::seconds;
 using std::this_thread::sleep_for;
 
-class plane {
+/**
+ * Telemetry stream rates requested from the vehicle, in Hz.
+ * A rate of 0 leaves that stream at the autopilot default.
+ */
+struct TelemetryRates {
+    double position_hz = 10.0;
+    double velocity_hz = 10.0;
+    double attitude_hz = 10.0;
+    double fixedwingMetrics_hz = 5.0;
+    double landedState_hz = 1.0;
+    double home_hz = 1.0;
+};
+
+class plane : public Vehicle {
 public:
-    plane(System *sharedPtr, bool isMain);
+    /// Who is steering the vehicle, as far as this plane has told it.
+    enum class ControlMode {
+        None,
+        Mission,
+        Offboard
+    };
+
+    /// Cached GPS global origin, resolved in the background at init and refreshed on home changes.
+    struct GlobalOrigin {
+        double latitude_deg{};
+        double longitude_deg{};
+        float altitude_m{};
+        bool valid{};
+    };
+
+    plane(System *sharedPtr, bool isMain, const TelemetryRates &rates = TelemetryRates{},
+          const CommandQueue::Config &commandRates = CommandQueue::Config{});
+    ~plane() override;
+
+    void setTelemetryRates(const TelemetryRates &rates);
+
+    /// Max send and keep-alive rates of the outbound setpoint queue.
+    void setCommandRates(const CommandQueue::Config &commandRates) {
+        commands->setConfig(commandRates);
+    };
 
+    /// Submitted, sent, coalesced and dropped setpoint counts.
+    CommandQueue::Stats commandStats() const {
+        return commands->stats();
+    };
+
+    /// Degree offsets cover a different distance at every latitude; offLocal() takes meters.
+    [[deprecated("use offLocal(), its offsets are in meters")]]
     bool offGlobal(double latOff, double longOff, double altOff, double yawOff) const;
+    bool offLocal(double north_m, double east_m, double altOff, double yawDeg) const;
+    bool sendPositionGlobal(double lat, double lon, float altAmsl, float yawDeg) const override;
+    bool sendVelocityNed(float north_m_s, float east_m_s, float down_m_s, float yawDeg) const override;
+    bool sendPositionVelocity(double lat, double lon, float altAmsl,
+                              float north_m_s, float east_m_s, float down_m_s, float yawDeg) const override;
     bool startOffboard();
     bool stopOffboard();
 
+    /**
+     * Upload the plan unless the vehicle already holds it.
+     * A plan with the same hash as the last successful upload costs no link traffic;
+     * the cache is dropped whenever the vehicle reports its mission changed.
+     * The answer is handed over on the callback worker, so don't wait for it there.
+     * @return future with the upload result, already Success when cached
+     */
+    std::future<MissionRaw::Result> uploadMission(const MissionPlan &plan);
+
+    /**
+     * Fly the plan from its first item, uploading it only if needed.
+     * Coming from offboard, the setpoint stream stops and the autopilot goes
+     * straight from offboard to mission mode; startOffboard() goes back the same way.
+     * Fails rather than blocks past the timeout when an acknowledgement is lost.
+     */
+    bool startMission(const MissionPlan &plan, milliseconds timeout = seconds(30));
+
+    bool pauseMission();
+
+    /// Current item and item count of the mission on the vehicle, -1/0 before any report.
+    std::pair<int32_t, int32_t> missionProgress() const {
+        return {missionCurrent.load(), missionTotal.load()};
+    };
+
+    /**
+     * Block until the vehicle reports the last mission item reached.
+     * Woken directly by the mission progress subscription, no polling.
+     * @return false on timeout
+     */
+    bool waitForMission(milliseconds timeout) const;
+
+    ControlMode getControlMode() const {
+        return controlMode.load();
+    };
+
+    /// Share of this vehicle's messages lost on the link over the last full window, 0..1.
+    double linkLoss() const override {
+        return link->recentLoss();
+    };
+
+    /// Fed by the fleet's MAVLink interceptors with every message to and from this vehicle.
+    LinkMonitor &linkMonitor() {
+        return *link;
+    };
+
+    LinkMonitor::Stats linkStats() const {
+        return link->stats(LinkMonitor::Clock::now());
+    };
+
+    /**
+     * Hold where the vehicle is, dropping the setpoint stream. Returns at once.
+     * Used by the follow engine when the leader's fix is too old to follow.
+     */
+    bool loiter() override;
+
+    /// Go back to the offboard or mission control that loiter() interrupted. Returns at once.
+    bool resume() override;
+
     void checkHealth() const;
 
+    /**
+     * Block until the vehicle reports the given landed state.
+     * Woken directly by the landed state subscription, no polling.
+     * @return false on timeout
+     */
+    bool waitFor(Telemetry::LandedState state, milliseconds timeout) const;
+
+    /**
+     * Block until all health checks pass.
+     * Woken directly by the health subscription, no polling.
+     * @return false on timeout
+     */
+    bool waitForHealthy(milliseconds timeout) const;
+
+    /**
+     * Block until the first position fix arrives.
+     * Woken directly by the position subscription, no polling.
+     * @return false on timeout
+     */
+    bool waitForPosition(milliseconds timeout) const;
+
+    /**
+     * Block until the GPS global origin is cached; offLocal() and startOffboard() refuse until then.
+     * Woken directly when the background request resolves, no polling.
+     * @return false on timeout
+     */
+    bool waitForOrigin(milliseconds timeout) const;
+
+    Telemetry::LandedState getLandedState() const {
+        return landedState.load();
+    };
+
+    bool isHealthy() const {
+        return healthy.load();
+    };
+
     bool arm() const;
 
     bool takeoff();
 
     bool land() const;
 
+    /// Send the command and return at once; the future gets the autopilot's answer.
+    std::future<Action::Result> armAsync();
+
+    std::future<Action::Result> takeoffAsync();
+
+    std::future<Action::Result> landAsync();
+
     bool startFollowing();
 
     void follow(double lat, double lon, float alt) const;
 
+    void follow(const plane &target) const;
+
     bool stopFollowing() const;
 
     bool isInAir() const;
@@ -71,20 +242,70 @@ public:
 
     bool stopVideo(bool stream, int streamID) const;
 
+    /**
+     * Take photos on a schedule and append their geotags to a CSV file.
+     * Returns at once; photos are triggered asynchronously and nothing waits on the camera.
+     * Put the camera in photo mode with setCameraMode() first.
+     */
+    bool startSurvey(const CameraPipeline::Config &config, const std::string &geotagPath);
+
+    /// Stop triggering and write the geotags of the photos already reported.
+    void stopSurvey();
+
+    CameraPipeline::Stats surveyStats() const;
+
     void debug(bool detailed) const;
 
     double getLatitude() const {
-        return latitude;
+        return pose.load().latitude_deg;
     };
 
     double getAltitude() const {
-        return altitude;
+        return pose.load().absolute_altitude_m;
     };
 
-    double getAirSpeed() const;
+    /// True airspeed from the fixed-wing metrics stream.
+    double getAirSpeed() const {
+        return pose.load().airspeed_m_s;
+    };
+
+    /// Horizontal speed over ground.
+    double getGroundSpeed() const {
+        return pose.load().groundSpeed_m_s();
+    };
+
+    double getHeading() const {
+        return pose.load().heading_deg;
+    };
+
+    double getClimbRate() const {
+        return pose.load().climb_rate_m_s;
+    };
 
     double getLongitude() const {
-        return longitude;
+        return pose.load().longitude_deg;
+    };
+
+    /**
+     * Consistent copy of the latest telemetry, safe to call from any thread.
+     * Never blocks the MAVSDK callback thread.
+     */
+    PoseSnapshot getPose() const override {
+        return pose.load();
+    };
+
+    /**
+     * Latest pose with position extrapolated to the given time by the estimator.
+     * Falls back to the raw snapshot until the estimator has a fix.
+     */
+    PoseSnapshot predictPose(PoseSnapshot::Clock::time_point when) const override;
+
+    GlobalOrigin getOrigin() const {
+        return origin.load();
+    };
+
+    int getSystemId() const override {
+        return sysid;
     };
 
     bool isMainPlane() const {
@@ -95,21 +316,120 @@ public:
         return telemetry;
     }
 
+    /// Record telemetry and sent commands into the given recorder, nullptr to stop. Must outlive the plane.
+    void setRecorder(FlightRecorder *flightRecorder) {
+        recorder.store(flightRecorder, std::memory_order_release);
+    };
+
+    /// Created on first use, most planes never follow-me or take photos.
+    FollowMe &followMe() const;
+
+    Camera &camera() const;
+
+    MissionRaw &missionRaw();
+
     System *system;
     Telemetry telemetry{*system};
     Action action{*system};
     Offboard offboard{*system};
-    FollowMe followMe{*system};
-    Camera camera{*system};
 
 private:
     int sysid{};
     [[maybe_unused]] int teamID{};
     int yaw{};
-    double latitude{};
-    double altitude{};
-    double longitude{};
-    void init();
+    SeqLock<PoseSnapshot> pose;
+    LeaderEstimator estimator;
+    SeqLock<GlobalOrigin> origin;
+    /// Home position the cached origin was last resolved for, only touched on the callback worker.
+    Telemetry::Position home{};
+    std::atomic<bool> originRefreshPending{false};
+    std::atomic<Telemetry::LandedState> landedState{Telemetry::LandedState::Unknown};
+    std::atomic<bool> healthy{false};
+    std::atomic<bool> hasPosition{false};
+    std::atomic<ControlMode> controlMode{ControlMode::None};
+    /// What loiter() interrupted and resume() restores, None when nothing.
+    std::atomic<ControlMode> resumeMode{ControlMode::None};
+    /// Hash of the plan the vehicle holds, 0 when unknown.
+    std::atomic<uint64_t> residentMission{0};
+    std::atomic<int32_t> missionCurrent{-1};
+    std::atomic<int32_t> missionTotal{0};
+    /// Guards nothing but the wait predicates above; notified on every state change.
+    mutable std::mutex stateMutex;
+    mutable std::condition_variable stateChanged;
+    std::atomic<FlightRecorder *> recorder{nullptr};
+    /// Subscription callbacks and async answers run on this plane's executor worker, keyed by system id. MAVSDK
+    /// callbacks capture the gate and only touch the plane through it, the destructor closes it.
+    std::shared_ptr<CallbackGate> callbackGate;
+
+    /// Timing and result instruments, registered once in init(), recorded without locks.
+    struct Instruments {
+        explicit Instruments(int sysid);
+
+        // Telemetry inter-arrival, each only touched by its own subscription callback.
+        IntervalRecorder position;
+        IntervalRecorder velocity;
+        IntervalRecorder attitude;
+        IntervalRecorder fixedwingMetrics;
+        // Time spent in the MAVSDK send call.
+        Histogram &positionSend;
+        Histogram &velocitySend;
+        Histogram &positionVelocitySend;
+        Histogram &followTargetSend;
+        /// Age of the target fix when follow(target) sends.
+        Histogram &followPoseAge;
+        /// follow(target) calls skipped because the target's fix was too old.
+        Counter &followStaleTargets;
+        ResultCounters positionResults;
+        ResultCounters velocityResults;
+        ResultCounters positionVelocityResults;
+        ResultCounters followTargetResults;
+        ResultCounters offboardStartResults;
+        ResultCounters offboardStopResults;
+        ResultCounters armResults;
+        ResultCounters takeoffResults;
+        ResultCounters landResults;
+        ResultCounters holdResults;
+        ResultCounters missionUploadResults;
+        ResultCounters missionStartResults;
+        /// Uploads skipped because the vehicle already held the plan.
+        Counter &missionUploadsCached;
+    };
+    std::unique_ptr<Instruments> instruments;
+    std::unique_ptr<LinkMonitor> link;
+    // Lazy plugins, constructing one subscribes to the system. Declared before the command queue, which sends through them.
+    mutable std::once_flag followMeCreated;
+    mutable std::unique_ptr<FollowMe> followMePlugin;
+    mutable std::once_flag cameraCreated;
+    mutable std::unique_ptr<Camera> cameraPlugin;
+    std::once_flag missionRawCreated;
+    std::unique_ptr<MissionRaw> missionRawPlugin;
+    /// Every setpoint goes out through here. Declared after the plugins and instruments, so its thread stops first.
+    std::unique_ptr<CommandQueue> commands;
+    /// Survey triggers and geotags, idle until startSurvey().
+    std::unique_ptr<CameraPipeline> survey;
+    /// Capture info is subscribed once, whatever the number of mode changes.
+    std::once_flag captureSubscription;
+
+    template<typename F>
+    void record(RecordKind kind, F &&fill) const {
+        FlightRecorder *active = recorder.load(std::memory_order_acquire);
+        if (active != nullptr) {
+            active->append(static_cast<uint8_t>(sysid), kind, fill);
+        }
+    }
+
+    void init(const TelemetryRates &rates, const CommandQueue::Config &commandRates);
+    void storeOrigin(const Telemetry::GpsGlobalOrigin &gpsOrigin);
+    void refreshOrigin(const Telemetry::Position &reportedHome);
+    bool transmit(const OutboundCommand &command) const;
+    bool setPositionGlobal(const Offboard::PositionGlobalYaw &setpoint) const;
+    bool setVelocityNed(const Offboard::VelocityNedYaw &setpoint) const;
+    bool setPositionVelocity(const OutboundCommand &command) const;
+    bool setFollowTarget(const FollowMe::TargetLocation &location) const;
+    void subscribeCaptures();
+    bool triggerPhoto(uint64_t trigger);
+    void recordPositionCommand(const Offboard::PositionGlobalYaw &setpoint, bool sent) const;
+    void recordFollowTarget(const FollowMe::TargetLocation &location, bool sent) const;
     bool isMain;
 };
 
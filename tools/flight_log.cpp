@@ -0,0 +1,96 @@
+// tracking - flight_log.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Streams a flight log written by FlightRecorder as CSV, oldest record first.
+// The file is read in fixed-size chunks, never loaded whole, and may still be
+// being written. Empty slots and slots rewritten while they were read are skipped.
+//
+// Usage: flight_log <file> [--sysid N]
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../FlightRecorder.h"
+
+using namespace std;
+
+namespace {
+const char *kindName(RecordKind kind) {
+    switch (kind) {
+        case RecordKind::Position:
+            return "position";
+        case RecordKind::Velocity:
+            return "velocity";
+        case RecordKind::Attitude:
+            return "attitude";
+        case RecordKind::FixedwingMetrics:
+            return "fixedwing_metrics";
+        case RecordKind::CommandPositionGlobal:
+            return "cmd_position_global";
+        case RecordKind::CommandVelocityNed:
+            return "cmd_velocity_ned";
+        case RecordKind::CommandFollowTarget:
+            return "cmd_follow_target";
+        case RecordKind::CommandPositionVelocity:
+            return "cmd_position_velocity";
+    }
+    return "unknown";
+}
+
+void printRecord(const FlightRecord &record, int64_t startWall_ns) {
+    const double wall_s = static_cast<double>(startWall_ns + record.timestamp_ns) / 1e9;
+    printf("%" PRIu64 ",%.6f,%u,%s,%.7f,%.7f,%.2f,%.3f,%.3f,%.3f,%.2f,%.2f,%.2f,%.3f,%d\n",
+           record.sequence - 1, wall_s, record.sysid, kindName(record.kind),
+           FlightRecord::fromE7(record.latitude_e7), FlightRecord::fromE7(record.longitude_e7), record.altitude_m,
+           record.north_m_s, record.east_m_s, record.down_m_s,
+           record.roll_deg, record.pitch_deg, record.yaw_deg, record.value,
+           (record.flags & FlightRecord::kFlagFailed) != 0 ? 1 : 0);
+}
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file> [--sysid N]\n", argv[0]);
+        return 2;
+    }
+    int sysidFilter = -1;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--sysid") == 0) {
+            sysidFilter = atoi(argv[i + 1]);
+        }
+    }
+
+    FlightLogReader log;
+    if (!log.open(argv[1])) {
+        fprintf(stderr, "%s: not a readable flight log of version %u\n", argv[1], FlightLogHeader::kVersion);
+        return 1;
+    }
+    const int64_t startWall_ns = log.header().startWall_ns;
+
+    printf("sequence,time_s,sysid,kind,latitude_deg,longitude_deg,altitude_m,"
+           "north_m_s,east_m_s,down_m_s,roll_deg,pitch_deg,yaw_deg,value,failed\n");
+    uint64_t records = 0;
+    log.forEach([&](const FlightRecord &record) {
+        if (sysidFilter >= 0 && record.sysid != sysidFilter) {
+            return;
+        }
+        printRecord(record, startWall_ns);
+        ++records;
+    });
+    fprintf(stderr, "%" PRIu64 " records\n", records);
+    return 0;
+}
@@ -0,0 +1,439 @@
+// tracking - follow_sim.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Runs the Teknofest follow engine against simulated aircraft on a virtual
+// clock, without SITL, MAVSDK or a network. Every scenario is seeded, so a
+// failing seed reproduces exactly. Scenarios run in parallel on all cores.
+//
+// Random scenarios: a scripted leader flies random turns, speed and altitude
+// changes; the follower starts at a random offset and has to close in.
+// Replay: the leader is an aircraft from a flight log written with --record.
+//
+// The error is the distance between the follower and the point the engine
+// aims for (followDistance_m behind the leader's true position), scored after
+// a warm-up; the cross-track error is its part across the leader's track.
+// Convergence time is when the error first stayed below kConverged_m for kSettle.
+// Exits with status 1 if any scenario's RMS error exceeds --max-rms.
+//
+// --mode picks the engine's setpoint type (position, velocity or
+// position-velocity) and --law the velocity mode's guidance law (l1 or pursuit).
+//
+// Usage: follow_sim [--scenarios N] [--duration S] [--seed N] [--no-prediction]
+//                   [--mode M] [--law L] [--max-rms M] [--verbose]
+//        follow_sim --replay file --sysid N [--no-prediction] [--mode M] [--law L] [--max-rms M]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Geodesy.h"
+#include "../ReplayVehicle.h"
+#include "../SimVehicle.h"
+#include "../Teknofest.h"
+#include "../VirtualClock.h"
+
+using namespace std;
+using Clock = Vehicle::Clock;
+
+namespace {
+constexpr Clock::duration kPhysicsStep = chrono::milliseconds(10);
+constexpr Clock::duration kScoreInterval = chrono::milliseconds(100);
+constexpr Clock::duration kWarmup = chrono::seconds(60);
+/// Converged once the error stays below kConverged_m for kSettle.
+constexpr double kConverged_m = 10.0;
+constexpr Clock::duration kSettle = chrono::seconds(10);
+constexpr int kLeaderId = 1;
+constexpr int kFollowerId = 2;
+const geodesy::Geodetic kWorldOrigin{41.0, 29.0, 100.0};
+
+struct Options {
+    int scenarios = 1000;
+    double duration_s = 180.0;
+    uint32_t seed = 1;
+    bool usePrediction = true;
+    Teknofest::Mode mode = Teknofest::Mode::Position;
+    guidance::Law law = guidance::Law::L1;
+    double maxRms_m = 15.0;
+    bool verbose = false;
+    string replayPath;
+    int replaySysid = -1;
+};
+
+struct Result {
+    uint32_t seed{};
+    double rms_m{};
+    double max_m{};
+    double final_m{};
+    double crossTrackRms_m{};
+    double convergence_s{};
+    uint64_t samples{};
+    Clock::duration simulated{};
+};
+
+/// Scores how far the follower is from where the engine wants it.
+class Score {
+public:
+    /// Call every kScoreInterval from the start; only samples after the warm-up count towards the RMS.
+    void add(Clock::duration elapsed, const PoseSnapshot &leaderTruth, const PoseSnapshot &followerTruth,
+             const Teknofest::Config &config) {
+        const Teknofest::Setpoint wanted = Teknofest::computeSetpoint(leaderTruth, config);
+        const geodesy::Ned offset = geodesy::LocalFrame({wanted.latitude_deg, wanted.longitude_deg,
+                                                         wanted.absolute_altitude_m})
+                .toNed({followerTruth.latitude_deg, followerTruth.longitude_deg, followerTruth.absolute_altitude_m});
+        const double error = sqrt(offset.north * offset.north + offset.east * offset.east + offset.down * offset.down);
+        if (error > kConverged_m) {
+            below = false;
+        } else if (!below) {
+            below = true;
+            belowSince = elapsed;
+        }
+        if (below && !converged && elapsed - belowSince >= kSettle) {
+            converged = true;
+            convergedAt = belowSince;
+        }
+        if (!converged) {
+            convergedAt = elapsed;
+        }
+        if (elapsed < kWarmup) {
+            return;
+        }
+        const double track_rad = wanted.yaw_deg * geodesy::kDegToRad;
+        const double crossTrack = offset.east * cos(track_rad) - offset.north * sin(track_rad);
+        sumSquares += error * error;
+        crossSquares += crossTrack * crossTrack;
+        maximum = max(maximum, error);
+        last = error;
+        ++samples;
+    }
+
+    void fill(Result &result) const {
+        result.rms_m = samples > 0 ? sqrt(sumSquares / samples) : 0.0;
+        result.crossTrackRms_m = samples > 0 ? sqrt(crossSquares / samples) : 0.0;
+        result.max_m = maximum;
+        result.final_m = last;
+        result.convergence_s = chrono::duration<double>(convergedAt).count();
+        result.samples = samples;
+    }
+
+private:
+    double sumSquares{};
+    double crossSquares{};
+    double maximum{};
+    double last{};
+    bool below{};
+    bool converged{};
+    Clock::duration belowSince{};
+    Clock::duration convergedAt{};
+    uint64_t samples{};
+};
+
+Teknofest::Config engineConfig(const Options &options) {
+    Teknofest::Config config;
+    config.usePrediction = options.usePrediction;
+    config.mode = options.mode;
+    config.guidance.law = options.law;
+    return config;
+}
+
+const char *modeName(const Options &options) {
+    switch (options.mode) {
+        case Teknofest::Mode::Position:
+            return "position";
+        case Teknofest::Mode::Velocity:
+            return options.law == guidance::Law::L1 ? "velocity, l1" : "velocity, pursuit";
+        case Teknofest::Mode::PositionVelocity:
+            return "position-velocity";
+    }
+    return "";
+}
+
+/**
+ * One random scenario, fully determined by its seed
+ * @param seed scenario seed
+ * @param options run options
+ * @return Result error statistics
+ */
+Result runScenario(uint32_t seed, const Options &options) {
+    mt19937 random(seed);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    auto between = [&](double low, double high) { return low + (high - low) * uniform(random); };
+
+    const geodesy::LocalFrame world(kWorldOrigin);
+    SimVehicle::Config airframe;
+    airframe.positionNoise_m = 1.0;
+
+    SimVehicle::State leaderStart;
+    leaderStart.heading_deg = between(0.0, 360.0);
+    leaderStart.airspeed_m_s = between(18.0, 22.0);
+    airframe.seed = seed * 2 + 1;
+    SimVehicle leader(kLeaderId, world, leaderStart, airframe);
+
+    SimVehicle::State followerStart;
+    const double heading_rad = leaderStart.heading_deg * geodesy::kDegToRad;
+    const double behind = between(50.0, 300.0);
+    const double aside = between(-100.0, 100.0);
+    followerStart.north_m = -behind * cos(heading_rad) - aside * sin(heading_rad);
+    followerStart.east_m = -behind * sin(heading_rad) + aside * cos(heading_rad);
+    followerStart.altitude_m = between(-20.0, 20.0);
+    followerStart.heading_deg = leaderStart.heading_deg + between(-60.0, 60.0);
+    followerStart.airspeed_m_s = between(16.0, 24.0);
+    airframe.seed = seed * 2 + 2;
+    SimVehicle follower(kFollowerId, world, followerStart, airframe);
+
+    const Teknofest::Config config = engineConfig(options);
+    Teknofest engine(follower, leader, config);
+
+    VirtualClock clock;
+    const Clock::duration duration = chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.duration_s));
+    Clock::time_point nextTick = clock.now();
+    Clock::time_point nextManeuver = clock.now();
+    Clock::time_point nextScore = clock.now();
+    Score score;
+    while (clock.elapsed() < duration) {
+        if (clock.now() >= nextManeuver) {
+            SimVehicle::Maneuver maneuver;
+            maneuver.turnRate_deg_s = uniform(random) < 0.3 ? 0.0 : between(-10.0, 10.0);
+            maneuver.airspeed_m_s = between(16.0, 24.0);
+            // Climb back towards the start altitude rather than drifting off.
+            maneuver.climb_m_s = between(-1.0, 1.0) - leader.truth().relative_altitude_m * 0.02;
+            leader.setManeuver(maneuver);
+            nextManeuver += chrono::duration_cast<Clock::duration>(chrono::duration<double>(between(5.0, 20.0)));
+        }
+        clock.advance(kPhysicsStep);
+        leader.step(clock.now());
+        follower.step(clock.now());
+        if (clock.now() >= nextTick) {
+            engine.tick(clock.now());
+            nextTick += engine.period();
+        }
+        if (clock.now() >= nextScore) {
+            score.add(clock.elapsed(), leader.truth(), follower.truth(), config);
+            nextScore += kScoreInterval;
+        }
+    }
+
+    Result result;
+    result.seed = seed;
+    result.simulated = clock.elapsed();
+    score.fill(result);
+    return result;
+}
+
+/**
+ * Follow a recorded aircraft with a simulated follower
+ * The world frame and the follower start 100 m behind the first recorded fix.
+ * @param records telemetry of the recorded leader
+ * @param options run options
+ * @return Result error statistics
+ */
+Result runReplay(const vector<FlightRecord> &records, const Options &options) {
+    VirtualClock clock;
+    ReplayVehicle leader(options.replaySysid, records, clock.now());
+    leader.advance(clock.now());
+    PoseSnapshot first = leader.getPose();
+    for (const FlightRecord &record: records) {
+        if (record.kind == RecordKind::Position) {
+            first.latitude_deg = FlightRecord::fromE7(record.latitude_e7);
+            first.longitude_deg = FlightRecord::fromE7(record.longitude_e7);
+            first.absolute_altitude_m = record.altitude_m;
+            break;
+        }
+    }
+    const geodesy::LocalFrame world({first.latitude_deg, first.longitude_deg, first.absolute_altitude_m});
+    double heading_rad = 0.0;
+    for (const FlightRecord &record: records) {
+        if (record.kind == RecordKind::Velocity) {
+            heading_rad = atan2(record.east_m_s, record.north_m_s);
+            break;
+        }
+    }
+    SimVehicle::State followerStart;
+    followerStart.north_m = -100.0 * cos(heading_rad);
+    followerStart.east_m = -100.0 * sin(heading_rad);
+    followerStart.heading_deg = heading_rad * geodesy::kRadToDeg;
+    SimVehicle follower(kFollowerId, world, followerStart);
+
+    const Teknofest::Config config = engineConfig(options);
+    Teknofest engine(follower, leader, config);
+
+    Clock::time_point nextTick = clock.now();
+    Clock::time_point nextScore = clock.now();
+    Score score;
+    while (!leader.finished()) {
+        clock.advance(kPhysicsStep);
+        leader.advance(clock.now());
+        follower.step(clock.now());
+        if (clock.now() >= nextTick) {
+            engine.tick(clock.now());
+            nextTick += engine.period();
+        }
+        if (clock.now() >= nextScore && leader.getPose().hasFix()) {
+            // The log is the only truth there is for a replayed leader.
+            PoseSnapshot leaderTruth = leader.getPose();
+            leaderTruth.positionTime = clock.now();
+            score.add(clock.elapsed(), leaderTruth, follower.truth(), config);
+            nextScore += kScoreInterval;
+        }
+    }
+
+    Result result;
+    result.simulated = clock.elapsed();
+    score.fill(result);
+    return result;
+}
+
+bool parse(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--scenarios" && hasValue) {
+            options.scenarios = atoi(argv[++i]);
+        } else if (arg == "--duration" && hasValue) {
+            options.duration_s = atof(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--max-rms" && hasValue) {
+            options.maxRms_m = atof(argv[++i]);
+        } else if (arg == "--replay" && hasValue) {
+            options.replayPath = argv[++i];
+        } else if (arg == "--sysid" && hasValue) {
+            options.replaySysid = atoi(argv[++i]);
+        } else if (arg == "--no-prediction") {
+            options.usePrediction = false;
+        } else if (arg == "--mode" && hasValue) {
+            const string mode = argv[++i];
+            if (mode == "position") {
+                options.mode = Teknofest::Mode::Position;
+            } else if (mode == "velocity") {
+                options.mode = Teknofest::Mode::Velocity;
+            } else if (mode == "position-velocity") {
+                options.mode = Teknofest::Mode::PositionVelocity;
+            } else {
+                return false;
+            }
+        } else if (arg == "--law" && hasValue) {
+            const string law = argv[++i];
+            if (law == "l1") {
+                options.law = guidance::Law::L1;
+            } else if (law == "pursuit") {
+                options.law = guidance::Law::PurePursuit;
+            } else {
+                return false;
+            }
+        } else if (arg == "--verbose") {
+            options.verbose = true;
+        } else {
+            return false;
+        }
+    }
+    return options.scenarios > 0 && options.duration_s > kWarmup.count() * 1e-9
+           && (options.replayPath.empty() || options.replaySysid >= 0);
+}
+
+double percentile(vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    const size_t index = min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+    nth_element(values.begin(), values.begin() + static_cast<ptrdiff_t>(index), values.end());
+    return values[index];
+}
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s [--scenarios N] [--duration S] [--seed N] [--no-prediction] [--mode M] [--law L] "
+                        "[--max-rms M] [--verbose]\n       %s --replay file --sysid N [--no-prediction] [--mode M] "
+                        "[--law L] [--max-rms M]\n"
+                        "  modes: position, velocity, position-velocity; laws: l1, pursuit\n",
+                argv[0], argv[0]);
+        return 2;
+    }
+
+    if (!options.replayPath.empty()) {
+        vector<FlightRecord> records;
+        if (!ReplayVehicle::load(options.replayPath, options.replaySysid, records)) {
+            fprintf(stderr, "%s: no telemetry for sysid %d\n", options.replayPath.c_str(), options.replaySysid);
+            return 1;
+        }
+        const Result result = runReplay(records, options);
+        if (result.samples == 0) {
+            fprintf(stderr, "log is shorter than the %lld s warm-up, nothing scored\n",
+                    static_cast<long long>(chrono::duration_cast<chrono::seconds>(kWarmup).count()));
+            return 1;
+        }
+        printf("replayed %.1f s of sysid %d (%s): rms %.2f m, cross-track rms %.2f m, max %.2f m, final %.2f m, "
+               "converged after %.1f s\n",
+               chrono::duration<double>(result.simulated).count(), options.replaySysid, modeName(options),
+               result.rms_m, result.crossTrackRms_m, result.max_m, result.final_m, result.convergence_s);
+        return result.rms_m > options.maxRms_m ? 1 : 0;
+    }
+
+    vector<Result> results(static_cast<size_t>(options.scenarios));
+    atomic<int> nextScenario{0};
+    const unsigned workers = max(1u, thread::hardware_concurrency());
+    const auto wallStart = chrono::steady_clock::now();
+    vector<thread> pool;
+    for (unsigned w = 0; w < workers; ++w) {
+        pool.emplace_back([&]() {
+            for (int i = nextScenario.fetch_add(1); i < options.scenarios; i = nextScenario.fetch_add(1)) {
+                results[static_cast<size_t>(i)] = runScenario(options.seed + static_cast<uint32_t>(i), options);
+            }
+        });
+    }
+    for (thread &worker: pool) {
+        worker.join();
+    }
+    const double wall_s = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+
+    vector<double> rms;
+    vector<double> crossTrack;
+    vector<double> convergence;
+    double simulated_s = 0.0;
+    int failed = 0;
+    for (const Result &result: results) {
+        rms.push_back(result.rms_m);
+        crossTrack.push_back(result.crossTrackRms_m);
+        convergence.push_back(result.convergence_s);
+        simulated_s += chrono::duration<double>(result.simulated).count();
+        const bool fail = result.rms_m > options.maxRms_m;
+        failed += fail ? 1 : 0;
+        if (fail || options.verbose) {
+            printf("%s seed %u: rms %.2f m, cross-track %.2f m, max %.2f m, final %.2f m, converged %.1f s\n",
+                   fail ? "FAIL" : "ok  ", result.seed, result.rms_m, result.crossTrackRms_m, result.max_m,
+                   result.final_m, result.convergence_s);
+        }
+    }
+    printf("%d scenarios of %.0f s (%s, %s), %u threads, %.2f s wall: %.0f scenarios/min, %.0fx real time\n",
+           options.scenarios, options.duration_s, modeName(options),
+           options.usePrediction ? "prediction" : "no prediction", workers, wall_s, options.scenarios / wall_s * 60.0, simulated_s / wall_s);
+    printf("rms error after %lld s warm-up: median %.2f m, p95 %.2f m, max %.2f m; %d above %.1f m\n",
+           static_cast<long long>(chrono::duration_cast<chrono::seconds>(kWarmup).count()),
+           percentile(rms, 0.5), percentile(rms, 0.95), *max_element(rms.begin(), rms.end()),
+           failed, options.maxRms_m);
+    printf("cross-track rms: median %.2f m, p95 %.2f m; converged within %.0f m after: median %.1f s, p95 %.1f s\n",
+           percentile(crossTrack, 0.5), percentile(crossTrack, 0.95), kConverged_m,
+           percentile(convergence, 0.5), percentile(convergence, 0.95));
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,274 @@
+// tracking - lossy_relay.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// UDP relay that loses, delays and blacks out MAVLink traffic on purpose, for
+// trying the tracker on a bad link without a radio.
+//
+// The vehicle side (an autopilot, SITL or mock_autopilot) sends to the listen
+// port; every datagram is forwarded to the tracker's UDP endpoint on the
+// forward port, and the tracker's answers go back to whoever sent last. A
+// datagram carries whole MAVLink frames, so dropping one loses messages, never
+// half of one. --loss drops vehicle-to-tracker datagrams, --uplink-loss the
+// other way; --burst-every/--burst black out both directions periodically;
+// --delay holds every datagram that long. Counts are printed every 5 s.
+//
+// Usage: lossy_relay --listen P --forward P [--loss P] [--uplink-loss P]
+//                    [--burst-every S --burst S] [--delay MS] [--seed N] [--duration S]
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <netinet/in.h>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+struct Options {
+    int listenPort{0};
+    int forwardPort{0};
+    /// Vehicle-to-tracker and tracker-to-vehicle drop probabilities.
+    double downlinkLoss{0.0};
+    double uplinkLoss{0.0};
+    double burstEvery_s{0.0};
+    double burst_s{0.0};
+    int delay_ms{0};
+    uint32_t seed{1};
+    double duration_s{0.0};
+};
+
+struct Held {
+    Clock::time_point due;
+    bool uplink;
+    vector<uint8_t> data;
+};
+
+struct Direction {
+    uint64_t received{};
+    uint64_t dropped{};
+    uint64_t blackedOut{};
+};
+
+class LossyRelay {
+public:
+    explicit LossyRelay(const Options &options) : options(options), rng(options.seed) {
+        vehicleSide = open(options.listenPort);
+        trackerSide = open(0);
+        tracker.sin_family = AF_INET;
+        tracker.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        tracker.sin_port = htons(static_cast<uint16_t>(options.forwardPort));
+        start = Clock::now();
+    }
+
+    ~LossyRelay() {
+        close(vehicleSide);
+        close(trackerSide);
+    }
+
+    bool isOpen() const {
+        return vehicleSide >= 0 && trackerSide >= 0;
+    }
+
+    void run() {
+        const Clock::time_point end = options.duration_s > 0.0
+                                      ? start + chrono::duration_cast<Clock::duration>(
+                                              chrono::duration<double>(options.duration_s))
+                                      : Clock::time_point::max();
+        Clock::time_point nextReport = start + chrono::seconds(5);
+        while (Clock::now() < end) {
+            Clock::time_point wake = min(end, nextReport);
+            if (!held.empty()) {
+                wake = min(wake, held.front().due);
+            }
+            const auto wait = chrono::duration_cast<chrono::milliseconds>(wake - Clock::now());
+            pollfd sockets[2] = {{vehicleSide, POLLIN, 0}, {trackerSide, POLLIN, 0}};
+            if (poll(sockets, 2, static_cast<int>(max<int64_t>(0, wait.count()))) > 0) {
+                if ((sockets[0].revents & POLLIN) != 0) {
+                    receive(vehicleSide, false);
+                }
+                if ((sockets[1].revents & POLLIN) != 0) {
+                    receive(trackerSide, true);
+                }
+            }
+            const Clock::time_point now = Clock::now();
+            while (!held.empty() && held.front().due <= now) {
+                forward(held.front().uplink, held.front().data.data(), held.front().data.size());
+                held.pop_front();
+            }
+            if (now >= nextReport) {
+                report();
+                nextReport += chrono::seconds(5);
+            }
+        }
+        report();
+    }
+
+private:
+    static int open(int port) {
+        const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        local.sin_port = htons(static_cast<uint16_t>(port));
+        if (sock >= 0 && bind(sock, reinterpret_cast<sockaddr *>(&local), sizeof(local)) != 0) {
+            close(sock);
+            return -1;
+        }
+        return sock;
+    }
+
+    /// Inside a periodic blackout window: nothing gets through in either direction.
+    bool blackedOut(Clock::time_point now) const {
+        if (options.burstEvery_s <= 0.0 || options.burst_s <= 0.0) {
+            return false;
+        }
+        const double t = chrono::duration<double>(now - start).count();
+        return fmod(t, options.burstEvery_s) >= options.burstEvery_s - options.burst_s;
+    }
+
+    void receive(int sock, bool uplink) {
+        uint8_t buffer[65536];
+        sockaddr_in from{};
+        socklen_t fromLength = sizeof(from);
+        const ssize_t length = recvfrom(sock, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&from),
+                                        &fromLength);
+        if (length <= 0) {
+            return;
+        }
+        if (!uplink) {
+            // Answers go back to whoever the vehicle side is now.
+            vehicle = from;
+            hasVehicle = true;
+        }
+        Direction &counts = uplink ? up : down;
+        ++counts.received;
+        const Clock::time_point now = Clock::now();
+        if (blackedOut(now)) {
+            ++counts.blackedOut;
+            return;
+        }
+        if (chance(rng) < (uplink ? options.uplinkLoss : options.downlinkLoss)) {
+            ++counts.dropped;
+            return;
+        }
+        if (options.delay_ms > 0) {
+            held.push_back({now + chrono::milliseconds(options.delay_ms), uplink,
+                            vector<uint8_t>(buffer, buffer + length)});
+            return;
+        }
+        forward(uplink, buffer, static_cast<size_t>(length));
+    }
+
+    void forward(bool uplink, const uint8_t *data, size_t length) {
+        if (uplink) {
+            if (hasVehicle) {
+                sendto(vehicleSide, data, length, 0, reinterpret_cast<const sockaddr *>(&vehicle), sizeof(vehicle));
+            }
+        } else {
+            sendto(trackerSide, data, length, 0, reinterpret_cast<const sockaddr *>(&tracker), sizeof(tracker));
+        }
+    }
+
+    void report() const {
+        const auto share = [](const Direction &counts) {
+            return counts.received == 0
+                   ? 0.0 : 100.0 * static_cast<double>(counts.dropped + counts.blackedOut) / counts.received;
+        };
+        printf("relay: down %llu received, %llu dropped, %llu blacked out (%.1f%%); "
+               "up %llu received, %llu dropped, %llu blacked out (%.1f%%)\n",
+               static_cast<unsigned long long>(down.received), static_cast<unsigned long long>(down.dropped),
+               static_cast<unsigned long long>(down.blackedOut), share(down),
+               static_cast<unsigned long long>(up.received), static_cast<unsigned long long>(up.dropped),
+               static_cast<unsigned long long>(up.blackedOut), share(up));
+        fflush(stdout);
+    }
+
+    const Options options;
+    mt19937 rng;
+    uniform_real_distribution<double> chance{0.0, 1.0};
+    int vehicleSide{-1};
+    int trackerSide{-1};
+    sockaddr_in tracker{};
+    sockaddr_in vehicle{};
+    bool hasVehicle{false};
+    Clock::time_point start;
+    /// Delayed datagrams; one delay for all, so they are due in arrival order.
+    deque<Held> held;
+    Direction down;
+    Direction up;
+};
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const string arg = argv[i];
+        if (arg == "--listen") {
+            options.listenPort = atoi(argv[i + 1]);
+        } else if (arg == "--forward") {
+            options.forwardPort = atoi(argv[i + 1]);
+        } else if (arg == "--loss") {
+            options.downlinkLoss = atof(argv[i + 1]);
+        } else if (arg == "--uplink-loss") {
+            options.uplinkLoss = atof(argv[i + 1]);
+        } else if (arg == "--burst-every") {
+            options.burstEvery_s = atof(argv[i + 1]);
+        } else if (arg == "--burst") {
+            options.burst_s = atof(argv[i + 1]);
+        } else if (arg == "--delay") {
+            options.delay_ms = atoi(argv[i + 1]);
+        } else if (arg == "--seed") {
+            options.seed = static_cast<uint32_t>(strtoul(argv[i + 1], nullptr, 10));
+        } else if (arg == "--duration") {
+            options.duration_s = atof(argv[i + 1]);
+        } else {
+            options.listenPort = 0;
+            break;
+        }
+    }
+    if (options.listenPort <= 0 || options.forwardPort <= 0) {
+        fprintf(stderr, "Usage: %s --listen P --forward P [--loss P] [--uplink-loss P] "
+                        "[--burst-every S --burst S] [--delay MS] [--seed N] [--duration S]\n", argv[0]);
+        return 2;
+    }
+    if (options.downlinkLoss < 0.0 || options.downlinkLoss > 1.0 || options.uplinkLoss < 0.0
+        || options.uplinkLoss > 1.0 || options.burst_s > options.burstEvery_s) {
+        fprintf(stderr, "loss must be 0..1 and the burst shorter than its period\n");
+        return 2;
+    }
+
+    LossyRelay relay(options);
+    if (!relay.isOpen()) {
+        perror("socket");
+        return 1;
+    }
+    printf("relay: 127.0.0.1:%d -> 127.0.0.1:%d, loss %.0f%% down %.0f%% up, delay %d ms\n", options.listenPort,
+           options.forwardPort, options.downlinkLoss * 100.0, options.uplinkLoss * 100.0, options.delay_ms);
+    fflush(stdout);
+    relay.run();
+    return 0;
+}
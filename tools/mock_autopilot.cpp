@@ -0,0 +1,454 @@
+// tracking - mock_autopilot.cpp
+// Copyright (c) 2024 Neo Stellar Ltd.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Stand-in autopilot speaking MAVLink 2 over loopback UDP, for measuring the
+// real stack: MAVSDK parsing and callbacks plus our plane and follow code.
+//
+// It plays N fixed-wing systems (sysid 1..N) flying circles, sending
+// HEARTBEAT at 1 Hz and GLOBAL_POSITION_INT and ATTITUDE at the given rate to
+// a MAVSDK UDP endpoint. Commands are acknowledged as accepted; requests for
+// GPS_GLOBAL_ORIGIN, HOME_POSITION and AUTOPILOT_VERSION are answered.
+//
+// Latency: every GLOBAL_POSITION_INT carries a tag in its altitude (millimetres
+// above a 100 m base). The follow path copies the leader altitude into the
+// SET_POSITION_TARGET_GLOBAL_INT it sends, so the tag identifies the sample a
+// command was computed from. The first command seen for each sample gives one
+// telemetry-to-command latency; both ends are timestamped here on one clock.
+// Run the follow engine without prediction, so the altitude is passed through.
+//
+// Usage: mock_autopilot [--systems N] [--rate HZ] [--port P] [--duration S]
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+using Clock = chrono::steady_clock;
+
+// Message ids, payload lengths and CRC extras from the MAVLink common dialect.
+constexpr uint32_t kHeartbeat = 0;
+constexpr uint32_t kAttitude = 30;
+constexpr uint32_t kGlobalPositionInt = 33;
+constexpr uint32_t kGpsGlobalOrigin = 49;
+constexpr uint32_t kCommandLong = 76;
+constexpr uint32_t kCommandAck = 77;
+constexpr uint32_t kSetPositionTargetGlobalInt = 86;
+constexpr uint32_t kAutopilotVersion = 148;
+constexpr uint32_t kHomePosition = 242;
+
+constexpr uint16_t kCmdSetMessageInterval = 511;
+constexpr uint16_t kCmdRequestMessage = 512;
+/// Older MAVSDK versions ask for the version this way.
+constexpr uint16_t kCmdRequestAutopilotCapabilities = 520;
+
+struct MessageInfo {
+    uint32_t id;
+    uint8_t length;
+    uint8_t crcExtra;
+};
+
+constexpr MessageInfo kMessages[] = {
+        {kHeartbeat, 9, 50},
+        {kAttitude, 28, 39},
+        {kGlobalPositionInt, 28, 104},
+        {kGpsGlobalOrigin, 12, 39},
+        {kCommandLong, 33, 152},
+        {kCommandAck, 10, 143},
+        {kSetPositionTargetGlobalInt, 53, 5},
+        {kAutopilotVersion, 60, 178},
+        {kHomePosition, 52, 104},
+};
+
+const MessageInfo *findMessage(uint32_t id) {
+    for (const MessageInfo &info: kMessages) {
+        if (info.id == id) {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+/// X.25 / MCRF4XX checksum used by MAVLink.
+void crcAccumulate(uint8_t byte, uint16_t &crc) {
+    uint8_t tmp = byte ^ static_cast<uint8_t>(crc & 0xff);
+    tmp ^= static_cast<uint8_t>(tmp << 4);
+    crc = static_cast<uint16_t>((crc >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4));
+}
+
+uint16_t crc(const uint8_t *data, size_t length, uint8_t extra) {
+    uint16_t value = 0xffff;
+    for (size_t i = 0; i < length; ++i) {
+        crcAccumulate(data[i], value);
+    }
+    crcAccumulate(extra, value);
+    return value;
+}
+
+template<typename T>
+void put(uint8_t *payload, size_t offset, T value) {
+    memcpy(payload + offset, &value, sizeof(T));
+}
+
+template<typename T>
+T get(const uint8_t *payload, size_t offset) {
+    T value;
+    memcpy(&value, payload + offset, sizeof(T));
+    return value;
+}
+
+/// Time from the first tag sent to a command arriving, per tag, and the resulting samples.
+class LatencyTracker {
+public:
+    static constexpr uint32_t kTags = 100000;
+    static constexpr int32_t kBaseAltitude_mm = 100000;
+
+    uint32_t nextTag() {
+        const uint32_t tag = counter++ % kTags;
+        sentAt[tag] = Clock::now();
+        matched[tag] = false;
+        return tag;
+    }
+
+    void commandReceived(float altitude_m, Clock::time_point when) {
+        ++commands;
+        const long tag = lround(altitude_m * 1000.0 - kBaseAltitude_mm);
+        if (tag < 0 || tag >= static_cast<long>(kTags) || matched[tag] || sentAt[tag] == Clock::time_point{}) {
+            return;
+        }
+        matched[tag] = true;
+        latencies_us.push_back(chrono::duration<double, micro>(when - sentAt[tag]).count());
+    }
+
+    void report(uint64_t telemetrySent) const {
+        printf("mock: %llu telemetry messages sent, %llu position commands received, %zu matched\n",
+               static_cast<unsigned long long>(telemetrySent), static_cast<unsigned long long>(commands),
+               latencies_us.size());
+        if (latencies_us.empty()) {
+            return;
+        }
+        vector<double> sorted = latencies_us;
+        sort(sorted.begin(), sorted.end());
+        auto at = [&sorted](double fraction) {
+            return sorted[min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+        };
+        printf("telemetry-to-command latency (us): p50 %.0f  p90 %.0f  p99 %.0f  p99.9 %.0f  max %.0f\n",
+               at(0.5), at(0.9), at(0.99), at(0.999), sorted.back());
+    }
+
+private:
+    uint64_t counter{};
+    uint64_t commands{};
+    vector<Clock::time_point> sentAt = vector<Clock::time_point>(kTags);
+    vector<bool> matched = vector<bool>(kTags);
+    vector<double> latencies_us;
+};
+
+class MockAutopilot {
+public:
+    MockAutopilot(int systems, double rateHz, int port)
+            : systems(systems), rateHz(rateHz), sequence(static_cast<size_t>(systems) + 1) {
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(sock, reinterpret_cast<sockaddr *>(&local), sizeof(local));
+        target.sin_family = AF_INET;
+        target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        target.sin_port = htons(static_cast<uint16_t>(port));
+        start = Clock::now();
+    }
+
+    ~MockAutopilot() {
+        close(sock);
+    }
+
+    bool isOpen() const {
+        return sock >= 0;
+    }
+
+    void run(Clock::duration duration) {
+        const Clock::duration telemetryPeriod = chrono::duration_cast<Clock::duration>(
+                chrono::duration<double>(1.0 / rateHz));
+        Clock::time_point nextHeartbeat = Clock::now();
+        Clock::time_point nextTelemetry = Clock::now();
+        const Clock::time_point end = Clock::now() + duration;
+        while (Clock::now() < end) {
+            const Clock::time_point now = Clock::now();
+            if (now >= nextHeartbeat) {
+                for (int id = 1; id <= systems; ++id) {
+                    sendHeartbeat(static_cast<uint8_t>(id));
+                }
+                nextHeartbeat += chrono::seconds(1);
+            }
+            if (now >= nextTelemetry) {
+                for (int id = 1; id <= systems; ++id) {
+                    sendTelemetry(static_cast<uint8_t>(id));
+                }
+                nextTelemetry += telemetryPeriod;
+            }
+            const Clock::time_point wake = min({nextHeartbeat, nextTelemetry, end});
+            const auto wait = chrono::duration_cast<chrono::milliseconds>(wake - Clock::now());
+            pollfd readable{sock, POLLIN, 0};
+            if (poll(&readable, 1, static_cast<int>(max<int64_t>(0, wait.count()))) > 0) {
+                receive();
+            }
+        }
+        latency.report(telemetrySent);
+    }
+
+private:
+    void send(uint8_t sysid, uint32_t id, const uint8_t *payload, uint8_t length) {
+        const MessageInfo *info = findMessage(id);
+        // MAVLink 2 drops trailing zero bytes of the payload.
+        while (length > 1 && payload[length - 1] == 0) {
+            --length;
+        }
+        uint8_t frame[280];
+        frame[0] = 0xfd;
+        frame[1] = length;
+        frame[2] = 0;
+        frame[3] = 0;
+        frame[4] = sequence[sysid]++;
+        frame[5] = sysid;
+        frame[6] = 1;
+        frame[7] = static_cast<uint8_t>(id & 0xff);
+        frame[8] = static_cast<uint8_t>((id >> 8) & 0xff);
+        frame[9] = static_cast<uint8_t>((id >> 16) & 0xff);
+        memcpy(frame + 10, payload, length);
+        const uint16_t checksum = crc(frame + 1, 9u + length, info->crcExtra);
+        frame[10 + length] = static_cast<uint8_t>(checksum & 0xff);
+        frame[11 + length] = static_cast<uint8_t>(checksum >> 8);
+        sendto(sock, frame, 12u + length, 0, reinterpret_cast<const sockaddr *>(&target), sizeof(target));
+    }
+
+    uint32_t bootMs() const {
+        return static_cast<uint32_t>(chrono::duration_cast<chrono::milliseconds>(Clock::now() - start).count());
+    }
+
+    /// Each system circles its own centre at 20 m/s.
+    void position(uint8_t sysid, double &lat, double &lon, double &north, double &east, double &heading) const {
+        constexpr double kRadius_m = 300.0;
+        constexpr double kSpeed_m_s = 20.0;
+        constexpr double kMetersPerDegree = 111320.0;
+        const double t = chrono::duration<double>(Clock::now() - start).count();
+        const double angle = t * kSpeed_m_s / kRadius_m + sysid;
+        lat = 41.0 + (kRadius_m * cos(angle) + sysid * 50.0) / kMetersPerDegree;
+        lon = 29.0 + kRadius_m * sin(angle) / (kMetersPerDegree * cos(41.0 * M_PI / 180.0));
+        north = -kSpeed_m_s * sin(angle);
+        east = kSpeed_m_s * cos(angle);
+        heading = atan2(east, north);
+    }
+
+    void sendHeartbeat(uint8_t sysid) {
+        uint8_t payload[9]{};
+        // PX4 auto mode, loiter submode.
+        put<uint32_t>(payload, 0, (4u << 16) | (3u << 24));
+        payload[4] = 1;    // MAV_TYPE_FIXED_WING
+        payload[5] = 12;   // MAV_AUTOPILOT_PX4
+        payload[6] = 0x81; // armed, custom mode
+        payload[7] = 4;    // MAV_STATE_ACTIVE
+        payload[8] = 3;
+        send(sysid, kHeartbeat, payload, sizeof(payload));
+    }
+
+    void sendTelemetry(uint8_t sysid) {
+        double lat, lon, north, east, heading;
+        position(sysid, lat, lon, north, east, heading);
+        const uint32_t tag = latency.nextTag();
+
+        uint8_t global[28]{};
+        put<uint32_t>(global, 0, bootMs());
+        put<int32_t>(global, 4, static_cast<int32_t>(lround(lat * 1e7)));
+        put<int32_t>(global, 8, static_cast<int32_t>(lround(lon * 1e7)));
+        put<int32_t>(global, 12, LatencyTracker::kBaseAltitude_mm + static_cast<int32_t>(tag));
+        put<int32_t>(global, 16, static_cast<int32_t>(tag));
+        put<int16_t>(global, 20, static_cast<int16_t>(lround(north * 100)));
+        put<int16_t>(global, 22, static_cast<int16_t>(lround(east * 100)));
+        put<uint16_t>(global, 26, static_cast<uint16_t>(lround(fmod(heading * 18000.0 / M_PI + 36000.0, 36000.0))));
+        send(sysid, kGlobalPositionInt, global, sizeof(global));
+
+        uint8_t attitude[28]{};
+        put<uint32_t>(attitude, 0, bootMs());
+        put<float>(attitude, 4, 0.35f);
+        put<float>(attitude, 12, static_cast<float>(heading));
+        send(sysid, kAttitude, attitude, sizeof(attitude));
+        telemetrySent += 2;
+    }
+
+    void sendAck(uint8_t sysid, uint16_t command, uint8_t toSystem, uint8_t toComponent) {
+        uint8_t payload[10]{};
+        put<uint16_t>(payload, 0, command);
+        payload[2] = 0; // MAV_RESULT_ACCEPTED
+        payload[8] = toSystem;
+        payload[9] = toComponent;
+        send(sysid, kCommandAck, payload, sizeof(payload));
+    }
+
+    void sendRequested(uint8_t sysid, uint32_t message) {
+        if (message == kGpsGlobalOrigin || message == kHomePosition) {
+            double lat, lon, north, east, heading;
+            position(sysid, lat, lon, north, east, heading);
+            uint8_t payload[52]{};
+            put<int32_t>(payload, 0, static_cast<int32_t>(lround(lat * 1e7)));
+            put<int32_t>(payload, 4, static_cast<int32_t>(lround(lon * 1e7)));
+            put<int32_t>(payload, 8, LatencyTracker::kBaseAltitude_mm);
+            put<float>(payload, 24, 1.0f); // q[0], identity attitude
+            send(sysid, message, payload, message == kGpsGlobalOrigin ? 12 : 52);
+        } else if (message == kAutopilotVersion) {
+            uint8_t payload[60]{};
+            // MISSION_INT | COMMAND_INT | SET_POSITION_TARGET_GLOBAL_INT | MAVLINK2
+            put<uint64_t>(payload, 0, 4u | 8u | 256u | 8192u);
+            put<uint64_t>(payload, 8, 0x4d4f434b00000000ull | sysid);
+            put<uint32_t>(payload, 16, 0x010e0000u);
+            send(sysid, kAutopilotVersion, payload, sizeof(payload));
+        }
+    }
+
+    void receive() {
+        uint8_t buffer[2048];
+        sockaddr_in from{};
+        socklen_t fromLength = sizeof(from);
+        const ssize_t length = recvfrom(sock, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&from),
+                                        &fromLength);
+        const Clock::time_point now = Clock::now();
+        if (length <= 0) {
+            return;
+        }
+        // Reply to wherever MAVSDK sends from.
+        target = from;
+        size_t offset = 0;
+        while (offset < static_cast<size_t>(length)) {
+            offset += parse(buffer + offset, static_cast<size_t>(length) - offset, now);
+        }
+    }
+
+    /**
+     * Parse one MAVLink 1 or 2 frame at the start of the buffer
+     * @return size_t bytes consumed
+     */
+    size_t parse(const uint8_t *data, size_t available, Clock::time_point now) {
+        if (data[0] != 0xfd && data[0] != 0xfe) {
+            return 1;
+        }
+        const bool v2 = data[0] == 0xfd;
+        const size_t header = v2 ? 10 : 6;
+        if (available < header + 2) {
+            return available;
+        }
+        const uint8_t length = data[1];
+        const bool signed2 = v2 && (data[2] & 0x01) != 0;
+        const size_t total = header + length + 2 + (signed2 ? 13 : 0);
+        if (available < total) {
+            return available;
+        }
+        const uint32_t id = v2 ? (data[7] | (data[8] << 8) | (data[9] << 16)) : data[5];
+        const MessageInfo *info = findMessage(id);
+        if (info == nullptr) {
+            return total;
+        }
+        const uint16_t expected = crc(data + 1, header - 1 + length, info->crcExtra);
+        if ((data[header + length] | (data[header + length + 1] << 8)) != expected) {
+            return total;
+        }
+        uint8_t payload[256]{};
+        memcpy(payload, data + header, length);
+        const uint8_t fromSystem = v2 ? data[5] : data[3];
+        const uint8_t fromComponent = v2 ? data[6] : data[4];
+        handle(id, payload, fromSystem, fromComponent, now);
+        return total;
+    }
+
+    void handle(uint32_t id, const uint8_t *payload, uint8_t fromSystem, uint8_t fromComponent,
+                Clock::time_point now) {
+        if (id == kSetPositionTargetGlobalInt) {
+            latency.commandReceived(get<float>(payload, 12), now);
+        } else if (id == kCommandLong) {
+            const uint16_t command = get<uint16_t>(payload, 28);
+            const uint8_t targetSystem = payload[30];
+            for (int sysid = 1; sysid <= systems; ++sysid) {
+                if (targetSystem != 0 && targetSystem != sysid) {
+                    continue;
+                }
+                sendAck(static_cast<uint8_t>(sysid), command, fromSystem, fromComponent);
+                if (command == kCmdRequestMessage) {
+                    sendRequested(static_cast<uint8_t>(sysid), static_cast<uint32_t>(get<float>(payload, 0)));
+                } else if (command == kCmdRequestAutopilotCapabilities) {
+                    sendRequested(static_cast<uint8_t>(sysid), kAutopilotVersion);
+                }
+            }
+        }
+        (void) kCmdSetMessageInterval; // acknowledged like everything else, rates are fixed here
+    }
+
+    const int systems;
+    const double rateHz;
+    int sock{-1};
+    sockaddr_in target{};
+    Clock::time_point start;
+    vector<uint8_t> sequence;
+    uint64_t telemetrySent{};
+    LatencyTracker latency;
+};
+}
+
+int main(int argc, char **argv) {
+    int systems = 2;
+    double rateHz = 50.0;
+    int port = 14540;
+    double duration_s = 40.0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const string arg = argv[i];
+        if (arg == "--systems") {
+            systems = atoi(argv[i + 1]);
+        } else if (arg == "--rate") {
+            rateHz = atof(argv[i + 1]);
+        } else if (arg == "--port") {
+            port = atoi(argv[i + 1]);
+        } else if (arg == "--duration") {
+            duration_s = atof(argv[i + 1]);
+        } else {
+            fprintf(stderr, "Usage: %s [--systems N] [--rate HZ] [--port P] [--duration S]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (systems < 1 || systems > 254 || rateHz <= 0.0) {
+        fprintf(stderr, "systems must be 1..254 and rate positive\n");
+        return 2;
+    }
+
+    MockAutopilot autopilot(systems, rateHz, port);
+    if (!autopilot.isOpen()) {
+        perror("socket");
+        return 1;
+    }
+    printf("mock: %d systems at %.0f Hz to 127.0.0.1:%d for %.0f s\n", systems, rateHz, port, duration_s);
+    fflush(stdout);
+    autopilot.run(chrono::duration_cast<Clock::duration>(chrono::duration<double>(duration_s)));
+    return 0;
+}